@@ -0,0 +1,218 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file arena.c
+ * @brief Scratch memory arena
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "jabcode.h"
+#include "arena.h"
+
+#define ARENA_ALIGNMENT	16
+#define ARENA_NO_BLOCK	((size_t)-1)
+#define ARENA_ALIGN(x)	(((x) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+/**
+ * @brief Header in front of every arena block
+*/
+typedef struct {
+	size_t	prev;		///< The offset of the previous block header in the chunk
+	size_t	freed;		///< Whether the block has been freed
+}jab_arena_block;
+
+/**
+ * @brief The arena the scratch allocations of the current thread are served from, NULL for the heap
+*/
+static _Thread_local jab_arena* scratch_arena = NULL;
+
+/**
+ * @brief Allocate a new arena chunk and make it the head
+ * @param arena the arena
+ * @param size the minimal usable size of the chunk
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+static jab_boolean addChunk(jab_arena* arena, size_t size)
+{
+	size = ARENA_ALIGN(size);
+	jab_arena_chunk* chunk = (jab_arena_chunk*)malloc(sizeof(jab_arena_chunk) + size);
+	if(chunk == NULL)
+	{
+		reportError("Memory allocation for scratch arena failed");
+		return JAB_FAILURE;
+	}
+	chunk->prev = arena->head;
+	chunk->size = size;
+	chunk->used = 0;
+	chunk->last = ARENA_NO_BLOCK;
+	arena->head = chunk;
+	arena->reserved += size;
+	arena->heap_allocs++;
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Initialize an arena
+ * @param arena the arena
+ * @param size the initial size in bytes, 0 for the default size
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean initArena(jab_arena* arena, size_t size)
+{
+	memset(arena, 0, sizeof(jab_arena));
+	return addChunk(arena, size > 0 ? size : ARENA_DEFAULT_SIZE);
+}
+
+/**
+ * @brief Free all chunks of an arena
+ * @param arena the arena
+*/
+void releaseArena(jab_arena* arena)
+{
+	while(arena->head)
+	{
+		jab_arena_chunk* prev = arena->head->prev;
+		free(arena->head);
+		arena->head = prev;
+	}
+	arena->live = 0;
+	arena->peak = 0;
+	arena->reserved = 0;
+}
+
+/**
+ * @brief Discard all blocks of an arena. If the arena had to grow, its chunks are merged into a single one
+ * that holds the previous peak, so that a following run of the same workload does not touch the heap.
+ * @param arena the arena
+*/
+void resetArena(jab_arena* arena)
+{
+	arena->heap_allocs = 0;
+	arena->allocs = 0;
+	arena->alloc_bytes = 0;
+	if(arena->head && arena->head->prev)
+	{
+		size_t size = arena->reserved;
+		releaseArena(arena);
+		addChunk(arena, size);
+	}
+	if(arena->head)
+	{
+		arena->head->used = 0;
+		arena->head->last = ARENA_NO_BLOCK;
+	}
+	arena->live = 0;
+	arena->peak = 0;
+}
+
+/**
+ * @brief Set the arena the scratch allocations of the calling thread are served from.
+ * Blocks of an arena must be freed before it is unset or while it is set again.
+ * @param arena the arena, NULL to allocate scratch memory from the heap
+ * @return the previously set arena
+*/
+jab_arena* setScratchArena(jab_arena* arena)
+{
+	jab_arena* prev = scratch_arena;
+	scratch_arena = arena;
+	return prev;
+}
+
+/**
+ * @brief Allocate scratch memory
+ * @param size the size in bytes
+ * @return the allocated memory | NULL if failed
+*/
+void* scratchMalloc(size_t size)
+{
+	jab_arena* arena = scratch_arena;
+	if(arena == NULL)
+		return malloc(size);
+	if(size > SIZE_MAX - sizeof(jab_arena_block) - ARENA_ALIGNMENT)
+		return NULL;
+
+	size_t block_size = sizeof(jab_arena_block) + ARENA_ALIGN(size);
+	if(arena->head == NULL || arena->head->size - arena->head->used < block_size)
+	{
+		size_t chunk_size = arena->head ? arena->head->size * 2 : ARENA_DEFAULT_SIZE;
+		if(!addChunk(arena, MAX(chunk_size, block_size)))
+			return NULL;
+	}
+	jab_arena_chunk* chunk = arena->head;
+	jab_arena_block* block = (jab_arena_block*)(chunk->mem + chunk->used);
+	block->prev = chunk->last;
+	block->freed = 0;
+	chunk->last = chunk->used;
+	chunk->used += block_size;
+
+	arena->live += block_size;
+	if(arena->live > arena->peak)
+		arena->peak = arena->live;
+	arena->allocs++;
+	arena->alloc_bytes += size;
+	return (jab_byte*)block + sizeof(jab_arena_block);
+}
+
+/**
+ * @brief Allocate zero-initialized scratch memory
+ * @param count the number of elements
+ * @param size the size of each element in bytes
+ * @return the allocated memory | NULL if failed
+*/
+void* scratchCalloc(size_t count, size_t size)
+{
+	if(scratch_arena == NULL)
+		return calloc(count, size);
+	//a wrapped product would return a block smaller than requested
+	if(size != 0 && count > SIZE_MAX / size)
+		return NULL;
+
+	void* ptr = scratchMalloc(count * size);
+	if(ptr)
+		memset(ptr, 0, count * size);
+	return ptr;
+}
+
+/**
+ * @brief Free scratch memory. The memory must be freed with the arena set that it was allocated from;
+ * with no arena set, it is passed to free(), which is only valid for memory allocated from the heap.
+ * @param ptr the memory allocated by scratchMalloc or scratchCalloc
+*/
+void scratchFree(void* ptr)
+{
+	if(ptr == NULL)
+		return;
+	jab_arena* arena = scratch_arena;
+	jab_arena_chunk* chunk = arena ? arena->head : NULL;
+	while(chunk && ((jab_byte*)ptr < chunk->mem || (jab_byte*)ptr >= chunk->mem + chunk->used))
+	{
+		chunk = chunk->prev;
+	}
+	//memory not owned by the arena
+	if(chunk == NULL)
+	{
+		free(ptr);
+		return;
+	}
+
+	jab_arena_block* block = (jab_arena_block*)((jab_byte*)ptr - sizeof(jab_arena_block));
+	block->freed = 1;
+	//release all freed blocks on top of the chunk
+	while(chunk->last != ARENA_NO_BLOCK)
+	{
+		block = (jab_arena_block*)(chunk->mem + chunk->last);
+		if(!block->freed)
+			break;
+		arena->live -= chunk->used - chunk->last;
+		chunk->used = chunk->last;
+		chunk->last = block->prev;
+	}
+}
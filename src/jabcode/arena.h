@@ -0,0 +1,57 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file arena.h
+ * @brief Scratch memory arena header
+ */
+
+#ifndef JABCODE_ARENA_H
+#define JABCODE_ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_DEFAULT_SIZE	(4 * 1024 * 1024)	//initial arena size in bytes if not specified
+
+/**
+ * @brief A contiguous block of arena memory
+*/
+typedef struct jab_arena_chunk {
+	struct jab_arena_chunk*	prev;		///< The previously allocated chunk
+	size_t					size;		///< The usable size in bytes
+	size_t					used;		///< The used size in bytes
+	size_t					last;		///< The offset of the last block header in the chunk
+	jab_byte				mem[];
+}jab_arena_chunk;
+
+/**
+ * @brief Scratch memory arena
+ *
+ * Allocations are served from the head chunk in LIFO order. Freeing the most recent
+ * block returns its memory immediately, freeing any other block defers the release
+ * until the blocks above it are freed or the arena is reset.
+*/
+typedef struct {
+	jab_arena_chunk*	head;			///< The chunk new blocks are carved from
+	size_t				live;			///< The bytes currently in use
+	size_t				peak;			///< The maximal bytes in use since the last reset
+	size_t				reserved;		///< The total size of all chunks
+	jab_int32			heap_allocs;	///< The number of chunks allocated since the last reset
+	jab_int32			allocs;			///< The number of blocks allocated since the last reset
+	size_t				alloc_bytes;	///< The bytes requested by the blocks allocated since the last reset
+}jab_arena;
+
+extern jab_boolean initArena(jab_arena* arena, size_t size);
+extern void resetArena(jab_arena* arena);
+extern void releaseArena(jab_arena* arena);
+extern jab_arena* setScratchArena(jab_arena* arena);
+extern void* scratchMalloc(size_t size);
+extern void* scratchCalloc(size_t count, size_t size);
+extern void scratchFree(void* ptr);
+
+#endif
@@ -15,6 +15,9 @@
 #include <stdio.h>
 #include <string.h>
 #include "jabcode.h"
+#include "detector.h"
+#include "arena.h"
+#include "timer.h"
 #include <math.h>
 
 #define BLOCK_SIZE_POWER	5
@@ -105,7 +108,7 @@ jab_int32 getMinimumThreshold(jab_int32 hist[], jab_int32 channel)
 */
 jab_bitmap* binarizerHist(jab_bitmap* bitmap, jab_int32 channel)
 {
-	jab_bitmap* binary = (jab_bitmap*)malloc(sizeof(jab_bitmap) + bitmap->width*bitmap->height*sizeof(jab_byte));
+	jab_bitmap* binary = (jab_bitmap*)scratchMalloc(sizeof(jab_bitmap) + bitmap->width*bitmap->height*sizeof(jab_byte));
 	if(binary == NULL)
 	{
 		reportError("Memory allocation for binary bitmap failed");
@@ -183,7 +186,7 @@ jab_bitmap* binarizerHist(jab_bitmap* bitmap, jab_int32 channel)
 */
 jab_bitmap* binarizerHard(jab_bitmap* bitmap, jab_int32 channel, jab_int32 threshold)
 {
-	jab_bitmap* binary = (jab_bitmap*)malloc(sizeof(jab_bitmap) + bitmap->width*bitmap->height*sizeof(jab_byte));
+	jab_bitmap* binary = (jab_bitmap*)scratchMalloc(sizeof(jab_bitmap) + bitmap->width*bitmap->height*sizeof(jab_byte));
 	if(binary == NULL)
 	{
 		reportError("Memory allocation for binary bitmap failed");
@@ -357,7 +360,7 @@ void filterBinary(jab_bitmap* binary)
 	jab_int32 filter_size = 5;
 	jab_int32 half_size = (filter_size - 1)/2;
 
-	jab_bitmap* tmp = (jab_bitmap*)malloc(sizeof(jab_bitmap) + width*height*sizeof(jab_byte));
+	jab_bitmap* tmp = (jab_bitmap*)scratchMalloc(sizeof(jab_bitmap) + width*height*sizeof(jab_byte));
 	if(tmp == NULL)
 	{
 		reportError("Memory allocation for temporary binary bitmap failed");
@@ -396,7 +399,7 @@ void filterBinary(jab_bitmap* binary)
 			binary->pixel[i*width + j] = sum > half_size ? 255 : 0;
 		}
 	}
-	free(tmp);
+	scratchFree(tmp);
 }
 
 /**
@@ -414,7 +417,7 @@ jab_bitmap* binarizer(jab_bitmap* bitmap, jab_int32 channel)
 		jab_int32 sub_height= bitmap->height>> BLOCK_SIZE_POWER;
 		if((sub_height & BLOCK_SIZE_MASK) != 0 )	sub_height++;
 
-		jab_byte* black_points = (jab_byte*)malloc(sub_width * sub_height * sizeof(jab_byte));
+		jab_byte* black_points = (jab_byte*)scratchMalloc(sub_width * sub_height * sizeof(jab_byte));
 		if(black_points == NULL)
 		{
 			reportError("Memory allocation for black points failed");
@@ -422,7 +425,7 @@ jab_bitmap* binarizer(jab_bitmap* bitmap, jab_int32 channel)
 		}
 		calculateBlackPoints(bitmap, channel, sub_width, sub_height, black_points);
 
-		jab_bitmap* binary = (jab_bitmap*)calloc(1, sizeof(jab_bitmap) + bitmap->width*bitmap->height*sizeof(jab_byte));
+		jab_bitmap* binary = (jab_bitmap*)scratchCalloc(1, sizeof(jab_bitmap) + bitmap->width*bitmap->height*sizeof(jab_byte));
 		if(binary == NULL)
 		{
 			reportError("Memory allocation for binary bitmap failed");
@@ -437,7 +440,7 @@ jab_bitmap* binarizer(jab_bitmap* bitmap, jab_int32 channel)
 
 		filterBinary(binary);
 
-		free(black_points);
+		scratchFree(black_points);
 		return binary;
 	}
 	else
@@ -447,23 +450,6 @@ jab_bitmap* binarizer(jab_bitmap* bitmap, jab_int32 channel)
 	}
 }
 
-/**
- * @brief Get the histogram of a color channel
- * @param bitmap the image
- * @param channel the channel
- * @param hist the histogram
-*/
-void getHistogram(jab_bitmap* bitmap, jab_int32 channel, jab_int32 hist[256])
-{
-	//get histogram
-	memset(hist, 0, 256*sizeof(jab_int32));
-	jab_int32 bytes_per_pixel = bitmap->bits_per_pixel / 8;
-	for(jab_int32 i=0; i<bitmap->width*bitmap->height; i++)
-	{
-		hist[bitmap->pixel[i*bytes_per_pixel + channel]]++;
-	}
-}
-
 /**
  * @brief Get the min and max index in the histogram whose value is larger than the threshold
  * @param hist the histogram
@@ -495,52 +481,6 @@ void getHistMaxMin(jab_int32 hist[256], jab_int32* max, jab_int32* min, jab_int3
 	}
 }
 
-/**
- * @brief Stretch the histograms of R, G and B channels
- * @param bitmap the image
-*/
-void balanceRGB(jab_bitmap* bitmap)
-{
-	jab_int32 bytes_per_pixel = bitmap->bits_per_pixel / 8;
-    jab_int32 bytes_per_row = bitmap->width * bytes_per_pixel;
-
-	//calculate max and min for each channel
-	jab_int32 max_r, max_g, max_b;
-    jab_int32 min_r, min_g, min_b;
-    jab_int32 hist_r[256], hist_g[256], hist_b[256];
-
-    getHistogram(bitmap, 0, hist_r);
-    getHistogram(bitmap, 1, hist_g);
-    getHistogram(bitmap, 2, hist_b);
-
-    //threshold for the number of pixels having the max or min values
-	jab_int32 count_ths = 20;
-    getHistMaxMin(hist_r, &max_r, &min_r, count_ths);
-    getHistMaxMin(hist_g, &max_g, &min_g, count_ths);
-    getHistMaxMin(hist_b, &max_b, &min_b, count_ths);
-
-	//normalize each channel
-	for(jab_int32 i=0; i<bitmap->height; i++)
-	{
-		for(jab_int32 j=0; j<bitmap->width; j++)
-		{
-			jab_int32 offset = i * bytes_per_row + j * bytes_per_pixel;
-			//R channel
-			if		(bitmap->pixel[offset + 0] < min_r)	bitmap->pixel[offset + 0] = 0;
-			else if (bitmap->pixel[offset + 0] > max_r)	bitmap->pixel[offset + 0] = 255;
-			else 	 bitmap->pixel[offset + 0] = (jab_byte)((jab_double)(bitmap->pixel[offset + 0] - min_r) / (jab_double)(max_r - min_r) * 255.0);
-			//G channel
-			if		(bitmap->pixel[offset + 1] < min_g)	bitmap->pixel[offset + 1] = 0;
-			else if (bitmap->pixel[offset + 1] > max_g)	bitmap->pixel[offset + 1] = 255;
-			else 	 bitmap->pixel[offset + 1] = (jab_byte)((jab_double)(bitmap->pixel[offset + 1] - min_g) / (jab_double)(max_g - min_g) * 255.0);
-			//B channel
-			if		(bitmap->pixel[offset + 2] < min_b) bitmap->pixel[offset + 2] = 0;
-			else if	(bitmap->pixel[offset + 2] > max_b)	bitmap->pixel[offset + 2] = 255;
-			else 	 bitmap->pixel[offset + 2] = (jab_byte)((jab_double)(bitmap->pixel[offset + 2] - min_b) / (jab_double)(max_b - min_b) * 255.0);
-		}
-	}
-}
-
 /**
  * @brief Get the average and variance of RGB values
  * @param rgb the pixel with RGB values
@@ -595,17 +535,62 @@ void getMinMax(jab_byte* rgb, jab_byte* min, jab_byte* mid, jab_byte* max, jab_i
 }
 
 /**
- * @brief Binarize a color channel of a bitmap using local binarization algorithm
+ * @brief Binarize one pixel into the R, G and B channels
+ * @param pixel the pixel with RGB values
+ * @param rgb_ths the black color thresholds for RGB channels
+ * @param rgb the binarized RGB channels
+ * @param index the pixel index in the binarized channels
+*/
+void binarizePixel(jab_byte* pixel, jab_float* rgb_ths, jab_bitmap* rgb[3], jab_int32 index)
+{
+	jab_double ths_std = 0.08;
+	//check black pixel
+	if(pixel[0] < rgb_ths[0] && pixel[1] < rgb_ths[1] && pixel[2] < rgb_ths[2])
+	{
+		rgb[0]->pixel[index] = 0;
+		rgb[1]->pixel[index] = 0;
+		rgb[2]->pixel[index] = 0;
+		return;
+	}
+
+	jab_double ave, var;
+	getAveVar(pixel, &ave, &var);
+	jab_double std = sqrt(var);	//standard deviation
+	jab_byte min, mid, max;
+	jab_int32 index_min, index_mid, index_max;
+	getMinMax(pixel, &min, &mid, &max, &index_min, &index_mid, &index_max);
+	std /= (jab_double)max;	//normalize std
+
+	if(std < ths_std && (pixel[0] > rgb_ths[0] && pixel[1] > rgb_ths[1] && pixel[2] > rgb_ths[2]))
+	{
+		rgb[0]->pixel[index] = 255;
+		rgb[1]->pixel[index] = 255;
+		rgb[2]->pixel[index] = 255;
+	}
+	else
+	{
+		rgb[index_max]->pixel[index] = 255;
+		rgb[index_min]->pixel[index] = 0;
+		jab_double r1 = (jab_double)pixel[index_mid] / (jab_double)pixel[index_min];
+		jab_double r2 = (jab_double)pixel[index_max] / (jab_double)pixel[index_mid];
+		if(r1 > r2)
+			rgb[index_mid]->pixel[index] = 255;
+		else
+			rgb[index_mid]->pixel[index] = 0;
+	}
+}
+
+/**
+ * @brief Allocate the binarized R, G and B channels of a bitmap
  * @param bitmap the input bitmap
  * @param rgb the binarized RGB channels
- * @param blk_ths the black color thresholds for RGB channels
  * @return JAB_SUCCESS | JAB_FAILURE
 */
-jab_boolean binarizerRGB(jab_bitmap* bitmap, jab_bitmap* rgb[3], jab_float* blk_ths)
+jab_boolean createBinaryChannels(jab_bitmap* bitmap, jab_bitmap* rgb[3])
 {
 	for(jab_int32 i=0; i<3; i++)
 	{
-		rgb[i] = (jab_bitmap*)calloc(1, sizeof(jab_bitmap) + bitmap->width*bitmap->height*sizeof(jab_byte));
+		rgb[i] = (jab_bitmap*)scratchCalloc(1, sizeof(jab_bitmap) + bitmap->width*bitmap->height*sizeof(jab_byte));
 		if(rgb[i] == NULL)
 		{
 			JAB_REPORT_ERROR(("Memory allocation for binary bitmap %d failed", i))
@@ -617,6 +602,20 @@ jab_boolean binarizerRGB(jab_bitmap* bitmap, jab_bitmap* rgb[3], jab_float* blk_
 		rgb[i]->bits_per_pixel = 8;
 		rgb[i]->channel_count = 1;
 	}
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Binarize a color channel of a bitmap using local binarization algorithm
+ * @param bitmap the input bitmap
+ * @param rgb the binarized RGB channels
+ * @param blk_ths the black color thresholds for RGB channels
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean binarizerRGB(jab_bitmap* bitmap, jab_bitmap* rgb[3], jab_float* blk_ths)
+{
+	if(!createBinaryChannels(bitmap, rgb))
+		return JAB_FAILURE;
 
 	jab_int32 bytes_per_pixel = bitmap->bits_per_pixel / 8;
     jab_int32 bytes_per_row = bitmap->width * bytes_per_pixel;
@@ -661,14 +660,12 @@ jab_boolean binarizerRGB(jab_bitmap* bitmap, jab_bitmap* rgb[3], jab_float* blk_
     }
 
 	//binarize each pixel in each channel
-	jab_double ths_std = 0.08;
 	jab_float rgb_ths[3] = {0, 0, 0};
     for(jab_int32 i=0; i<bitmap->height; i++)
 	{
 		for(jab_int32 j=0; j<bitmap->width; j++)
 		{
 			jab_int32 offset = i * bytes_per_row + j * bytes_per_pixel;
-			//check black pixel
 			if(blk_ths == 0)
             {
                 jab_int32 block_index = MIN(i/block_size_y, block_num_y-1) * block_num_x + MIN(j/block_size_x, block_num_x-1);
@@ -682,43 +679,204 @@ jab_boolean binarizerRGB(jab_bitmap* bitmap, jab_bitmap* rgb[3], jab_float* blk_
                 rgb_ths[1] = blk_ths[1];
                 rgb_ths[2] = blk_ths[2];
             }
-			if(bitmap->pixel[offset + 0] < rgb_ths[0] && bitmap->pixel[offset + 1] < rgb_ths[1] && bitmap->pixel[offset + 2] < rgb_ths[2])
-            {
-                rgb[0]->pixel[i*bitmap->width + j] = 0;
-                rgb[1]->pixel[i*bitmap->width + j] = 0;
-                rgb[2]->pixel[i*bitmap->width + j] = 0;
-                continue;
-            }
+            binarizePixel(&bitmap->pixel[offset], rgb_ths, rgb, i*bitmap->width + j);
+		}
+	}
+	filterBinary(rgb[0]);
+	filterBinary(rgb[1]);
+	filterBinary(rgb[2]);
+	return JAB_SUCCESS;
+}
 
-			jab_double ave, var;
-			getAveVar(&bitmap->pixel[offset], &ave, &var);
-			jab_double std = sqrt(var);	//standard deviation
-			jab_byte min, mid, max;
-			jab_int32 index_min, index_mid, index_max;
-			getMinMax(&bitmap->pixel[offset], &min, &mid, &max, &index_min, &index_mid, &index_max);
-			std /= (jab_double)max;	//normalize std
+/**
+ * @brief Initialize the statistics of a frame. The frame is divided into the same blocks binarizerRGB uses
+ * to calculate the average pixel values.
+ * @param stats the frame statistics
+ * @param width the frame width
+ * @param height the frame height
+*/
+void initFrameStats(jab_frame_stats* stats, jab_int32 width, jab_int32 height)
+{
+	memset(stats, 0, sizeof(jab_frame_stats));
+	stats->width = width;
+	stats->height = height;
+	jab_int32 max_block_size = MAX(MAX(width, height) / 2, 1);
+	stats->block_num_x = (width % max_block_size) != 0 ? (width / max_block_size) + 1 : (width / max_block_size);
+	stats->block_num_y = (height% max_block_size) != 0 ? (height/ max_block_size) + 1 : (height/ max_block_size);
+	stats->block_size_x = width / stats->block_num_x;
+	stats->block_size_y = height/ stats->block_num_y;
+}
 
-			if(std < ths_std && (bitmap->pixel[offset + 0] > rgb_ths[0] && bitmap->pixel[offset + 1] > rgb_ths[1] && bitmap->pixel[offset + 2] > rgb_ths[2]))
-			{
-				rgb[0]->pixel[i*bitmap->width + j] = 255;
-				rgb[1]->pixel[i*bitmap->width + j] = 255;
-				rgb[2]->pixel[i*bitmap->width + j] = 255;
-			}
-			else
-			{
-				rgb[index_max]->pixel[i*bitmap->width + j] = 255;
-				rgb[index_min]->pixel[i*bitmap->width + j] = 0;
-				jab_double r1 = (jab_double)bitmap->pixel[offset + index_mid] / (jab_double)bitmap->pixel[offset + index_min];
-				jab_double r2 = (jab_double)bitmap->pixel[offset + index_max] / (jab_double)bitmap->pixel[offset + index_mid];
-				if(r1 > r2)
-					rgb[index_mid]->pixel[i*bitmap->width + j] = 255;
-				else
-					rgb[index_mid]->pixel[i*bitmap->width + j] = 0;
-			}
+/**
+ * @brief Add one pixel row to the frame statistics
+ * @param stats the frame statistics
+ * @param row the pixel row with RGB values
+ * @param bytes_per_pixel the number of bytes per pixel in the row
+ * @param y the row index
+*/
+void addFrameRow(jab_frame_stats* stats, jab_byte* row, jab_int32 bytes_per_pixel, jab_int32 y)
+{
+	jab_int32 block_y = MIN(y / stats->block_size_y, stats->block_num_y-1);
+	for(jab_int32 block_x=0; block_x<stats->block_num_x; block_x++)
+	{
+		jab_int32 (*hist)[256] = stats->block_hist[block_y * stats->block_num_x + block_x];
+		jab_int32 sx = block_x * stats->block_size_x;
+		jab_int32 ex = (block_x == stats->block_num_x-1) ? stats->width : (sx + stats->block_size_x);
+		jab_byte* pixel = row + sx * bytes_per_pixel;
+		for(jab_int32 x=sx; x<ex; x++)
+		{
+			hist[0][pixel[0]]++;
+			hist[1][pixel[1]]++;
+			hist[2][pixel[2]]++;
+			pixel += bytes_per_pixel;
 		}
 	}
+}
+
+/**
+ * @brief Clamp a value to the range of a byte
+ * @param value the value
+ * @return the clamped value
+*/
+static inline jab_byte clampByte(jab_int32 value)
+{
+	return (jab_byte)(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+/**
+ * @brief Convert one pixel row of a caller-owned buffer to RGB
+ * @param buffer the pixel buffer
+ * @param y the row index
+ * @param row the converted row with 3 bytes per pixel
+*/
+void convertPixelRow(jab_pixel_buffer* buffer, jab_int32 y, jab_byte* row)
+{
+	jab_byte* src = buffer->pixel + (size_t)y * buffer->stride;
+	switch(buffer->format)
+	{
+	case PIXEL_FORMAT_RGBA:
+	case PIXEL_FORMAT_BGRA:
+	case PIXEL_FORMAT_RGB24:
+	case PIXEL_FORMAT_BGR24:
+	{
+		jab_int32 bytes_per_pixel = (buffer->format == PIXEL_FORMAT_RGBA || buffer->format == PIXEL_FORMAT_BGRA) ? 4 : 3;
+		jab_int32 r = (buffer->format == PIXEL_FORMAT_RGBA || buffer->format == PIXEL_FORMAT_RGB24) ? 0 : 2;
+		for(jab_int32 x=0; x<buffer->width; x++)
+		{
+			row[0] = src[r];
+			row[1] = src[1];
+			row[2] = src[2 - r];
+			row += 3;
+			src += bytes_per_pixel;
+		}
+		break;
+	}
+	case PIXEL_FORMAT_NV12:
+	{
+		//ITU-R BT.601 limited range
+		jab_byte* uv = buffer->chroma + (size_t)(y / 2) * buffer->chroma_stride;
+		for(jab_int32 x=0; x<buffer->width; x++)
+		{
+			jab_int32 c = 298 * (src[x] - 16) + 128;
+			jab_int32 d = uv[x & ~1] - 128;
+			jab_int32 e = uv[x | 1] - 128;
+			row[0] = clampByte((c + 409 * e) >> 8);
+			row[1] = clampByte((c - 100 * d - 208 * e) >> 8);
+			row[2] = clampByte((c + 516 * d) >> 8);
+			row += 3;
+		}
+		break;
+	}
+	}
+}
+
+/**
+ * @brief Stretch the histograms of R, G and B channels and binarize the bitmap in a single pass.
+ * The stretched values are written back to the bitmap.
+ * @param bitmap the input bitmap, or the RGB frame receiving the converted pixels of source
+ * @param source the caller-owned pixels to convert into bitmap on the fly, NULL if bitmap holds the pixels
+ * @param stats the statistics of the pixels
+ * @param rgb the binarized RGB channels
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean balanceBinarizeRGB(jab_bitmap* bitmap, jab_pixel_buffer* source, jab_frame_stats* stats, jab_bitmap* rgb[3])
+{
+	if(!createBinaryChannels(bitmap, rgb))
+		return JAB_FAILURE;
+
+	jab_int64 stage_start = startDecodeStage();
+	jab_int32 block_number = stats->block_num_x * stats->block_num_y;
+	//merge the block histograms
+	jab_int32 hist[3][256];
+	memset(hist, 0, sizeof(hist));
+	for(jab_int32 b=0; b<block_number; b++)
+	{
+		for(jab_int32 c=0; c<3; c++)
+		{
+			for(jab_int32 v=0; v<256; v++)
+				hist[c][v] += stats->block_hist[b][c][v];
+		}
+	}
+
+	//build the stretch table for each channel
+	//threshold for the number of pixels having the max or min values
+	jab_int32 count_ths = 20;
+	jab_byte stretch[3][256];
+	for(jab_int32 c=0; c<3; c++)
+	{
+		jab_int32 max, min;
+		getHistMaxMin(hist[c], &max, &min, count_ths);
+		for(jab_int32 v=0; v<256; v++)
+		{
+			if		(v < min)	stretch[c][v] = 0;
+			else if (v > max)	stretch[c][v] = 255;
+			else 	 stretch[c][v] = (jab_byte)((jab_double)(v - min) / (jab_double)(max - min) * 255.0);
+		}
+	}
+
+	//calculate the average stretched pixel value, block-wise
+	jab_float pixel_ave[MAX_FRAME_BLOCKS][3];
+	for(jab_int32 b=0; b<block_number; b++)
+	{
+		jab_int64 counter = 0;
+		jab_int64 sum[3] = {0, 0, 0};
+		for(jab_int32 v=0; v<256; v++)
+		{
+			counter += stats->block_hist[b][0][v];
+			for(jab_int32 c=0; c<3; c++)
+				sum[c] += (jab_int64)stats->block_hist[b][c][v] * stretch[c][v];
+		}
+		for(jab_int32 c=0; c<3; c++)
+			pixel_ave[b][c] = (jab_float)sum[c] / (jab_float)counter;
+	}
+	endDecodeStage(DECODE_STAGE_BALANCE, stage_start);
+
+	//stretch and binarize each pixel
+	stage_start = startDecodeStage();
+	jab_int32 bytes_per_pixel = bitmap->bits_per_pixel / 8;
+	jab_int32 bytes_per_row = bitmap->width * bytes_per_pixel;
+	for(jab_int32 i=0; i<bitmap->height; i++)
+	{
+		jab_byte* pixel = bitmap->pixel + i * bytes_per_row;
+		if(source)
+			convertPixelRow(source, i, pixel);
+		jab_int32 block_row = MIN(i/stats->block_size_y, stats->block_num_y-1) * stats->block_num_x;
+		for(jab_int32 j=0; j<bitmap->width; j++)
+		{
+			pixel[0] = stretch[0][pixel[0]];
+			pixel[1] = stretch[1][pixel[1]];
+			pixel[2] = stretch[2][pixel[2]];
+			jab_int32 block_index = block_row + MIN(j/stats->block_size_x, stats->block_num_x-1);
+			binarizePixel(pixel, pixel_ave[block_index], rgb, i*bitmap->width + j);
+			pixel += bytes_per_pixel;
+		}
+	}
+	endDecodeStage(DECODE_STAGE_BINARIZE, stage_start);
+
+	stage_start = startDecodeStage();
 	filterBinary(rgb[0]);
 	filterBinary(rgb[1]);
 	filterBinary(rgb[2]);
+	endDecodeStage(DECODE_STAGE_FILTER, stage_start);
 	return JAB_SUCCESS;
 }
@@ -20,6 +20,8 @@
 #include "decoder.h"
 #include "ldpc.h"
 #include "encoder.h"
+#include "arena.h"
+#include "timer.h"
 
 /**
  * @brief Copy 16-color sub-blocks of 64-color palette into 32-color blocks of 256-color palette and interpolate into 32 colors
@@ -203,8 +205,8 @@ jab_int32 readColorPaletteInMaster(jab_bitmap* matrix, jab_decoded_symbol* symbo
 {
 	//allocate buffer for palette
 	jab_int32 color_number = (jab_int32)pow(2, symbol->metadata.Nc + 1);
-	free(symbol->palette);
-	symbol->palette = (jab_byte*)malloc(color_number * sizeof(jab_byte) * 3 * COLOR_PALETTE_NUMBER);
+	scratchFree(symbol->palette);
+	symbol->palette = (jab_byte*)scratchMalloc(color_number * sizeof(jab_byte) * 3 * COLOR_PALETTE_NUMBER);
 	if(symbol->palette == NULL)
 	{
 		reportError("Memory allocation for master palette failed");
@@ -288,8 +290,8 @@ jab_int32 readColorPaletteInSlave(jab_bitmap* matrix, jab_decoded_symbol* symbol
 {
 	//allocate buffer for palette
 	jab_int32 color_number = (jab_int32)pow(2, symbol->metadata.Nc + 1);
-	free(symbol->palette);
-	symbol->palette = (jab_byte*)malloc(color_number * sizeof(jab_byte) * 3 * COLOR_PALETTE_NUMBER);
+	scratchFree(symbol->palette);
+	symbol->palette = (jab_byte*)scratchMalloc(color_number * sizeof(jab_byte) * 3 * COLOR_PALETTE_NUMBER);
     if(symbol->palette == NULL)
     {
 		reportError("Memory allocation for slave palette failed");
@@ -791,7 +793,7 @@ jab_int32 decodeMasterMetadataPartI(jab_bitmap* matrix, jab_decoded_symbol* symb
 	}
 
 	//decode ldpc for part1
-	if( !decodeLDPChd(part1, MASTER_METADATA_PART1_LENGTH, MASTER_METADATA_PART1_LENGTH > 36 ? 4 : 3, 0) )
+	if( !decodeLDPChd(part1, MASTER_METADATA_PART1_LENGTH, MASTER_METADATA_PART1_LENGTH > 36 ? 4 : 3, 0, NULL) )
 	{
 #if TEST_MODE
 		reportError("LDPC decoding for master metadata part 1 failed");
@@ -800,6 +802,14 @@ jab_int32 decodeMasterMetadataPartI(jab_bitmap* matrix, jab_decoded_symbol* symb
 	}
 	//parse part1
 	symbol->metadata.Nc = (part1[0] << 2) + (part1[1] << 1) + part1[2];
+	//the color palette placement is only defined for up to 8 colors
+	if(symbol->metadata.Nc > DEFAULT_MODULE_COLOR_MODE)
+	{
+#if TEST_MODE
+		reportError("Unsupported color number in primary metadata part 1 found");
+#endif
+		return DECODE_METADATA_FAILED;
+	}
 
 	return JAB_SUCCESS;
 }
@@ -853,7 +863,7 @@ jab_int32 decodeMasterMetadataPartII(jab_bitmap* matrix, jab_decoded_symbol* sym
     }
 
 	//decode ldpc for part2
-	if( !decodeLDPChd(part2, MASTER_METADATA_PART2_LENGTH, MASTER_METADATA_PART2_LENGTH > 36 ? 4 : 3, 0) )
+	if( !decodeLDPChd(part2, MASTER_METADATA_PART2_LENGTH, MASTER_METADATA_PART2_LENGTH > 36 ? 4 : 3, 0, NULL) )
 	{
 #if TEST_MODE
 		reportError("LDPC decoding for master metadata part 2 failed");
@@ -933,7 +943,7 @@ jab_data* readRawModuleData(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_
 {
     jab_int32 color_number = (jab_int32)pow(2, symbol->metadata.Nc + 1);
 	jab_int32 module_count = 0;
-    jab_data* data = (jab_data*)malloc(sizeof(jab_data) + matrix->width * matrix->height * sizeof(jab_char));
+    jab_data* data = (jab_data*)scratchMalloc(sizeof(jab_data) + matrix->width * matrix->height * sizeof(jab_char));
     if(data == NULL)
 	{
 		reportError("Memory allocation for raw module data failed");
@@ -1020,7 +1030,7 @@ jab_data* readRawModuleData(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_
 jab_data* rawModuleData2RawData(jab_data* raw_module_data, jab_int32 bits_per_module)
 {
 	//
-	jab_data* raw_data = (jab_data *)malloc(sizeof(jab_data) + raw_module_data->length * bits_per_module * sizeof(jab_char));
+	jab_data* raw_data = (jab_data *)scratchMalloc(sizeof(jab_data) + raw_module_data->length * bits_per_module * sizeof(jab_char));
     if(raw_data == NULL)
 	{
 		reportError("Memory allocation for raw data failed");
@@ -1183,11 +1193,13 @@ jab_int32 decodeSymbol(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_byte*
 	fillDataMap(data_map, matrix->width, matrix->height, type);
 
 	//read raw data
+	jab_int64 stage_start = startDecodeStage();
 	jab_data* raw_module_data = readRawModuleData(matrix, symbol, data_map, norm_palette, pal_ths);
+	endDecodeStage(DECODE_STAGE_MODULE_READ, stage_start);
 	if(raw_module_data == NULL)
 	{
 		JAB_REPORT_ERROR(("Reading raw module data in symbol %d failed", symbol->index))
-		free(data_map);
+		scratchFree(data_map);
 		return FATAL_ERROR;
 	}
 #if TEST_MODE
@@ -1196,9 +1208,15 @@ jab_int32 decodeSymbol(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_byte*
 	fclose(fp);
 #endif // TEST_MODE
 
+	jab_decode_stats* stats = getDecodeStats();
+	if(stats)
+		stats->modules += raw_module_data->length;
+
 	//demask
+	stage_start = startDecodeStage();
 	demaskSymbol(raw_module_data, data_map, symbol->side_size, symbol->metadata.mask_type, (jab_int32)pow(2, symbol->metadata.Nc + 1));
-	free(data_map);
+	endDecodeStage(DECODE_STAGE_DEMASK, stage_start);
+	scratchFree(data_map);
 #if TEST_MODE
 	fp = fopen("jab_demasked_module_data.bin", "wb");
 	fwrite(raw_module_data->data, raw_module_data->length, 1, fp);
@@ -1206,8 +1224,10 @@ jab_int32 decodeSymbol(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_byte*
 #endif // TEST_MODE
 
 	//change to one-bit-per-byte representation
+	stage_start = startDecodeStage();
 	jab_data* raw_data = rawModuleData2RawData(raw_module_data, symbol->metadata.Nc + 1);
-	free(raw_module_data);
+	endDecodeStage(DECODE_STAGE_MODULE_READ, stage_start);
+	scratchFree(raw_module_data);
 	if(raw_data == NULL)
 	{
 		JAB_REPORT_ERROR(("Reading raw data in symbol %d failed", symbol->index))
@@ -1222,7 +1242,9 @@ jab_int32 decodeSymbol(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_byte*
 
 	//deinterleave data
 	raw_data->length = Pg;	//drop the padding bits
+	stage_start = startDecodeStage();
     deinterleaveData(raw_data);
+	endDecodeStage(DECODE_STAGE_DEINTERLEAVE, stage_start);
 
 #if TEST_MODE
 	JAB_REPORT_INFO(("wc:%d, wr:%d, Pg:%d, Pn: %d", wc, wr, Pg, Pn))
@@ -1232,10 +1254,15 @@ jab_int32 decodeSymbol(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_byte*
 #endif // TEST_MODE
 
 	//decode ldpc
-    if(decodeLDPChd((jab_byte*)raw_data->data, Pg, symbol->metadata.ecl.x, symbol->metadata.ecl.y) != Pn)
+	stage_start = startDecodeStage();
+	jab_int32 net_length = decodeLDPChd((jab_byte*)raw_data->data, Pg, symbol->metadata.ecl.x, symbol->metadata.ecl.y, &symbol->ldpc);
+	endDecodeStage(DECODE_STAGE_LDPC, stage_start);
+	if(stats)
+		stats->corrected_bits += symbol->ldpc.corrected_bits;
+    if(net_length != Pn)
     {
 		JAB_REPORT_ERROR(("LDPC decoding for data in symbol %d failed", symbol->index))
-		free(raw_data);
+		scratchFree(raw_data);
 		return JAB_FAILURE;
 	}
 
@@ -1262,10 +1289,12 @@ jab_int32 decodeSymbol(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_byte*
 	{
 		if(symbol->metadata.docked_position & (0x08 >> i))
 		{
+			stage_start = startDecodeStage();
 			jab_int32 read_bit_length = decodeSlaveMetadata(symbol, i, raw_data, metadata_offset);
+			endDecodeStage(DECODE_STAGE_METADATA, stage_start);
 			if(read_bit_length == DECODE_METADATA_FAILED)
 			{
-				free(raw_data);
+				scratchFree(raw_data);
 				return DECODE_METADATA_FAILED;
 			}
 			metadata_offset -= read_bit_length;
@@ -1274,18 +1303,18 @@ jab_int32 decodeSymbol(jab_bitmap* matrix, jab_decoded_symbol* symbol, jab_byte*
 
 	//copy the decoded data to symbol
 	jab_int32 net_data_length = metadata_offset + 1;
-	symbol->data = (jab_data *)malloc(sizeof(jab_data) + net_data_length * sizeof(jab_char));
+	symbol->data = (jab_data *)scratchMalloc(sizeof(jab_data) + net_data_length * sizeof(jab_char));
 	if(symbol->data == NULL)
 	{
 		reportError("Memory allocation for symbol data failed");
-		free(raw_data);
+		scratchFree(raw_data);
 		return FATAL_ERROR;
 	}
 	symbol->data->length = net_data_length;
 	memcpy(symbol->data->data, raw_data->data, net_data_length);
 
 	//clean memory
-	free(raw_data);
+	scratchFree(raw_data);
 	return JAB_SUCCESS;
 }
 
@@ -1316,7 +1345,7 @@ jab_int32 decodeMaster(jab_bitmap* matrix, jab_decoded_symbol* symbol)
 	}
 
 	//create data map
-	jab_byte* data_map = (jab_byte*)calloc(1, matrix->width*matrix->height*sizeof(jab_byte));
+	jab_byte* data_map = (jab_byte*)scratchCalloc(1, matrix->width*matrix->height*sizeof(jab_byte));
 	if(data_map == NULL)
 	{
 		reportError("Memory allocation for data map in master failed");
@@ -1329,7 +1358,9 @@ jab_int32 decodeMaster(jab_bitmap* matrix, jab_decoded_symbol* symbol)
 	jab_int32 module_count = 0;
 
 	//decode metadata PartI (Nc)
+	jab_int64 stage_start = startDecodeStage();
 	jab_int32 decode_partI_ret = decodeMasterMetadataPartI(matrix, symbol, data_map, &module_count, &x, &y);
+	endDecodeStage(DECODE_STAGE_METADATA, stage_start);
 	if(decode_partI_ret == JAB_FAILURE)
 	{
 		return JAB_FAILURE;
@@ -1347,7 +1378,10 @@ jab_int32 decodeMaster(jab_bitmap* matrix, jab_decoded_symbol* symbol)
 	}
 
 	//read color palettes
-    if(readColorPaletteInMaster(matrix, symbol, data_map, &module_count, &x, &y) < 0)
+	stage_start = startDecodeStage();
+	jab_int32 palette_ret = readColorPaletteInMaster(matrix, symbol, data_map, &module_count, &x, &y);
+	endDecodeStage(DECODE_STAGE_PALETTE, stage_start);
+    if(palette_ret < 0)
 	{
 		reportError("Reading color palettes in master symbol failed");
 		return JAB_FAILURE;
@@ -1368,7 +1402,10 @@ jab_int32 decodeMaster(jab_bitmap* matrix, jab_decoded_symbol* symbol)
 	//decode metadata PartII
 	if(decode_partI_ret == JAB_SUCCESS)
 	{
-		if(decodeMasterMetadataPartII(matrix, symbol, data_map, norm_palette, pal_ths, &module_count, &x, &y) <= 0)
+		stage_start = startDecodeStage();
+		jab_int32 decode_partII_ret = decodeMasterMetadataPartII(matrix, symbol, data_map, norm_palette, pal_ths, &module_count, &x, &y);
+		endDecodeStage(DECODE_STAGE_METADATA, stage_start);
+		if(decode_partII_ret <= 0)
 		{
 			return JAB_FAILURE;
 		}
@@ -1393,7 +1430,7 @@ jab_int32 decodeSlave(jab_bitmap* matrix, jab_decoded_symbol* symbol)
 	}
 
 	//create data map
-	jab_byte* data_map = (jab_byte*)calloc(1, matrix->width*matrix->height*sizeof(jab_byte));
+	jab_byte* data_map = (jab_byte*)scratchCalloc(1, matrix->width*matrix->height*sizeof(jab_byte));
 	if(data_map == NULL)
 	{
 		reportError("Memory allocation for data map in slave failed");
@@ -1401,10 +1438,13 @@ jab_int32 decodeSlave(jab_bitmap* matrix, jab_decoded_symbol* symbol)
 	}
 
 	//read color palettes
-	if(readColorPaletteInSlave(matrix, symbol, data_map) < 0)
+	jab_int64 stage_start = startDecodeStage();
+	jab_int32 palette_ret = readColorPaletteInSlave(matrix, symbol, data_map);
+	endDecodeStage(DECODE_STAGE_PALETTE, stage_start);
+	if(palette_ret < 0)
 	{
 		reportError("Reading color palettes in slave symbol failed");
-		free(data_map);
+		scratchFree(data_map);
 		return FATAL_ERROR;
 	}
 
@@ -1425,408 +1465,376 @@ jab_int32 decodeSlave(jab_bitmap* matrix, jab_decoded_symbol* symbol)
 }
 
 /**
- * @brief Read bit data
- * @param data the data buffer
- * @param start the start reading offset
- * @param length the length of the data to be read
- * @param value the read data
- * @return the length of the read data
+ * @brief Pack bit data into a 64-bit word, most significant bit first
+ * @param bits the bit data
+ * @param length the number of bits to pack, at most 64
+ * @return the packed word, the bits not set are zero
 */
-jab_int32 readData(jab_data* data, jab_int32 start, jab_int32 length, jab_int32* value)
+static inline jab_uint64 packWord(jab_char* bits, jab_int32 length)
 {
-	jab_int32 i;
-	jab_int32 val = 0;
-	for(i=start; i<(start + length) && i<data->length; i++)
+	jab_uint64 word = 0;
+	if(length == 64)
+	{
+		for(jab_int32 j=0; j<64; j+=8)
+		{
+			//gather 8 bits with one multiplication, the first one becomes the most significant bit
+			jab_uint64 group;
+			memcpy(&group, &bits[j], 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+			group = __builtin_bswap64(group);
+#endif
+			word = (word << 8) | (((group & 0x0101010101010101ULL) * 0x8040201008040201ULL) >> 56);
+		}
+		return word;
+	}
+	for(jab_int32 j=0; j<length; j++)
 	{
-		val += data->data[i] << (length - 1 - (i - start));
+		word = (word << 1) | (jab_uint64)(bits[j] & 1);
 	}
-	*value = val;
-	return (i - start);
+	return length > 0 ? word << (64 - length) : 0;
 }
 
 /**
- * @brief Interpret decoded bits
- * @param bits the input bits
- * @return the data message
+ * @brief Read bits from packed data without consuming them
+ * @param words the packed words
+ * @param start the start reading offset
+ * @param length the number of bits to read, at most 32
+ * @return the read bits
 */
-jab_data* decodeData(jab_data* bits)
+static inline jab_int32 peekBits(jab_uint64* words, jab_int32 start, jab_int32 length)
 {
-	jab_byte* decoded_bytes = (jab_byte *)malloc(bits->length * sizeof(jab_byte));
-	if(decoded_bytes == NULL)
+	jab_int32 offset = start & 63;
+	jab_uint64 window = words[start >> 6] << offset;
+	if(offset > 0)
+		window |= words[(start >> 6) + 1] >> (64 - offset);
+	return (jab_int32)(window >> (64 - length));
+}
+
+/**
+ * @brief Build the decoding table holding the decoded bytes or the mode switch of every codeword in every mode
+ * @param table the decoding table
+*/
+static void buildDecodingTable(jab_decode_entry table[JAB_ENCODING_MODES][64])
+{
+	const jab_byte* chars[JAB_ENCODING_MODES] = {jab_decoding_table_upper, jab_decoding_table_lower, jab_decoding_table_numeric,
+												 jab_decoding_table_punct, jab_decoding_table_mixed, jab_decoding_table_alphanumeric};
+	const jab_int32 char_number[JAB_ENCODING_MODES] = {27, 27, 13, 16, 32, 63};
+
+	memset(table, 0, JAB_ENCODING_MODES * 64 * sizeof(jab_decode_entry));
+	for(jab_int32 i=0; i<JAB_ENCODING_MODES; i++)
 	{
-		reportError("Memory allocation for decoded bytes failed");
-		return NULL;
+		for(jab_int32 j=0; j<char_number[i]; j++)
+		{
+			table[i][j].count = 1;
+			table[i][j].bytes[0] = chars[i][j];
+		}
 	}
+	for(jab_int32 j=0; j<4; j++)
+	{
+		table[Mixed][19+j].count = 2;
+		table[Mixed][19+j].bytes[0] = jab_decoding_table_mixed_pair[j][0];
+		table[Mixed][19+j].bytes[1] = jab_decoding_table_mixed_pair[j][1];
+	}
+	//latch and shift codewords
+	const jab_int32 switches[][4] = {	{Upper, 27, Punct, Upper}, {Upper, 28, Lower, None}, {Upper, 29, Numeric, None}, {Upper, 30, Alphanumeric, None},
+											{Lower, 27, Punct, Lower}, {Lower, 28, Upper, Lower}, {Lower, 29, Numeric, None}, {Lower, 30, Alphanumeric, None},
+											{Numeric, 13, Punct, Numeric}, {Numeric, 14, Upper, None}};
+	for(jab_int32 i=0; i<(jab_int32)(sizeof(switches)/sizeof(switches[0])); i++)
+	{
+		table[switches[i][0]][switches[i][1]].mode = switches[i][2];
+		table[switches[i][0]][switches[i][1]].pre_mode = switches[i][3];
+	}
+	//escape codewords, the mode switch is selected by the next 2 bits
+	table[Upper][31].escape = 1;
+	table[Lower][31].escape = 1;
+	table[Numeric][15].escape = 1;
+	table[Alphanumeric][63].escape = 1;
+}
+
+/**
+ * @brief Initialize an incremental data decoder
+ * @param decoder the data decoder
+ * @param callback called with the newly decoded bytes after each symbol, NULL if not needed
+ * @param user_data the user data passed to the callback
+*/
+void initDataDecoder(jab_data_decoder* decoder, jab_payload_callback callback, void* user_data)
+{
+	memset(decoder, 0, sizeof(jab_data_decoder));
+	buildDecodingTable(decoder->table);
+	decoder->mode = Upper;
+	decoder->pre_mode = None;
+	decoder->callback = callback;
+	decoder->user_data = user_data;
+}
 
-	jab_encode_mode mode = Upper;
-	jab_encode_mode pre_mode = None;
-	jab_int32 index = 0;	//index of input bits
-	jab_int32 count = 0;	//index of decoded bytes
+/**
+ * @brief Free the buffers of a data decoder
+ * @param decoder the data decoder
+*/
+void releaseDataDecoder(jab_data_decoder* decoder)
+{
+	scratchFree(decoder->words);
+	scratchFree(decoder->bytes);
+	decoder->words = NULL;
+	decoder->bytes = NULL;
+	decoder->word_capacity = 0;
+	decoder->byte_capacity = 0;
+}
 
-	while(index < bits->length)
+/**
+ * @brief Make room in a data decoder for more data bits and the bytes decoded from them
+ * @param decoder the data decoder
+ * @param length the number of data bits to hold
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+static jab_boolean reserveDataBits(jab_data_decoder* decoder, jab_int32 length)
+{
+	//two zero words after the data let peekBits read past the end
+	jab_int32 word_count = length / 64 + 2;
+	if(word_count <= decoder->word_capacity)
+		return JAB_SUCCESS;
+	word_count = MAX(word_count, decoder->word_capacity * 2);
+	//a mixed mode pair takes 5 bits for 2 bytes, every other codeword takes at least 4 bits for a byte
+	jab_int32 byte_capacity = word_count * 32 + 2;
+	jab_uint64* words = (jab_uint64 *)scratchMalloc(word_count * sizeof(jab_uint64));
+	jab_byte* bytes = (jab_byte *)scratchMalloc(byte_capacity * sizeof(jab_byte));
+	if(words == NULL || bytes == NULL)
+	{
+		reportError("Memory allocation for data stream failed");
+		scratchFree(words);
+		scratchFree(bytes);
+		return JAB_FAILURE;
+	}
+	memset(words, 0, word_count * sizeof(jab_uint64));
+	if(decoder->words)
 	{
-		//read the encoded value
-		jab_boolean flag = 0;
-		jab_int32 value = 0;
-        jab_int32 n;
-        if(mode != Byte)
-        {
-            n = readData(bits, index, character_size[mode], &value);
-            if(n < character_size[mode])	//did not read enough bits
-                break;
-            //update index
-            index += character_size[mode];
-        }
+		memcpy(words, decoder->words, decoder->word_capacity * sizeof(jab_uint64));
+		memcpy(bytes, decoder->bytes, decoder->count * sizeof(jab_byte));
+		releaseDataDecoder(decoder);
+	}
+	decoder->words = words;
+	decoder->word_capacity = word_count;
+	decoder->bytes = bytes;
+	decoder->byte_capacity = byte_capacity;
+	return JAB_SUCCESS;
+}
 
-		//decode value
-		switch(mode)
+/**
+ * @brief Decode the data bits available in a data decoder. Codewords not yet complete are left for the next call.
+ * @param decoder the data decoder
+ * @param final whether no more data bits follow
+*/
+static void decodeAvailableData(jab_data_decoder* decoder, jab_boolean final)
+{
+	jab_uint64* words = decoder->words;
+	jab_byte* decoded_bytes = decoder->bytes;
+	jab_encode_mode mode = decoder->mode;
+	jab_encode_mode pre_mode = decoder->pre_mode;
+	jab_int32 length = decoder->length;
+	jab_int32 index = decoder->index;	//index of input bits
+	jab_int32 count = decoder->count;	//index of decoded bytes
+	jab_int32 byte_run = decoder->byte_run;
+
+	while(!decoder->finished && index < length)
+	{
+		if(mode == Byte)
 		{
-			case Upper:
-				if(value <= 26)
-				{
-					decoded_bytes[count++] = jab_decoding_table_upper[value];
-					if(pre_mode != None)
-						mode = pre_mode;
-				}
-				else
-				{
-					switch(value)
-					{
-						case 27:
-							mode = Punct;
-							pre_mode = Upper;
-							break;
-						case 28:
-							mode = Lower;
-							pre_mode = None;
-							break;
-						case 29:
-							mode = Numeric;
-							pre_mode = None;
-							break;
-						case 30:
-							mode = Alphanumeric;
-							pre_mode = None;
-							break;
-						case 31:
-							//read 2 bits more
-							n = readData(bits, index, 2, &value);
-							if(n < 2)	//did not read enough bits
-							{
-								flag = 1;
-								break;
-							}
-							//update index
-							index += 2;
-							switch(value)
-							{
-								case 0:
-									mode = Byte;
-									pre_mode = Upper;
-									break;
-								case 1:
-									mode = Mixed;
-									pre_mode = Upper;
-									break;
-								case 2:
-									mode = ECI;
-									pre_mode = None;
-									break;
-								case 3:
-									flag = 1;		//end of message (EOM)
-									break;
-							}
-							break;
-						default:
-							reportError("Invalid value decoded");
-							free(decoded_bytes);
-							return NULL;
-					}
-				}
-				break;
-			case Lower:
-				if(value <= 26)
-				{
-					decoded_bytes[count++] = jab_decoding_table_lower[value];
-					if(pre_mode != None)
-						mode = pre_mode;
-				}
-				else
-				{
-					switch(value)
-					{
-						case 27:
-							mode = Punct;
-							pre_mode = Lower;
-							break;
-						case 28:
-							mode = Upper;
-							pre_mode = Lower;
-							break;
-						case 29:
-							mode = Numeric;
-							pre_mode = None;
-							break;
-						case 30:
-							mode = Alphanumeric;
-							pre_mode = None;
-							break;
-						case 31:
-							//read 2 bits more
-							n = readData(bits, index, 2, &value);
-							if(n < 2)	//did not read enough bits
-							{
-								flag = 1;
-								break;
-							}
-							//update index
-							index += 2;
-							switch(value)
-							{
-								case 0:
-									mode = Byte;
-									pre_mode = Lower;
-									break;
-								case 1:
-									mode = Mixed;
-									pre_mode = Lower;
-									break;
-								case 2:
-									mode = Upper;
-									pre_mode = None;
-									break;
-								case 3:
-									mode = FNC1;
-									pre_mode = None;
-									break;
-							}
-							break;
-						default:
-							reportError("Invalid value decoded");
-							free(decoded_bytes);
-							return NULL;
-					}
-				}
-				break;
-			case Numeric:
-				if(value <= 12)
-				{
-					decoded_bytes[count++] = jab_decoding_table_numeric[value];
-					if(pre_mode != None)
-						mode = pre_mode;
-				}
-				else
-				{
-					switch(value)
-					{
-						case 13:
-							mode = Punct;
-							pre_mode = Numeric;
-							break;
-						case 14:
-							mode = Upper;
-							pre_mode = None;
-							break;
-						case 15:
-							//read 2 bits more
-							n = readData(bits, index, 2, &value);
-							if(n < 2)	//did not read enough bits
-							{
-								flag = 1;
-								break;
-							}
-							//update index
-							index += 2;
-							switch(value)
-							{
-								case 0:
-									mode = Byte;
-									pre_mode = Numeric;
-									break;
-								case 1:
-									mode = Mixed;
-									pre_mode = Numeric;
-									break;
-								case 2:
-									mode = Upper;
-									pre_mode = Numeric;
-									break;
-								case 3:
-									mode = Lower;
-									pre_mode = None;
-									break;
-							}
-							break;
-						default:
-							reportError("Invalid value decoded");
-							free(decoded_bytes);
-							return NULL;
-					}
-				}
-				break;
-			case Punct:
-				if(value >=0 && value <= 15)
-				{
-					decoded_bytes[count++] = jab_decoding_table_punct[value];
-					mode = pre_mode;
-				}
-				else
-				{
-					reportError("Invalid value decoded");
-					free(decoded_bytes);
-					return NULL;
-				}
-				break;
-			case Mixed:
-				if(value >=0 && value <= 31)
-				{
-					if(value == 19)
-					{
-						decoded_bytes[count++] = 10;
-						decoded_bytes[count++] = 13;
-					}
-					else if(value == 20)
-					{
-						decoded_bytes[count++] = 44;
-						decoded_bytes[count++] = 32;
-					}
-					else if(value == 21)
-					{
-						decoded_bytes[count++] = 46;
-						decoded_bytes[count++] = 32;
-					}
-					else if(value == 22)
-					{
-						decoded_bytes[count++] = 58;
-						decoded_bytes[count++] = 32;
-					}
-					else
-					{
-						decoded_bytes[count++] = jab_decoding_table_mixed[value];
-					}
-					mode = pre_mode;
-				}
-				else
-				{
-					reportError("Invalid value decoded");
-					free(decoded_bytes);
-					return NULL;
-				}
-				break;
-			case Alphanumeric:
-				if(value <= 62)
-				{
-					decoded_bytes[count++] = jab_decoding_table_alphanumeric[value];
-					if(pre_mode != None)
-						mode = pre_mode;
-				}
-				else if(value == 63)
-				{
-					//read 2 bits more
-					n = readData(bits, index, 2, &value);
-					if(n < 2)	//did not read enough bits
-					{
-						flag = 1;
-						break;
-					}
-					//update index
-					index += 2;
-					switch(value)
-					{
-						case 0:
-							mode = Byte;
-							pre_mode = Alphanumeric;
-							break;
-						case 1:
-							mode = Mixed;
-							pre_mode = Alphanumeric;
-							break;
-						case 2:
-							mode = Punct;
-							pre_mode = Alphanumeric;
-							break;
-						case 3:
-							mode = Upper;
-							pre_mode = None;
-							break;
-					}
-				}
-				else
-				{
-					reportError("Invalid value decoded");
-					free(decoded_bytes);
-					return NULL;
-				}
-				break;
-			case Byte:
+			if(byte_run == 0)
 			{
-				//read 4 bits more
-				n = readData(bits, index, 4, &value);
-				if(n < 4)	//did not read enough bits
+				//read 4 bits
+				jab_int32 byte_length = -1;
+				if(index + 4 <= length)
 				{
-                    reportError("Not enough bits to decode");
-					free(decoded_bytes);
-					return NULL;
+					byte_length = peekBits(words, index, 4);
+					if(byte_length == 0)		//read the next 13 bits
+						byte_length = (index + 17 <= length) ? peekBits(words, index + 4, 13) + 15+1 : -1;	//the number of encoded bytes = value + 15
 				}
-				//update index
-				index += 4;
-				if(value == 0)		//read the next 13 bits
+				if(byte_length < 0)	//did not read enough bits
 				{
-					//read 13 bits more
-					n = readData(bits, index, 13, &value);
-					if(n < 13)	//did not read enough bits
+					if(final)
 					{
-                        reportError("Not enough bits to decode");
-						free(decoded_bytes);
-						return NULL;
+						reportError("Not enough bits to decode");
+						decoder->failed = 1;
 					}
-                    value += 15+1;	//the number of encoded bytes = value + 15
-					//update index
-					index += 13;
+					break;
 				}
-				jab_int32 byte_length = value;
-				//read the next (byte_length * 8) bits
-				for(jab_int32 i=0; i<byte_length; i++)
+				index += byte_length > 15 ? 17 : 4;
+				byte_run = byte_length;
+			}
+			//read the bytes of the run available so far
+			jab_int32 byte_count = MIN(byte_run, (length - index) / 8);
+			for(jab_int32 i=0; i<byte_count; i++)
+			{
+				decoded_bytes[count++] = (jab_byte)peekBits(words, index, 8);
+				index += 8;
+			}
+			byte_run -= byte_count;
+			if(byte_run > 0)	//did not read enough bits
+			{
+				if(final)
 				{
-					n = readData(bits, index, 8, &value);
-					if(n < 8)	//did not read enough bits
-					{
-                        reportError("Not enough bits to decode");
-						free(decoded_bytes);
-						return NULL;
-					}
-					//update index
-					index += 8;
-					decoded_bytes[count++] = (jab_byte)value;
+					reportError("Not enough bits to decode");
+					decoder->failed = 1;
 				}
-				mode = pre_mode;
 				break;
 			}
-			case ECI:
-				//TODO: not implemented
-				index += bits->length;
-				break;
-			case FNC1:
-				//TODO: not implemented
-				index += bits->length;
+			mode = pre_mode;
+			continue;
+		}
+		if(mode == ECI || mode == FNC1)	//TODO: not implemented
+		{
+			decoder->finished = 1;
+			break;
+		}
+		if(mode == None)
+		{
+			reportError("Decoding mode is None.");
+			decoder->finished = 1;
+			break;
+		}
+
+		//read the encoded value
+		if(index + character_size[mode] > length)	//did not read enough bits
+			break;
+		const jab_decode_entry* entry = &decoder->table[mode][peekBits(words, index, character_size[mode])];
+
+		//decode value
+		if(entry->count > 0)
+		{
+			index += character_size[mode];
+			decoded_bytes[count] = entry->bytes[0];
+			decoded_bytes[count+1] = entry->bytes[1];
+			count += entry->count;
+			if(pre_mode != None)
+				mode = pre_mode;
+		}
+		else if(entry->escape)
+		{
+			//read 2 bits more
+			if(index + character_size[mode] + 2 > length)	//did not read enough bits
 				break;
-			case None:
-				reportError("Decoding mode is None.");
-				index += bits->length;
+			const jab_encode_mode* next = jab_escape_switch[mode][peekBits(words, index + character_size[mode], 2)];
+			index += character_size[mode] + 2;
+			if(next[0] == None)	//end of message (EOM)
+			{
+				decoder->finished = 1;
 				break;
+			}
+			mode = next[0];
+			pre_mode = next[1];
 		}
-		if(flag) break;
+		else
+		{
+			index += character_size[mode];
+			mode = entry->mode;
+			pre_mode = entry->pre_mode;
+		}
+	}
+	if(final && byte_run > 0 && !decoder->failed)	//the data ends inside a byte run
+	{
+		reportError("Not enough bits to decode");
+		decoder->failed = 1;
 	}
+	decoder->mode = mode;
+	decoder->pre_mode = pre_mode;
+	decoder->index = index;
+	decoder->count = count;
+	decoder->byte_run = byte_run;
+}
 
-	//copy decoded data
-	jab_data* decoded_data = (jab_data *)malloc(sizeof(jab_data) + count * sizeof(jab_byte));
-	if(decoded_data == NULL){
-        reportError("Memory allocation for decoded data failed");
-        return NULL;
-    }
-    decoded_data->length = count;
-    memcpy(decoded_data->data, decoded_bytes, count);
+/**
+ * @brief Pass the bytes decoded since the last call to the callback of a data decoder
+ * @param decoder the data decoder
+ * @param symbol_index the index of the symbol whose data was decoded last
+*/
+static void deliverDecodedBytes(jab_data_decoder* decoder, jab_int32 symbol_index)
+{
+	if(decoder->callback && decoder->count > decoder->delivered)
+		decoder->callback(decoder->user_data, symbol_index, decoder->bytes + decoder->delivered, decoder->count - decoder->delivered);
+	decoder->delivered = decoder->count;
+}
+
+/**
+ * @brief Append the data of the next symbol in cascade order to a data decoder and decode the completed codewords
+ * @param decoder the data decoder
+ * @param bits the data bits of the symbol
+ * @param symbol_index the symbol index
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean appendSymbolData(jab_data_decoder* decoder, jab_data* bits, jab_int32 symbol_index)
+{
+	if(decoder->failed)
+		return JAB_FAILURE;
+	if(!reserveDataBits(decoder, decoder->length + bits->length))
+	{
+		decoder->failed = 1;
+		return JAB_FAILURE;
+	}
+	jab_int64 stage_start = startDecodeStage();
+	//the appended bits continue in the last, partly filled word
+	jab_int32 shift = decoder->length & 63;
+	jab_uint64* dst = decoder->words + (decoder->length >> 6);
+	for(jab_int32 i=0; i<bits->length; i+=64)
+	{
+		jab_uint64 word = packWord(&bits->data[i], MIN(64, bits->length - i));
+		dst[i/64] |= word >> shift;
+		if(shift > 0)
+			dst[i/64 + 1] |= word << (64 - shift);
+	}
+	decoder->length += bits->length;
+
+	decodeAvailableData(decoder, 0);
+	endDecodeStage(DECODE_STAGE_DATA, stage_start);
+	deliverDecodedBytes(decoder, symbol_index);
+	return !decoder->failed;
+}
 
-	free(decoded_bytes);
+/**
+ * @brief Decode the remaining data bits of a data decoder and release its buffers
+ * @param decoder the data decoder
+ * @param symbol_index the index of the last symbol
+ * @return the data message | NULL if failed
+*/
+jab_data* finishDataDecoder(jab_data_decoder* decoder, jab_int32 symbol_index)
+{
+	jab_data* decoded_data = NULL;
+	if(!decoder->failed)
+	{
+		jab_int64 stage_start = startDecodeStage();
+		decodeAvailableData(decoder, 1);
+		endDecodeStage(DECODE_STAGE_DATA, stage_start);
+	}
+	if(!decoder->failed)
+	{
+		deliverDecodedBytes(decoder, symbol_index);
+		//copy decoded data
+		decoded_data = (jab_data *)malloc(sizeof(jab_data) + decoder->count * sizeof(jab_byte));
+		if(decoded_data == NULL)
+			reportError("Memory allocation for decoded data failed");
+		else
+		{
+			decoded_data->length = decoder->count;
+			if(decoder->count > 0)
+				memcpy(decoded_data->data, decoder->bytes, decoder->count);
+		}
+	}
+	releaseDataDecoder(decoder);
 	return decoded_data;
 }
+
+/**
+ * @brief Interpret decoded bits
+ * @param bits the input bits
+ * @return the data message
+*/
+jab_data* decodeData(jab_data* bits)
+{
+	jab_data_decoder decoder;
+	initDataDecoder(&decoder, NULL, NULL);
+	if(!appendSymbolData(&decoder, bits, 0))
+	{
+		releaseDataDecoder(&decoder);
+		return NULL;
+	}
+	return finishDataDecoder(&decoder, 0);
+}
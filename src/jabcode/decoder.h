@@ -61,8 +61,63 @@ typedef enum {
 	FNC1
 }jab_encode_mode;
 
+/**
+ * @brief Mode switches selected by the 2 bits following the escape codeword, as {mode, previous mode}.
+ * None as mode marks the end of message, a mode without escape codeword has no entries.
+*/
+static const jab_encode_mode jab_escape_switch[JAB_ENCODING_MODES][4][2] =
+		{	{{Byte, Upper},			{Mixed, Upper},			{ECI, None},				{None, None}},	//upper case mode
+			{{Byte, Lower},			{Mixed, Lower},			{Upper, None},				{FNC1, None}},	//lower case mode
+			{{Byte, Numeric},		{Mixed, Numeric},		{Upper, Numeric},			{Lower, None}},	//numeric mode
+			{{None, None},			{None, None},			{None, None},				{None, None}},	//punctuation mode
+			{{None, None},			{None, None},			{None, None},				{None, None}},	//mixed mode
+			{{Byte, Alphanumeric},	{Mixed, Alphanumeric},	{Punct, Alphanumeric},		{Upper, None}}	//alphanumeric mode
+		};
+
+/**
+ * @brief Decoded character pairs of the mixed mode values 19 to 22
+*/
+static const jab_byte jab_decoding_table_mixed_pair[4][2] = {{10, 13}, {44, 32}, {46, 32}, {58, 32}};
+
+/**
+ * @brief Decoding table entry of a codeword in a mode
+*/
+typedef struct {
+	jab_byte		count;		///< The number of decoded bytes, 0 for a mode switch
+	jab_byte		bytes[2];	///< The decoded bytes
+	jab_boolean		escape;		///< Whether the mode switch is selected by the next 2 bits
+	jab_encode_mode	mode;		///< The mode switched to, None for the end of message
+	jab_encode_mode	pre_mode;	///< The mode to return to after the next character, None for a latch
+}jab_decode_entry;
+
+/**
+ * @brief Incremental decoder of the data stream, fed with the data of the symbols in cascade order
+*/
+typedef struct {
+	jab_decode_entry	table[JAB_ENCODING_MODES][64];	///< The decoding table
+	jab_uint64*	words;				///< The data bits packed into 64-bit words, followed by zero words
+	jab_int32	word_capacity;		///< The number of allocated words
+	jab_int32	length;				///< The number of data bits
+	jab_int32	index;				///< The offset of the next bit to decode
+	jab_encode_mode	mode;			///< The current encoding mode
+	jab_encode_mode	pre_mode;		///< The mode to return to after the next character
+	jab_int32	byte_run;			///< The number of bytes left in the current byte mode run
+	jab_boolean	finished;			///< Whether the end of the message was reached
+	jab_boolean	failed;				///< Whether decoding failed
+	jab_byte*	bytes;				///< The decoded bytes
+	jab_int32	byte_capacity;		///< The number of allocated bytes
+	jab_int32	count;				///< The number of decoded bytes
+	jab_int32	delivered;			///< The number of decoded bytes passed to the callback
+	jab_payload_callback	callback;	///< Called with the newly decoded bytes after each symbol, NULL if not needed
+	void*		user_data;			///< The user data passed to the callback
+}jab_data_decoder;
+
 extern jab_int32 decodeMaster(jab_bitmap* matrix, jab_decoded_symbol* symbol);
 extern jab_int32 decodeSlave(jab_bitmap* matrix, jab_decoded_symbol* symbol);
+extern void initDataDecoder(jab_data_decoder* decoder, jab_payload_callback callback, void* user_data);
+extern jab_boolean appendSymbolData(jab_data_decoder* decoder, jab_data* bits, jab_int32 symbol_index);
+extern jab_data* finishDataDecoder(jab_data_decoder* decoder, jab_int32 symbol_index);
+extern void releaseDataDecoder(jab_data_decoder* decoder);
 extern jab_data* decodeData(jab_data* bits);
 extern void deinterleaveData(jab_data* data);
 extern void getNextMetadataModuleInMaster(jab_int32 matrix_height, jab_int32 matrix_width, jab_int32 next_module_count, jab_int32* x, jab_int32* y);
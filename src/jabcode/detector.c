@@ -19,6 +19,9 @@
 #include "detector.h"
 #include "decoder.h"
 #include "encoder.h"
+#include "arena.h"
+#include "ldpc.h"
+#include "timer.h"
 
 /**
  * @brief Check the proportion of layer sizes in finder pattern
@@ -1349,7 +1352,7 @@ void seekMissingFinderPattern(jab_bitmap* bitmap, jab_finder_pattern* fps, jab_i
 	jab_bitmap* rgb[3];
 	for(jab_int32 i=0; i<3; i++)
 	{
-		rgb[i] = (jab_bitmap*)calloc(1, sizeof(jab_bitmap) + area_height*area_width*sizeof(jab_byte));
+		rgb[i] = (jab_bitmap*)scratchCalloc(1, sizeof(jab_bitmap) + area_height*area_width*sizeof(jab_byte));
 		if(rgb[i] == NULL)
 		{
 			JAB_REPORT_INFO(("Memory allocation for binary bitmap failed, the missing finder pattern can not be found."))
@@ -1431,7 +1434,7 @@ void seekMissingFinderPattern(jab_bitmap* bitmap, jab_finder_pattern* fps, jab_i
 		break;
 	}
 	//search for the missing finder pattern
-	jab_finder_pattern* fps_miss = (jab_finder_pattern*)calloc(MAX_FINDER_PATTERNS, sizeof(jab_finder_pattern));
+	jab_finder_pattern* fps_miss = (jab_finder_pattern*)scratchCalloc(MAX_FINDER_PATTERNS, sizeof(jab_finder_pattern));
     if(fps_miss == NULL)
     {
         reportError("Memory allocation for finder patterns failed, the missing finder pattern can not be found.");
@@ -1575,7 +1578,7 @@ jab_finder_pattern* findMasterSymbol(jab_bitmap* bitmap, jab_bitmap* ch[], jab_d
     jab_int32 min_module_size = ch[0]->height / (2 * MAX_SYMBOL_ROWS * MAX_MODULES);
     if(min_module_size < 1 || mode == INTENSIVE_DETECT) min_module_size = 1;
 
-    jab_finder_pattern* fps = (jab_finder_pattern*)calloc(MAX_FINDER_PATTERNS, sizeof(jab_finder_pattern));
+    jab_finder_pattern* fps = (jab_finder_pattern*)scratchCalloc(MAX_FINDER_PATTERNS, sizeof(jab_finder_pattern));
     if(fps == NULL)
     {
         reportError("Memory allocation for finder patterns failed");
@@ -2297,15 +2300,10 @@ jab_alignment_pattern findAlignmentPattern(jab_bitmap* ch[], jab_float x, jab_fl
     jab_int32 radius = (jab_int32)(4 * module_size);
     jab_int32 radius_max = 4 * radius;
 
+    //candidate buffer, only the first 'counter' entries are valid
+    jab_alignment_pattern aps[MAX_FINDER_PATTERNS];
     for(; radius<radius_max; radius<<=1)
     {
-        jab_alignment_pattern* aps = (jab_alignment_pattern*)calloc(MAX_FINDER_PATTERNS, sizeof(jab_alignment_pattern));
-        if(aps == NULL)
-        {
-            reportError("Memory allocation for alignment patterns failed");
-            return ap;
-        }
-
         jab_int32 startx = (jab_int32)MAX(0, x - radius);
         jab_int32 starty = (jab_int32)MAX(0, y - radius);
         jab_int32 endx = (jab_int32)MIN(ch[0]->width - 1, x + radius);
@@ -2313,7 +2311,7 @@ jab_alignment_pattern findAlignmentPattern(jab_bitmap* ch[], jab_float x, jab_fl
         if(endx - startx < 3 * module_size || endy - starty < 3 * module_size) continue;
 
         jab_int32 counter = 0;
-        for(jab_int32 k=starty; k<endy; k++)
+        for(jab_int32 k=starty; k<endy && counter<MAX_FINDER_PATTERNS; k++)
         {
             //search from middle outwards
             jab_int32 kk = k - starty;
@@ -2390,11 +2388,9 @@ jab_alignment_pattern findAlignmentPattern(jab_bitmap* ch[], jab_float x, jab_fl
             if(index >= 0) //if found twice, done!
             {
                 ap = aps[index];
-                free(aps);
                 return ap;
             }
         }
-        free(aps);
     }
     ap.type = -1;
     ap.found_count = 0;
@@ -2412,7 +2408,7 @@ jab_alignment_pattern findAlignmentPattern(jab_bitmap* ch[], jab_float x, jab_fl
 */
 jab_boolean findSlaveSymbol(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbol* host_symbol, jab_decoded_symbol* slave_symbol, jab_int32 docked_position)
 {
-    jab_alignment_pattern* aps = (jab_alignment_pattern*)calloc(4, sizeof(jab_alignment_pattern));
+    jab_alignment_pattern* aps = (jab_alignment_pattern*)scratchCalloc(4, sizeof(jab_alignment_pattern));
     if(aps == NULL)
     {
         reportError("Memory allocation for alignment patterns failed");
@@ -2578,7 +2574,7 @@ jab_boolean findSlaveSymbol(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_sy
     //if neither ap3 nor ap4 is found, failed
     if(aps[ap3].found_count == 0 && aps[ap4].found_count == 0)
     {
-        free(aps);
+        scratchFree(aps);
         return JAB_FAILURE;
     }
     //if only 3 aps are found, try anyway by estimating the coordinate of the fourth one
@@ -2594,7 +2590,7 @@ jab_boolean findSlaveSymbol(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_sy
         if(aps[ap3].center.x > bitmap->width - 1 || aps[ap3].center.y > bitmap->height - 1)
         {
 			JAB_REPORT_ERROR(("Alignment pattern %d out of image", ap3))
-			free(aps);
+			scratchFree(aps);
 			return JAB_FAILURE;
         }
     }
@@ -2610,7 +2606,7 @@ jab_boolean findSlaveSymbol(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_sy
         if(aps[ap4].center.x > bitmap->width - 1 || aps[ap4].center.y > bitmap->height - 1)
         {
 			JAB_REPORT_ERROR(("Alignment pattern %d out of image", ap4))
-			free(aps);
+			scratchFree(aps);
 			return JAB_FAILURE;
         }
     }
@@ -2632,7 +2628,7 @@ jab_boolean findSlaveSymbol(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_sy
 	saveImage(test_mode_bitmap, "jab_detector_result_slave.png");
 #endif
 
-    free(aps);
+    scratchFree(aps);
     return JAB_SUCCESS;
 }
 
@@ -2969,7 +2965,7 @@ jab_bitmap* sampleSymbolByAlignmentPattern(jab_bitmap* bitmap, jab_bitmap* ch[],
     jab_int32 number_of_ap_y = jab_ap_num[side_ver_y_index];
 
     //buffer for all possible alignment patterns
-	jab_alignment_pattern* aps = (jab_alignment_pattern *)malloc(number_of_ap_x * number_of_ap_y *sizeof(jab_alignment_pattern));
+	jab_alignment_pattern* aps = (jab_alignment_pattern *)scratchMalloc(number_of_ap_x * number_of_ap_y * sizeof(jab_alignment_pattern));
 	if(aps == NULL)
 	{
 		reportError("Memory allocation for alignment patterns failed");
@@ -3127,23 +3123,25 @@ jab_bitmap* sampleSymbolByAlignmentPattern(jab_bitmap* bitmap, jab_bitmap* ch[],
 		}
 	}
 
-	//allocate the buffer for the sampled matrix of the symbol
+	//calculate the transformation matrix of each block and assign every module to the last block covering it
     jab_int32 width = symbol->side_size.x;
 	jab_int32 height= symbol->side_size.y;
-	jab_int32 mtx_bytes_per_pixel = bitmap->bits_per_pixel / 8;
-	jab_int32 mtx_bytes_per_row = width * mtx_bytes_per_pixel;
-	jab_bitmap* matrix = (jab_bitmap*)malloc(sizeof(jab_bitmap) + width*height*mtx_bytes_per_pixel*sizeof(jab_byte));
-	if(matrix == NULL)
+	jab_int32 rect_number = rect_index / 2;
+	jab_perspective_transform* pts = (jab_perspective_transform *)scratchMalloc(rect_number * sizeof(jab_perspective_transform));
+	jab_vector2d* origins = (jab_vector2d *)scratchMalloc(rect_number * sizeof(jab_vector2d));
+	jab_vector2d* sizes = (jab_vector2d *)scratchMalloc(rect_number * sizeof(jab_vector2d));
+	jab_byte* block_map = (jab_byte *)scratchMalloc(width * height * sizeof(jab_byte));
+	if(pts == NULL || origins == NULL || sizes == NULL || block_map == NULL)
 	{
-		reportError("Memory allocation for symbol bitmap matrix failed");
+		reportError("Memory allocation for sampling blocks failed");
+		scratchFree(block_map);
+		scratchFree(sizes);
+		scratchFree(origins);
+		scratchFree(pts);
+		scratchFree(aps);
 		return NULL;
 	}
-	matrix->channel_count = bitmap->channel_count;
-	matrix->bits_per_channel = bitmap->bits_per_channel;
-	matrix->bits_per_pixel = matrix->bits_per_channel * matrix->channel_count;
-	matrix->width = width;
-	matrix->height= height;
-
+	memset(block_map, 0xFF, width * height * sizeof(jab_byte));
 	for(jab_int32 i=0; i<rect_index; i+=2)
 	{
 		jab_vector2d blk_size;
@@ -3193,62 +3191,50 @@ jab_bitmap* sampleSymbolByAlignmentPattern(jab_bitmap* bitmap, jab_bitmap* ch[],
 			p2.x = (jab_float)blk_size.x - 3.5f;
 		}
 		//calculate perspective transform matrix for the current block
-		jab_perspective_transform* pt = perspectiveTransform(
-					p0.x, p0.y,
-					p1.x, p1.y,
-					p2.x, p2.y,
-					p3.x, p3.y,
-					aps[rect[i+0].y*number_of_ap_x + rect[i+0].x].center.x, aps[rect[i+0].y*number_of_ap_x + rect[i+0].x].center.y,
-					aps[rect[i+0].y*number_of_ap_x + rect[i+1].x].center.x, aps[rect[i+0].y*number_of_ap_x + rect[i+1].x].center.y,
-					aps[rect[i+1].y*number_of_ap_x + rect[i+1].x].center.x, aps[rect[i+1].y*number_of_ap_x + rect[i+1].x].center.y,
-					aps[rect[i+1].y*number_of_ap_x + rect[i+0].x].center.x, aps[rect[i+1].y*number_of_ap_x + rect[i+0].x].center.y);
-		if(pt == NULL)
-		{
-			free(aps);
-			free(matrix);
-			return NULL;
-		}
-		//sample the current block
-#if TEST_MODE
-		test_mode_color = 0;
-#endif
-		jab_bitmap* block = sampleSymbol(bitmap, pt, blk_size);
-		free(pt);
-		if(block == NULL)
-		{
-			reportError("Sampling block failed");
-			free(aps);
-			free(matrix);
-			return NULL;
-		}
-		//save the sampled block in the matrix
+		jab_int32 blk = i / 2;
+		calcPerspectiveTransform(p0.x, p0.y,
+								 p1.x, p1.y,
+								 p2.x, p2.y,
+								 p3.x, p3.y,
+								 aps[rect[i+0].y*number_of_ap_x + rect[i+0].x].center.x, aps[rect[i+0].y*number_of_ap_x + rect[i+0].x].center.y,
+								 aps[rect[i+0].y*number_of_ap_x + rect[i+1].x].center.x, aps[rect[i+0].y*number_of_ap_x + rect[i+1].x].center.y,
+								 aps[rect[i+1].y*number_of_ap_x + rect[i+1].x].center.x, aps[rect[i+1].y*number_of_ap_x + rect[i+1].x].center.y,
+								 aps[rect[i+1].y*number_of_ap_x + rect[i+0].x].center.x, aps[rect[i+1].y*number_of_ap_x + rect[i+0].x].center.y,
+								 &pts[blk]);
+		//the modules covered by the current block in the matrix
 		jab_int32 start_x = jab_ap_pos[side_ver_x_index][rect[i].x] - 1;
 		jab_int32 start_y = jab_ap_pos[side_ver_y_index][rect[i].y] - 1;
 		if(rect[i].x == 0)
 			start_x = 0;
 		if(rect[i].y == 0)
 			start_y = 0;
-		jab_int32 blk_bytes_per_pixel = block->bits_per_pixel / 8;
-		jab_int32 blk_bytes_per_row = blk_size.x * mtx_bytes_per_pixel;
+		origins[blk].x = start_x;
+		origins[blk].y = start_y;
+		sizes[blk] = blk_size;
 		for(jab_int32 y=0, mtx_y=start_y; y<blk_size.y && mtx_y<height; y++, mtx_y++)
 		{
-			for(jab_int32 x=0, mtx_x=start_x; x<blk_size.x && mtx_x<width; x++, mtx_x++)
-			{
-				jab_int32 mtx_offset = mtx_y * mtx_bytes_per_row + mtx_x * mtx_bytes_per_pixel;
-				jab_int32 blk_offset = y * blk_bytes_per_row + x * blk_bytes_per_pixel;
-				matrix->pixel[mtx_offset] 	  = block->pixel[blk_offset];
-				matrix->pixel[mtx_offset + 1] = block->pixel[blk_offset + 1];
-				matrix->pixel[mtx_offset + 2] = block->pixel[blk_offset + 2];
-				matrix->pixel[mtx_offset + 3] = block->pixel[blk_offset + 3];
-			}
+			memset(block_map + mtx_y * width + start_x, blk, MIN(blk_size.x, width - start_x) * sizeof(jab_byte));
 		}
-		free(block);
+	}
+
+	//sample all blocks in a single pass over the symbol
+#if TEST_MODE
+	test_mode_color = 0;
+#endif
+	jab_bitmap* matrix = sampleSymbolByBlocks(bitmap, pts, origins, sizes, rect_number, block_map, symbol->side_size);
+	scratchFree(block_map);
+	scratchFree(sizes);
+	scratchFree(origins);
+	scratchFree(pts);
+	scratchFree(aps);
+	if(matrix == NULL)
+	{
+		reportError("Sampling block failed");
+		return NULL;
 	}
 #if TEST_MODE
     saveImage(test_mode_bitmap, "jab_sample_pos_ap.png");
 #endif
-
-	free(aps);
 	return matrix;
 }
 
@@ -3332,7 +3318,9 @@ jab_boolean detectMaster(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbo
     //find master symbol
     jab_finder_pattern* fps;
     jab_int32 status;
+    jab_int64 stage_start = startDecodeStage();
     fps = findMasterSymbol(bitmap, ch, INTENSIVE_DETECT, &status);
+    endDecodeStage(DECODE_STAGE_FINDER, stage_start);
     if(status == FATAL_ERROR) return JAB_FAILURE;
     else if(status == JAB_FAILURE)
     {
@@ -3340,20 +3328,25 @@ jab_boolean detectMaster(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbo
         JAB_REPORT_INFO(("Trying to detect more finder patterns based on the found ones"))
 #endif
         //calculate the average pixel value around the found FPs
+        stage_start = startDecodeStage();
         jab_float rgb_ave[3];
         getAveragePixelValue(bitmap, fps, rgb_ave);
-        free(fps);
+        scratchFree(fps);
         //binarize the bitmap using the average pixel values as thresholds
-        for(jab_int32 i=0; i<3; free(ch[i++]));
-        if(!binarizerRGB(bitmap, ch, rgb_ave))
+        for(jab_int32 i=0; i<3; scratchFree(ch[i++]));
+        jab_boolean binarized = binarizerRGB(bitmap, ch, rgb_ave);
+        endDecodeStage(DECODE_STAGE_RETRY_BINARIZE, stage_start);
+        if(!binarized)
         {
             return JAB_FAILURE;
         }
         //find master symbol
+        stage_start = startDecodeStage();
         fps = findMasterSymbol(bitmap, ch, INTENSIVE_DETECT, &status);
+        endDecodeStage(DECODE_STAGE_FINDER, stage_start);
         if(status == JAB_FAILURE || status == FATAL_ERROR)
         {
-            free(fps);
+            scratchFree(fps);
             return JAB_FAILURE;
         }
     }
@@ -3363,7 +3356,7 @@ jab_boolean detectMaster(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbo
     if(side_size.x == -1 || side_size.y == -1)
     {
 		reportError("Calculating side size failed");
-        free(fps);
+        scratchFree(fps);
 		return JAB_FAILURE;
     }
 #if TEST_MODE
@@ -3376,7 +3369,7 @@ jab_boolean detectMaster(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbo
 															side_size);
 	if(pt == NULL)
 	{
-		free(fps);
+		scratchFree(fps);
 		return JAB_FAILURE;
 	}
 
@@ -3384,15 +3377,17 @@ jab_boolean detectMaster(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbo
 #if TEST_MODE
 	test_mode_color = 255;
 #endif
+	stage_start = startDecodeStage();
 	jab_bitmap* matrix = sampleSymbol(bitmap, pt, side_size);
-	free(pt);
+	endDecodeStage(DECODE_STAGE_SAMPLING, stage_start);
+	scratchFree(pt);
 #if TEST_MODE
 	saveImage(test_mode_bitmap, "jab_sample_pos_fp.png");
 #endif
 	if(matrix == NULL)
 	{
 		reportError("Sampling master symbol failed");
-		free(fps);
+		scratchFree(fps);
 		return JAB_FAILURE;
 	}
 
@@ -3408,15 +3403,15 @@ jab_boolean detectMaster(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbo
 
 	//decode master symbol
 	jab_int32 decode_result = decodeMaster(matrix, master_symbol);
-	free(matrix);
+	scratchFree(matrix);
 	if(decode_result == JAB_SUCCESS)
 	{
-		free(fps);
+		scratchFree(fps);
 		return JAB_SUCCESS;
 	}
 	else if(decode_result < 0)	//fatal error occurred
 	{
-		free(fps);
+		scratchFree(fps);
 		return JAB_FAILURE;
 	}
 	else	//if decoding using only finder patterns failed, try decoding using alignment patterns
@@ -3426,8 +3421,10 @@ jab_boolean detectMaster(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbo
 #endif // TEST_MODE
 		master_symbol->side_size.x = VERSION2SIZE(master_symbol->metadata.side_version.x);
 		master_symbol->side_size.y = VERSION2SIZE(master_symbol->metadata.side_version.y);
+		stage_start = startDecodeStage();
 		matrix = sampleSymbolByAlignmentPattern(bitmap, ch, master_symbol, fps);
-		free(fps);
+		endDecodeStage(DECODE_STAGE_SAMPLING, stage_start);
+		scratchFree(fps);
 		if(matrix == NULL)
 		{
 #if TEST_MODE
@@ -3436,7 +3433,7 @@ jab_boolean detectMaster(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbo
 			return JAB_FAILURE;
 		}
 		decode_result = decodeMaster(matrix, master_symbol);
-		free(matrix);
+		scratchFree(matrix);
 		if(decode_result == JAB_SUCCESS)
 			return JAB_SUCCESS;
 		else
@@ -3463,7 +3460,10 @@ jab_bitmap* detectSlave(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbol
     }
 
     //find slave symbol next to the host symbol
-    if(!findSlaveSymbol(bitmap, ch, host_symbol, slave_symbol, docked_position))
+    jab_int64 stage_start = startDecodeStage();
+    jab_boolean found = findSlaveSymbol(bitmap, ch, host_symbol, slave_symbol, docked_position);
+    endDecodeStage(DECODE_STAGE_FINDER, stage_start);
+    if(!found)
     {
         JAB_REPORT_ERROR(("Slave symbol %d not found", slave_symbol->index))
         return NULL;
@@ -3482,15 +3482,17 @@ jab_bitmap* detectSlave(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbol
 #if TEST_MODE
 	test_mode_color = 255;
 #endif
+    stage_start = startDecodeStage();
     jab_bitmap* matrix = sampleSymbol(bitmap, pt, slave_symbol->side_size);
+    endDecodeStage(DECODE_STAGE_SAMPLING, stage_start);
     if(matrix == NULL)
     {
         JAB_REPORT_ERROR(("Sampling slave symbol %d failed", slave_symbol->index))
-        free(pt);
+        scratchFree(pt);
         return JAB_FAILURE;
     }
 
-    free(pt);
+    scratchFree(pt);
     return matrix;
 }
 
@@ -3501,9 +3503,10 @@ jab_bitmap* detectSlave(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbol
  * @param symbols the symbol list
  * @param host_index the index number of the host symbol
  * @param total the number of symbols in the list
+ * @param stream the data decoder the data of the decoded slave symbols is appended to
  * @return JAB_SUCCESS | JAB_FAILURE
 */
-jab_boolean decodeDockedSlaves(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbol* symbols, jab_int32 host_index, jab_int32* total)
+jab_boolean decodeDockedSlaves(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded_symbol* symbols, jab_int32 host_index, jab_int32* total, jab_data_decoder* stream)
 {
     jab_int32 docked_positions[4] = {0};
     docked_positions[0] = symbols[host_index].metadata.docked_position & 0x08;
@@ -3527,11 +3530,13 @@ jab_boolean decodeDockedSlaves(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded
             if(decodeSlave(matrix, &symbols[*total]) > 0)
             {
                 (*total)++;
-                free(matrix);
+                scratchFree(matrix);
+                if(!appendSymbolData(stream, symbols[*total-1].data, *total-1))
+                    return JAB_FAILURE;
             }
             else
             {
-                free(matrix);
+                scratchFree(matrix);
                 return JAB_FAILURE;
             }
         }
@@ -3540,8 +3545,72 @@ jab_boolean decodeDockedSlaves(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded
 }
 
 /**
- * @brief Extended function to decode a JAB Code
- * @param bitmap the image bitmap
+ * @brief Check the decoding result of the symbols and decode the rest of the data stream
+ * @param stream the data decoder holding the data of the decoded symbols
+ * @param symbols the decoded symbols
+ * @param total the number of decoded symbols
+ * @param res whether all detected symbols were decoded
+ * @param mode the decoding mode
+ * @param status the decoding status code
+ * @param max_symbol_number the maximal possible number of symbols to be decoded
+ * @return the decoded data | NULL if failed
+*/
+jab_data* collectDecodedData(jab_data_decoder* stream, jab_decoded_symbol* symbols, jab_int32 total, jab_boolean res, jab_int32 mode, jab_int32* status, jab_int32 max_symbol_number)
+{
+    //check result
+	if(total == 0 || (mode == NORMAL_DECODE && res == 0 ))
+	{
+		if(symbols[0].module_size > 0 && status)
+			*status = 1;
+		//clean memory
+		releaseDataDecoder(stream);
+		for(jab_int32 i=0; i<=MIN(total, max_symbol_number-1); i++)
+		{
+			scratchFree(symbols[i].palette);
+			scratchFree(symbols[i].data);
+		}
+        return NULL;
+	}
+	if(mode == COMPATIBLE_DECODE && res == 0)
+	{
+		if(status) *status = 2;
+		res = 1;
+	}
+
+    jab_decode_stats* stats = getDecodeStats();
+    if(stats)
+		stats->symbols = total;
+
+    //decode the data bits not decoded yet
+    jab_data* decoded_data = finishDataDecoder(stream, total-1);
+    if(decoded_data == NULL)
+	{
+		reportError("Decoding data failed");
+		if(status) *status = 1;
+		res = 0;
+	}
+
+    //clean memory
+    for(jab_int32 i=0; i<=MIN(total, max_symbol_number-1); i++)
+    {
+		scratchFree(symbols[i].palette);
+		scratchFree(symbols[i].data);
+    }
+	if(res == 0) return NULL;
+	if(status)
+	{
+		if(*status != 2)
+			*status = 3;
+	}
+    return decoded_data;
+}
+
+/**
+ * @brief Decode a JAB Code in a frame whose statistics have been collected
+ * @param ctx the decode context, NULL if none
+ * @param bitmap the frame bitmap, or the RGB frame receiving the converted pixels of source
+ * @param source the caller-owned pixels, NULL if bitmap holds the pixels
+ * @param stats the frame statistics
  * @param mode the decoding mode(NORMAL_DECODE: only output completely decoded data when all symbols are correctly decoded
  *								 COMPATIBLE_DECODE: also output partly decoded data even if some symbols are not correctly decoded
  * @param status the decoding status code (0: not detectable, 1: not decodable, 2: partly decoded with COMPATIBLE_DECODE mode, 3: fully decoded)
@@ -3549,7 +3618,7 @@ jab_boolean decodeDockedSlaves(jab_bitmap* bitmap, jab_bitmap* ch[], jab_decoded
  * @param max_symbol_number the maximal possible number of symbols to be decoded
  * @return the decoded data | NULL if failed
 */
-jab_data* decodeJABCodeEx(jab_bitmap* bitmap, jab_int32 mode, jab_int32* status, jab_decoded_symbol* symbols, jab_int32 max_symbol_number)
+jab_data* decodeFrame(jab_decode_context* ctx, jab_bitmap* bitmap, jab_pixel_buffer* source, jab_frame_stats* stats, jab_int32 mode, jab_int32* status, jab_decoded_symbol* symbols, jab_int32 max_symbol_number)
 {
 	if(status) *status = 0;
 	if(!symbols)
@@ -3558,10 +3627,9 @@ jab_data* decodeJABCodeEx(jab_bitmap* bitmap, jab_int32 mode, jab_int32* status,
 		return NULL;
 	}
 
-	//binarize r, g, b channels
+	//balance and binarize r, g, b channels
 	jab_bitmap* ch[3];
-	balanceRGB(bitmap);
-    if(!binarizerRGB(bitmap, ch, 0))
+    if(!balanceBinarizeRGB(bitmap, source, stats, ch))
 	{
 		return NULL;
 	}
@@ -3586,18 +3654,22 @@ jab_data* decodeJABCodeEx(jab_bitmap* bitmap, jab_int32 mode, jab_int32* status,
     memset(symbols, 0, max_symbol_number * sizeof(jab_decoded_symbol));
     jab_int32 total = 0;	//total number of decoded symbols
     jab_boolean res = 1;
+    //the data stream is decoded symbol by symbol as the symbols are decoded
+    jab_data_decoder stream;
+    initDataDecoder(&stream, ctx ? ctx->payload_callback : NULL, ctx ? ctx->payload_user_data : NULL);
 
     //detect and decode master symbol
     if(detectMaster(bitmap, ch, &symbols[0]))
 	{
 		total++;
+		res = appendSymbolData(&stream, symbols[0].data, 0);
 	}
     //detect and decode docked slave symbols recursively
-    if(total>0)
+    if(total>0 && res)
     {
         for(jab_int32 i=0; i<total && total<max_symbol_number; i++)
         {
-            if(!decodeDockedSlaves(bitmap, ch, symbols, i, &total))
+            if(!decodeDockedSlaves(bitmap, ch, symbols, i, &total, &stream))
             {
                 res = 0;
                 break;
@@ -3605,75 +3677,207 @@ jab_data* decodeJABCodeEx(jab_bitmap* bitmap, jab_int32 mode, jab_int32* status,
         }
     }
 
-    //check result
-	if(total == 0 || (mode == NORMAL_DECODE && res == 0 ))
+    for(jab_int32 i=0; i<3; scratchFree(ch[i++]));
+#if TEST_MODE
+	free(test_mode_bitmap);
+#endif // TEST_MODE
+    return collectDecodedData(&stream, symbols, total, res, mode, status, max_symbol_number);
+}
+
+/**
+ * @brief Copy a symbol out of a module image
+ * @param bitmap the module image
+ * @param position the module coordinates of the upper left corner of the symbol
+ * @param side_size the symbol side sizes
+ * @return the symbol matrix | NULL if the symbol is not inside the image
+*/
+jab_bitmap* cropSymbol(jab_bitmap* bitmap, jab_vector2d position, jab_vector2d side_size)
+{
+	if(position.x < 0 || position.y < 0 || side_size.x <= 0 || side_size.y <= 0 ||
+	   position.x > bitmap->width - side_size.x || position.y > bitmap->height - side_size.y)
 	{
-		if(symbols[0].module_size > 0 && status)
-			*status = 1;
-		//clean memory
-		for(jab_int32 i=0; i<3; free(ch[i++]));
-		for(jab_int32 i=0; i<=MIN(total, max_symbol_number-1); i++)
+		reportError("Symbol out of module image");
+		return NULL;
+	}
+	jab_int32 bytes_per_pixel = bitmap->bits_per_pixel / 8;
+	jab_bitmap* matrix = (jab_bitmap*)scratchMalloc(sizeof(jab_bitmap) + side_size.x*side_size.y*bytes_per_pixel*sizeof(jab_byte));
+	if(matrix == NULL)
+	{
+		reportError("Memory allocation for symbol bitmap matrix failed");
+		return NULL;
+	}
+	matrix->width = side_size.x;
+	matrix->height= side_size.y;
+	matrix->channel_count = bitmap->channel_count;
+	matrix->bits_per_channel = bitmap->bits_per_channel;
+	matrix->bits_per_pixel = bitmap->bits_per_pixel;
+	for(jab_int32 y=0; y<side_size.y; y++)
+	{
+		memcpy(matrix->pixel + y*side_size.x*bytes_per_pixel,
+			   bitmap->pixel + ((position.y + y)*bitmap->width + position.x)*bytes_per_pixel,
+			   side_size.x*bytes_per_pixel);
+	}
+	return matrix;
+}
+
+/**
+ * @brief Decode docked slave symbols around a host symbol in a module image
+ * @param bitmap the module image
+ * @param symbols the symbol list
+ * @param positions the module coordinates of the upper left corner of each symbol in the list
+ * @param host_index the index number of the host symbol
+ * @param total the number of symbols in the list
+ * @param stream the data decoder the data of the decoded slave symbols is appended to
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean decodeDockedSlaveModules(jab_bitmap* bitmap, jab_decoded_symbol* symbols, jab_vector2d* positions, jab_int32 host_index, jab_int32* total, jab_data_decoder* stream)
+{
+	//the host side each docked position faces in the slave symbol
+	jab_int32 host_positions[4] = {1, 0, 3, 2};
+	jab_decoded_symbol* host = &symbols[host_index];
+	for(jab_int32 j=0; j<4; j++)
+	{
+		if((host->metadata.docked_position & (0x08 >> j)) && (*total)<MAX_SYMBOL_NUMBER)
 		{
-			free(symbols[i].palette);
-			free(symbols[i].data);
+			jab_decoded_symbol* slave = &symbols[*total];
+			slave->index = *total;
+			slave->host_index = host_index;
+			slave->host_position = host_positions[j];
+			slave->metadata = host->slave_metadata[j];
+			slave->module_size = host->module_size;
+			slave->side_size.x = VERSION2SIZE(slave->metadata.side_version.x);
+			slave->side_size.y = VERSION2SIZE(slave->metadata.side_version.y);
+
+			//the slave shares the docked side with the host
+			jab_vector2d position = positions[host_index];
+			switch(j)
+			{
+			case 0: position.y -= slave->side_size.y;	break;	//top
+			case 1: position.y += host->side_size.y;	break;	//bottom
+			case 2: position.x -= slave->side_size.x;	break;	//left
+			case 3: position.x += host->side_size.x;	break;	//right
+			}
+			positions[*total] = position;
+
+			jab_bitmap* matrix = cropSymbol(bitmap, position, slave->side_size);
+			if(matrix == NULL)
+			{
+				JAB_REPORT_ERROR(("Detecting slave symbol %d failed", slave->index))
+				return JAB_FAILURE;
+			}
+			jab_int32 decode_result = decodeSlave(matrix, slave);
+			scratchFree(matrix);
+			if(decode_result <= 0)
+				return JAB_FAILURE;
+			(*total)++;
+			if(!appendSymbolData(stream, slave->data, slave->index))
+				return JAB_FAILURE;
 		}
-        return NULL;
 	}
-	if(mode == COMPATIBLE_DECODE && res == 0)
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Decode a JAB Code in a module image, which has one pixel per module. The symbols are read at the positions
+ * given by the module layout, no detection and sampling is needed.
+ * @param ctx the decode context, NULL if none
+ * @param bitmap the module image
+ * @param layout the module layout
+ * @param mode the decoding mode(NORMAL_DECODE: only output completely decoded data when all symbols are correctly decoded
+ *								 COMPATIBLE_DECODE: also output partly decoded data even if some symbols are not correctly decoded
+ * @param status the decoding status code (0: not detectable, 1: not decodable, 2: partly decoded with COMPATIBLE_DECODE mode, 3: fully decoded)
+ * @param symbols the decoded symbols
+ * @param max_symbol_number the maximal possible number of symbols to be decoded
+ * @return the decoded data | NULL if failed
+*/
+jab_data* decodeModuleImage(jab_decode_context* ctx, jab_bitmap* bitmap, jab_module_layout* layout, jab_int32 mode, jab_int32* status, jab_decoded_symbol* symbols, jab_int32 max_symbol_number)
+{
+	if(status) *status = 0;
+	if(!symbols)
 	{
-		if(status) *status = 2;
-		res = 1;
+		reportError("Invalid symbol buffer");
+		return NULL;
 	}
+	memset(symbols, 0, max_symbol_number * sizeof(jab_decoded_symbol));
+	jab_vector2d positions[MAX_SYMBOL_NUMBER];
+	jab_int32 total = 0;
+	jab_boolean res = 1;
+	jab_data_decoder stream;
+	initDataDecoder(&stream, ctx ? ctx->payload_callback : NULL, ctx ? ctx->payload_user_data : NULL);
 
-	//concatenate the decoded data
-    jab_int32 total_data_length = 0;
-    for(jab_int32 i=0; i<total; i++)
-    {
-        total_data_length += symbols[i].data->length;
-    }
-    jab_data* decoded_bits = (jab_data *)malloc(sizeof(jab_data) + total_data_length * sizeof(jab_char));
-    if(decoded_bits == NULL){
-        reportError("Memory allocation for decoded bits failed");
-        if(status) *status = 1;
-        return NULL;
-    }
-    jab_int32 offset = 0;
-    for(jab_int32 i=0; i<total; i++)
-    {
-        jab_char* src = symbols[i].data->data;
-        jab_char* dst = decoded_bits->data;
-        dst += offset;
-        memcpy(dst, src, symbols[i].data->length);
-        offset += symbols[i].data->length;
-    }
-    decoded_bits->length = total_data_length;
-    //decode data
-    jab_data* decoded_data = decodeData(decoded_bits);
-    if(decoded_data == NULL)
+	//decode master symbol
+	symbols[0].side_size = layout->master_size;
+	symbols[0].module_size = (jab_float)layout->module_size;
+	positions[0] = layout->master_position;
+	jab_bitmap* matrix = cropSymbol(bitmap, layout->master_position, layout->master_size);
+	if(matrix)
 	{
-		reportError("Decoding data failed");
-		if(status) *status = 1;
-		res = 0;
+		if(decodeMaster(matrix, &symbols[0]) == JAB_SUCCESS)
+		{
+			total++;
+			res = appendSymbolData(&stream, symbols[0].data, 0);
+		}
+		scratchFree(matrix);
+	}
+	//decode docked slave symbols recursively
+	for(jab_int32 i=0; i<total && total<max_symbol_number && res; i++)
+	{
+		if(!decodeDockedSlaveModules(bitmap, symbols, positions, i, &total, &stream))
+		{
+			res = 0;
+			break;
+		}
 	}
+	return collectDecodedData(&stream, symbols, total, res, mode, status, max_symbol_number);
+}
 
-    //clean memory
-    for(jab_int32 i=0; i<3; free(ch[i++]));
-    for(jab_int32 i=0; i<=MIN(total, max_symbol_number-1); i++)
-    {
-		free(symbols[i].palette);
-		free(symbols[i].data);
-    }
-    free(decoded_bits);
-#if TEST_MODE
-	free(test_mode_bitmap);
-#endif // TEST_MODE
-	if(res == 0) return NULL;
-	if(status)
+/**
+ * @brief Decode a JAB Code in a bitmap
+ * @param ctx the decode context, NULL if none
+ * @param bitmap the image bitmap
+ * @param mode the decoding mode(NORMAL_DECODE: only output completely decoded data when all symbols are correctly decoded
+ *								 COMPATIBLE_DECODE: also output partly decoded data even if some symbols are not correctly decoded
+ * @param status the decoding status code (0: not detectable, 1: not decodable, 2: partly decoded with COMPATIBLE_DECODE mode, 3: fully decoded)
+ * @param symbols the decoded symbols
+ * @param max_symbol_number the maximal possible number of symbols to be decoded
+ * @return the decoded data | NULL if failed
+*/
+static jab_data* decodeBitmap(jab_decode_context* ctx, jab_bitmap* bitmap, jab_int32 mode, jab_int32* status, jab_decoded_symbol* symbols, jab_int32 max_symbol_number)
+{
+	if(status) *status = 0;
+	//collect the frame statistics
+	jab_frame_stats* stats = (jab_frame_stats*)scratchMalloc(sizeof(jab_frame_stats));
+	if(stats == NULL)
 	{
-		if(*status != 2)
-			*status = 3;
+		reportError("Memory allocation for frame statistics failed");
+		return NULL;
 	}
-    return decoded_data;
+	initFrameStats(stats, bitmap->width, bitmap->height);
+	jab_int32 bytes_per_pixel = bitmap->bits_per_pixel / 8;
+	jab_int32 bytes_per_row = bitmap->width * bytes_per_pixel;
+	for(jab_int32 i=0; i<bitmap->height; i++)
+	{
+		addFrameRow(stats, bitmap->pixel + i*bytes_per_row, bytes_per_pixel, i);
+	}
+
+	jab_data* decoded_data = decodeFrame(ctx, bitmap, NULL, stats, mode, status, symbols, max_symbol_number);
+	scratchFree(stats);
+	return decoded_data;
+}
+
+/**
+ * @brief Extended function to decode a JAB Code
+ * @param bitmap the image bitmap
+ * @param mode the decoding mode(NORMAL_DECODE: only output completely decoded data when all symbols are correctly decoded
+ *								 COMPATIBLE_DECODE: also output partly decoded data even if some symbols are not correctly decoded
+ * @param status the decoding status code (0: not detectable, 1: not decodable, 2: partly decoded with COMPATIBLE_DECODE mode, 3: fully decoded)
+ * @param symbols the decoded symbols
+ * @param max_symbol_number the maximal possible number of symbols to be decoded
+ * @return the decoded data | NULL if failed
+*/
+jab_data* decodeJABCodeEx(jab_bitmap* bitmap, jab_int32 mode, jab_int32* status, jab_decoded_symbol* symbols, jab_int32 max_symbol_number)
+{
+	return decodeBitmap(NULL, bitmap, mode, status, symbols, max_symbol_number);
 }
 
 /**
@@ -3689,3 +3893,271 @@ jab_data* decodeJABCode(jab_bitmap* bitmap, jab_int32 mode, jab_int32* status)
 	jab_decoded_symbol symbols[MAX_SYMBOL_NUMBER];
 	return decodeJABCodeEx(bitmap, mode, status, symbols, MAX_SYMBOL_NUMBER);
 }
+
+/**
+ * @brief Create a decode context
+ * @param scratch_size the initial size of the scratch memory in bytes, 0 for the default size. The scratch memory grows
+ *					   as needed and is kept at the largest size any decode required.
+ * @return the decode context | NULL if failed
+*/
+jab_decode_context* createDecodeContext(jab_int32 scratch_size)
+{
+	jab_decode_context* ctx = (jab_decode_context*)calloc(1, sizeof(jab_decode_context));
+	if(ctx == NULL)
+	{
+		reportError("Memory allocation for decode context failed");
+		return NULL;
+	}
+	jab_arena* arena = (jab_arena*)malloc(sizeof(jab_arena));
+	if(arena == NULL)
+	{
+		reportError("Memory allocation for decode context failed");
+		free(ctx);
+		return NULL;
+	}
+	if(!initArena(arena, scratch_size > 0 ? (size_t)scratch_size : 0))
+	{
+		free(arena);
+		free(ctx);
+		return NULL;
+	}
+	ctx->arena = arena;
+	ctx->reserved = (jab_int64)arena->reserved;
+	return ctx;
+}
+
+/**
+ * @brief Destroy a decode context and free its scratch memory
+ * @param ctx the decode context
+*/
+void destroyDecodeContext(jab_decode_context* ctx)
+{
+	if(ctx == NULL) return;
+	if(ctx->arena)
+	{
+		releaseArena((jab_arena*)ctx->arena);
+		free(ctx->arena);
+	}
+	free(ctx);
+}
+
+/**
+ * @brief Start a decode with the scratch memory and the LDPC decoder options of a decode context and record its
+ * statistics in the context
+ * @param ctx the decode context, NULL to take the scratch memory from the heap and use the default options
+ * @return the previously set scratch arena
+*/
+jab_arena* enterDecodeContext(jab_decode_context* ctx)
+{
+	setLDPCDecodeOptions(ctx ? ctx->ldpc_max_iter : 0, ctx ? ctx->ldpc_policy : LDPC_HARD_DECISION);
+	if(ctx)
+	{
+		memset(&ctx->stats, 0, sizeof(jab_decode_stats));
+		//the start time, replaced by the duration when the decode finishes
+		ctx->stats.total_time = getMonotonicTime();
+	}
+	setDecodeStats(ctx ? &ctx->stats : NULL);
+	if(ctx == NULL || ctx->arena == NULL)
+		return setScratchArena(NULL);
+	jab_arena* arena = (jab_arena*)ctx->arena;
+	resetArena(arena);
+	return setScratchArena(arena);
+}
+
+/**
+ * @brief Finish a decode with the scratch memory of a decode context, update its memory statistics and restore the
+ * default LDPC decoder options and the unrecorded statistics
+ * @param ctx the decode context, NULL if the scratch memory was taken from the heap
+ * @param prev_arena the scratch arena to restore
+*/
+void leaveDecodeContext(jab_decode_context* ctx, jab_arena* prev_arena)
+{
+	setScratchArena(prev_arena);
+	setLDPCDecodeOptions(0, LDPC_HARD_DECISION);
+	setDecodeStats(NULL);
+	if(ctx)
+		ctx->stats.total_time = getMonotonicTime() - ctx->stats.total_time;
+	if(ctx == NULL || ctx->arena == NULL)
+		return;
+	jab_arena* arena = (jab_arena*)ctx->arena;
+	ctx->peak_usage = (jab_int64)arena->peak;
+	ctx->reserved = (jab_int64)arena->reserved;
+	ctx->heap_allocations = arena->heap_allocs;
+}
+
+/**
+ * @brief Decode a JAB Code using the scratch memory of a decode context. All intermediate buffers are taken from
+ * the context and discarded when the next decode with the same context starts. The returned data is allocated on
+ * the heap and owned by the caller. If ctx->payload_callback is set, the payload is also passed to it symbol by symbol
+ * while the decode is running. A context must not be used by more than one thread at a time.
+ * @param ctx the decode context
+ * @param bitmap the image bitmap
+ * @param mode the decoding mode(NORMAL_DECODE: only output completely decoded data when all symbols are correctly decoded
+ *								 COMPATIBLE_DECODE: also output partly decoded data even if some symbols are not correctly decoded
+ * @param status the decoding status code (0: not detectable, 1: not decodable, 2: partly decoded with COMPATIBLE_DECODE mode, 3: fully decoded)
+ * @param symbols the decoded symbols, NULL if not needed
+ * @param max_symbol_number the maximal possible number of symbols to be decoded
+ * @return the decoded data | NULL if failed
+*/
+jab_data* decodeJABCodeWithContext(jab_decode_context* ctx, jab_bitmap* bitmap, jab_int32 mode, jab_int32* status, jab_decoded_symbol* symbols, jab_int32 max_symbol_number)
+{
+	jab_decoded_symbol local_symbols[MAX_SYMBOL_NUMBER];
+	if(symbols == NULL)
+	{
+		symbols = local_symbols;
+		max_symbol_number = MAX_SYMBOL_NUMBER;
+	}
+	jab_arena* prev_arena = enterDecodeContext(ctx);
+	jab_data* decoded_data = decodeBitmap(ctx, bitmap, mode, status, symbols, max_symbol_number);
+	leaveDecodeContext(ctx, prev_arena);
+	return decoded_data;
+}
+
+/**
+ * @brief Decode a JAB Code in a PNG image file. The image rows are streamed into a full RGB frame in scratch memory while
+ * the statistics for balancing and binarization are collected, so no separate RGBA bitmap of the image is built.
+ * Balancing and binarization are not done as the rows arrive but in one pass over the frame after reading, because
+ * they depend on the statistics of the whole image. The frame is kept as the sampler reads the module colors from it.
+ * Module images written by saveModuleImageToMemory are decoded directly without detection and sampling.
+ * @param ctx the decode context, NULL to take the scratch memory from the heap
+ * @param filename the image filename
+ * @param mode the decoding mode(NORMAL_DECODE: only output completely decoded data when all symbols are correctly decoded
+ *								 COMPATIBLE_DECODE: also output partly decoded data even if some symbols are not correctly decoded
+ * @param status the decoding status code (0: not detectable, 1: not decodable, 2: partly decoded with COMPATIBLE_DECODE mode, 3: fully decoded)
+ * @param symbols the decoded symbols, NULL if not needed
+ * @param max_symbol_number the maximal possible number of symbols to be decoded
+ * @return the decoded data | NULL if failed
+*/
+jab_data* decodeJABCodeFromFile(jab_decode_context* ctx, jab_char* filename, jab_int32 mode, jab_int32* status, jab_decoded_symbol* symbols, jab_int32 max_symbol_number)
+{
+	jab_decoded_symbol local_symbols[MAX_SYMBOL_NUMBER];
+	if(symbols == NULL)
+	{
+		symbols = local_symbols;
+		max_symbol_number = MAX_SYMBOL_NUMBER;
+	}
+	if(status) *status = 0;
+	jab_arena* prev_arena = enterDecodeContext(ctx);
+	jab_data* decoded_data = NULL;
+	jab_frame_stats* stats = (jab_frame_stats*)scratchMalloc(sizeof(jab_frame_stats));
+	if(stats == NULL)
+	{
+		reportError("Memory allocation for frame statistics failed");
+	}
+	else
+	{
+		jab_module_layout layout;
+		jab_bitmap* frame = readImageFrame(filename, stats, &layout);
+		if(frame && layout.module_size > 0)
+		{
+			decoded_data = decodeModuleImage(ctx, frame, &layout, mode, status, symbols, max_symbol_number);
+			scratchFree(frame);
+		}
+		else if(frame)
+		{
+			decoded_data = decodeFrame(ctx, frame, NULL, stats, mode, status, symbols, max_symbol_number);
+			scratchFree(frame);
+		}
+		scratchFree(stats);
+	}
+	leaveDecodeContext(ctx, prev_arena);
+	return decoded_data;
+}
+
+/**
+ * @brief Decode a JAB Code in a caller-owned pixel buffer. This is a convenience conversion, not a zero-copy decode:
+ * the detector and the sampler read the color-balanced pixels, so every format, RGB24 and RGBA included, is copied
+ * into a frame of width*height*3 bytes of scratch memory. What the caller saves is building an RGBA bitmap of its own.
+ * RGBA and RGB24 buffers are read in place for the frame statistics and copied in the pass that balances and binarizes
+ * them, the other formats are converted into the frame while the statistics are collected.
+ * @param ctx the decode context, NULL to take the scratch memory from the heap
+ * @param buffer the pixel buffer
+ * @param mode the decoding mode(NORMAL_DECODE: only output completely decoded data when all symbols are correctly decoded
+ *								 COMPATIBLE_DECODE: also output partly decoded data even if some symbols are not correctly decoded
+ * @param status the decoding status code (0: not detectable, 1: not decodable, 2: partly decoded with COMPATIBLE_DECODE mode, 3: fully decoded)
+ * @param symbols the decoded symbols, NULL if not needed
+ * @param max_symbol_number the maximal possible number of symbols to be decoded
+ * @return the decoded data | NULL if failed
+*/
+jab_data* decodeJABCodeFromBuffer(jab_decode_context* ctx, jab_pixel_buffer* buffer, jab_int32 mode, jab_int32* status, jab_decoded_symbol* symbols, jab_int32 max_symbol_number)
+{
+	if(status) *status = 0;
+	if(buffer == NULL || buffer->pixel == NULL || buffer->width <= 0 || buffer->height <= 0)
+	{
+		reportError("Invalid pixel buffer");
+		return NULL;
+	}
+	jab_int32 bytes_per_pixel;
+	switch(buffer->format)
+	{
+	case PIXEL_FORMAT_RGBA:
+	case PIXEL_FORMAT_BGRA:
+		bytes_per_pixel = 4;
+		break;
+	case PIXEL_FORMAT_RGB24:
+	case PIXEL_FORMAT_BGR24:
+		bytes_per_pixel = 3;
+		break;
+	case PIXEL_FORMAT_NV12:
+		bytes_per_pixel = 1;
+		if(buffer->chroma == NULL || buffer->chroma_stride < ((buffer->width + 1) & ~1))
+		{
+			reportError("Invalid chroma plane in pixel buffer");
+			return NULL;
+		}
+		break;
+	default:
+		JAB_REPORT_ERROR(("Unsupported pixel format %d", buffer->format))
+		return NULL;
+	}
+	if(buffer->stride < buffer->width * bytes_per_pixel)
+	{
+		reportError("Invalid stride of pixel buffer");
+		return NULL;
+	}
+
+	jab_decoded_symbol local_symbols[MAX_SYMBOL_NUMBER];
+	if(symbols == NULL)
+	{
+		symbols = local_symbols;
+		max_symbol_number = MAX_SYMBOL_NUMBER;
+	}
+	jab_arena* prev_arena = enterDecodeContext(ctx);
+	jab_data* decoded_data = NULL;
+	jab_frame_stats* stats = (jab_frame_stats*)scratchMalloc(sizeof(jab_frame_stats));
+	jab_bitmap* frame = (jab_bitmap*)scratchMalloc(sizeof(jab_bitmap) + (size_t)buffer->width * buffer->height * 3);
+	if(stats == NULL || frame == NULL)
+	{
+		reportError("Memory allocation for frame failed");
+	}
+	else
+	{
+		frame->width = buffer->width;
+		frame->height = buffer->height;
+		frame->bits_per_channel = 8;
+		frame->bits_per_pixel = 24;
+		frame->channel_count = 3;
+
+		//collect the frame statistics, rows not in RGB order are converted into the frame on the way and not read again
+		initFrameStats(stats, buffer->width, buffer->height);
+		jab_boolean rgb_order = (buffer->format == PIXEL_FORMAT_RGBA || buffer->format == PIXEL_FORMAT_RGB24);
+		for(jab_int32 i=0; i<buffer->height; i++)
+		{
+			if(rgb_order)
+			{
+				addFrameRow(stats, buffer->pixel + (size_t)i * buffer->stride, bytes_per_pixel, i);
+			}
+			else
+			{
+				jab_byte* row = frame->pixel + (size_t)i * buffer->width * 3;
+				convertPixelRow(buffer, i, row);
+				addFrameRow(stats, row, 3, i);
+			}
+		}
+		decoded_data = decodeFrame(ctx, frame, rgb_order ? buffer : NULL, stats, mode, status, symbols, max_symbol_number);
+	}
+	scratchFree(frame);
+	scratchFree(stats);
+	leaveDecodeContext(ctx, prev_arena);
+	return decoded_data;
+}
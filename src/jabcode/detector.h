@@ -26,6 +26,9 @@ jab_int32	test_mode_color;
 #define MAX_FINDER_PATTERNS 500
 #define PI 					3.14159265
 #define CROSS_AREA_WIDTH	14	//the width of the area across the host and slave symbols
+#define MAX_FRAME_BLOCKS	9	//the maximal number of blocks a frame is divided into for binarization
+#define MODULE_IMAGE_CHUNK		"jaBC"	//private png chunk recording the layout of a module image
+#define MODULE_IMAGE_CHUNK_SIZE	20		//module size, master symbol position and master symbol side sizes as 32-bit integers
 
 #define DIST(x1, y1, x2, y2) (jab_float)(sqrt((x1-x2)*(x1-x2) + (y1-y2)*(y1-y2)))
 
@@ -65,9 +68,35 @@ typedef struct {
 	jab_float a33;
 }jab_perspective_transform;
 
+/**
+ * @brief Statistics of a frame collected while its pixels are ingested
+*/
+typedef struct {
+	jab_int32	width;
+	jab_int32	height;
+	jab_int32	block_num_x;
+	jab_int32	block_num_y;
+	jab_int32	block_size_x;
+	jab_int32	block_size_y;
+	jab_int32	block_hist[MAX_FRAME_BLOCKS][3][256];	///< The histogram of each color channel in each block
+}jab_frame_stats;
+
+/**
+ * @brief The layout of a module image, which has one pixel per module
+*/
+typedef struct {
+	jab_int32		module_size;		///< The module size the code was rendered with, 0 if the image is no module image
+	jab_vector2d	master_position;	///< The module coordinates of the upper left corner of the master symbol
+	jab_vector2d	master_size;		///< The side sizes of the master symbol in modules
+}jab_module_layout;
+
 extern void getAveVar(jab_byte* rgb, jab_double* ave, jab_double* var);
 extern void getMinMax(jab_byte* rgb, jab_byte* min, jab_byte* mid, jab_byte* max, jab_int32* index_min, jab_int32* index_mid, jab_int32* index_max);
-extern void balanceRGB(jab_bitmap* bitmap);
+extern void initFrameStats(jab_frame_stats* stats, jab_int32 width, jab_int32 height);
+extern void addFrameRow(jab_frame_stats* stats, jab_byte* row, jab_int32 bytes_per_pixel, jab_int32 y);
+extern void convertPixelRow(jab_pixel_buffer* buffer, jab_int32 y, jab_byte* row);
+extern jab_boolean balanceBinarizeRGB(jab_bitmap* bitmap, jab_pixel_buffer* source, jab_frame_stats* stats, jab_bitmap* rgb[3]);
+extern jab_bitmap* readImageFrame(jab_char* filename, jab_frame_stats* stats, jab_module_layout* layout);
 extern jab_boolean binarizerRGB(jab_bitmap* bitmap, jab_bitmap* rgb[3], jab_float* blk_ths);
 extern jab_bitmap* binarizer(jab_bitmap* bitmap, jab_int32 channel);
 extern jab_bitmap* binarizerHist(jab_bitmap* bitmap, jab_int32 channel);
@@ -83,8 +112,19 @@ extern jab_perspective_transform* perspectiveTransform( jab_float x0, jab_float
 														jab_float x1p, jab_float y1p,
 														jab_float x2p, jab_float y2p,
 														jab_float x3p, jab_float y3p);
+extern void calcPerspectiveTransform(jab_float x0, jab_float y0,
+									 jab_float x1, jab_float y1,
+									 jab_float x2, jab_float y2,
+									 jab_float x3, jab_float y3,
+									 jab_float x0p, jab_float y0p,
+									 jab_float x1p, jab_float y1p,
+									 jab_float x2p, jab_float y2p,
+									 jab_float x3p, jab_float y3p,
+									 jab_perspective_transform* pt);
 extern void warpPoints(jab_perspective_transform* pt, jab_point* points, jab_int32 length);
 extern jab_bitmap* sampleSymbol(jab_bitmap* bitmap, jab_perspective_transform* pt, jab_vector2d side_size);
+extern jab_bitmap* sampleSymbolByBlocks(jab_bitmap* bitmap, jab_perspective_transform* pts, jab_vector2d* origins, jab_vector2d* sizes,
+										jab_int32 block_number, jab_byte* block_map, jab_vector2d side_size);
 extern jab_bitmap* sampleCrossArea(jab_bitmap* bitmap, jab_perspective_transform* pt);
 
 #endif
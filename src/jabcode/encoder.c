@@ -20,6 +20,8 @@
 #include "ldpc.h"
 #include "detector.h"
 #include "decoder.h"
+#include "arena.h"
+#include "timer.h"
 
 /**
  * @brief Generate color palettes with more than 8 colors
@@ -166,6 +168,25 @@ void convert_dec_to_bin(jab_int32 dec, jab_char* bin, jab_int32 start_position,
     }
 }
 
+/**
+ * @brief Make sure a buffer kept in the encode object holds at least the required size
+ * @param buffer the buffer, reallocated if it is too small
+ * @param capacity the allocated size of the buffer in bytes
+ * @param size the required size in bytes
+ * @return JAB_SUCCESS | JAB_FAILURE
+ */
+jab_boolean reserveBuffer(void** buffer, jab_int32* capacity, jab_int32 size)
+{
+    if(*buffer != NULL && *capacity >= size)
+        return JAB_SUCCESS;
+    void* new_buffer = realloc(*buffer, size);
+    if(new_buffer == NULL)
+        return JAB_FAILURE;
+    *buffer = new_buffer;
+    *capacity = size;
+    return JAB_SUCCESS;
+}
+
 /**
  * @brief Create encode object
  * @param color_number the number of module colors
@@ -192,6 +213,7 @@ jab_encode* createEncode(jab_int32 color_number, jab_int32 symbol_number)
     enc->master_symbol_width = 0;
     enc->master_symbol_height= 0;
     enc->module_size 		 = DEFAULT_MODULE_SIZE;
+    enc->output_mode		 = BITMAP_OUTPUT;
 
     //set default color palette
 	enc->palette = (jab_byte *)calloc(color_number * 3, sizeof(jab_byte));
@@ -244,6 +266,7 @@ void destroyEncode(jab_encode* enc)
     free(enc->symbol_ecc_levels);
     free(enc->symbol_positions);
     free(enc->bitmap);
+    free(enc->module_matrix);
     if(enc->symbols)
     {
         for(jab_int32 i=0; i<enc->symbol_number; i++)
@@ -255,70 +278,127 @@ void destroyEncode(jab_encode* enc)
         }
         free(enc->symbols);
     }
+    if(enc->scratch)
+    {
+        releaseArena((jab_arena*)enc->scratch);
+        free(enc->scratch);
+    }
     free(enc);
 }
 
+/**
+ * @brief Reset encode object for the next code. The buffers of the previous code are kept and reused by the next
+ * call of generateJABCode if they are large enough. The symbol versions chosen by the encoder are reset so that
+ * the next code gets its own optimal version.
+ * @param enc the encode object
+ */
+void resetEncode(jab_encode* enc)
+{
+    if(enc->auto_master_version)
+    {
+        //only reset the version if it has not been set by the caller in the meantime
+        if(enc->symbol_versions[0].x == SIZE2VERSION(enc->symbols[0].side_size.x) &&
+           enc->symbol_versions[0].y == SIZE2VERSION(enc->symbols[0].side_size.y))
+        {
+            enc->symbol_versions[0].x = 0;
+            enc->symbol_versions[0].y = 0;
+        }
+        enc->auto_master_version = 0;
+    }
+    if(enc->scratch)
+        resetArena((jab_arena*)enc->scratch);
+}
+
+/**
+ * @brief Read the chunk of the payload starting at a position from the payload source
+ * @param payload the payload reader
+ * @param position the payload offset
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+static jab_boolean readPayloadChunk(jab_payload_reader* payload, jab_int32 position)
+{
+	if(payload->source == NULL || payload->failed || position >= payload->length)
+		return JAB_FAILURE;
+	jab_int32 size = payload->source(payload->user_data, position, payload->buffer, MIN(PAYLOAD_CHUNK_SIZE, payload->length - position));
+	if(size <= 0)
+	{
+		JAB_REPORT_ERROR(("Reading the payload at offset %d failed", position))
+		payload->failed = 1;
+		return JAB_FAILURE;
+	}
+	payload->start = position;
+	payload->size = size;
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Get a payload byte
+ * @param payload the payload reader
+ * @param position the payload offset
+ * @return the byte value | 0 if the position is beyond the payload
+*/
+static inline jab_int32 getPayloadByte(jab_payload_reader* payload, jab_int32 position)
+{
+	jab_int32 offset = position - payload->start;
+	if(offset < 0 || offset >= payload->size)
+	{
+		if(!readPayloadChunk(payload, position))
+			return 0;
+		offset = 0;
+	}
+	return (jab_byte)payload->buffer[offset];
+}
+
 /**
  * @brief Analyze the input data and determine the optimal encoding modes for each character
  * @param input the input character data
  * @param encoded_length the shortest encoding length
  * @return the optimal encoding sequence | NULL: fatal error (out of memory)
  */
-jab_int32* analyzeInputData(jab_data* input, jab_int32* encoded_length)
+jab_byte* analyzeInputData(jab_payload_reader* input, jab_int32* encoded_length)
 {
-    jab_int32 encode_seq_length=ENC_MAX;
-    jab_char* seq = (jab_char *)malloc(sizeof(jab_char)*input->length);
-    if(seq == NULL) {
-        reportError("Memory allocation for sequence failed");
-        return NULL;
-    }
-    jab_int32* curr_seq_len=(jab_int32 *)malloc(sizeof(jab_int32)*((input->length+2)*14));
-    if(curr_seq_len == NULL){
-        reportError("Memory allocation for current sequence length failed");
-        free(seq);
+    //one mode per step plus the start mode and a possible trailing shift
+    jab_byte* encode_seq = (jab_byte *)scratchMalloc(input->length+2);
+    if(encode_seq == NULL)
+    {
+        reportError("Memory allocation for encode sequence failed");
         return NULL;
     }
-    jab_int32* prev_mode=(jab_int32 *)malloc(sizeof(jab_int32)*(2*input->length+2)*14);
-    if(prev_mode == NULL){
+    //the previous mode of each mode in each step, kept for backtracking
+    jab_byte* mode_history = (jab_byte *)scratchMalloc(MODE_HISTORY_ROW * (input->length+1));
+    if(mode_history == NULL)
+    {
         reportError("Memory allocation for previous mode failed");
-        free(seq);
-        free(curr_seq_len);
-        return NULL;
-    }
-    for (jab_int32 i=0; i < (2*input->length+2)*14; i++)
-        prev_mode[i] = ENC_MAX/2;
-
-    jab_int32* switch_mode = (jab_int32 *)malloc(sizeof(jab_int32) * 28);
-    if(switch_mode == NULL){
-        reportError("Memory allocation for mode switch failed");
-        free(seq);
-        free(curr_seq_len);
-        free(prev_mode);
-        return NULL;
-    }
-    for (jab_int32 i=0; i < 28; i++)
-        switch_mode[i] = ENC_MAX/2;
-    jab_int32* temp_switch_mode = (jab_int32 *)malloc(sizeof(jab_int32) * 28);
-    if(temp_switch_mode == NULL){
-        reportError("Memory allocation for mode switch failed");
-        free(seq);
-        free(curr_seq_len);
-        free(prev_mode);
-        free(switch_mode);
+        scratchFree(encode_seq);
         return NULL;
     }
-    for (jab_int32 i=0; i < 28; i++)
-        temp_switch_mode[i] = ENC_MAX/2;
+
+    //only the sequence lengths of the previous and the current step are needed
+    jab_int32 seq_len_rows[2][14];
+    jab_int32* prev_seq_len = seq_len_rows[0];
+    jab_int32* curr_seq_len = seq_len_rows[1];
+    //the previous modes of the current step
+    jab_int32 prev_mode[14];
+    //the shift mode from which a mode was returned to, in the previous and the current step
+    jab_byte switch_rows[2][14];
+    jab_byte* temp_switch_mode = switch_rows[0];
+    jab_byte* switch_mode = switch_rows[1];
+    memset(switch_rows, SWITCH_NONE, sizeof(switch_rows));
+    //the non-shift mode from which a shift mode was invoked, in the previous and the current step
+    jab_int32 base_rows[2][14];
+    jab_int32* prev_base_mode = base_rows[0];
+    jab_int32* curr_base_mode = base_rows[1];
 
     //calculate the shortest encoding sequence
     //initialize start in upper case mode; no previous mode available
-    for (jab_int32 k=0;k<7;k++)
+    for (jab_int32 k=0;k<14;k++)
     {
-        curr_seq_len[k]=curr_seq_len[k+7]=ENC_MAX;
-        prev_mode[k]=prev_mode[k+7]=ENC_MAX;
+        prev_seq_len[k]=ENC_MAX;
+        prev_base_mode[k]=0;
     }
+    prev_seq_len[0]=0;
 
-    curr_seq_len[0]=0;
+    jab_int32 encode_seq_length=ENC_MAX;
     jab_byte jp_to_nxt_char=0, confirm=0;
     jab_int32 curr_seq_counter=0;
     jab_boolean is_shift=0;
@@ -327,67 +407,52 @@ jab_int32* analyzeInputData(jab_data* input, jab_int32* encoded_length)
     jab_int32 prev_mode_index=0;
     for (jab_int32 i=0;i<end_of_loop;i++)
     {
-        jab_int32 tmp=input->data[nb_char];
-        jab_int32 tmp1=0;
-        if(nb_char+1 < input->length)
-            tmp1=input->data[nb_char+1];
-        if(tmp<0)
-            tmp=256+tmp;
-        if(tmp1<0)
-            tmp1=256+tmp1;
+        jab_int32 tmp=getPayloadByte(input, nb_char);
+        jab_int32 tmp1=getPayloadByte(input, nb_char+1);
         curr_seq_counter++;
         for (jab_int32 j=0;j<JAB_ENCODING_MODES;j++)
         {
             if (jab_enconing_table[tmp][j]>-1 && jab_enconing_table[tmp][j]<64) //check if character is in encoding table
-                curr_seq_len[(i+1)*14+j]=curr_seq_len[(i+1)*14+j+7]=character_size[j];
+                curr_seq_len[j]=curr_seq_len[j+7]=character_size[j];
             else if((jab_enconing_table[tmp][j]==-18 && tmp1==10) || (jab_enconing_table[tmp][j]<-18 && tmp1==32))//read next character to decide if encodalbe in current mode
             {
-                curr_seq_len[(i+1)*14+j]=curr_seq_len[(i+1)*14+j+7]=character_size[j];
+                curr_seq_len[j]=curr_seq_len[j+7]=character_size[j];
                 jp_to_nxt_char=1; //jump to next character
             }
             else //not encodable in this mode
-                curr_seq_len[(i+1)*14+j]=curr_seq_len[(i+1)*14+j+7]=ENC_MAX;
+                curr_seq_len[j]=curr_seq_len[j+7]=ENC_MAX;
         }
-        curr_seq_len[(i+1)*14+6]=curr_seq_len[(i+1)*14+13]=character_size[6]; //input sequence can always be encoded by byte mode
+        curr_seq_len[6]=curr_seq_len[13]=character_size[6]; //input sequence can always be encoded by byte mode
         is_shift=0;
         for (jab_int32 j=0;j<14;j++)
         {
-            jab_int32 prev=-1;
-            jab_int32 len=curr_seq_len[(i+1)*14+j]+curr_seq_len[i*14+j]+latch_shift_to[j][j];
-            prev_mode[curr_seq_counter*14+j]=j;
-            for (jab_int32 k=0;k<14;k++)
+            jab_int32 char_len=curr_seq_len[j];
+            jab_int32 len=char_len+prev_seq_len[j]+latch_shift_to[j][j];
+            prev_mode[j]=j;
+            for (jab_int32 k=0;k<13;k++) //byte mode shift is never continued from
             {
-                if((len>=curr_seq_len[(i+1)*14+j]+curr_seq_len[i*14+k]+latch_shift_to[k][j] && k<13) || (k==13 && prev==j))
+                if(len>=char_len+prev_seq_len[k]+latch_shift_to[k][j])
                 {
-                    len=curr_seq_len[(i+1)*14+j]+curr_seq_len[i*14+k]+latch_shift_to[k][j];
-                    if (temp_switch_mode[2*k]==k)
-                        prev_mode[curr_seq_counter*14+j]=temp_switch_mode[2*k+1];
+                    len=char_len+prev_seq_len[k]+latch_shift_to[k][j];
+                    if (temp_switch_mode[k]!=SWITCH_NONE)
+                        prev_mode[j]=temp_switch_mode[k];
                     else
-                        prev_mode[curr_seq_counter*14+j]=k;
-                    if (k==13 && prev==j)
-                        prev=-1;
+                        prev_mode[j]=k;
                 }
             }
-            curr_seq_len[(i+1)*14+j]=len;
+            curr_seq_len[j]=len;
             //shift back to mode if shift is used
             if (j>6)
             {
-                if ((curr_seq_len[(i+1)*14+prev_mode[curr_seq_counter*14+j]]>len ||
-                    (jp_to_nxt_char==1 && curr_seq_len[(i+1)*14+prev_mode[curr_seq_counter*14+j]]+character_size[(prev_mode[curr_seq_counter*14+j])%7]>len)) &&
+                //the mode the shift was invoked from, looking through shifts in preceding steps
+                curr_base_mode[j]=prev_mode[j]>6 ? prev_base_mode[prev_mode[j]] : prev_mode[j];
+                if ((curr_seq_len[prev_mode[j]]>len ||
+                    (jp_to_nxt_char==1 && curr_seq_len[prev_mode[j]]+character_size[prev_mode[j]%7]>len)) &&
                      j != 13)
                 {
-                    jab_int32 index=prev_mode[curr_seq_counter*14+j];
-                    jab_int32 loop=1;
-                    while (index>6 && curr_seq_counter-loop >= 0)
-                    {
-                        index=prev_mode[(curr_seq_counter-loop)*14+index];
-                        loop++;
-                    }
-
-                    curr_seq_len[(i+1)*14+index]=len;
-                    prev_mode[(curr_seq_counter+1)*14+index]=j;
-                    switch_mode[2*index]=index;
-                    switch_mode[2*index+1]=j;
+                    jab_int32 index=curr_base_mode[j];
+                    curr_seq_len[index]=len;
+                    switch_mode[index]=j;
                     is_shift=1;
                     if(jp_to_nxt_char==1 && j==11)
                     {
@@ -395,33 +460,24 @@ jab_int32* analyzeInputData(jab_data* input, jab_int32* encoded_length)
                         prev_mode_index=index;
                     }
                 }
-                else if ((curr_seq_len[(i+1)*14+prev_mode[curr_seq_counter*14+j]]>len ||
-                        (jp_to_nxt_char==1 && curr_seq_len[(i+1)*14+prev_mode[curr_seq_counter*14+j]]+character_size[prev_mode[curr_seq_counter*14+j]%7]>len)) && j == 13 )
+                else if ((curr_seq_len[prev_mode[j]]>len ||
+                        (jp_to_nxt_char==1 && curr_seq_len[prev_mode[j]]+character_size[prev_mode[j]%7]>len)) && j == 13 )
                    {
-                       curr_seq_len[(i+1)*14+prev_mode[curr_seq_counter*14+j]]=len;
-                       prev_mode[(curr_seq_counter+1)*14+prev_mode[curr_seq_counter*14+j]]=j;
-                       switch_mode[2*prev_mode[curr_seq_counter*14+j]]=prev_mode[curr_seq_counter*14+j];
-                       switch_mode[2*prev_mode[curr_seq_counter*14+j]+1]=j;
+                       curr_seq_len[prev_mode[j]]=len;
+                       switch_mode[prev_mode[j]]=j;
                        is_shift=1;
                    }
                 if(j!=13)
-                    curr_seq_len[(i+1)*14+j]=ENC_MAX;
-                else
-                    prev=prev_mode[curr_seq_counter*14+j];
+                    curr_seq_len[j]=ENC_MAX;
             }
         }
-        for (jab_int32 j=0;j<28;j++)
-        {
-            temp_switch_mode[j]=switch_mode[j];
-            switch_mode[j]=ENC_MAX/2;
-        }
 
         if(jp_to_nxt_char==1 && confirm==1)
         {
             for (jab_int32 j=0;j<=2*JAB_ENCODING_MODES+1;j++)
             {
                 if(j != prev_mode_index)
-                    curr_seq_len[(i+1)*14+j]=ENC_MAX;
+                    curr_seq_len[j]=ENC_MAX;
             }
             nb_char++;
             end_of_loop--;
@@ -430,29 +486,32 @@ jab_int32* analyzeInputData(jab_data* input, jab_int32* encoded_length)
         jp_to_nxt_char=0;
         confirm=0;
         nb_char++;
+
+        //store the previous modes of this step, two modes per byte
+        jab_byte* history = mode_history + curr_seq_counter*MODE_HISTORY_ROW;
+        for (jab_int32 j=0;j<14;j+=2)
+            history[j/2]=(jab_byte)(prev_mode[j] | (prev_mode[j+1] << 4));
+        //move on to the next step
+        jab_int32* swap_len=prev_seq_len; prev_seq_len=curr_seq_len; curr_seq_len=swap_len;
+        jab_int32* swap_base=prev_base_mode; prev_base_mode=curr_base_mode; curr_base_mode=swap_base;
+        jab_byte* swap_switch=temp_switch_mode; temp_switch_mode=switch_mode; switch_mode=swap_switch;
+        memset(switch_mode, SWITCH_NONE, 14);
     }
 
     //pick smallest number in last step
     jab_int32 current_mode=0;
     for (jab_int32 j=0;j<=2*JAB_ENCODING_MODES+1;j++)
     {
-        if (encode_seq_length>curr_seq_len[(nb_char-(input->length-end_of_loop))*14+j])
+        if (encode_seq_length>prev_seq_len[j])
         {
-            encode_seq_length=curr_seq_len[(nb_char-(input->length-end_of_loop))*14+j];
+            encode_seq_length=prev_seq_len[j];
             current_mode=j;
         }
     }
     if(current_mode>6)
         is_shift=1;
-    if (is_shift && temp_switch_mode[2*current_mode+1]<14)
-        current_mode=temp_switch_mode[2*current_mode+1];
-
-    jab_int32* encode_seq = (jab_int32 *)malloc(sizeof(jab_int32) * (curr_seq_counter+1+is_shift));
-    if(encode_seq == NULL)
-    {
-        reportError("Memory allocation for encode sequence failed");
-        return NULL;
-    }
+    if (is_shift && temp_switch_mode[current_mode]!=SWITCH_NONE)
+        current_mode=temp_switch_mode[current_mode];
 
     //check if byte mode is used more than 15 times in sequence
     //->>length will be increased by 13
@@ -507,7 +566,8 @@ jab_int32* analyzeInputData(jab_data* input, jab_int32* encoded_length)
         }
         if (encode_seq[i]<14 && i-1!=0)
         {
-            encode_seq[i-1]=prev_mode[i*14+encode_seq[i]];
+            jab_byte history=mode_history[i*MODE_HISTORY_ROW+encode_seq[i]/2];
+            encode_seq[i-1]=(encode_seq[i] & 1) ? history >> 4 : history & 0x0F;
             seq_len+=character_size[encode_seq[i-1]%7];
             if(encode_seq[i-1]!=encode_seq[i])
                 seq_len+=latch_shift_to[encode_seq[i-1]][encode_seq[i]];
@@ -551,14 +611,14 @@ jab_int32* analyzeInputData(jab_data* input, jab_int32* encoded_length)
             }
         }
         else
+        {
+            scratchFree(mode_history);
+            scratchFree(encode_seq);
             return NULL;
+        }
     }
     *encoded_length=encode_seq_length;
-    free(seq);
-    free(curr_seq_len);
-    free(prev_mode);
-    free(switch_mode);
-    free(temp_switch_mode);
+    scratchFree(mode_history);
     return encode_seq;
 }
 
@@ -692,22 +752,92 @@ void getOptimalECC(jab_int32 capacity, jab_int32 net_data_length, jab_int32* wcw
 	}
 }
 
+/**
+ * @brief Bit writer packing the encoded data into 64-bit words, most significant bit first
+*/
+typedef struct {
+	jab_uint64*	words;		///< The packed words
+	jab_int32	capacity;	///< The number of allocated words
+	jab_int32	word_count;	///< The number of completed words
+	jab_uint64	acc;		///< The bits not yet stored in a word
+	jab_int32	acc_bits;	///< The number of bits in the accumulator
+}jab_bit_writer;
+
+/**
+ * @brief Append a codeword to the bit writer
+ * @param writer the bit writer
+ * @param value the codeword value, negative values are taken as bytes
+ * @param length the codeword length in bits (at most 32)
+*/
+static inline void writeBits(jab_bit_writer* writer, jab_int32 value, jab_int32 length)
+{
+	if(value < 0) value += 256;
+	jab_uint64 bits = (jab_uint64)value & ((1ULL << length) - 1);
+	jab_int32 free_bits = 64 - writer->acc_bits;
+	if(length < free_bits)
+	{
+		writer->acc = (writer->acc << length) | bits;
+		writer->acc_bits += length;
+	}
+	else
+	{
+		//fill up the current word and keep the remaining bits
+		jab_int32 rest = length - free_bits;
+		if(writer->word_count < writer->capacity)
+			writer->words[writer->word_count++] = (writer->acc << free_bits) | (bits >> rest);
+		writer->acc = bits & ((1ULL << rest) - 1);
+		writer->acc_bits = rest;
+	}
+}
+
+/**
+ * @brief Store the pending bits of the bit writer in a last word
+ * @param writer the bit writer
+*/
+static void flushBits(jab_bit_writer* writer)
+{
+	if(writer->acc_bits > 0 && writer->word_count < writer->capacity)
+	{
+		writer->words[writer->word_count++] = writer->acc << (64 - writer->acc_bits);
+		writer->acc = 0;
+		writer->acc_bits = 0;
+	}
+}
+
+/**
+ * @brief Expand a range of packed bits into one byte per bit
+ * @param words the packed bits
+ * @param start the index of the first bit to expand
+ * @param bits the expanded bits
+ * @param length the number of bits to expand
+*/
+static void unpackBits(jab_uint64* words, jab_int32 start, jab_char* bits, jab_int32 length)
+{
+	for (jab_int32 i=0; i<length; i++)
+	{
+		jab_int32 pos = start + i;
+		bits[i] = (jab_char)((words[pos/64] >> (63 - pos%64)) & 1);
+	}
+}
+
 /**
  * @brief Encode the input data
  * @param data the character input data
  * @param encoded_length the optimal encoding length
  * @param encode_seq the optimal encoding sequence
- * @return the encoded data | NULL if failed
+ * @return the encoded bits packed into 64-bit words, most significant bit first | NULL if failed
  */
-jab_data* encodeData(jab_data* data, jab_int32 encoded_length,jab_int32* encode_seq)
+jab_uint64* encodeData(jab_payload_reader* data, jab_int32 encoded_length, jab_byte* encode_seq)
 {
-    jab_data* encoded_data = (jab_data *)malloc(sizeof(jab_data) + encoded_length*sizeof(jab_char));
-    if(encoded_data == NULL)
+    //the last codewords may run past the encoded length, they are cut off at the end
+    jab_bit_writer writer = {0};
+    writer.capacity = encoded_length/64 + 2;
+    writer.words = (jab_uint64 *)scratchMalloc(sizeof(jab_uint64) * writer.capacity);
+    if(writer.words == NULL)
     {
         reportError("Memory allocation for encoded data failed");
         return NULL;
     }
-    encoded_data->length = encoded_length;
 
     jab_int32 counter=0;
     jab_boolean shift_back=0;
@@ -720,9 +850,7 @@ jab_data* encodeData(jab_data* data, jab_int32 encoded_length,jab_int32* encode_
     //encoding starts in upper case mode
     for (jab_int32 i=0;i<end_of_loop;i++)
     {
-        jab_int32 tmp=data->data[current_encoded_length];
-        if (tmp < 0)
-            tmp+=256;
+        jab_int32 tmp=getPayloadByte(data, current_encoded_length);
         if (position<encoded_length)
         {
             jab_int32 decimal_value;
@@ -734,11 +862,11 @@ jab_data* encodeData(jab_data* data, jab_int32 encoded_length,jab_int32* encode_
                 if(encode_seq[counter+1] == 6 || encode_seq[counter+1] == 13)
                     length-=4;
                 if(length < ENC_MAX)
-                    convert_dec_to_bin(mode_switch[encode_seq[counter]][encode_seq[counter+1]],encoded_data->data,position,length);
+                    writeBits(&writer, mode_switch[encode_seq[counter]][encode_seq[counter+1]], length);
                 else
                 {
                     reportError("Encoding data failed");
-                    free(encoded_data);
+                    scratchFree(writer.words);
                     return NULL;
                 }
                 position+=latch_shift_to[encode_seq[counter]][encode_seq[counter+1]];
@@ -754,15 +882,13 @@ jab_data* encodeData(jab_data* data, jab_int32 encoded_length,jab_int32* encode_
                 if(jab_enconing_table[tmp][encode_seq[counter+1]%7]>-1 && character_size[encode_seq[counter+1]%7] < ENC_MAX)
                 {
                     //encode character
-                    convert_dec_to_bin(jab_enconing_table[tmp][encode_seq[counter+1]%7],encoded_data->data,position,character_size[encode_seq[counter+1]%7]);
+                    writeBits(&writer, jab_enconing_table[tmp][encode_seq[counter+1]%7], character_size[encode_seq[counter+1]%7]);
                     position+=character_size[encode_seq[counter+1]%7];
                     counter++;
                 }
                 else if (jab_enconing_table[tmp][encode_seq[counter+1]%7]<-1)
                 {
-                    jab_int32 tmp1=data->data[current_encoded_length+1];
-                    if (tmp1 < 0)
-                        tmp1+=256;
+                    jab_int32 tmp1=getPayloadByte(data, current_encoded_length+1);
                     //read next character to see if more efficient encoding possible
                     if (((tmp==44 || tmp== 46 || tmp==58) && tmp1==32) || (tmp==13 && tmp1==10))
                         decimal_value=abs(jab_enconing_table[tmp][encode_seq[counter+1]%7]);
@@ -771,11 +897,11 @@ jab_data* encodeData(jab_data* data, jab_int32 encoded_length,jab_int32* encode_
                     else
                     {
                         reportError("Encoding data failed");
-                        free(encoded_data);
+                        scratchFree(writer.words);
                         return NULL;
                     }
                     if (character_size[encode_seq[counter+1]%7] < ENC_MAX)
-                    convert_dec_to_bin(decimal_value,encoded_data->data,position,character_size[encode_seq[counter+1]%7]);
+                    writeBits(&writer, decimal_value, character_size[encode_seq[counter+1]%7]);
                     position+=character_size[encode_seq[counter+1]%7];
                     counter++;
                     end_of_loop--;
@@ -784,7 +910,7 @@ jab_data* encodeData(jab_data* data, jab_int32 encoded_length,jab_int32* encode_
                 else
                 {
                     reportError("Encoding data failed");
-                    free(encoded_data);
+                    scratchFree(writer.words);
                     return NULL;
                 }
             }
@@ -802,17 +928,17 @@ jab_data* encodeData(jab_data* data, jab_int32 encoded_length,jab_int32* encode_
                         else
                             break;
                     }
-                    convert_dec_to_bin(byte_counter > 15 ? 0 : byte_counter,encoded_data->data,position,4);
+                    writeBits(&writer, byte_counter > 15 ? 0 : byte_counter, 4);
                     position+=4;
                     if(byte_counter > 15)
                     {
 						if(byte_counter <= 8207)//8207=2^13+15; if number of bytes exceeds 8207, encoder shall shift to byte mode again from upper case mode && byte_counter < 8207
 						{
-							convert_dec_to_bin(byte_counter-15-1,encoded_data->data,position,13);
+							writeBits(&writer, byte_counter-15-1, 13);
 						}
 						else
 						{
-							convert_dec_to_bin(8191,encoded_data->data,position,13);
+							writeBits(&writer, 8191, 13);
 						}
                         position+=13;
                     }
@@ -822,41 +948,41 @@ jab_data* encodeData(jab_data* data, jab_int32 encoded_length,jab_int32* encode_
 				{
 					if(encode_seq[counter-(byte_offset-byte_counter)]==0 || encode_seq[counter-(byte_offset-byte_counter)]==7 || encode_seq[counter-(byte_offset-byte_counter)]==1|| encode_seq[counter-(byte_offset-byte_counter)]==8)
 					{
-						convert_dec_to_bin(124,encoded_data->data,position,7);// shift from upper case to byte
+						writeBits(&writer, 124, 7);// shift from upper case to byte
 						position+=7;
 					}
 					if(encode_seq[counter-(byte_offset-byte_counter)]==2 || encode_seq[counter-(byte_offset-byte_counter)]==9)
 					{
-						convert_dec_to_bin(60,encoded_data->data,position,5);// shift from numeric to byte
+						writeBits(&writer, 60, 5);// shift from numeric to byte
 						position+=5;
 					}
 					if(encode_seq[counter-(byte_offset-byte_counter)]==5 || encode_seq[counter-(byte_offset-byte_counter)]==12)
 					{
-						convert_dec_to_bin(252,encoded_data->data,position,8);// shift from alphanumeric to byte
+						writeBits(&writer, 252, 8);// shift from alphanumeric to byte
 						position+=8;
 					}
-					convert_dec_to_bin(byte_counter > 15 ? 0 : byte_counter,encoded_data->data,position,4); //write the first 4 bits
+					writeBits(&writer, byte_counter > 15 ? 0 : byte_counter, 4); //write the first 4 bits
 					position+=4;
 					if(byte_counter > 15) //if more than 15 bytes -> use the next 13 bits to wirte the length
 					{
 						if(byte_counter <= 8207)//8207=2^13+15; if number of bytes exceeds 8207, encoder shall shift to byte mode again from upper case mode && byte_counter < 8207
 						{
-							convert_dec_to_bin(byte_counter-15-1,encoded_data->data,position,13);
+							writeBits(&writer, byte_counter-15-1, 13);
 						}
 						else //number exceeds 2^13 + 15
 						{
-							convert_dec_to_bin(8191,encoded_data->data,position,13);
+							writeBits(&writer, 8191, 13);
 						}
 						position+=13;
 					}
 					factor++;
 				}
                 if (character_size[encode_seq[counter+1]%7] < ENC_MAX)
-                    convert_dec_to_bin(tmp,encoded_data->data,position,character_size[encode_seq[counter+1]%7]);
+                    writeBits(&writer, tmp, character_size[encode_seq[counter+1]%7]);
                 else
                 {
                     reportError("Encoding data failed");
-                    free(encoded_data);
+                    scratchFree(writer.words);
                     return NULL;
                 }
                 position+=character_size[encode_seq[counter+1]%7];
@@ -878,12 +1004,15 @@ jab_data* encodeData(jab_data* data, jab_int32 encoded_length,jab_int32* encode_
         else
         {
             reportError("Encoding data failed");
-            free(encoded_data);
+            scratchFree(writer.words);
             return NULL;
         }
         current_encoded_length++;
     }
-    return encoded_data;
+    flushBits(&writer);
+    //bits not written are zero
+    memset(writer.words + writer.word_count, 0, sizeof(jab_uint64) * (writer.capacity - writer.word_count));
+    return writer.words;
 }
 
 /**
@@ -907,7 +1036,7 @@ jab_boolean encodeMasterMetadata(jab_encode* enc)
 
 	//write each part of master metadata
 	//Part I
-	jab_data* partI = (jab_data *)malloc(sizeof(jab_data) + partI_length*sizeof(jab_char));
+	jab_data* partI = (jab_data *)scratchMalloc(sizeof(jab_data) + partI_length*sizeof(jab_char));
 	if(partI == NULL)
 	{
 		reportError("Memory allocation for metadata Part I in master symbol failed");
@@ -916,7 +1045,7 @@ jab_boolean encodeMasterMetadata(jab_encode* enc)
 	partI->length = partI_length;
 	convert_dec_to_bin(Nc, partI->data, 0, partI->length);
 	//Part II
-	jab_data* partII = (jab_data *)malloc(sizeof(jab_data) + partII_length*sizeof(jab_char));
+	jab_data* partII = (jab_data *)scratchMalloc(sizeof(jab_data) + partII_length*sizeof(jab_char));
 	if(partII == NULL)
 	{
 		reportError("Memory allocation for metadata Part II in master symbol failed");
@@ -946,8 +1075,7 @@ jab_boolean encodeMasterMetadata(jab_encode* enc)
 	}
 
 	jab_int32 encoded_metadata_length = encoded_partI->length + encoded_partII->length;
-	enc->symbols[0].metadata = (jab_data *)malloc(sizeof(jab_data) + encoded_metadata_length*sizeof(jab_char));
-	if(enc->symbols[0].metadata == NULL)
+	if(!reserveBuffer((void**)&enc->symbols[0].metadata, &enc->symbols[0].metadata_capacity, sizeof(jab_data) + encoded_metadata_length*sizeof(jab_char)))
 	{
 		reportError("Memory allocation for encoded metadata in master symbol failed");
 		return JAB_FAILURE;
@@ -957,10 +1085,10 @@ jab_boolean encodeMasterMetadata(jab_encode* enc)
 	memcpy(enc->symbols[0].metadata->data, encoded_partI->data, encoded_partI->length);
 	memcpy(enc->symbols[0].metadata->data+encoded_partI->length, encoded_partII->data, encoded_partII->length);
 
-	free(partI);
-	free(partII);
-	free(encoded_partI);
-	free(encoded_partII);
+	scratchFree(encoded_partII);
+	scratchFree(encoded_partI);
+	scratchFree(partII);
+	scratchFree(partI);
     return JAB_SUCCESS;
 }
 
@@ -973,7 +1101,7 @@ jab_boolean encodeMasterMetadata(jab_encode* enc)
 jab_boolean updateMasterMetadataPartII(jab_encode* enc, jab_int32 mask_ref)
 {
 	jab_int32 partII_length	= MASTER_METADATA_PART2_LENGTH/2;	//partII net length
-	jab_data* partII = (jab_data *)malloc(sizeof(jab_data) + partII_length*sizeof(jab_char));
+	jab_data* partII = (jab_data *)scratchMalloc(sizeof(jab_data) + partII_length*sizeof(jab_char));
 	if(partII == NULL)
 	{
 		reportError("Memory allocation for metadata Part II in master symbol failed");
@@ -1006,8 +1134,8 @@ jab_boolean updateMasterMetadataPartII(jab_encode* enc, jab_int32 mask_ref)
 	//update metadata
 	memcpy(enc->symbols[0].metadata->data+MASTER_METADATA_PART1_LENGTH, encoded_partII->data, encoded_partII->length);
 
-	free(partII);
-	free(encoded_partII);
+	scratchFree(encoded_partII);
+	scratchFree(partII);
 	return JAB_SUCCESS;
 }
 
@@ -1034,12 +1162,12 @@ void placeMasterMetadataPartII(jab_encode* enc)
 	jab_int32 partII_bit_start = MASTER_METADATA_PART1_LENGTH;
 	jab_int32 partII_bit_end = MASTER_METADATA_PART1_LENGTH + MASTER_METADATA_PART2_LENGTH;
 	jab_int32 metadata_index = partII_bit_start;
-	while(metadata_index <= partII_bit_end)
+	while(metadata_index < partII_bit_end)
 	{
     	jab_byte color_index = enc->symbols[0].matrix[y*enc->symbols[0].side_size.x + x];
 		for(jab_int32 j=0; j<nb_of_bits_per_mod; j++)
 		{
-			if(metadata_index <= partII_bit_end)
+			if(metadata_index < partII_bit_end)
 			{
 				jab_byte bit = enc->symbols[0].metadata->data[metadata_index];
 				if(bit == 0)
@@ -1120,20 +1248,23 @@ void getColorPaletteIndex(jab_byte* index, jab_int32 index_size, jab_int32 color
 jab_boolean createMatrix(jab_encode* enc, jab_int32 index, jab_data* ecc_encoded_data)
 {
     //Allocate matrix
-    enc->symbols[index].matrix = (jab_byte *)calloc(enc->symbols[index].side_size.x * enc->symbols[index].side_size.y, sizeof(jab_byte));
-    if(enc->symbols[index].matrix == NULL)
+    jab_int32 matrix_size = enc->symbols[index].side_size.x * enc->symbols[index].side_size.y * sizeof(jab_byte);
+    jab_int32 matrix_capacity = enc->symbols[index].matrix_capacity;
+    if(!reserveBuffer((void**)&enc->symbols[index].matrix, &matrix_capacity, matrix_size))
     {
         reportError("Memory allocation for symbol matrix failed");
         return JAB_FAILURE;
     }
+    memset(enc->symbols[index].matrix, 0, matrix_size);
     //Allocate boolean matrix
-    enc->symbols[index].data_map = (jab_byte *)malloc(enc->symbols[index].side_size.x * enc->symbols[index].side_size.y * sizeof(jab_byte));
-    if(!enc->symbols[index].data_map)
+    matrix_capacity = enc->symbols[index].matrix_capacity;
+    if(!reserveBuffer((void**)&enc->symbols[index].data_map, &matrix_capacity, matrix_size))
     {
         reportError("Memory allocation for data map failed");
         return JAB_FAILURE;
     }
-    memset(enc->symbols[index].data_map, 1, enc->symbols[index].side_size.x * enc->symbols[index].side_size.y * sizeof(jab_byte));
+    enc->symbols[index].matrix_capacity = matrix_capacity;
+    memset(enc->symbols[index].data_map, 1, matrix_size);
 
     //set alignment patterns
     jab_int32 Nc = log(enc->color_number)/log(2.0) - 1;
@@ -1566,7 +1697,7 @@ jab_boolean assignDockedSymbols(jab_encode* enc)
 */
 jab_code* getCodePara(jab_encode* enc)
 {
-    jab_code* cp = (jab_code *)malloc(sizeof(jab_code));
+    jab_code* cp = (jab_code *)scratchMalloc(sizeof(jab_code));
     if(!cp)
     {
         reportError("Memory allocation for code parameter failed");
@@ -1607,17 +1738,18 @@ jab_code* getCodePara(jab_encode* enc)
     //calculate the code size
     cp->rows = max_y - cp->min_y + 1;
     cp->cols = max_x - cp->min_x + 1;
-    cp->row_height = (jab_int32 *)malloc(cp->rows * sizeof(jab_int32));
+    cp->row_height = (jab_int32 *)scratchMalloc(cp->rows * sizeof(jab_int32));
     if(!cp->row_height)
     {
-		free(cp);
+		scratchFree(cp);
         reportError("Memory allocation for row height in code parameter failed");
         return NULL;
     }
-    cp->col_width = (jab_int32 *)malloc(cp->cols * sizeof(jab_int32));
+    cp->col_width = (jab_int32 *)scratchMalloc(cp->cols * sizeof(jab_int32));
     if(!cp->col_width)
     {
-		free(cp);
+		scratchFree(cp->row_height);
+		scratchFree(cp);
         reportError("Memory allocation for column width in code parameter failed");
         return NULL;
     }
@@ -1655,6 +1787,60 @@ jab_code* getCodePara(jab_encode* enc)
     return cp;
 }
 
+/**
+ * @brief Create the module matrix of the whole code
+ * @param enc the encode parameters
+ * @param cp the code parameters
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean createModuleMatrix(jab_encode* enc, jab_code* cp)
+{
+    jab_int32 width = cp->code_size.x;
+    jab_int32 height= cp->code_size.y;
+    jab_int32 matrix_size = sizeof(jab_module_matrix) + width*height*sizeof(jab_byte);
+    if(!reserveBuffer((void**)&enc->module_matrix, &enc->module_matrix_capacity, matrix_size))
+    {
+        reportError("Memory allocation for module matrix failed");
+        return JAB_FAILURE;
+    }
+    jab_module_matrix* mm = enc->module_matrix;
+    mm->width = width;
+    mm->height = height;
+    mm->color_number = enc->color_number;
+    mm->module_size = cp->dimension;
+    mm->master_size = enc->symbols[0].side_size;
+    mm->palette = enc->palette;
+    //only multi-symbol codes can have area not covered by any symbol
+    if(enc->symbol_number > 1)
+        memset(mm->module, EMPTY_MODULE, width*height*sizeof(jab_byte));
+
+    //place symbols in the matrix
+    for(jab_int32 k=0; k<enc->symbol_number; k++)
+    {
+        //calculate the starting coordinates of the symbol matrix
+        jab_int32 startx = 0, starty = 0;
+        jab_int32 col = jab_symbol_pos[enc->symbol_positions[k]].x - cp->min_x;
+        jab_int32 row = jab_symbol_pos[enc->symbol_positions[k]].y - cp->min_y;
+        for(jab_int32 c=0; c<col; c++)
+            startx += cp->col_width[c];
+        for(jab_int32 r=0; r<row; r++)
+            starty += cp->row_height[r];
+        if(k == 0)
+        {
+            mm->master_position.x = startx;
+            mm->master_position.y = starty;
+        }
+
+        jab_int32 symbol_width = enc->symbols[k].side_size.x;
+        jab_int32 symbol_height= enc->symbols[k].side_size.y;
+        for(jab_int32 y=0; y<symbol_height; y++)
+        {
+            memcpy(mm->module + (starty+y)*width + startx, enc->symbols[k].matrix + y*symbol_width, symbol_width*sizeof(jab_byte));
+        }
+    }
+    return JAB_SUCCESS;
+}
+
 /**
  * @brief Create bitmap for the code
  * @param enc the encode parameters
@@ -1664,21 +1850,38 @@ jab_code* getCodePara(jab_encode* enc)
 jab_boolean createBitmap(jab_encode* enc, jab_code* cp)
 {
     //create bitmap
-    jab_int32 width = cp->dimension * cp->code_size.x;
-    jab_int32 height= cp->dimension * cp->code_size.y;
-    jab_int32 bytes_per_pixel = BITMAP_BITS_PER_PIXEL / 8;
+    jab_boolean indexed = (enc->output_mode == INDEXED_BITMAP_OUTPUT);
+    jab_int32 dimension = cp->dimension;
+    jab_int32 width = dimension * cp->code_size.x;
+    jab_int32 height= dimension * cp->code_size.y;
+    jab_int32 bits_per_pixel = indexed ? BITMAP_BITS_PER_CHANNEL : BITMAP_BITS_PER_PIXEL;
+    jab_int32 bytes_per_pixel = bits_per_pixel / 8;
     jab_int32 bytes_per_row = width * bytes_per_pixel;
-    enc->bitmap = (jab_bitmap *)calloc(1, sizeof(jab_bitmap) + width*height*bytes_per_pixel*sizeof(jab_byte));
-    if(enc->bitmap == NULL)
+    jab_int32 bitmap_size = sizeof(jab_bitmap) + width*height*bytes_per_pixel*sizeof(jab_byte);
+    if(!reserveBuffer((void**)&enc->bitmap, &enc->bitmap_capacity, bitmap_size))
     {
         reportError("Memory allocation for bitmap failed");
         return JAB_FAILURE;
     }
     enc->bitmap->width = width;
     enc->bitmap->height= height;
-    enc->bitmap->bits_per_pixel = BITMAP_BITS_PER_PIXEL;
+    enc->bitmap->bits_per_pixel = bits_per_pixel;
     enc->bitmap->bits_per_channel = BITMAP_BITS_PER_CHANNEL;
-    enc->bitmap->channel_count = BITMAP_CHANNEL_COUNT;
+    enc->bitmap->channel_count = indexed ? 1 : BITMAP_CHANNEL_COUNT;
+    //only multi-symbol codes can have area not covered by any symbol
+    if(enc->symbol_number > 1)
+        memset(enc->bitmap->pixel, indexed ? EMPTY_MODULE : 0, width*height*bytes_per_pixel*sizeof(jab_byte));
+
+    //pack the palette into RGBA pixels
+    jab_uint32 color[MAX_COLOR_NUMBER];
+    if(!indexed)
+    {
+        for(jab_int32 i=0; i<enc->color_number; i++)
+        {
+            jab_byte rgba[4] = {enc->palette[i*3], enc->palette[i*3 + 1], enc->palette[i*3 + 2], 255};
+            memcpy(&color[i], rgba, sizeof(jab_uint32));
+        }
+    }
 
     //place symbols in bitmap
     for(jab_int32 k=0; k<enc->symbol_number; k++)
@@ -1692,26 +1895,44 @@ jab_boolean createBitmap(jab_encode* enc, jab_code* cp)
         for(jab_int32 r=0; r<row; r++)
             starty += cp->row_height[r];
 
-        //place symbol in the code
+        //place symbol in the code row by row
         jab_int32 symbol_width = enc->symbols[k].side_size.x;
         jab_int32 symbol_height= enc->symbols[k].side_size.y;
-        for(jab_int32 x=startx; x<(startx+symbol_width); x++)
+        jab_int32 span = symbol_width * dimension * bytes_per_pixel;
+        for(jab_int32 y=0; y<symbol_height; y++)
         {
-            for(jab_int32 y=starty; y<(starty+symbol_height); y++)
+            jab_byte* modules = enc->symbols[k].matrix + y*symbol_width;
+            jab_byte* first_row = enc->bitmap->pixel + (starty+y)*dimension*bytes_per_row + startx*dimension*bytes_per_pixel;
+            //render the first pixel row of the module row
+            if(indexed && dimension == 1)
+            {
+                memcpy(first_row, modules, symbol_width);
+            }
+            else if(indexed)
+            {
+                for(jab_int32 x=0; x<symbol_width; x++)
+                    memset(first_row + x*dimension, modules[x], dimension);
+            }
+            else if(dimension == 1)
             {
-                //place one module in the bitmap
-                jab_int32 p_index = enc->symbols[k].matrix[(y-starty)*symbol_width + (x-startx)];
-                 for(jab_int32 i=y*cp->dimension; i<(y*cp->dimension+cp->dimension); i++)
+                jab_uint32* pixel = (jab_uint32*)first_row;
+                for(jab_int32 x=0; x<symbol_width; x++)
+                    pixel[x] = color[modules[x]];
+            }
+            else
+            {
+                jab_uint32* pixel = (jab_uint32*)first_row;
+                for(jab_int32 x=0; x<symbol_width; x++)
                 {
-                    for(jab_int32 j=x*cp->dimension; j<(x*cp->dimension+cp->dimension); j++)
-                    {
-                        enc->bitmap->pixel[i*bytes_per_row + j*bytes_per_pixel]     = enc->palette[p_index * 3];	//R
-                        enc->bitmap->pixel[i*bytes_per_row + j*bytes_per_pixel + 1] = enc->palette[p_index * 3 + 1];//B
-                        enc->bitmap->pixel[i*bytes_per_row + j*bytes_per_pixel + 2] = enc->palette[p_index * 3 + 2];//G
-                        enc->bitmap->pixel[i*bytes_per_row + j*bytes_per_pixel + 3] = 255; 							//A
-                    }
+                    jab_uint32 c = color[modules[x]];
+                    for(jab_int32 j=0; j<dimension; j++)
+                        pixel[j] = c;
+                    pixel += dimension;
                 }
             }
+            //replicate it for the rest of the module row
+            for(jab_int32 i=1; i<dimension; i++)
+                memcpy(first_row + i*bytes_per_row, first_row, span);
         }
     }
     return JAB_SUCCESS;
@@ -1756,13 +1977,12 @@ jab_boolean checkDockedSymbolSize(jab_encode* enc)
 /**
  * @brief Set the minimal master symbol version
  * @param enc the encode parameters
- * @param encoded_data the encoded message
+ * @param net_data_length the encoded message length
  * @return JAB_SUCCESS | JAB_FAILURE
  */
-jab_boolean setMasterSymbolVersion(jab_encode *enc, jab_data* encoded_data)
+jab_boolean setMasterSymbolVersion(jab_encode *enc, jab_int32 net_data_length)
 {
     //calculate required number of data modules depending on data_length
-    jab_int32 net_data_length = encoded_data->length;
     jab_int32 payload_length = net_data_length + 5;  //plus S and flag bit
     if(enc->symbol_ecc_levels[0] == 0) enc->symbol_ecc_levels[0] = DEFAULT_ECC_LEVEL;
     enc->symbols[0].wcwr[0] = ecclevel2wcwr[enc->symbol_ecc_levels[0]][0];
@@ -1806,6 +2026,8 @@ jab_boolean setMasterSymbolVersion(jab_encode *enc, jab_data* encoded_data)
 	//update symbol side size
     enc->symbols[0].side_size.x = VERSION2SIZE(enc->symbol_versions[0].x);
 	enc->symbols[0].side_size.y = VERSION2SIZE(enc->symbol_versions[0].y);
+	//the version is chosen again for the next code
+	enc->auto_master_version = 1;
 
     return JAB_SUCCESS;
 }
@@ -1817,19 +2039,15 @@ jab_boolean setMasterSymbolVersion(jab_encode *enc, jab_data* encoded_data)
 */
 jab_boolean addE2SlaveMetadata(jab_symbol* slave)
 {
-	//copy old metadata to new metadata
+	//extend the old metadata
 	jab_int32 old_metadata_length = slave->metadata->length;
 	jab_int32 new_metadata_length = old_metadata_length + 6;
-	jab_data* old_metadata = slave->metadata;
-	slave->metadata = (jab_data *)malloc(sizeof(jab_data) + new_metadata_length*sizeof(jab_char));
-	if(slave->metadata == NULL)
+	if(!reserveBuffer((void**)&slave->metadata, &slave->metadata_capacity, sizeof(jab_data) + new_metadata_length*sizeof(jab_char)))
 	{
 		reportError("Memory allocation for metadata in slave symbol failed");
 		return JAB_FAILURE;
 	}
 	slave->metadata->length = new_metadata_length;
-	memcpy(slave->metadata->data, old_metadata->data, old_metadata_length);
-	free(old_metadata);
 
 	//update SE = 1
 	slave->metadata->data[1] = 1;
@@ -1841,20 +2059,31 @@ jab_boolean addE2SlaveMetadata(jab_symbol* slave)
 	return JAB_SUCCESS;
 }
 
+/**
+ * @brief Layout of the data payload of a symbol
+*/
+typedef struct {
+	jab_int32	data_offset;	///< The offset of the symbol's share in the encoded message
+	jab_int32	data_length;	///< The length of the symbol's share of the encoded message
+	jab_int32	payload_length;	///< The length of the full payload including the flag bit and metadata
+	jab_int32	length;			///< The length of the payload padded to the net capacity
+}jab_symbol_payload;
+
 /**
  * @brief Update slave metadata E in its host data stream
  * @param enc the encode parameters
  * @param host_index the host symbol index
+ * @param host_data the data payload of the host symbol
  * @param slave_index the slave symbol index
 */
-void updateSlaveMetadataE(jab_encode* enc, jab_int32 host_index, jab_int32 slave_index)
+void updateSlaveMetadataE(jab_encode* enc, jab_int32 host_index, jab_data* host_data, jab_int32 slave_index)
 {
 	jab_symbol* host = &enc->symbols[host_index];
 	jab_symbol* slave= &enc->symbols[slave_index];
 
-	jab_int32 offset = host->data->length - 1;
+	jab_int32 offset = host_data->length - 1;
 	//find the start flag of metadata
-	while(host->data->data[offset] == 0)
+	while(host_data->data[offset] == 0)
 	{
 		offset--;
 	}
@@ -1888,17 +2117,18 @@ void updateSlaveMetadataE(jab_encode* enc, jab_int32 host_index, jab_int32 slave
 	convert_dec_to_bin(E2, E, 3, 3);
 	for(jab_int32 i=0; i<6; i++)
 	{
-		host->data->data[offset--] = E[i];
+		host_data->data[offset--] = E[i];
 	}
 }
 
 /**
- * @brief Set the data payload for each symbol
+ * @brief Divide the encoded message among the symbols and set the code rate of each symbol
  * @param enc the encode parameters
- * @param encoded_data the encoded message
+ * @param encoded_length the encoded message length
+ * @param payloads the payload layout of each symbol
  * @return JAB_SUCCESS | JAB_FAILURE
 */
-jab_boolean fitDataIntoSymbols(jab_encode* enc, jab_data* encoded_data)
+jab_boolean fitDataIntoSymbols(jab_encode* enc, jab_int32 encoded_length, jab_symbol_payload* payloads)
 {
 	//calculate the net capacity of each symbol and the total net capacity
 	jab_int32 capacity[enc->symbol_number];
@@ -1920,12 +2150,12 @@ jab_boolean fitDataIntoSymbols(jab_encode* enc, jab_data* encoded_data)
 		jab_int32 s_data_length;
 		if(i == enc->symbol_number - 1)
 		{
-			s_data_length = encoded_data->length - assigned_data_length;
+			s_data_length = encoded_length - assigned_data_length;
 		}
 		else
 		{
 			jab_float prop = (jab_float)net_capacity[i] / (jab_float)total_net_capacity;
-			s_data_length = (jab_int32)(prop * encoded_data->length);
+			s_data_length = (jab_int32)(prop * encoded_length);
 		}
 		jab_int32 s_payload_length = s_data_length;
 
@@ -1984,51 +2214,76 @@ jab_boolean fitDataIntoSymbols(jab_encode* enc, jab_data* encoded_data)
 			{
 				getOptimalECC(capacity[i], pn_length, enc->symbols[i].wcwr);
 				pn_length = (capacity[i]/enc->symbols[i].wcwr[1])*enc->symbols[i].wcwr[1] - (capacity[i]/enc->symbols[i].wcwr[1])*enc->symbols[i].wcwr[0];
-				updateSlaveMetadataE(enc, enc->symbols[i].host, i);
 			}
 			else
 				pn_length = net_capacity[i];
 		}
 
-		//start to set full payload
-        enc->symbols[i].data = (jab_data *)calloc(1, sizeof(jab_data) + pn_length*sizeof(jab_char));
-        if(enc->symbols[i].data == NULL)
+		payloads[i].data_offset = assigned_data_length;
+		payloads[i].data_length = s_data_length;
+		payloads[i].payload_length = s_payload_length;
+		payloads[i].length = pn_length;
+		assigned_data_length += s_data_length;
+	}
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Assemble the data payload of a symbol from its share of the encoded message and the metadata it carries
+ * @param enc the encode parameters
+ * @param index the symbol index
+ * @param payload the payload layout of the symbol
+ * @param encoded_bits the encoded message packed into 64-bit words
+ * @return the data payload | NULL if failed
+*/
+jab_data* setSymbolPayload(jab_encode* enc, jab_int32 index, jab_symbol_payload* payload, jab_uint64* encoded_bits)
+{
+	jab_data* data = (jab_data *)scratchMalloc(sizeof(jab_data) + payload->length*sizeof(jab_char));
+	if(data == NULL)
+	{
+		reportError("Memory allocation for data payload in symbol failed");
+		return NULL;
+	}
+	memset(data->data, 0, payload->length*sizeof(jab_char));
+	data->length = payload->length;
+	//set data
+	unpackBits(encoded_bits, payload->data_offset, data->data, payload->data_length);
+	//set flag bit
+	jab_int32 set_pos = payload->payload_length - 1;
+	data->data[set_pos--] = 1;
+	//set host metadata S
+	for(jab_int32 k=0; k<4; k++)
+	{
+		if(enc->symbols[index].slaves[k] > 0)
 		{
-			reportError("Memory allocation for data payload in symbol failed");
-			return JAB_FAILURE;
+			data->data[set_pos--] = 1;
 		}
-		enc->symbols[i].data->length = pn_length;
-		//set data
-		memcpy(enc->symbols[i].data->data, &encoded_data->data[assigned_data_length], s_data_length);
-		assigned_data_length += s_data_length;
-		//set flag bit
-		jab_int32 set_pos = s_payload_length - 1;
-		enc->symbols[i].data->data[set_pos--] = 1;
-		//set host metadata S
-		for(jab_int32 k=0; k<4; k++)
+		else if(enc->symbols[index].slaves[k] == 0)
 		{
-			if(enc->symbols[i].slaves[k] > 0)
-			{
-				enc->symbols[i].data->data[set_pos--] = 1;
-			}
-			else if(enc->symbols[i].slaves[k] == 0)
-			{
-				enc->symbols[i].data->data[set_pos--] = 0;
-			}
+			data->data[set_pos--] = 0;
 		}
-		//set slave metadata
-		for(jab_int32 k=0; k<4; k++)
+	}
+	//set slave metadata
+	for(jab_int32 k=0; k<4; k++)
+	{
+		if(enc->symbols[index].slaves[k] > 0)
 		{
-			if(enc->symbols[i].slaves[k] > 0)
+			for(jab_int32 m=0; m<enc->symbols[enc->symbols[index].slaves[k]].metadata->length; m++)
 			{
-				for(jab_int32 m=0; m<enc->symbols[enc->symbols[i].slaves[k]].metadata->length; m++)
-				{
-					enc->symbols[i].data->data[set_pos--] = enc->symbols[enc->symbols[i].slaves[k]].metadata->data[m];
-				}
+				data->data[set_pos--] = enc->symbols[enc->symbols[index].slaves[k]].metadata->data[m];
 			}
 		}
 	}
-	return JAB_SUCCESS;
+	//update metadata E of slave symbols with their own code rate
+	for(jab_int32 k=0; k<4; k++)
+	{
+		jab_int32 slave_index = enc->symbols[index].slaves[k];
+		if(slave_index > 0 && enc->symbols[slave_index].metadata->data[1] == 1)	//SE = 1
+		{
+			updateSlaveMetadataE(enc, index, data, slave_index);
+		}
+	}
+	return data;
 }
 
 /**
@@ -2151,8 +2406,7 @@ jab_boolean setSlaveMetadata(jab_encode* enc)
 			metadata_length += 6;
 		}
 		//write slave metadata
-		enc->symbols[i].metadata = (jab_data *)malloc(sizeof(jab_data) + metadata_length*sizeof(jab_char));
-		if(enc->symbols[i].metadata == NULL)
+		if(!reserveBuffer((void**)&enc->symbols[i].metadata, &enc->symbols[i].metadata_capacity, sizeof(jab_data) + metadata_length*sizeof(jab_char)))
 		{
 			reportError("Memory allocation for metadata in slave symbol failed");
 			return JAB_FAILURE;
@@ -2177,20 +2431,57 @@ jab_boolean setSlaveMetadata(jab_encode* enc)
 }
 
 /**
- * @brief Generate JABCode
+ * @brief The timer and allocation counters at the start of an encode stage
+*/
+typedef struct {
+	jab_int64	time;
+	jab_int32	allocs;
+	size_t		alloc_bytes;
+}jab_encode_stage_start;
+
+/**
+ * @brief Start timing an encode stage if the encode records statistics
+ * @param enc the encode parameters
+ * @param start the counters at the start of the stage
+*/
+static void startEncodeStage(jab_encode* enc, jab_encode_stage_start* start)
+{
+	if(!enc->record_stats)
+		return;
+	jab_arena* arena = (jab_arena*)enc->scratch;
+	start->allocs = arena->allocs;
+	start->alloc_bytes = arena->alloc_bytes;
+	start->time = getMonotonicTime();
+}
+
+/**
+ * @brief Finish timing an encode stage and add its time and scratch allocations to the encode statistics
+ * @param enc the encode parameters
+ * @param stage the encode stage
+ * @param start the counters at the start of the stage
+*/
+static void endEncodeStage(jab_encode* enc, jab_int32 stage, jab_encode_stage_start* start)
+{
+	if(!enc->record_stats)
+		return;
+	jab_arena* arena = (jab_arena*)enc->scratch;
+	enc->stats.stage_time[stage] += getMonotonicTime() - start->time;
+	enc->stats.stage_count[stage]++;
+	enc->stats.stage_allocs[stage] += arena->allocs - start->allocs;
+	enc->stats.stage_alloc_bytes[stage] += (jab_int64)(arena->alloc_bytes - start->alloc_bytes);
+}
+
+/**
+ * @brief Build the code of the input data into the buffers of the encode object
  * @param enc the encode parameters
  * @param data the input data
- * @return 0:success | 1: out of memory | 2:no input data | 3:incorrect symbol version or position | 4: input data too long
+ * @return 0:success | 1: out of memory | 2:no input data | 3:incorrect symbol version or position | 4: input data too long | 5: reading input data failed
 */
-jab_int32 generateJABCode(jab_encode* enc, jab_data* data)
+jab_int32 buildJABCode(jab_encode* enc, jab_payload_reader* data)
 {
+    jab_encode_stage_start stage_start = {0};
     //Check data
-    if(data == NULL)
-    {
-        reportError("No input data specified!");
-        return 2;
-    }
-    if(data->length == 0)
+    if(data->length <= 0)
     {
         reportError("No input data specified!");
         return 2;
@@ -2202,72 +2493,127 @@ jab_int32 generateJABCode(jab_encode* enc, jab_data* data)
 
     //get the optimal encoded length and encoding sequence
     jab_int32 encoded_length;
-    jab_int32* encode_seq = analyzeInputData(data, &encoded_length);
+    startEncodeStage(enc, &stage_start);
+    jab_byte* encode_seq = analyzeInputData(data, &encoded_length);
+    endEncodeStage(enc, ENCODE_STAGE_ANALYZE, &stage_start);
     if(encode_seq == NULL)
 	{
 		reportError("Analyzing input data failed");
 		return 1;
     }
+	if(data->failed)
+	{
+		scratchFree(encode_seq);
+		return 5;
+	}
 	//encode data using optimal encoding modes
-    jab_data* encoded_data = encodeData(data, encoded_length, encode_seq);
-    free(encode_seq);
-    if(encoded_data == NULL)
+    startEncodeStage(enc, &stage_start);
+    jab_uint64* encoded_bits = encodeData(data, encoded_length, encode_seq);
+    endEncodeStage(enc, ENCODE_STAGE_ENCODE, &stage_start);
+    scratchFree(encode_seq);
+    if(encoded_bits == NULL)
     {
         return 1;
     }
+	if(data->failed)
+	{
+		scratchFree(encoded_bits);
+		return 5;
+	}
     //set master symbol version if not given
     if(enc->symbol_number == 1 && (enc->symbol_versions[0].x == 0 || enc->symbol_versions[0].y == 0))
     {
-        if(!setMasterSymbolVersion(enc, encoded_data))
+        startEncodeStage(enc, &stage_start);
+        jab_boolean version_set = setMasterSymbolVersion(enc, encoded_length);
+        endEncodeStage(enc, ENCODE_STAGE_FIT, &stage_start);
+        if(!version_set)
         {
-        	free(encoded_data);
+        	scratchFree(encoded_bits);
             return 4;
         }
     }
 	//set metadata for slave symbols
 	if(!setSlaveMetadata(enc))
 	{
-		free(encoded_data);
+		scratchFree(encoded_bits);
 		return 1;
 	}
-	//assign encoded data into symbols
-	if(!fitDataIntoSymbols(enc, encoded_data))
+	//divide the encoded data among the symbols
+	jab_symbol_payload payloads[enc->symbol_number];
+	startEncodeStage(enc, &stage_start);
+	jab_boolean fitted = fitDataIntoSymbols(enc, encoded_length, payloads);
+	endEncodeStage(enc, ENCODE_STAGE_FIT, &stage_start);
+	if(!fitted)
 	{
-		free(encoded_data);
+		scratchFree(encoded_bits);
 		return 4;
 	}
-	free(encoded_data);
 	//set master metadata
 	if(!isDefaultMode(enc))
 	{
 		if(!encodeMasterMetadata(enc))
 		{
 			JAB_REPORT_ERROR(("Encoding master symbol metadata failed"))
+			scratchFree(encoded_bits);
             return 1;
 		}
 	}
 
-    //encode each symbol in turn
+    //encode each symbol in turn, only the payload of the current symbol is expanded
     for(jab_int32 i=0; i<enc->symbol_number; i++)
     {
+        jab_data* symbol_data = setSymbolPayload(enc, i, &payloads[i], encoded_bits);
+        if(symbol_data == NULL)
+        {
+            scratchFree(encoded_bits);
+            return 1;
+        }
+        //keep the payload of in-memory encodes in the symbol, a streamed encode keeps no payload buffer
+        if(data->source == NULL)
+        {
+            if(!reserveBuffer((void**)&enc->symbols[i].data, &enc->symbols[i].data_capacity, sizeof(jab_data) + symbol_data->length*sizeof(jab_char)))
+            {
+                reportError("Memory allocation for data payload in symbol failed");
+                scratchFree(symbol_data);
+                scratchFree(encoded_bits);
+                return 1;
+            }
+            memcpy(enc->symbols[i].data, symbol_data, sizeof(jab_data) + symbol_data->length*sizeof(jab_char));
+        }
+        else
+        {
+            free(enc->symbols[i].data);
+            enc->symbols[i].data = NULL;
+            enc->symbols[i].data_capacity = 0;
+        }
         //error correction for data
-        jab_data* ecc_encoded_data = encodeLDPC(enc->symbols[i].data, enc->symbols[i].wcwr);
+        startEncodeStage(enc, &stage_start);
+        jab_data* ecc_encoded_data = encodeLDPC(symbol_data, enc->symbols[i].wcwr);
+        endEncodeStage(enc, ENCODE_STAGE_LDPC, &stage_start);
+        scratchFree(symbol_data);
         if(ecc_encoded_data == NULL)
         {
             JAB_REPORT_ERROR(("LDPC encoding for the data in symbol %d failed", i))
+            scratchFree(encoded_bits);
             return 1;
         }
         //interleave
+        startEncodeStage(enc, &stage_start);
         interleaveData(ecc_encoded_data);
+        endEncodeStage(enc, ENCODE_STAGE_INTERLEAVE, &stage_start);
         //create Matrix
+        startEncodeStage(enc, &stage_start);
         jab_boolean cm_flag = createMatrix(enc, i, ecc_encoded_data);
-        free(ecc_encoded_data);
+        endEncodeStage(enc, ENCODE_STAGE_MATRIX, &stage_start);
+        scratchFree(ecc_encoded_data);
         if(!cm_flag)
         {
 			JAB_REPORT_ERROR(("Creating matrix for symbol %d failed", i))
+			scratchFree(encoded_bits);
 			return 1;
 		}
     }
+    scratchFree(encoded_bits);
 
     //mask all symbols in the code
     jab_code* cp = getCodePara(enc);
@@ -2275,18 +2621,21 @@ jab_int32 generateJABCode(jab_encode* enc, jab_data* data)
     {
 		return 1;
     }
+    startEncodeStage(enc, &stage_start);
     if(isDefaultMode(enc))	//default mode
 	{
 		maskSymbols(enc, DEFAULT_MASKING_REFERENCE, 0, 0);
+		if(enc->record_stats)
+			enc->stats.mask_type = DEFAULT_MASKING_REFERENCE;
 	}
 	else
 	{
 		jab_int32 mask_reference = maskCode(enc, cp);
 		if(mask_reference < 0)
 		{
-			free(cp->row_height);
-			free(cp->col_width);
-			free(cp);
+			scratchFree(cp->col_width);
+			scratchFree(cp->row_height);
+			scratchFree(cp);
 			return 1;
 		}
 #if TEST_MODE
@@ -2300,12 +2649,27 @@ jab_int32 generateJABCode(jab_encode* enc, jab_data* data)
 			placeMasterMetadataPartII(enc);
 		}
 	}
+    endEncodeStage(enc, ENCODE_STAGE_MASK, &stage_start);
 
-    //create the code bitmap
-    jab_boolean cb_flag = createBitmap(enc, cp);
-    free(cp->row_height);
-    free(cp->col_width);
-    free(cp);
+    //create the module matrix and, if required, the code bitmap
+    startEncodeStage(enc, &stage_start);
+    jab_boolean cb_flag = createModuleMatrix(enc, cp);
+    if(cb_flag)
+    {
+        if(enc->output_mode == MODULE_MATRIX_OUTPUT)
+        {
+            //the bitmap of a previous code is no longer valid
+            free(enc->bitmap);
+            enc->bitmap = NULL;
+            enc->bitmap_capacity = 0;
+        }
+        else
+            cb_flag = createBitmap(enc, cp);
+    }
+    endEncodeStage(enc, ENCODE_STAGE_BITMAP, &stage_start);
+    scratchFree(cp->col_width);
+    scratchFree(cp->row_height);
+    scratchFree(cp);
     if(!cb_flag)
 	{
 		JAB_REPORT_ERROR(("Creating the code bitmap failed"))
@@ -2314,6 +2678,114 @@ jab_int32 generateJABCode(jab_encode* enc, jab_data* data)
     return 0;
 }
 
+/**
+ * @brief Reset the encode object and build the code of the payload with its scratch arena
+ * @param enc the encode parameters
+ * @param payload the payload reader, a reader without buffer gets a chunk buffer from the arena
+ * @return 0:success | 1: out of memory | 2:no input data | 3:incorrect symbol version or position | 4: input data too long | 5: reading input data failed
+*/
+static jab_int32 runEncode(jab_encode* enc, jab_payload_reader* payload)
+{
+    resetEncode(enc);
+    //intermediate buffers are taken from the scratch arena of the encode object
+    if(enc->scratch == NULL)
+    {
+        enc->scratch = malloc(sizeof(jab_arena));
+        if(enc->scratch == NULL)
+        {
+            reportError("Memory allocation for encoder scratch memory failed");
+            return 1;
+        }
+        if(!initArena((jab_arena*)enc->scratch, 0))
+        {
+            free(enc->scratch);
+            enc->scratch = NULL;
+            return 1;
+        }
+    }
+    jab_arena* prev_arena = setScratchArena((jab_arena*)enc->scratch);
+    if(enc->record_stats)
+    {
+        memset(&enc->stats, 0, sizeof(jab_encode_stats));
+        enc->stats.mask_type = -1;
+        for(jab_int32 i=0; i<NUMBER_OF_MASK_PATTERNS; i++)
+            enc->stats.mask_penalty[i] = -1;
+        enc->stats.total_time = getMonotonicTime();
+    }
+    jab_int32 result = 1;
+    if(payload->buffer == NULL)
+    {
+        payload->buffer = (jab_char *)scratchMalloc(PAYLOAD_CHUNK_SIZE);
+        if(payload->buffer == NULL)
+            reportError("Memory allocation for payload buffer failed");
+        else
+        {
+            result = buildJABCode(enc, payload);
+            scratchFree(payload->buffer);
+        }
+    }
+    else
+        result = buildJABCode(enc, payload);
+    setScratchArena(prev_arena);
+    if(enc->record_stats)
+    {
+        jab_arena* arena = (jab_arena*)enc->scratch;
+        enc->stats.total_time = getMonotonicTime() - enc->stats.total_time;
+        enc->stats.scratch_peak = (jab_int64)arena->peak;
+        enc->stats.heap_allocs = arena->heap_allocs;
+    }
+    return result;
+}
+
+/**
+ * @brief Generate JABCode
+ * @param enc the encode parameters
+ * @param data the input data
+ * @return 0:success | 1: out of memory | 2:no input data | 3:incorrect symbol version or position | 4: input data too long
+ * @note The encode object can be reused for further codes. enc->bitmap, enc->module_matrix and the symbol buffers
+ * stay valid until the next call of generateJABCode, resetEncode or destroyEncode. With enc->output_mode set to
+ * MODULE_MATRIX_OUTPUT no bitmap is rendered and enc->bitmap is NULL.
+*/
+jab_int32 generateJABCode(jab_encode* enc, jab_data* data)
+{
+    if(data == NULL)
+    {
+        reportError("No input data specified!");
+        return 2;
+    }
+    jab_payload_reader payload = {0};
+    payload.length = data->length;
+    payload.size = data->length;
+    payload.buffer = data->data;
+    return runEncode(enc, &payload);
+}
+
+/**
+ * @brief Generate JABCode from a payload that is read in chunks from a payload source
+ * @param enc the encode parameters
+ * @param source the payload source
+ * @param user_data the user data passed to the payload source
+ * @param length the payload length in bytes
+ * @return 0:success | 1: out of memory | 2:no input data | 3:incorrect symbol version or position | 4: input data too long | 5: reading input data failed
+ * @note The raw payload is never held in memory as a whole, but the memory use is not bounded by the chunk buffer
+ * and one symbol either. The mode analysis needs the whole payload before the first symbol can be laid out, so the
+ * source is read twice, and the encoding modes of all payload bytes and the packed encoded message are kept in
+ * scratch memory, a few bytes per payload byte. The symbols keep no data payload, enc->symbols[i].data is NULL.
+*/
+jab_int32 generateJABCodeFromStream(jab_encode* enc, jab_payload_source source, void* user_data, jab_int32 length)
+{
+    if(source == NULL)
+    {
+        reportError("No input data specified!");
+        return 2;
+    }
+    jab_payload_reader payload = {0};
+    payload.source = source;
+    payload.user_data = user_data;
+    payload.length = length;
+    return runEncode(enc, &payload);
+}
+
 /**
  * @brief Report error message
  * @param message the error message
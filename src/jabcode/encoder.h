@@ -200,6 +200,23 @@ static const jab_int32 latch_shift_to[14][14]=
 */
 static const jab_int32 character_size[7]={5,5,4,4,5,6,8};
 
+#define MODE_HISTORY_ROW	7		//bytes per step in the mode history of the encoding analysis, 4 bits per mode
+#define SWITCH_NONE			0xFF	//no shift back to a mode in the encoding analysis
+#define PAYLOAD_CHUNK_SIZE	4096	//bytes read from a payload source at once
+
+/**
+ * @brief Sequential reader over the payload, held in memory or read from a payload source in chunks
+*/
+typedef struct {
+	jab_payload_source	source;		///< The payload source, NULL if the whole payload is in buffer
+	void*		user_data;			///< The user data passed to the payload source
+	jab_int32	length;				///< The payload length in bytes
+	jab_int32	start;				///< The payload offset of the first buffered byte
+	jab_int32	size;				///< The number of buffered bytes
+	jab_char*	buffer;				///< The buffered bytes
+	jab_boolean	failed;				///< Whether reading from the payload source failed
+}jab_payload_reader;
+
 /**
  * @brief Mode switch message
 */
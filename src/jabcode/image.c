@@ -12,12 +12,18 @@
  */
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include "jabcode.h"
+#include "detector.h"
+#include "arena.h"
 #include "png.h"
 #include "tiffio.h"
 
+#define CMYK_LUT_BITS	8	//the size of the table of converted colors as power of two
+#define CMYK_LUT_SIZE	(1 << CMYK_LUT_BITS)
+
 /**
  * @brief Save code bitmap in RGB as png image
  * @param bitmap the code bitmap
@@ -57,6 +63,446 @@ jab_boolean saveImage(jab_bitmap* bitmap, jab_char* filename)
 	return JAB_SUCCESS;
 }
 
+/**
+ * @brief Growing memory buffer receiving the png stream
+*/
+typedef struct {
+	jab_data*	data;
+	jab_int32	capacity;
+}jab_png_buffer;
+
+/**
+ * @brief Append png data to the memory buffer
+ * @param png the png write structure
+ * @param bytes the data to append
+ * @param length the data length
+*/
+static void writePNGData(png_structp png, png_bytep bytes, png_size_t length)
+{
+	jab_png_buffer* buffer = (jab_png_buffer*)png_get_io_ptr(png);
+	if(buffer->data->length + (jab_int64)length > buffer->capacity)
+	{
+		jab_int64 capacity = MAX((jab_int64)buffer->capacity * 2, buffer->data->length + (jab_int64)length);
+		if(capacity > INT32_MAX - (jab_int64)sizeof(jab_data))
+		{
+			png_error(png, "PNG stream too large");
+		}
+		jab_data* data = (jab_data*)realloc(buffer->data, sizeof(jab_data) + capacity);
+		if(data == NULL)
+		{
+			png_error(png, "Memory allocation for PNG stream failed");
+		}
+		buffer->data = data;
+		buffer->capacity = (jab_int32)capacity;
+	}
+	memcpy(buffer->data->data + buffer->data->length, bytes, length);
+	buffer->data->length += length;
+}
+
+/**
+ * @brief Nothing to flush for memory buffers
+ * @param png the png write structure
+*/
+static void flushPNGData(png_structp png)
+{
+	(void)png;
+}
+
+/**
+ * @brief Get the palette index of an RGBA pixel, adding the pixel color to the palette if it is new
+ * @param color the packed RGBA pixel
+ * @param table the hash table of palette colors, entries hold the index plus one
+ * @param colors the packed palette colors
+ * @param color_number the number of palette colors
+ * @return the palette index | -1 if the palette is full
+*/
+static jab_int32 lookupColor(jab_uint32 color, jab_int16* table, jab_uint32* colors, jab_int32* color_number)
+{
+	jab_uint32 slot = (color * 2654435761u) >> 22;
+	while(table[slot])
+	{
+		if(colors[table[slot] - 1] == color)
+			return table[slot] - 1;
+		slot = (slot + 1) & 1023;
+	}
+	if(*color_number == 256)
+		return -1;
+	colors[*color_number] = color;
+	table[slot] = (jab_int16)(++(*color_number));
+	return *color_number - 1;
+}
+
+/**
+ * @brief Serialize the module layout of a module image in big-endian byte order
+ * @param layout the module layout
+ * @param data the serialized layout of MODULE_IMAGE_CHUNK_SIZE bytes
+*/
+static void writeModuleLayout(jab_module_layout* layout, jab_byte* data)
+{
+	jab_int32 values[MODULE_IMAGE_CHUNK_SIZE / 4] = {layout->module_size, layout->master_position.x, layout->master_position.y,
+													 layout->master_size.x, layout->master_size.y};
+	for(jab_int32 i=0; i<MODULE_IMAGE_CHUNK_SIZE / 4; i++)
+	{
+		png_save_uint_32(data + i*4, (png_uint_32)values[i]);
+	}
+}
+
+/**
+ * @brief Parse the module layout of a module image
+ * @param data the serialized layout of MODULE_IMAGE_CHUNK_SIZE bytes
+ * @param layout the module layout
+*/
+static void readModuleLayout(jab_byte* data, jab_module_layout* layout)
+{
+	layout->module_size 	  = (jab_int32)png_get_uint_32(data);
+	layout->master_position.x = (jab_int32)png_get_uint_32(data + 4);
+	layout->master_position.y = (jab_int32)png_get_uint_32(data + 8);
+	layout->master_size.x 	  = (jab_int32)png_get_uint_32(data + 12);
+	layout->master_size.y 	  = (jab_int32)png_get_uint_32(data + 16);
+}
+
+/**
+ * @brief Check whether a side size is the side size of a symbol version
+ * @param side_size the side size in modules
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+static jab_boolean isSymbolSideSize(jab_int32 side_size)
+{
+	return side_size >= VERSION2SIZE(1) && side_size <= VERSION2SIZE(32) && (side_size - 17) % 4 == 0;
+}
+
+/**
+ * @brief Check the module layout of a module image against the image, as the chunk may come from any png file
+ * @param layout the module layout
+ * @param width the image width, i.e. the number of modules in a row
+ * @param height the image height, i.e. the number of modules in a column
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+static jab_boolean checkModuleLayout(jab_module_layout* layout, jab_int32 width, jab_int32 height)
+{
+	if(layout->module_size < 1)
+		return JAB_FAILURE;
+	if(!isSymbolSideSize(layout->master_size.x) || !isSymbolSideSize(layout->master_size.y))
+		return JAB_FAILURE;
+	//the image has one pixel per module, so the master symbol has to lie inside it in pixels
+	if(layout->master_position.x < 0 || layout->master_position.y < 0 ||
+	   layout->master_position.x > width - layout->master_size.x || layout->master_position.y > height - layout->master_size.y)
+		return JAB_FAILURE;
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Encode pixels as png image in memory
+ * @param pixels the pixels in RGBA or the palette indices
+ * @param width the image width
+ * @param height the image height
+ * @param bytes_per_pixel 4 for RGBA pixels, 1 for palette indices
+ * @param palette the RGB palette of the indices, NULL for RGBA pixels
+ * @param color_number the number of palette colors
+ * @param compression_level the zlib compression level from 0 to 9, -1 for the default level
+ * @param filter the row filter
+ * @param chunk the ancillary chunk to write before the image data, NULL if none
+ * @return the png stream | NULL if failed
+*/
+static jab_data* encodePNG(jab_byte* pixels, jab_int32 width, jab_int32 height, jab_int32 bytes_per_pixel, jab_byte* palette, jab_int32 color_number,
+						   jab_int32 compression_level, jab_int32 filter, png_unknown_chunk* chunk)
+{
+	if((palette == NULL && bytes_per_pixel != 4) || (palette != NULL && (bytes_per_pixel != 1 || color_number < 1 || color_number > 256)))
+	{
+		reportError("Unsupported bitmap format for PNG encoding");
+		return NULL;
+	}
+
+	//map the pixels to output palette indices
+	png_color plte[256];
+	png_byte trns[256];
+	jab_int32 plte_number = 0;
+	jab_int32 trns_number = 0;
+	jab_byte* index = NULL;		//the palette index of every pixel, for RGBA bitmaps only
+	jab_byte map[256];			//the output index of every bitmap index, for indexed bitmaps only
+	if(palette)
+	{
+		for(jab_int32 i=0; i<color_number; i++)
+		{
+			plte[i].red   = palette[i*3];
+			plte[i].green = palette[i*3 + 1];
+			plte[i].blue  = palette[i*3 + 2];
+			map[i] = (jab_byte)i;
+		}
+		plte_number = color_number;
+		//all indices beyond the palette share one transparent entry
+		jab_boolean uncovered = 0;
+		if(color_number < 256)
+		{
+			for(jab_int32 i=0; i<width*height; i++)
+				uncovered |= (pixels[i] >= color_number);
+		}
+		if(uncovered)
+		{
+			memset(&plte[color_number], 0, sizeof(png_color));
+			memset(trns, 255, color_number);
+			trns[color_number] = 0;
+			trns_number = color_number + 1;
+			plte_number++;
+			for(jab_int32 i=color_number; i<256; i++)
+				map[i] = (jab_byte)color_number;
+		}
+	}
+	else
+	{
+		index = (jab_byte*)malloc(width * height * sizeof(jab_byte));
+		if(index == NULL)
+		{
+			reportError("Memory allocation for palette indices failed");
+			return NULL;
+		}
+		jab_int16 table[1024];
+		jab_uint32 colors[256];
+		memset(table, 0, sizeof(table));
+		jab_uint32* pixel = (jab_uint32*)pixels;
+		jab_uint32 last_color = 0;
+		jab_int32 last_index = -1;
+		for(jab_int32 i=0; i<width*height; i++)
+		{
+			if(last_index < 0 || pixel[i] != last_color)
+			{
+				last_color = pixel[i];
+				last_index = lookupColor(last_color, table, colors, &plte_number);
+				if(last_index < 0)
+					break;
+			}
+			index[i] = (jab_byte)last_index;
+		}
+		if(last_index < 0)
+		{
+			//too many colors for a palette
+			free(index);
+			index = NULL;
+			plte_number = 0;
+		}
+		for(jab_int32 i=0; i<plte_number; i++)
+		{
+			jab_byte* rgba = (jab_byte*)&colors[i];
+			plte[i].red   = rgba[0];
+			plte[i].green = rgba[1];
+			plte[i].blue  = rgba[2];
+			trns[i] = rgba[3];
+			if(rgba[3] != 255)
+				trns_number = i + 1;
+		}
+	}
+	jab_int32 bit_depth = 8;
+	if(plte_number > 0)
+	{
+		if	   (plte_number <= 2)  bit_depth = 1;
+		else if(plte_number <= 4)  bit_depth = 2;
+		else if(plte_number <= 16) bit_depth = 4;
+	}
+	jab_int32 pixels_per_byte = 8 / bit_depth;
+	jab_int32 row_size = plte_number > 0 ? (width + pixels_per_byte - 1) / pixels_per_byte : width * 4;
+
+	jab_png_buffer buffer;
+	buffer.capacity = MAX(row_size * height / 16, 1024);
+	buffer.data = (jab_data*)malloc(sizeof(jab_data) + buffer.capacity);
+	jab_byte* row = (jab_byte*)malloc(row_size);
+	png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	png_infop info = png ? png_create_info_struct(png) : NULL;
+	if(buffer.data == NULL || row == NULL || info == NULL)
+	{
+		png_destroy_write_struct(&png, &info);
+		free(buffer.data);
+		free(row);
+		free(index);
+		reportError("Memory allocation for PNG encoding failed");
+		return NULL;
+	}
+	buffer.data->length = 0;
+	if(setjmp(png_jmpbuf(png)))
+	{
+		png_destroy_write_struct(&png, &info);
+		free(buffer.data);
+		free(row);
+		free(index);
+		reportError("Encoding png image failed");
+		return NULL;
+	}
+	png_set_write_fn(png, &buffer, writePNGData, flushPNGData);
+	if(compression_level >= 0)
+		png_set_compression_level(png, MIN(compression_level, 9));
+	switch(filter)
+	{
+	case ROW_FILTER_NONE:	 png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_NONE);	break;
+	case ROW_FILTER_SUB:	 png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_SUB);		break;
+	case ROW_FILTER_UP:		 png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_UP);		break;
+	case ROW_FILTER_AVERAGE: png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_AVG);		break;
+	case ROW_FILTER_PAETH:	 png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_PAETH);	break;
+	case ROW_FILTER_ADAPTIVE:png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_ALL_FILTERS);	break;
+	}
+	if(plte_number > 0)
+	{
+		png_set_IHDR(png, info, width, height, bit_depth, PNG_COLOR_TYPE_PALETTE,
+					 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+		png_set_PLTE(png, info, plte, plte_number);
+		if(trns_number > 0)
+			png_set_tRNS(png, info, trns, trns_number, NULL);
+	}
+	else
+	{
+		png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_RGB_ALPHA,
+					 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	}
+	if(chunk)
+	{
+		png_set_keep_unknown_chunks(png, PNG_HANDLE_CHUNK_ALWAYS, chunk->name, 1);
+		png_set_unknown_chunks(png, info, chunk, 1);
+	}
+	png_write_info(png, info);
+
+	//pack the palette indices of each row to the bit depth. Rows repeat for module sizes above one,
+	//so a row equal to the previous one is written again without packing.
+	for(jab_int32 y=0; y<height; y++)
+	{
+		png_bytep out = row;
+		if(plte_number == 0)
+		{
+			out = pixels + y * width * 4;
+		}
+		else
+		{
+			jab_byte* src = index ? index + y * width : pixels + y * width;
+			if(y == 0 || memcmp(src, src - width, width) != 0)
+			{
+				for(jab_int32 x=0, i=0; x<width; i++)
+				{
+					jab_int32 v = 0;
+					for(jab_int32 k=0; k<pixels_per_byte; k++, x++)
+					{
+						v = (v << bit_depth) | (x < width ? (index ? src[x] : map[src[x]]) : 0);
+					}
+					row[i] = (jab_byte)v;
+				}
+			}
+		}
+		png_write_row(png, out);
+	}
+	png_write_end(png, info);
+	png_destroy_write_struct(&png, &info);
+	free(row);
+	free(index);
+	return buffer.data;
+}
+
+/**
+ * @brief Encode code bitmap as palette-indexed png image in memory. Code bitmaps have few colors and long runs
+ * of identical pixels, so the palette image with bit depth reduced to the color number is much smaller and
+ * faster to compress than the RGBA image written by saveImage.
+ * @param bitmap the code bitmap, either in RGBA or with palette indices as created with INDEXED_BITMAP_OUTPUT
+ * @param palette the RGB palette of an indexed bitmap, NULL for RGBA bitmaps whose palette is collected from the pixels.
+ *				  Indices not covered by the palette, like EMPTY_MODULE, become transparent.
+ * @param color_number the number of palette colors
+ * @param compression_level the zlib compression level from 0 to 9, -1 for the default level
+ * @param filter the row filter ROW_FILTER_NONE to ROW_FILTER_ADAPTIVE, ROW_FILTER_DEFAULT for the libpng choice which
+ *				 is no filter for palette images. Filters rarely pay off on code bitmaps.
+ * @return the png stream | NULL if failed. RGBA bitmaps with more than 256 colors are stored as RGBA image.
+*/
+jab_data* saveImageToMemory(jab_bitmap* bitmap, jab_byte* palette, jab_int32 color_number, jab_int32 compression_level, jab_int32 filter)
+{
+	return encodePNG(bitmap->pixel, bitmap->width, bitmap->height, bitmap->bits_per_pixel / 8, palette, color_number, compression_level, filter, NULL);
+}
+
+/**
+ * @brief Encode the module matrix of a code as png image in memory with one pixel per module. The module size and
+ * the position of the master symbol are recorded in a MODULE_IMAGE_CHUNK chunk, so that decodeJABCodeFromFile
+ * decodes the image without detecting and sampling the symbols. The image is a fraction of the size of the rendered
+ * code and suits archiving and round-trip tests.
+ * @param matrix the module matrix
+ * @param compression_level the zlib compression level from 0 to 9, -1 for the default level
+ * @param filter the row filter ROW_FILTER_NONE to ROW_FILTER_ADAPTIVE, ROW_FILTER_DEFAULT for the libpng choice
+ * @return the png stream | NULL if failed
+*/
+jab_data* saveModuleImageToMemory(jab_module_matrix* matrix, jab_int32 compression_level, jab_int32 filter)
+{
+	jab_module_layout layout;
+	layout.module_size = matrix->module_size;
+	layout.master_position = matrix->master_position;
+	layout.master_size = matrix->master_size;
+	jab_byte layout_data[MODULE_IMAGE_CHUNK_SIZE];
+	writeModuleLayout(&layout, layout_data);
+
+	png_unknown_chunk chunk;
+	memset(&chunk, 0, sizeof(chunk));
+	memcpy(chunk.name, MODULE_IMAGE_CHUNK, 5);
+	chunk.data = layout_data;
+	chunk.size = MODULE_IMAGE_CHUNK_SIZE;
+	chunk.location = PNG_HAVE_IHDR;
+	return encodePNG(matrix->module, matrix->width, matrix->height, 1, matrix->palette, matrix->color_number, compression_level, filter, &chunk);
+}
+
+/**
+ * @brief Convert a color from RGB to CMYK color space
+ * @param rgb the RGB values
+ * @param cmyk the CMYK values
+*/
+void convertColorRGB2CMYK(jab_byte* rgb, jab_byte* cmyk)
+{
+	jab_double r1 = (jab_double)rgb[0] / 255.0;
+	jab_double g1 = (jab_double)rgb[1] / 255.0;
+	jab_double b1 = (jab_double)rgb[2] / 255.0;
+
+	jab_double k = 1 - MAX(r1, MAX(g1, b1));
+
+	if(k == 1)
+	{
+		cmyk[0] = 0;	//C
+		cmyk[1] = 0;	//M
+		cmyk[2] = 0;	//Y
+		cmyk[3] = 255;	//K
+	}
+	else
+	{
+		cmyk[0] = (jab_byte)((1.0 - r1 - k) / (1.0 - k) * 255);	//C
+		cmyk[1] = (jab_byte)((1.0 - g1 - k) / (1.0 - k) * 255);	//M
+		cmyk[2] = (jab_byte)((1.0 - b1 - k) / (1.0 - k) * 255);	//Y
+		cmyk[3] = (jab_byte)(k * 255);								//K
+	}
+}
+
+/**
+ * @brief Convert a pixel row from RGB to CMYK color space. A code has only a few colors, so each color is converted
+ * once and looked up in a direct-mapped table of the converted colors afterwards.
+ * @param rgb the pixel row in RGB
+ * @param bytes_per_pixel the number of bytes per pixel in the RGB row
+ * @param width the number of pixels in the row
+ * @param cmyk the pixel row in CMYK
+ * @param lut the table of converted colors, keys and CMYK values of CMYK_LUT_SIZE entries each
+*/
+static void convertRowRGB2CMYK(jab_byte* rgb, jab_int32 bytes_per_pixel, jab_int32 width, jab_byte* cmyk, jab_uint32* lut)
+{
+	jab_uint32* lut_key = lut;
+	jab_uint32* lut_value = lut + CMYK_LUT_SIZE;
+	jab_uint32 last_key = 0;
+	jab_uint32 last_value = 0;
+	for(jab_int32 x=0; x<width; x++)
+	{
+		//the key is never 0, which marks empty table entries
+		jab_uint32 key = 0x01000000u | ((jab_uint32)rgb[0] << 16) | ((jab_uint32)rgb[1] << 8) | rgb[2];
+		if(key != last_key)
+		{
+			jab_uint32 slot = (key * 2654435761u) >> (32 - CMYK_LUT_BITS);
+			if(lut_key[slot] != key)
+			{
+				convertColorRGB2CMYK(rgb, (jab_byte*)&lut_value[slot]);
+				lut_key[slot] = key;
+			}
+			last_key = key;
+			last_value = lut_value[slot];
+		}
+		memcpy(cmyk, &last_value, 4);
+		rgb += bytes_per_pixel;
+		cmyk += 4;
+	}
+}
+
 /**
  * @brief Convert a bitmap from RGB to CMYK color space
  * @param bitmap the bitmap in RGB
@@ -84,36 +530,12 @@ jab_bitmap* convertRGB2CMYK(jab_bitmap* rgb)
     cmyk->channel_count = BITMAP_CHANNEL_COUNT;
 
 	jab_int32 rgb_bytes_per_pixel = rgb->bits_per_pixel / 8;
-    jab_int32 rgb_bytes_per_row = rgb->width * rgb_bytes_per_pixel;
-    jab_int32 cmyk_bytes_per_pixel = rgb->bits_per_pixel / 8;
-    jab_int32 cmyk_bytes_per_row = rgb->width * cmyk_bytes_per_pixel;
-
-
+    jab_int32 rgb_bytes_per_row = w * rgb_bytes_per_pixel;
+    jab_int32 cmyk_bytes_per_row = w * BITMAP_CHANNEL_COUNT;
+    jab_uint32 lut[CMYK_LUT_SIZE * 2] = {0};
     for(jab_int32 i=0; i<h; i++)
 	{
-		for(jab_int32 j=0; j<w; j++)
-		{
-			jab_double r1 = (jab_double)rgb->pixel[i*rgb_bytes_per_row + j*rgb_bytes_per_pixel + 0] / 255.0;
-			jab_double g1 = (jab_double)rgb->pixel[i*rgb_bytes_per_row + j*rgb_bytes_per_pixel + 1] / 255.0;
-			jab_double b1 = (jab_double)rgb->pixel[i*rgb_bytes_per_row + j*rgb_bytes_per_pixel + 2] / 255.0;
-
-			jab_double k = 1 - MAX(r1, MAX(g1, b1));
-
-			if(k == 1)
-			{
-				cmyk->pixel[i*cmyk_bytes_per_row + j*cmyk_bytes_per_pixel + 0] = 0;	//C
-				cmyk->pixel[i*cmyk_bytes_per_row + j*cmyk_bytes_per_pixel + 1] = 0;	//M
-				cmyk->pixel[i*cmyk_bytes_per_row + j*cmyk_bytes_per_pixel + 2] = 0;	//Y
-				cmyk->pixel[i*cmyk_bytes_per_row + j*cmyk_bytes_per_pixel + 3] = 255;	//K
-			}
-			else
-			{
-				cmyk->pixel[i*cmyk_bytes_per_row + j*cmyk_bytes_per_pixel + 0] = (jab_byte)((1.0 - r1 - k) / (1.0 - k) * 255);	//C
-				cmyk->pixel[i*cmyk_bytes_per_row + j*cmyk_bytes_per_pixel + 1] = (jab_byte)((1.0 - g1 - k) / (1.0 - k) * 255);	//M
-				cmyk->pixel[i*cmyk_bytes_per_row + j*cmyk_bytes_per_pixel + 2] = (jab_byte)((1.0 - b1 - k) / (1.0 - k) * 255);	//Y
-				cmyk->pixel[i*cmyk_bytes_per_row + j*cmyk_bytes_per_pixel + 3] = (jab_byte)(k * 255);								//K
-			}
-		}
+		convertRowRGB2CMYK(rgb->pixel + i*rgb_bytes_per_row, rgb_bytes_per_pixel, w, cmyk->pixel + i*cmyk_bytes_per_row, lut);
 	}
     return cmyk;
 }
@@ -127,20 +549,35 @@ jab_bitmap* convertRGB2CMYK(jab_bitmap* rgb)
 */
 jab_boolean saveImageCMYK(jab_bitmap* bitmap, jab_boolean isCMYK, jab_char* filename)
 {
-	jab_bitmap* cmyk = 0;
+	return saveImageCMYKEx(bitmap, isCMYK, TIFF_COMPRESSION_NONE, filename);
+}
 
-	if(isCMYK)
+/**
+ * @brief Save code bitmap in CMYK as TIFF image with compression. The image is written strip by strip. An RGB bitmap
+ * is converted to CMYK one strip at a time, so no CMYK copy of the whole bitmap is made.
+ * @param bitmap the code bitmap
+ * @param isCMYK set TRUE if the code bitmap is already in CMYK
+ * @param compression TIFF_COMPRESSION_NONE | TIFF_COMPRESSION_LZW | TIFF_COMPRESSION_DEFLATE | TIFF_COMPRESSION_PACKBITS
+ * @param filename the image filename
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+jab_boolean saveImageCMYKEx(jab_bitmap* bitmap, jab_boolean isCMYK, jab_int32 compression, jab_char* filename)
+{
+	if(!isCMYK && bitmap->channel_count < 3)
 	{
-		cmyk = bitmap;
+		JAB_REPORT_ERROR(("Not true color RGB bitmap"))
+        return JAB_FAILURE;
 	}
-	else
+	jab_int32 tiff_compression;
+	switch(compression)
 	{
-		cmyk = convertRGB2CMYK(bitmap);
-		if(cmyk == NULL)
-		{
-			JAB_REPORT_ERROR(("Converting RGB to CMYK failed"))
-			return JAB_FAILURE;
-		}
+	case TIFF_COMPRESSION_NONE:		tiff_compression = COMPRESSION_NONE;			break;
+	case TIFF_COMPRESSION_LZW:		tiff_compression = COMPRESSION_LZW;				break;
+	case TIFF_COMPRESSION_DEFLATE:	tiff_compression = COMPRESSION_ADOBE_DEFLATE;	break;
+	case TIFF_COMPRESSION_PACKBITS:	tiff_compression = COMPRESSION_PACKBITS;		break;
+	default:
+		JAB_REPORT_ERROR(("Unsupported TIFF compression %d", compression))
+		return JAB_FAILURE;
 	}
 
 	//save CMYK image as TIFF
@@ -148,26 +585,57 @@ jab_boolean saveImageCMYK(jab_bitmap* bitmap, jab_boolean isCMYK, jab_char* file
 	if(out == NULL)
 	{
 		JAB_REPORT_ERROR(("Cannot open %s for writing", filename))
-		if(!isCMYK)	free(cmyk);
 		return JAB_FAILURE;
 	}
 
-	TIFFSetField(out, TIFFTAG_IMAGEWIDTH, cmyk->width);
-	TIFFSetField(out, TIFFTAG_IMAGELENGTH, cmyk->height);
-	TIFFSetField(out, TIFFTAG_SAMPLESPERPIXEL, cmyk->channel_count);
-	TIFFSetField(out, TIFFTAG_BITSPERSAMPLE, cmyk->bits_per_channel);
+	TIFFSetField(out, TIFFTAG_IMAGEWIDTH, bitmap->width);
+	TIFFSetField(out, TIFFTAG_IMAGELENGTH, bitmap->height);
+	TIFFSetField(out, TIFFTAG_SAMPLESPERPIXEL, BITMAP_CHANNEL_COUNT);
+	TIFFSetField(out, TIFFTAG_BITSPERSAMPLE, BITMAP_BITS_PER_CHANNEL);
 	TIFFSetField(out, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
 	TIFFSetField(out, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
 	TIFFSetField(out, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_SEPARATED);
+	if(tiff_compression != COMPRESSION_NONE && !TIFFSetField(out, TIFFTAG_COMPRESSION, tiff_compression))
+	{
+		JAB_REPORT_ERROR(("TIFF compression %d not available", compression))
+		TIFFClose(out);
+		return JAB_FAILURE;
+	}
+	//the horizontal differences of module runs are zero, which LZW and Deflate compress well
+	if(tiff_compression == COMPRESSION_LZW || tiff_compression == COMPRESSION_ADOBE_DEFLATE)
+		TIFFSetField(out, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
 	jab_int32 rows_per_strip = TIFFDefaultStripSize(out, -1);
 	TIFFSetField(out, TIFFTAG_ROWSPERSTRIP, rows_per_strip);
 
-	//write image to the file one scanline at a time
-	jab_int32 row_size = cmyk->width * cmyk->channel_count;
+	//write image to the file one strip at a time
+	jab_int32 row_size = bitmap->width * BITMAP_CHANNEL_COUNT;
+	jab_int32 bytes_per_pixel = bitmap->bits_per_pixel / 8;
+	jab_byte* strip = (jab_byte*)malloc(rows_per_strip * row_size);
+	if(strip == NULL)
+	{
+		reportError("Memory allocation for TIFF strip failed");
+		TIFFClose(out);
+		return JAB_FAILURE;
+	}
+	jab_uint32 lut[CMYK_LUT_SIZE * 2] = {0};
 	jab_boolean status = JAB_SUCCESS;
-	for(jab_int32 row=0; row<cmyk->height; row++)
+	for(jab_int32 row=0, s=0; row<bitmap->height; row+=rows_per_strip, s++)
 	{
-		if(TIFFWriteScanline(out, &cmyk->pixel[row * row_size], row, 0) < 0)
+		jab_int32 rows = MIN(rows_per_strip, bitmap->height - row);
+		//the codec may modify the data, so it is always passed in the strip buffer
+		if(isCMYK)
+		{
+			memcpy(strip, bitmap->pixel + row * row_size, rows * row_size);
+		}
+		else
+		{
+			for(jab_int32 i=0; i<rows; i++)
+			{
+				convertRowRGB2CMYK(bitmap->pixel + (row + i) * bitmap->width * bytes_per_pixel, bytes_per_pixel, bitmap->width,
+								   strip + i * row_size, lut);
+			}
+		}
+		if(TIFFWriteEncodedStrip(out, s, strip, rows * row_size) < 0)
 		{
 			status = JAB_FAILURE;
 			break;
@@ -175,7 +643,7 @@ jab_boolean saveImageCMYK(jab_bitmap* bitmap, jab_boolean isCMYK, jab_char* file
 	}
 
 	TIFFClose(out);
-	if(!isCMYK)	free(cmyk);
+	free(strip);
 	return status;
 }
 
@@ -229,3 +697,103 @@ jab_bitmap* readImage(jab_char* filename)
 	}
 	return bitmap;
 }
+
+/**
+ * @brief Read png image row by row into an RGB frame for decoding and collect the frame statistics on the way.
+ * The whole image is expanded into the frame: the module sampler needs the colors, and the rows can only be balanced
+ * and binarized once the statistics of the whole image are known.
+ * @param filename the image filename
+ * @param stats the frame statistics
+ * @param layout the module layout if the image is a module image written by saveModuleImageToMemory,
+ *				 otherwise its module size is set to 0
+ * @return the RGB frame allocated from scratch memory | NULL if failed
+*/
+jab_bitmap* readImageFrame(jab_char* filename, jab_frame_stats* stats, jab_module_layout* layout)
+{
+	FILE* fp = fopen(filename, "rb");
+	if(fp == NULL)
+	{
+		JAB_REPORT_ERROR(("Cannot open %s for reading", filename))
+		return NULL;
+	}
+	png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	png_infop info = png ? png_create_info_struct(png) : NULL;
+	if(info == NULL)
+	{
+		png_destroy_read_struct(&png, NULL, NULL);
+		fclose(fp);
+		reportError("Memory allocation failed");
+		return NULL;
+	}
+	jab_bitmap* volatile frame = NULL;
+	if(setjmp(png_jmpbuf(png)))
+	{
+		png_destroy_read_struct(&png, &info, NULL);
+		fclose(fp);
+		scratchFree(frame);
+		reportError("Reading png image failed");
+		return NULL;
+	}
+	png_init_io(png, fp);
+	png_set_keep_unknown_chunks(png, PNG_HANDLE_CHUNK_ALWAYS, (png_const_bytep)MODULE_IMAGE_CHUNK, 1);
+	png_read_info(png, info);
+
+	layout->module_size = 0;
+	png_unknown_chunkp chunks;
+	jab_int32 chunk_number = png_get_unknown_chunks(png, info, &chunks);
+	for(jab_int32 i=0; i<chunk_number; i++)
+	{
+		if(memcmp(chunks[i].name, MODULE_IMAGE_CHUNK, 4) == 0 && chunks[i].size == MODULE_IMAGE_CHUNK_SIZE)
+			readModuleLayout(chunks[i].data, layout);
+	}
+
+	//convert to 8-bit RGB with the same gamma handling as readImage. The alpha channel is not used for decoding.
+	png_set_expand(png);
+	png_set_scale_16(png);
+	png_set_gray_to_rgb(png);
+	png_set_alpha_mode(png, PNG_ALPHA_PNG, PNG_DEFAULT_sRGB);
+	png_set_strip_alpha(png);
+	jab_int32 passes = png_set_interlace_handling(png);
+	png_read_update_info(png, info);
+
+	jab_int32 width = png_get_image_width(png, info);
+	jab_int32 height= png_get_image_height(png, info);
+	jab_int32 bytes_per_row = width * 3;
+	if(png_get_rowbytes(png, info) != (png_size_t)bytes_per_row)
+	{
+		png_error(png, "Unexpected row size");
+	}
+	if(layout->module_size != 0 && !checkModuleLayout(layout, width, height))
+	{
+		//decode it as a normal image
+		reportError("Invalid module image layout, detecting the code instead");
+		layout->module_size = 0;
+	}
+	frame = (jab_bitmap*)scratchMalloc(sizeof(jab_bitmap) + bytes_per_row*height*sizeof(jab_byte));
+	if(frame == NULL)
+	{
+		png_error(png, "Memory allocation for frame failed");
+	}
+	frame->width = width;
+	frame->height= height;
+	frame->bits_per_channel = BITMAP_BITS_PER_CHANNEL;
+	frame->bits_per_pixel = BITMAP_BITS_PER_CHANNEL * 3;
+	frame->channel_count = 3;
+
+	//rows are final in the last pass of interlaced images
+	initFrameStats(stats, width, height);
+	for(jab_int32 pass=0; pass<passes; pass++)
+	{
+		for(jab_int32 y=0; y<height; y++)
+		{
+			jab_byte* row = frame->pixel + y*bytes_per_row;
+			png_read_row(png, row, NULL);
+			if(pass == passes-1)
+				addFrameRow(stats, row, 3, y);
+		}
+	}
+	png_read_end(png, NULL);
+	png_destroy_read_struct(&png, &info, NULL);
+	fclose(fp);
+	return frame;
+}
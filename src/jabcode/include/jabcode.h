@@ -46,6 +46,61 @@
 #define NORMAL_DECODE		0
 #define COMPATIBLE_DECODE	1
 
+#define LDPC_HARD_DECISION		0	//correct the detected bits by bit flipping
+#define LDPC_SOFT_DECISION		1	//correct the detected bits by belief propagation
+#define LDPC_HARD_THEN_SOFT		2	//use belief propagation on the code blocks bit flipping could not correct
+#define LDPC_DEFAULT_MAX_ITER	25	//default maximal number of LDPC decoding iterations per code block
+
+#define DECODE_STAGE_BALANCE		0	//computing the color stretch from the frame histograms
+#define DECODE_STAGE_BINARIZE		1	//stretching and binarizing the pixels
+#define DECODE_STAGE_FILTER			2	//filtering the binarized channels
+#define DECODE_STAGE_FINDER			3	//searching the finder patterns of master and slave symbols
+#define DECODE_STAGE_RETRY_BINARIZE	4	//binarizing again with the colors around the found finder patterns
+#define DECODE_STAGE_SAMPLING		5	//sampling the symbol modules
+#define DECODE_STAGE_PALETTE		6	//reading the color palettes
+#define DECODE_STAGE_METADATA		7	//decoding the metadata of master and slave symbols
+#define DECODE_STAGE_MODULE_READ	8	//reading the data modules into bits
+#define DECODE_STAGE_DEMASK			9	//removing the data mask
+#define DECODE_STAGE_DEINTERLEAVE	10	//deinterleaving the data bits
+#define DECODE_STAGE_LDPC			11	//LDPC decoding of the data bits
+#define DECODE_STAGE_DATA			12	//interpreting the decoded bits
+#define DECODE_STAGE_NUMBER			13
+
+#define ENCODE_STAGE_ANALYZE		0	//choosing the encoding modes of the input data
+#define ENCODE_STAGE_ENCODE			1	//encoding the input data into bits
+#define ENCODE_STAGE_FIT			2	//choosing the master symbol version and dividing the bits among the symbols
+#define ENCODE_STAGE_LDPC			3	//LDPC encoding of the symbol data
+#define ENCODE_STAGE_INTERLEAVE		4	//interleaving the encoded symbol data
+#define ENCODE_STAGE_MATRIX			5	//placing the symbol modules
+#define ENCODE_STAGE_MASK			6	//evaluating the mask patterns and masking the symbols
+#define ENCODE_STAGE_BITMAP			7	//creating the module matrix and rendering the bitmap
+#define ENCODE_STAGE_NUMBER			8
+
+#define BITMAP_OUTPUT			0	//render the code into an RGBA bitmap
+#define MODULE_MATRIX_OUTPUT	1	//stop after masking and only provide the module matrix
+#define INDEXED_BITMAP_OUTPUT	2	//render the code into an 8-bit bitmap of palette indices
+
+#define EMPTY_MODULE		0xFF	//module matrix entry for the code area not covered by any symbol
+
+#define ROW_FILTER_DEFAULT	-1	//png row filter chosen by libpng
+#define ROW_FILTER_NONE		0
+#define ROW_FILTER_SUB		1
+#define ROW_FILTER_UP		2
+#define ROW_FILTER_AVERAGE	3
+#define ROW_FILTER_PAETH	4
+#define ROW_FILTER_ADAPTIVE	5	//png row filter chosen per row
+
+#define TIFF_COMPRESSION_NONE		0
+#define TIFF_COMPRESSION_LZW		1
+#define TIFF_COMPRESSION_DEFLATE	2
+#define TIFF_COMPRESSION_PACKBITS	3
+
+#define PIXEL_FORMAT_RGBA	0	//4 bytes per pixel in order R, G, B, A
+#define PIXEL_FORMAT_BGRA	1	//4 bytes per pixel in order B, G, R, A
+#define PIXEL_FORMAT_RGB24	2	//3 bytes per pixel in order R, G, B
+#define PIXEL_FORMAT_BGR24	3	//3 bytes per pixel in order B, G, R
+#define PIXEL_FORMAT_NV12	4	//8-bit Y plane followed by an interleaved U, V plane subsampled by 2 in both directions
+
 #define VERSION2SIZE(x)		(x * 4 + 17)
 #define SIZE2VERSION(x)		((x - 17) / 4)
 #define MAX(a,b) 			({__typeof__ (a) _a = (a); __typeof__ (b) _b = (b); _a > _b ? _a : _b;})
@@ -102,6 +157,34 @@ typedef struct {
    jab_byte		pixel[];
 }jab_bitmap;
 
+/**
+ * @brief Caller-owned pixel buffer. decodeJABCodeFromBuffer does not decode it in place but converts it into an RGB
+ * frame of its own, the buffer is only read.
+*/
+typedef struct {
+	jab_int32	width;			///< The image width in pixels
+	jab_int32	height;			///< The image height in pixels
+	jab_int32	format;			///< PIXEL_FORMAT_RGBA | PIXEL_FORMAT_BGRA | PIXEL_FORMAT_RGB24 | PIXEL_FORMAT_BGR24 | PIXEL_FORMAT_NV12
+	jab_int32	stride;			///< The number of bytes from one row of pixel to the next
+	jab_byte*	pixel;			///< The pixels, or the Y plane for PIXEL_FORMAT_NV12
+	jab_int32	chroma_stride;	///< The number of bytes from one row of chroma to the next, PIXEL_FORMAT_NV12 only
+	jab_byte*	chroma;			///< The interleaved U, V plane, PIXEL_FORMAT_NV12 only
+}jab_pixel_buffer;
+
+/**
+ * @brief Code module matrix
+*/
+typedef struct {
+	jab_int32	width;			///< The code width in modules
+	jab_int32	height;			///< The code height in modules
+	jab_int32	color_number;	///< The number of palette colors
+	jab_int32	module_size;	///< The module size in pixels the code is rendered with
+	jab_vector2d	master_position;	///< The module coordinates of the upper left corner of the master symbol
+	jab_vector2d	master_size;	///< The side sizes of the master symbol in modules
+	jab_byte*	palette;		///< The module colors in format RGB
+	jab_byte	module[];		///< The palette index of each module row by row, EMPTY_MODULE outside of symbols
+}jab_module_matrix;
+
 /**
  * @brief Symbol parameters
 */
@@ -111,12 +194,30 @@ typedef struct {
 	jab_int32		host;
 	jab_int32		slaves[4];
 	jab_int32 		wcwr[2];
-	jab_data*		data;
+	jab_data*		data;					///< The data payload of the symbol before LDPC encoding, NULL after generateJABCodeFromStream
 	jab_byte*		data_map;
 	jab_data*		metadata;
 	jab_byte*		matrix;
+	jab_int32		data_capacity;			///< Allocated bytes of data, kept for the next code
+	jab_int32		metadata_capacity;		///< Allocated bytes of metadata, kept for the next code
+	jab_int32		matrix_capacity;		///< Allocated bytes of matrix and data_map each, kept for the next code
 }jab_symbol;
 
+/**
+ * @brief Timers and counters of an encode
+*/
+typedef struct {
+	jab_int64	total_time;							///< The time of the whole encode in nanoseconds
+	jab_int64	stage_time[ENCODE_STAGE_NUMBER];	///< The time spent in each stage in nanoseconds
+	jab_int32	stage_count[ENCODE_STAGE_NUMBER];	///< The number of times each stage ran
+	jab_int32	stage_allocs[ENCODE_STAGE_NUMBER];	///< The number of scratch allocations of each stage
+	jab_int64	stage_alloc_bytes[ENCODE_STAGE_NUMBER];	///< The scratch bytes allocated by each stage
+	jab_int64	scratch_peak;						///< The maximal scratch memory in use in bytes
+	jab_int32	heap_allocs;						///< The number of times the scratch memory had to grow
+	jab_int32	mask_type;							///< The chosen mask pattern
+	jab_int32	mask_penalty[NUMBER_OF_MASK_PATTERNS];	///< The penalty score of each mask pattern, -1 if not evaluated
+}jab_encode_stats;
+
 /**
  * @brief Encode parameters
 */
@@ -131,7 +232,15 @@ typedef struct {
 	jab_byte* 		symbol_ecc_levels;
 	jab_int32*		symbol_positions;
 	jab_symbol*		symbols;				///< Pointer to internal representation of JAB Code symbols
+	jab_int32		output_mode;			///< BITMAP_OUTPUT | MODULE_MATRIX_OUTPUT | INDEXED_BITMAP_OUTPUT
 	jab_bitmap*		bitmap;
+	jab_module_matrix*	module_matrix;		///< The palette-indexed modules of the whole code
+	jab_int32		module_matrix_capacity;	///< Allocated bytes of module_matrix, kept for the next code
+	jab_int32		bitmap_capacity;		///< Allocated bytes of bitmap, kept for the next code
+	jab_boolean		auto_master_version;	///< Whether the master symbol version was chosen by the encoder
+	void*			scratch;				///< Scratch memory arena for intermediate buffers, internal
+	jab_boolean		record_stats;			///< Whether the next codes record their timers and counters in stats
+	jab_encode_stats	stats;				///< The timers and counters of the last code if record_stats is set
 }jab_encode;
 
 /**
@@ -146,6 +255,20 @@ typedef struct {
 	jab_vector2d ecl;
 }jab_metadata;
 
+/**
+ * @brief LDPC decoding statistics of a symbol, summed up over its code blocks
+*/
+typedef struct {
+	jab_int32	blocks;					///< The number of code blocks
+	jab_int32	soft_blocks;			///< The number of code blocks decoded by belief propagation
+	jab_int32	iterations;				///< The number of decoding iterations
+	jab_int32	max_block_iterations;	///< The largest number of decoding iterations of one code block
+	jab_int32	corrected_bits;			///< The number of bits changed by the decoders
+	jab_int32	syndrome_before;		///< The number of unsatisfied parity checks before decoding
+	jab_int32	syndrome_after;			///< The number of unsatisfied parity checks after decoding
+	jab_int64	time;					///< The decoding time in nanoseconds, including the parity check matrix setup
+}jab_ldpc_stats;
+
 /**
  * @brief Decoded symbol
 */
@@ -160,16 +283,77 @@ typedef struct {
 	jab_metadata slave_metadata[4];
 	jab_byte* palette;
 	jab_data* data;
+	jab_ldpc_stats ldpc;	///< The LDPC decoding statistics of the symbol data
 }jab_decoded_symbol;
 
+/**
+ * @brief Payload source of a streamed encode. The payload is read twice from the start, each time in ascending
+ * order, and must stay the same in between.
+ * @param user_data the user data given to generateJABCodeFromStream
+ * @param offset the offset of the first byte to read
+ * @param buffer the buffer to read the bytes into
+ * @param size the number of bytes requested
+ * @return the number of bytes read, at least 1 | 0 or negative if failed
+*/
+typedef jab_int32 (*jab_payload_source)(void* user_data, jab_int32 offset, jab_char* buffer, jab_int32 size);
+
+/**
+ * @brief Receiver of the payload of a decode in pieces. It is called after each symbol in cascade order with the
+ * bytes that became decodable with the data of that symbol, so the payload can be processed while the remaining
+ * symbols are decoded. The pieces are delivered in payload order. If the decode finally fails, the bytes delivered so
+ * far are not the complete payload, which is told by the decoding status.
+ * @param user_data the user data given with the callback
+ * @param symbol_index the index of the symbol in cascade order
+ * @param bytes the newly decoded bytes
+ * @param length the number of newly decoded bytes
+*/
+typedef void (*jab_payload_callback)(void* user_data, jab_int32 symbol_index, jab_byte* bytes, jab_int32 length);
+
+/**
+ * @brief Timers and counters of a decode
+*/
+typedef struct {
+	jab_int64	total_time;						///< The time of the whole decode in nanoseconds
+	jab_int64	stage_time[DECODE_STAGE_NUMBER];	///< The time spent in each stage in nanoseconds
+	jab_int32	stage_count[DECODE_STAGE_NUMBER];	///< The number of times each stage ran
+	jab_int32	symbols;						///< The number of decoded symbols
+	jab_int32	modules;						///< The number of data modules read
+	jab_int32	corrected_bits;					///< The number of bits corrected by the LDPC decoder
+}jab_decode_stats;
+
+/**
+ * @brief Decode context owning the scratch memory of decodes, reusable across frames
+*/
+typedef struct {
+	void*		arena;				///< Scratch memory arena, internal
+	jab_int64	peak_usage;			///< Peak scratch memory in bytes used by the last decode
+	jab_int64	reserved;			///< Scratch memory in bytes held by the context
+	jab_int32	heap_allocations;	///< Number of heap allocations for scratch memory made by the last decode
+	jab_payload_callback	payload_callback;	///< Receives the payload of each decode symbol by symbol, NULL if not needed
+	void*		payload_user_data;	///< The user data passed to payload_callback
+	jab_int32	ldpc_max_iter;		///< The maximal number of LDPC decoding iterations per code block, 0 for LDPC_DEFAULT_MAX_ITER
+	jab_int32	ldpc_policy;		///< LDPC_HARD_DECISION | LDPC_SOFT_DECISION | LDPC_HARD_THEN_SOFT
+	jab_decode_stats	stats;		///< The timers and counters of the last decode
+}jab_decode_context;
+
 
 extern jab_encode* createEncode(jab_int32 color_number, jab_int32 symbol_number);
 extern void destroyEncode(jab_encode* enc);
+extern void resetEncode(jab_encode* enc);
 extern jab_int32 generateJABCode(jab_encode* enc, jab_data* data);
+extern jab_int32 generateJABCodeFromStream(jab_encode* enc, jab_payload_source source, void* user_data, jab_int32 length);
 extern jab_data* decodeJABCode(jab_bitmap* bitmap, jab_int32 mode, jab_int32* status);
 extern jab_data* decodeJABCodeEx(jab_bitmap* bitmap, jab_int32 mode, jab_int32* status, jab_decoded_symbol* symbols, jab_int32 max_symbol_number);
+extern jab_decode_context* createDecodeContext(jab_int32 scratch_size);
+extern void destroyDecodeContext(jab_decode_context* ctx);
+extern jab_data* decodeJABCodeWithContext(jab_decode_context* ctx, jab_bitmap* bitmap, jab_int32 mode, jab_int32* status, jab_decoded_symbol* symbols, jab_int32 max_symbol_number);
+extern jab_data* decodeJABCodeFromFile(jab_decode_context* ctx, jab_char* filename, jab_int32 mode, jab_int32* status, jab_decoded_symbol* symbols, jab_int32 max_symbol_number);
+extern jab_data* decodeJABCodeFromBuffer(jab_decode_context* ctx, jab_pixel_buffer* buffer, jab_int32 mode, jab_int32* status, jab_decoded_symbol* symbols, jab_int32 max_symbol_number);
 extern jab_boolean saveImage(jab_bitmap* bitmap, jab_char* filename);
+extern jab_data* saveImageToMemory(jab_bitmap* bitmap, jab_byte* palette, jab_int32 color_number, jab_int32 compression_level, jab_int32 filter);
+extern jab_data* saveModuleImageToMemory(jab_module_matrix* matrix, jab_int32 compression_level, jab_int32 filter);
 extern jab_boolean saveImageCMYK(jab_bitmap* bitmap, jab_boolean isCMYK, jab_char* filename);
+extern jab_boolean saveImageCMYKEx(jab_bitmap* bitmap, jab_boolean isCMYK, jab_int32 compression, jab_char* filename);
 extern jab_bitmap* readImage(jab_char* filename);
 extern void reportError(jab_char* message);
 
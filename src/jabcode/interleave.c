@@ -16,6 +16,7 @@
 #include "jabcode.h"
 #include "encoder.h"
 #include "pseudo_random.h"
+#include "arena.h"
 
 #define INTERLEAVE_SEED 226759
 
@@ -41,7 +42,7 @@ void interleaveData(jab_data* data)
 */
 void deinterleaveData(jab_data* data)
 {
-    jab_int32 * index = (jab_int32 *)malloc(data->length * sizeof(jab_int32));
+    jab_int32 * index = (jab_int32 *)scratchMalloc(data->length * sizeof(jab_int32));
     if(index == NULL)
     {
         reportError("Memory allocation for index buffer in deinterleaver failed");
@@ -61,10 +62,11 @@ void deinterleaveData(jab_data* data)
 		index[pos] = tmp;
     }
     //deinterleave data
-    jab_char* tmp_data = (jab_char *)malloc(data->length * sizeof(jab_char));
+    jab_char* tmp_data = (jab_char *)scratchMalloc(data->length * sizeof(jab_char));
     if(tmp_data == NULL)
     {
         reportError("Memory allocation for temporary buffer in deinterleaver failed");
+        scratchFree(index);
         return;
     }
 	memcpy(tmp_data, data->data, data->length*sizeof(jab_char));
@@ -72,6 +74,6 @@ void deinterleaveData(jab_data* data)
     {
         data->data[index[i]] = tmp_data[i];
     }
-    free(tmp_data);
-    free(index);
+    scratchFree(tmp_data);
+    scratchFree(index);
 }
@@ -19,6 +19,27 @@
 #include <stdio.h>
 #include "detector.h"
 #include "pseudo_random.h"
+#include "arena.h"
+#include "timer.h"
+
+#define GJ_BLOCK_ROWS	8	//rows eliminated together in the Gauss Jordan elimination
+
+/**
+ * @brief The LDPC decoder options of the decodes running in the calling thread
+*/
+static _Thread_local jab_int32 ldpc_max_iter = LDPC_DEFAULT_MAX_ITER;
+static _Thread_local jab_int32 ldpc_policy = LDPC_HARD_DECISION;
+
+/**
+ * @brief Set the LDPC decoder options of the calling thread
+ * @param max_iter the maximal number of decoding iterations per code block, 0 for LDPC_DEFAULT_MAX_ITER
+ * @param policy LDPC_HARD_DECISION | LDPC_SOFT_DECISION | LDPC_HARD_THEN_SOFT
+*/
+void setLDPCDecodeOptions(jab_int32 max_iter, jab_int32 policy)
+{
+    ldpc_max_iter = max_iter > 0 ? max_iter : LDPC_DEFAULT_MAX_ITER;
+    ldpc_policy = (policy == LDPC_SOFT_DECISION || policy == LDPC_HARD_THEN_SOFT) ? policy : LDPC_HARD_DECISION;
+}
 
 /**
  * @brief Create matrix A for message data
@@ -38,17 +59,17 @@ jab_int32 *createMatrixA(jab_int32 wc, jab_int32 wr, jab_int32 capacity)
     jab_int32 effwidth=ceil(capacity/(jab_float)32)*32;
     jab_int32 offset=ceil(capacity/(jab_float)32);
     //create a matrix with '0' entries
-    jab_int32 *matrixA=(jab_int32 *)calloc(ceil(capacity/(jab_float)32)*nb_pcb,sizeof(jab_int32));
+    jab_int32 *matrixA=(jab_int32 *)scratchCalloc(ceil(capacity/(jab_float)32)*nb_pcb,sizeof(jab_int32));
     if(matrixA == NULL)
     {
         reportError("Memory allocation for matrix in LDPC failed");
         return NULL;
     }
-    jab_int32* permutation=(jab_int32 *)calloc(capacity, sizeof(jab_int32));
+    jab_int32* permutation=(jab_int32 *)scratchCalloc(capacity, sizeof(jab_int32));
     if(permutation == NULL)
     {
         reportError("Memory allocation for matrix in LDPC failed");
-        free(matrixA);
+        scratchFree(matrixA);
         return NULL;
     }
     for (jab_int32 i=0;i<capacity;i++)
@@ -62,6 +83,8 @@ jab_int32 *createMatrixA(jab_int32 wc, jab_int32 wr, jab_int32 capacity)
     }
     //Permutate the columns and fill the remaining matrix
     //generate matrixA by following Gallagers algorithm
+    //a column of the first set has its only '1' in the row of its consecutive ones, the last columns have none
+    jab_int32 first_set_width=(capacity/wr)*wr;
     setSeed(LPDC_MESSAGE_SEED);
     for (jab_int32 i=1; i<wc; i++)
     {
@@ -69,115 +92,202 @@ jab_int32 *createMatrixA(jab_int32 wc, jab_int32 wr, jab_int32 capacity)
         for (jab_int32 j=0;j<capacity;j++)
         {
             jab_int32 pos = (jab_int32)( (jab_float)lcg64_temper() / (jab_float)UINT32_MAX * (capacity - j) );
-            for (jab_int32 k=0;k<capacity/wr;k++)
-                matrixA[(off_index+k)*offset+j/32] |= ((matrixA[(permutation[pos]/32+k*offset)] >> (31-permutation[pos]%32)) & 1) << (31-j%32);
+            if(permutation[pos] < first_set_width)
+                matrixA[(off_index+permutation[pos]/wr)*offset+j/32] |= 1 << (31-j%32);
             jab_int32  tmp = permutation[capacity - 1 -j];
             permutation[capacity - 1 - j] = permutation[pos];
             permutation[pos] = tmp;
         }
     }
-    free(permutation);
+    scratchFree(permutation);
     return matrixA;
 }
 
 /**
- * @brief Gauss Jordan elimination algorithm
+ * @brief Transpose a 64x64 bit matrix in place, the most significant bit of a row is its first column
+ * @param block the matrix rows
+*/
+static void transposeBlock(jab_uint64* block)
+{
+    jab_uint64 mask=0x00000000FFFFFFFFULL;
+    for (jab_int32 j=32; j!=0; j>>=1, mask^=mask << j)
+    {
+        for (jab_int32 k=0; k<64; k=(k+j+1) & ~j)
+        {
+            jab_uint64 t=(block[k] ^ (block[k+j] >> j)) & mask;
+            block[k] ^= t;
+            block[k+j] ^= t << j;
+        }
+    }
+}
+
+/**
+ * @brief Gauss Jordan elimination of a matrix with rows of 64-bit words, column 0 is the most significant bit of the
+ * first word. The rows are processed in order, the pivot of a row is its first '1'.
+ * @param matrix the matrix
+ * @param rows the number of rows
+ * @param stride the number of words of a row
+ * @param pivot_words the number of leading words of a row that hold the columns to eliminate
+ * @param pivot_columns the pivot column of each row, -1 for the rows that become zero
+ * @return 0: success | 1: fatal error (out of memory)
+*/
+static jab_int32 reduceRows(jab_uint64* matrix, jab_int32 rows, jab_int32 stride, jab_int32 pivot_words, jab_int32* pivot_columns)
+{
+    //sums of all combinations of the pivot rows of a block
+    jab_uint64* combinations=(jab_uint64 *)scratchMalloc((1 << GJ_BLOCK_ROWS)*stride*sizeof(jab_uint64));
+    if(combinations == NULL)
+        return 1;
+
+    //the rows are processed in blocks. The pivots of a block are eliminated from the rows of the block one by one, and
+    //from all other rows at once by adding the sum of the pivot rows selected by the bits in the pivot columns.
+    for (jab_int32 block=0; block<rows; block+=GJ_BLOCK_ROWS)
+    {
+        jab_int32 block_end=MIN(block+GJ_BLOCK_ROWS, rows);
+        jab_int32 pivot_count=0;
+        jab_int32 pivot_rows[GJ_BLOCK_ROWS];
+        jab_int32 pivot_word_index[GJ_BLOCK_ROWS];
+        jab_uint64 pivot_masks[GJ_BLOCK_ROWS];
+        jab_int32 first_word=stride;
+        for (jab_int32 i=block; i<block_end; i++)
+        {
+            jab_uint64* pivot_row=matrix+stride*i;
+            //the pivot is the first '1' in the row
+            jab_int32 pivot_word=0;
+            while(pivot_word < pivot_words && pivot_row[pivot_word] == 0)
+                pivot_word++;
+            if(pivot_word == pivot_words)
+            {
+                pivot_columns[i]=-1;
+                continue;
+            }
+            jab_int32 pivot_column=pivot_word*64+__builtin_clzll(pivot_row[pivot_word]);
+            pivot_columns[i]=pivot_column;
+
+            //subtract pivot row GF(2) in the block, its words before the pivot are zero
+            jab_uint64 pivot_mask=1ULL << (63-pivot_column%64);
+            for (jab_int32 j=block; j<block_end; j++)
+            {
+                jab_uint64* row=matrix+stride*j;
+                if ((row[pivot_word] & pivot_mask) && j != i)
+                {
+                    for (jab_int32 k=pivot_word;k<stride;k++)
+                        row[k] ^= pivot_row[k];
+                }
+            }
+            pivot_rows[pivot_count]=i;
+            pivot_word_index[pivot_count]=pivot_word;
+            pivot_masks[pivot_count]=pivot_mask;
+            pivot_count++;
+            first_word=MIN(first_word, pivot_word);
+        }
+        if(pivot_count == 0)
+            continue;
+
+        //the sum of the pivot rows for every combination, each one adds a single row to a smaller one
+        memset(combinations+first_word, 0, (stride-first_word)*sizeof(jab_uint64));
+        for (jab_int32 c=1; c<(1 << pivot_count); c++)
+        {
+            jab_uint64* sum=combinations+c*stride;
+            jab_uint64* prev=combinations+(c & (c-1))*stride;
+            jab_uint64* pivot_row=matrix+stride*pivot_rows[__builtin_ctz(c)];
+            for (jab_int32 k=first_word;k<stride;k++)
+                sum[k]=prev[k] ^ pivot_row[k];
+        }
+        //subtract the pivot rows from all rows outside the block
+        for (jab_int32 j=0; j<rows; j++)
+        {
+            if(j == block)
+            {
+                j=block_end-1;
+                continue;
+            }
+            jab_uint64* row=matrix+stride*j;
+            jab_int32 c=0;
+            for (jab_int32 p=0; p<pivot_count; p++)
+                c |= ((row[pivot_word_index[p]] & pivot_masks[p]) != 0) << p;
+            if(c)
+            {
+                jab_uint64* sum=combinations+c*stride;
+                for (jab_int32 k=first_word;k<stride;k++)
+                    row[k] ^= sum[k];
+            }
+        }
+    }
+    scratchFree(combinations);
+    return 0;
+}
+
+/**
+ * @brief Gauss Jordan elimination algorithm. Finds the row order and the column swaps that rearrange the matrix into
+ * the form used by the encoder and the decoder.
  * @param matrixA the matrix
- * @param wc the number of '1's in a column
- * @param wr the number of '1's in a row
+ * @param nb_pcb the number of rows of the matrix
  * @param capacity the number of columns of the matrix
  * @param matrix_rank the rank of the matrix
- * @param encode specifies if function is called by the encoder or decoder
+ * @param row_order the order of the rows of the rearranged matrix, with space for capacity entries
+ * @param swap_col the pairs of swapped columns, with space for 2*capacity entries
+ * @param swap_number the number of column swaps
+ * @param reduced the reduced matrix on 64-bit rows, NULL if it is not needed
  * @return 0: success | 1: fatal error (out of memory)
 */
-jab_int32 GaussJordan(jab_int32* matrixA, jab_int32 wc, jab_int32 wr, jab_int32 capacity, jab_int32* matrix_rank, jab_boolean encode)
+static jab_int32 eliminateMatrix(jab_int32* matrixA, jab_int32 nb_pcb, jab_int32 capacity, jab_int32* matrix_rank, jab_int32* row_order, jab_int32* swap_col, jab_int32* swap_number, jab_uint64** reduced)
 {
     jab_int32 loop=0;
-    jab_int32 nb_pcb;
-    if(wr<4)
-        nb_pcb=capacity/2;
-    else
-        nb_pcb=capacity/wr*wc;
-
     jab_int32 offset=ceil(capacity/(jab_float)32);
+    //the elimination works on rows of 64-bit words, column 0 is the most significant bit of the first word
+    jab_int32 stride=(capacity+63)/64;
 
-    jab_int32*matrixH=(jab_int32 *)calloc(offset*nb_pcb,sizeof(jab_int32));
+    jab_uint64* matrixH=(jab_uint64 *)scratchCalloc(stride*nb_pcb,sizeof(jab_uint64));
     if(matrixH == NULL)
     {
         reportError("Memory allocation for matrix in LDPC failed");
         return 1;
     }
-    memcpy(matrixH,matrixA,offset*nb_pcb*sizeof(jab_int32));
-
-    jab_int32* column_arrangement=(jab_int32 *)calloc(capacity, sizeof(jab_int32));
-    if(column_arrangement == NULL)
+    for (jab_int32 i=0; i<nb_pcb; i++)
     {
-        reportError("Memory allocation for matrix in LDPC failed");
-        free(matrixH);
-        return 1;
+        for (jab_int32 k=0; k<offset; k++)
+            matrixH[i*stride+k/2] |= (jab_uint64)(jab_uint32)matrixA[i*offset+k] << ((k & 1) ? 0 : 32);
     }
-    jab_boolean* processed_column=(jab_boolean *)calloc(capacity, sizeof(jab_boolean));
+
+    jab_boolean* processed_column=(jab_boolean *)scratchCalloc(capacity, sizeof(jab_boolean));
     if(processed_column == NULL)
     {
         reportError("Memory allocation for matrix in LDPC failed");
-        free(matrixH);
-        free(column_arrangement);
+        scratchFree(matrixH);
         return 1;
     }
-    jab_int32* zero_lines_nb=(jab_int32 *)calloc(nb_pcb, sizeof(jab_int32));
+    jab_int32* zero_lines_nb=(jab_int32 *)scratchCalloc(nb_pcb, sizeof(jab_int32));
     if(zero_lines_nb == NULL)
     {
         reportError("Memory allocation for matrix in LDPC failed");
-        free(matrixH);
-        free(column_arrangement);
-        free(processed_column);
+        scratchFree(matrixH);
+        scratchFree(processed_column);
         return 1;
     }
-    jab_int32* swap_col=(jab_int32 *)calloc(2*capacity, sizeof(jab_int32));
-    if(swap_col == NULL)
+    jab_int32* pivot_columns=(jab_int32 *)scratchMalloc(nb_pcb*sizeof(jab_int32));
+    if(pivot_columns == NULL || reduceRows(matrixH, nb_pcb, stride, stride, pivot_columns))
     {
         reportError("Memory allocation for matrix in LDPC failed");
-        free(matrixH);
-        free(column_arrangement);
-        free(processed_column);
-        free(zero_lines_nb);
+        scratchFree(pivot_columns);
+        scratchFree(matrixH);
+        scratchFree(processed_column);
+        scratchFree(zero_lines_nb);
         return 1;
     }
 
     jab_int32 zero_lines=0;
-
     for (jab_int32 i=0; i<nb_pcb; i++)
     {
-        jab_int32 pivot_column=capacity+1;
-        for (jab_int32 j=0; j<capacity; j++)
-        {
-            if((matrixH[(offset*32*i+j)/32] >> (31-(offset*32*i+j)%32)) & 1)
-            {
-                pivot_column=j;
-                break;
-            }
-        }
-        if(pivot_column < capacity)
+        jab_int32 pivot_column=pivot_columns[i];
+        if(pivot_column >= 0)
         {
             processed_column[pivot_column]=1;
-            column_arrangement[pivot_column]=i;
+            row_order[pivot_column]=i;
             if (pivot_column>=nb_pcb)
             {
                 swap_col[2*loop]=pivot_column;
                 loop++;
             }
-
-            jab_int32 off_index=pivot_column/32;
-            jab_int32 off_index1=pivot_column%32;
-            for (jab_int32 j=0; j<nb_pcb; j++)
-            {
-                if (((matrixH[off_index+j*offset] >> (31-off_index1)) & 1) && j != i)
-                {
-                    //subtract pivot row GF(2)
-                    for (jab_int32 k=0;k<offset;k++)
-                        matrixH[k+offset*j] ^= matrixH[k+offset*i];
-                }
-            }
         }
         else //zero line
         {
@@ -185,24 +295,25 @@ jab_int32 GaussJordan(jab_int32* matrixA, jab_int32 wc, jab_int32 wr, jab_int32
             zero_lines++;
         }
     }
+    scratchFree(pivot_columns);
 
     *matrix_rank=nb_pcb-zero_lines;
     jab_int32 loop2=0;
     for(jab_int32 i=*matrix_rank;i<nb_pcb;i++)
     {
-        if(column_arrangement[i] > 0)
+        if(row_order[i] > 0)
         {
             for (jab_int32 j=0;j < nb_pcb;j++)
             {
                 if (processed_column[j] == 0)
                 {
-                    column_arrangement[j]=column_arrangement[i];
-                    column_arrangement[i]=0;
+                    row_order[j]=row_order[i];
+                    row_order[i]=0;
                     processed_column[j]=1;
                     processed_column[i]=0;
                     swap_col[2*loop]=i;
                     swap_col[2*loop+1]=j;
-                    column_arrangement[i]=j;
+                    row_order[i]=j;
                     loop++;
                     loop2++;
                     break;
@@ -216,7 +327,7 @@ jab_int32 GaussJordan(jab_int32* matrixA, jab_int32 wc, jab_int32 wr, jab_int32
     {
         if(processed_column[kl] == 0 && loop1 < loop-loop2)
         {
-            column_arrangement[kl]=column_arrangement[swap_col[2*loop1]];
+            row_order[kl]=row_order[swap_col[2*loop1]];
             processed_column[kl]=1;
             swap_col[2*loop1+1]=kl;
             loop1++;
@@ -228,57 +339,154 @@ jab_int32 GaussJordan(jab_int32* matrixA, jab_int32 wc, jab_int32 wr, jab_int32
     {
         if(processed_column[kl]==0)
         {
-            column_arrangement[kl]=zero_lines_nb[loop1];
+            row_order[kl]=zero_lines_nb[loop1];
             loop1++;
         }
     }
+    scratchFree(processed_column);
+    scratchFree(zero_lines_nb);
+    *swap_number=loop;
+    if(reduced)
+        *reduced=matrixH;
+    else
+        scratchFree(matrixH);
+    return 0;
+}
+
+/**
+ * @brief Rearrange the rows and swap the columns of a matrix as found by the Gauss Jordan elimination
+ * @param matrixA the matrix, replaced by the rearranged matrix
+ * @param matrixH the reduced matrix on 64-bit rows to rearrange instead of matrixA, NULL to rearrange matrixA
+ * @param nb_pcb the number of rows of the matrix
+ * @param capacity the number of columns of the matrix
+ * @param row_order the order of the rows
+ * @param swap_col the pairs of swapped columns
+ * @param swap_number the number of column swaps
+ * @return 0: success | 1: fatal error (out of memory)
+*/
+static jab_int32 rearrangeMatrix(jab_int32* matrixA, jab_uint64* matrixH, jab_int32 nb_pcb, jab_int32 capacity, jab_int32* row_order, jab_int32* swap_col, jab_int32 swap_number)
+{
+    jab_int32 offset=ceil(capacity/(jab_float)32);
+    jab_int32 stride=(capacity+63)/64;
     //rearrange matrixH if encoder and store it in matrixA
     //rearrange matrixA if decoder
-    if(encode)
+    //the rearranged rows are transposed, so that the column swaps only reorder the transposed rows
+    jab_int32 row_words=(nb_pcb+63)/64;
+    jab_uint64* columns=(jab_uint64 *)scratchMalloc(stride*64*row_words*sizeof(jab_uint64));
+    jab_int32* column_order=(jab_int32 *)scratchMalloc(capacity*sizeof(jab_int32));
+    if(columns == NULL || column_order == NULL)
     {
-        for(jab_int32 i=0;i< nb_pcb;i++)
-            memcpy(matrixA+i*offset,matrixH+column_arrangement[i]*offset,offset*sizeof(jab_int32));
-
-        //swap columns
-        jab_int32 tmp=0;
-        for(jab_int32 i=0;i<loop;i++)
+        reportError("Memory allocation for matrix in LDPC failed");
+        scratchFree(columns);
+        scratchFree(column_order);
+        return 1;
+    }
+    jab_uint64 block[64];
+    for (jab_int32 rb=0; rb<row_words; rb++)
+    {
+        for (jab_int32 w=0; w<stride; w++)
         {
-            for (jab_int32 j=0;j<nb_pcb;j++)
+            for (jab_int32 b=0; b<64; b++)
             {
-                tmp ^= (-((matrixA[swap_col[2*i]/32+j*offset] >> (31-swap_col[2*i]%32)) & 1) ^ tmp) & (1 << 0);
-                matrixA[swap_col[2*i]/32+j*offset]   ^= (-((matrixA[swap_col[2*i+1]/32+j*offset] >> (31-swap_col[2*i+1]%32)) & 1) ^ matrixA[swap_col[2*i]/32+j*offset]) & (1 << (31-swap_col[2*i]%32));
-                matrixA[swap_col[2*i+1]/32+offset*j] ^= (-((tmp >> 0) & 1) ^ matrixA[swap_col[2*i+1]/32+offset*j]) & (1 << (31-swap_col[2*i+1]%32));
+                jab_int32 r=rb*64+b;
+                if(r >= nb_pcb)
+                    block[b]=0;
+                else if(matrixH)
+                    block[b]=matrixH[row_order[r]*stride+w];
+                else
+                {
+                    jab_int32* src=matrixA+row_order[r]*offset;
+                    block[b]=(jab_uint64)(jab_uint32)src[2*w] << 32;
+                    if(2*w+1 < offset)
+                        block[b] |= (jab_uint32)src[2*w+1];
+                }
             }
+            transposeBlock(block);
+            for (jab_int32 b=0; b<64; b++)
+                columns[(w*64+b)*row_words+rb]=block[b];
         }
     }
-    else
+    //swap columns
+    for (jab_int32 c=0; c<capacity; c++)
+        column_order[c]=c;
+    for(jab_int32 i=0;i<swap_number;i++)
     {
-    //    memcpy(matrixH,matrixA,offset*nb_pcb*sizeof(jab_int32));
-        for(jab_int32 i=0;i< nb_pcb;i++)
-            memcpy(matrixH+i*offset,matrixA+column_arrangement[i]*offset,offset*sizeof(jab_int32));
-
-        //swap columns
-        jab_int32 tmp=0;
-        for(jab_int32 i=0;i<loop;i++)
+        jab_int32 tmp=column_order[swap_col[2*i]];
+        column_order[swap_col[2*i]]=column_order[swap_col[2*i+1]];
+        column_order[swap_col[2*i+1]]=tmp;
+    }
+    for (jab_int32 rb=0; rb<row_words; rb++)
+    {
+        for (jab_int32 w=0; w<stride; w++)
         {
-            for (jab_int32 j=0;j<nb_pcb;j++)
+            for (jab_int32 b=0; b<64; b++)
+            {
+                jab_int32 c=w*64+b;
+                block[b]=(c < capacity) ? columns[column_order[c]*row_words+rb] : 0;
+            }
+            transposeBlock(block);
+            for (jab_int32 b=0; b<64 && rb*64+b<nb_pcb; b++)
             {
-                tmp ^= (-((matrixH[swap_col[2*i]/32+j*offset] >> (31-swap_col[2*i]%32)) & 1) ^ tmp) & (1 << 0);
-                matrixH[swap_col[2*i]/32+j*offset]   ^= (-((matrixH[swap_col[2*i+1]/32+j*offset] >> (31-swap_col[2*i+1]%32)) & 1) ^ matrixH[swap_col[2*i]/32+j*offset]) & (1 << (31-swap_col[2*i]%32));
-                matrixH[swap_col[2*i+1]/32+offset*j] ^= (-((tmp >> 0) & 1) ^ matrixH[swap_col[2*i+1]/32+offset*j]) & (1 << (31-swap_col[2*i+1]%32));
+                jab_int32* dst=matrixA+(rb*64+b)*offset;
+                dst[2*w]=(jab_int32)(jab_uint32)(block[b] >> 32);
+                if(2*w+1 < offset)
+                    dst[2*w+1]=(jab_int32)(jab_uint32)block[b];
             }
         }
-        memcpy(matrixA,matrixH,offset*nb_pcb*sizeof(jab_int32));
     }
-
-    free(column_arrangement);
-    free(processed_column);
-    free(zero_lines_nb);
-    free(swap_col);
-    free(matrixH);
+    scratchFree(columns);
+    scratchFree(column_order);
     return 0;
 }
 
+/**
+ * @brief Get the number of parity check bits, i.e. the number of rows of the parity check matrix
+ * @param wc the number of '1's in a column
+ * @param wr the number of '1's in a row
+ * @param capacity the number of columns of the matrix
+ * @return the number of parity check bits
+*/
+static jab_int32 getParityCheckNumber(jab_int32 wc, jab_int32 wr, jab_int32 capacity)
+{
+    if(wr<4)
+        return capacity/2;
+    return capacity/wr*wc;
+}
+
+/**
+ * @brief Gauss Jordan elimination algorithm
+ * @param matrixA the matrix
+ * @param wc the number of '1's in a column
+ * @param wr the number of '1's in a row
+ * @param capacity the number of columns of the matrix
+ * @param matrix_rank the rank of the matrix
+ * @param encode specifies if function is called by the encoder or decoder
+ * @return 0: success | 1: fatal error (out of memory)
+*/
+jab_int32 GaussJordan(jab_int32* matrixA, jab_int32 wc, jab_int32 wr, jab_int32 capacity, jab_int32* matrix_rank, jab_boolean encode)
+{
+    jab_int32 nb_pcb=getParityCheckNumber(wc, wr, capacity);
+    jab_int32* row_order=(jab_int32 *)scratchCalloc(capacity, sizeof(jab_int32));
+    jab_int32* swap_col=(jab_int32 *)scratchCalloc(2*capacity, sizeof(jab_int32));
+    if(row_order == NULL || swap_col == NULL)
+    {
+        reportError("Memory allocation for matrix in LDPC failed");
+        scratchFree(row_order);
+        scratchFree(swap_col);
+        return 1;
+    }
+    //the encoder uses the reduced matrix, the decoder the rearranged original one
+    jab_uint64* matrixH=NULL;
+    jab_int32 swap_number=0;
+    jab_int32 ret=eliminateMatrix(matrixA, nb_pcb, capacity, matrix_rank, row_order, swap_col, &swap_number, encode ? &matrixH : NULL);
+    if(ret == 0)
+        ret=rearrangeMatrix(matrixA, matrixH, nb_pcb, capacity, row_order, swap_col, swap_number);
+    scratchFree(matrixH);
+    scratchFree(row_order);
+    scratchFree(swap_col);
+    return ret;
+}
+
 /**
  * @brief Create the error correction matrix for the metadata
  * @param wc the number of '1's in a column
@@ -290,17 +498,17 @@ jab_int32 *createMetadataMatrixA(jab_int32 wc, jab_int32 capacity)
     jab_int32 nb_pcb=capacity/2;
     jab_int32 offset=ceil(capacity/(jab_float)32);
     //create a matrix with '0' entries
-    jab_int32*matrixA=(jab_int32 *)calloc(offset*nb_pcb,sizeof(jab_int32));
+    jab_int32*matrixA=(jab_int32 *)scratchCalloc(offset*nb_pcb,sizeof(jab_int32));
     if(matrixA == NULL)
     {
         reportError("Memory allocation for matrix in LDPC failed");
         return NULL;
     }
-    jab_int32* permutation=(jab_int32 *)calloc(capacity, sizeof(jab_int32));
+    jab_int32* permutation=(jab_int32 *)scratchCalloc(capacity, sizeof(jab_int32));
     if(permutation == NULL)
     {
         reportError("Memory allocation for matrix in LDPC failed");
-        free(matrixA);
+        scratchFree(matrixA);
         return NULL;
     }
     for (jab_int32 i=0;i<capacity;i++)
@@ -320,54 +528,470 @@ jab_int32 *createMetadataMatrixA(jab_int32 wc, jab_int32 capacity)
             permutation[pos] = tmp;
         }
     }
-    free(permutation);
+    scratchFree(permutation);
     return matrixA;
 }
 
 /**
- * @brief Create the generator matrix to encode messages
- * @param matrixA the error correction matrix
+ * @brief Find the row order and the column swaps of the Gauss Jordan elimination of a parity check matrix
+ * @param wc the number of '1's in a column
+ * @param wr the number of '1's in a row, 0 for metadata
+ * @param capacity the number of columns of the matrix
+ * @param matrix_rank the rank of the matrix
+ * @param row_order the order of the rows of the rearranged matrix, with space for capacity entries
+ * @param swap_col the pairs of swapped columns, with space for 2*capacity entries
+ * @param swap_number the number of column swaps
+ * @return 0: success | 1: fatal error (out of memory)
+*/
+jab_int32 getParityCheckOrder(jab_int32 wc, jab_int32 wr, jab_int32 capacity, jab_int32* matrix_rank, jab_int32* row_order, jab_int32* swap_col, jab_int32* swap_number)
+{
+    jab_int32* matrixA;
+    if(wr > 0)
+        matrixA = createMatrixA(wc, wr, capacity);
+    else
+        matrixA = createMetadataMatrixA(wc, capacity);
+    if(matrixA == NULL)
+        return 1;
+    jab_int32 ret=eliminateMatrix(matrixA, getParityCheckNumber(wc, wr, capacity), capacity, matrix_rank, row_order, swap_col, swap_number, NULL);
+    scratchFree(matrixA);
+    return ret;
+}
+
+/**
+ * @brief Find the precomputed table of a parity check matrix
+ * @param wc the number of '1's in a column
+ * @param wr the number of '1's in a row, 0 for metadata
  * @param capacity the number of columns of the matrix
- * @param Pn the number of net message bits
- * @return the generator matrix | NULL if failed (out of memory)
+ * @return the table | NULL if the matrix has no table
+*/
+static const jab_ldpc_table* findLDPCTable(jab_int32 wc, jab_int32 wr, jab_int32 capacity)
+{
+    jab_int32 low=0, high=jab_ldpc_table_number-1;
+    while(low <= high)
+    {
+        jab_int32 mid=(low+high)/2;
+        const jab_ldpc_table* table=&jab_ldpc_tables[mid];
+        jab_int32 diff=table->wr != wr ? table->wr - wr : (table->wc != wc ? table->wc - wc : table->capacity - capacity);
+        if(diff == 0)
+            return table;
+        if(diff < 0)
+            low=mid+1;
+        else
+            high=mid-1;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Create the rearranged parity check matrix for the decoder. The Gauss Jordan elimination is skipped if the
+ * matrix has a precomputed table.
+ * @param wc the number of '1's in a column
+ * @param wr the number of '1's in a row, 0 for metadata
+ * @param capacity the number of columns of the matrix
+ * @param matrix_rank the rank of the matrix
+ * @return the rearranged parity check matrix | NULL if failed
 */
-jab_int32 *createGeneratorMatrix(jab_int32* matrixA, jab_int32 capacity, jab_int32 Pn)
+static jab_int32* createParityCheckMatrix(jab_int32 wc, jab_int32 wr, jab_int32 capacity, jab_int32* matrix_rank)
 {
-    jab_int32 effwidth=ceil(Pn/(jab_float)32)*32;
-    jab_int32 offset=ceil(Pn/(jab_float)32);
-    jab_int32 offset_cap=ceil(capacity/(jab_float)32);
-    //create G [I C]
-    //remember matrixA is now A = [I CT], now use it and create G=[CT
-                //                                                 I ]
-    jab_int32* G=(jab_int32 *)calloc(offset*capacity, sizeof(jab_int32));
-    if(G == NULL)
+    jab_int32* matrixA;
+    if(wr > 0)
+        matrixA = createMatrixA(wc, wr, capacity);
+    else
+        matrixA = createMetadataMatrixA(wc, capacity);
+    if(matrixA == NULL)
+    {
+        reportError("LDPC parity check matrix could not be created.");
+        return NULL;
+    }
+
+    const jab_ldpc_table* table=findLDPCTable(wc, wr, capacity);
+    if(table == NULL)
+    {
+        if(GaussJordan(matrixA, wc, wr, capacity, matrix_rank, 0))
+        {
+            reportError("Gauss Jordan Elimination of LDPC parity check matrix failed.");
+            scratchFree(matrixA);
+            return NULL;
+        }
+        return matrixA;
+    }
+
+    jab_int32 nb_pcb=getParityCheckNumber(wc, wr, capacity);
+    jab_int32* row_order=(jab_int32 *)scratchMalloc(nb_pcb*sizeof(jab_int32));
+    jab_int32* swap_col=(jab_int32 *)scratchMalloc((2*table->swap_number+1)*sizeof(jab_int32));
+    if(row_order == NULL || swap_col == NULL)
     {
         reportError("Memory allocation for matrix in LDPC failed");
+        scratchFree(row_order);
+        scratchFree(swap_col);
+        scratchFree(matrixA);
+        return NULL;
+    }
+    for (jab_int32 i=0; i<nb_pcb; i++)
+        row_order[i]=table->row_order[i];
+    for (jab_int32 i=0; i<2*table->swap_number; i++)
+        swap_col[i]=table->swap_col[i];
+    jab_int32 ret=rearrangeMatrix(matrixA, NULL, nb_pcb, capacity, row_order, swap_col, table->swap_number);
+    scratchFree(row_order);
+    scratchFree(swap_col);
+    if(ret)
+    {
+        scratchFree(matrixA);
         return NULL;
     }
+    *matrix_rank=table->matrix_rank;
+    return matrixA;
+}
 
-    //fill identity matrix
-    for (jab_int32 i=0; i< Pn; i++)
-        G[(capacity-Pn+i) * offset+i/32] |= 1 << (31-i%32);
+/**
+ * @brief Sparse systematic LDPC encoder. The parity bits are solved from the rearranged parity check matrix by back
+ * substitution, the ones back substitution cannot reach are inactivated and solved from the remaining checks.
+*/
+typedef struct {
+	jab_int32	capacity;		///< The number of columns of the parity check matrix
+	jab_int32	matrix_rank;	///< The number of parity bits
+	jab_int32*	row_start;		///< The start of the columns of each row in row_columns
+	jab_int32*	row_columns;	///< The columns of the '1's of the rows
+	jab_int32	solve_number;	///< The number of parity bits solved by back substitution
+	jab_int32*	solve_columns;	///< The parity bits in the order they are solved
+	jab_int32*	solve_rows;		///< The row each parity bit is solved from
+	jab_int32	gap;			///< The number of inactivated parity bits
+	jab_int32*	gap_columns;	///< The inactivated parity bits
+	jab_int32	gap_row_number;	///< The number of rows the inactivated parity bits are solved from
+	jab_int32*	gap_rows;		///< The rows the inactivated parity bits are solved from
+	jab_int32	gap_words;		///< The number of 64-bit words of a row of gap_inverse
+	jab_uint64*	gap_inverse;	///< The combination of the gap rows that solves each inactivated parity bit
+}jab_ldpc_encoder;
 
-    //copy CT matrix from A to G
-    jab_int32 matrix_index=capacity-Pn;
-    jab_int32 loop=0;
+/**
+ * @brief Free an LDPC encoder
+ * @param encoder the encoder
+*/
+static void releaseLDPCEncoder(jab_ldpc_encoder* encoder)
+{
+    if(encoder == NULL)
+        return;
+    scratchFree(encoder->gap_inverse);
+    scratchFree(encoder->gap_rows);
+    scratchFree(encoder->gap_columns);
+    scratchFree(encoder->solve_rows);
+    scratchFree(encoder->solve_columns);
+    scratchFree(encoder->row_columns);
+    scratchFree(encoder->row_start);
+    scratchFree(encoder);
+}
 
-    for (jab_int32 i=0; i<(capacity-Pn)*effwidth; i++)
+/**
+ * @brief Find the combinations of the remaining rows that solve the inactivated parity bits
+ * @param encoder the encoder
+ * @param nb_pcb the number of rows of the parity check matrix
+ * @param row_used whether a row is used by back substitution
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+static jab_boolean solveInactivatedBits(jab_ldpc_encoder* encoder, jab_int32 nb_pcb, jab_byte* row_used)
+{
+    jab_int32 rank=encoder->matrix_rank;
+    jab_int32 words=(encoder->gap+63)/64;
+    encoder->gap_row_number=nb_pcb-encoder->solve_number;
+    encoder->gap_words=(encoder->gap_row_number+63)/64;
+    //each remaining row is the inactivated bits it depends on, followed by the remaining rows it is combined from
+    jab_int32 width=words+encoder->gap_words;
+    jab_uint64* dependency=(jab_uint64 *)scratchCalloc(rank*words, sizeof(jab_uint64));
+    jab_uint64* system=(jab_uint64 *)scratchCalloc(encoder->gap_row_number*width, sizeof(jab_uint64));
+    jab_int32* pivot_columns=(jab_int32 *)scratchMalloc(encoder->gap_row_number*sizeof(jab_int32));
+    encoder->gap_rows=(jab_int32 *)scratchMalloc(encoder->gap_row_number*sizeof(jab_int32));
+    encoder->gap_inverse=(jab_uint64 *)scratchMalloc(encoder->gap*encoder->gap_words*sizeof(jab_uint64));
+    if(dependency == NULL || system == NULL || pivot_columns == NULL || encoder->gap_rows == NULL || encoder->gap_inverse == NULL)
+    {
+        reportError("Memory allocation for LDPC encoder failed");
+        scratchFree(dependency);
+        scratchFree(system);
+        scratchFree(pivot_columns);
+        return JAB_FAILURE;
+    }
+    for (jab_int32 k=0; k<encoder->gap; k++)
+        dependency[encoder->gap_columns[k]*words+k/64] |= 1ULL << (63-k%64);
+    for (jab_int32 n=0; n<encoder->solve_number; n++)
+    {
+        jab_uint64* dst=dependency+encoder->solve_columns[n]*words;
+        for (jab_int32 i=encoder->row_start[encoder->solve_rows[n]]; i<encoder->row_start[encoder->solve_rows[n]+1]; i++)
+        {
+            jab_int32 c=encoder->row_columns[i];
+            if(c < rank && c != encoder->solve_columns[n])
+            {
+                for (jab_int32 w=0; w<words; w++)
+                    dst[w] ^= dependency[c*words+w];
+            }
+        }
+    }
+    jab_int32 nb_rows=0;
+    for (jab_int32 r=0; r<nb_pcb; r++)
     {
-        if(matrix_index >= capacity)
+        if(row_used[r])
+            continue;
+        jab_uint64* dst=system+nb_rows*width;
+        for (jab_int32 i=encoder->row_start[r]; i<encoder->row_start[r+1]; i++)
         {
-            loop++;
-            matrix_index=capacity-Pn;
+            jab_int32 c=encoder->row_columns[i];
+            if(c < rank)
+            {
+                for (jab_int32 w=0; w<words; w++)
+                    dst[w] ^= dependency[c*words+w];
+            }
         }
-        if(i % effwidth < Pn)
+        dst[words+nb_rows/64] |= 1ULL << (63-nb_rows%64);
+        encoder->gap_rows[nb_rows++]=r;
+    }
+
+    //the row whose pivot is an inactivated bit ends up as the combination of rows that solves it
+    jab_boolean solved=(reduceRows(system, nb_rows, width, words, pivot_columns) == 0);
+    jab_int32 nb_solved=0;
+    for (jab_int32 i=0; i<nb_rows && solved; i++)
+    {
+        if(pivot_columns[i] < 0)
+            continue;
+        memcpy(encoder->gap_inverse+pivot_columns[i]*encoder->gap_words, system+i*width+words, encoder->gap_words*sizeof(jab_uint64));
+        nb_solved++;
+    }
+    if(!solved || nb_solved != encoder->gap)
+    {
+        reportError("Inactivated parity bits could not be solved in LDPC encoder");
+        scratchFree(dependency);
+        scratchFree(system);
+        scratchFree(pivot_columns);
+        return JAB_FAILURE;
+    }
+    scratchFree(dependency);
+    scratchFree(system);
+    scratchFree(pivot_columns);
+    return JAB_SUCCESS;
+}
+
+/**
+ * @brief Create the sparse systematic encoder of a parity check matrix
+ * @param wc the number of '1's in a column
+ * @param wr the number of '1's in a row, 0 for metadata
+ * @param capacity the number of columns of the matrix
+ * @return the encoder | NULL if failed
+*/
+static jab_ldpc_encoder* createLDPCEncoder(jab_int32 wc, jab_int32 wr, jab_int32 capacity)
+{
+    jab_int32 matrix_rank=0;
+    jab_int32* matrixA=createParityCheckMatrix(wc, wr, capacity, &matrix_rank);
+    if(matrixA == NULL)
+        return NULL;
+    jab_int32 nb_pcb=getParityCheckNumber(wc, wr, capacity);
+    jab_int32 offset=ceil(capacity/(jab_float)32);
+    jab_int32 nb_ones=0;
+    for (jab_int32 i=0; i<nb_pcb*offset; i++)
+        nb_ones+=__builtin_popcount((jab_uint32)matrixA[i]);
+
+    jab_ldpc_encoder* encoder=(jab_ldpc_encoder *)scratchCalloc(1, sizeof(jab_ldpc_encoder));
+    if(encoder == NULL)
+    {
+        reportError("Memory allocation for LDPC encoder failed");
+        scratchFree(matrixA);
+        return NULL;
+    }
+    encoder->capacity=capacity;
+    encoder->matrix_rank=matrix_rank;
+    encoder->row_start=(jab_int32 *)scratchMalloc((nb_pcb+1)*sizeof(jab_int32));
+    encoder->row_columns=(jab_int32 *)scratchMalloc((nb_ones+1)*sizeof(jab_int32));
+    encoder->solve_columns=(jab_int32 *)scratchMalloc((matrix_rank+1)*sizeof(jab_int32));
+    encoder->solve_rows=(jab_int32 *)scratchMalloc((matrix_rank+1)*sizeof(jab_int32));
+    encoder->gap_columns=(jab_int32 *)scratchMalloc((matrix_rank+1)*sizeof(jab_int32));
+    //the rows of each parity bit, the unknown parity bits of each row and the rows with one unknown parity bit
+    jab_int32* column_start=(jab_int32 *)scratchCalloc(matrix_rank+1, sizeof(jab_int32));
+    jab_int32* column_rows=(jab_int32 *)scratchMalloc((nb_ones+1)*sizeof(jab_int32));
+    jab_int32* degree=(jab_int32 *)scratchCalloc(nb_pcb, sizeof(jab_int32));
+    jab_int32* queue=(jab_int32 *)scratchMalloc(nb_pcb*sizeof(jab_int32));
+    jab_int32* pairs=(jab_int32 *)scratchMalloc(nb_pcb*sizeof(jab_int32));
+    jab_byte* row_used=(jab_byte *)scratchCalloc(nb_pcb, sizeof(jab_byte));
+    jab_byte* column_done=(jab_byte *)scratchCalloc(matrix_rank+1, sizeof(jab_byte));
+    jab_boolean ok=encoder->row_start && encoder->row_columns && encoder->solve_columns && encoder->solve_rows && encoder->gap_columns &&
+                   column_start && column_rows && degree && queue && pairs && row_used && column_done;
+    if(!ok)
+        reportError("Memory allocation for LDPC encoder failed");
+
+    if(ok)
+    {
+        jab_int32 n=0;
+        for (jab_int32 r=0; r<nb_pcb; r++)
         {
-            G[i/32] ^= (-((matrixA[matrix_index/32+offset_cap*loop] >> (31-matrix_index%32)) & 1) ^ G[i/32]) & (1 << (31-i%32));
-            matrix_index++;
+            encoder->row_start[r]=n;
+            for (jab_int32 k=0; k<offset; k++)
+            {
+                jab_uint32 word=(jab_uint32)matrixA[r*offset+k];
+                while(word)
+                {
+                    jab_int32 b=__builtin_clz(word);
+                    jab_int32 c=k*32+b;
+                    encoder->row_columns[n++]=c;
+                    word &= ~(0x80000000u >> b);
+                    if(c < matrix_rank)
+                    {
+                        column_start[c+1]++;
+                        degree[r]++;
+                    }
+                }
+            }
+        }
+        encoder->row_start[nb_pcb]=n;
+        for (jab_int32 c=0; c<matrix_rank; c++)
+            column_start[c+1]+=column_start[c];
+        jab_int32 top=0, pair_top=0;
+        for (jab_int32 r=0; r<nb_pcb; r++)
+        {
+            for (jab_int32 i=encoder->row_start[r]; i<encoder->row_start[r+1]; i++)
+            {
+                jab_int32 c=encoder->row_columns[i];
+                if(c < matrix_rank)
+                    column_rows[column_start[c]++]=r;
+            }
+            if(degree[r] == 1)
+                queue[top++]=r;
+            else if(degree[r] == 2)
+                pairs[pair_top++]=r;
+        }
+        for (jab_int32 c=matrix_rank; c>0; c--)
+            column_start[c]=column_start[c-1];
+        column_start[0]=0;
+
+        //solve the parity bits by back substitution, inactivate one when no row has a single unknown parity bit
+        for (jab_int32 resolved=0; resolved<matrix_rank && ok; resolved++)
+        {
+            jab_int32 row=-1;
+            while(top > 0 && row < 0)
+            {
+                jab_int32 r=queue[--top];
+                if(!row_used[r] && degree[r] == 1)
+                    row=r;
+            }
+            //take a row with two unknown parity bits, or else the row with the fewest
+            while(pair_top > 0 && row < 0)
+            {
+                jab_int32 r=pairs[--pair_top];
+                if(!row_used[r] && degree[r] == 2)
+                    row=r;
+            }
+            if(row < 0)
+            {
+                for (jab_int32 r=0; r<nb_pcb; r++)
+                {
+                    if(!row_used[r] && degree[r] > 1 && (row < 0 || degree[r] < degree[row]))
+                        row=r;
+                }
+                if(row < 0)
+                {
+                    reportError("Parity bits could not be solved in LDPC encoder");
+                    ok=0;
+                    break;
+                }
+            }
+            //the unknown parity bit checked by most rows
+            jab_int32 column=-1;
+            for (jab_int32 i=encoder->row_start[row]; i<encoder->row_start[row+1]; i++)
+            {
+                jab_int32 c=encoder->row_columns[i];
+                if(c < matrix_rank && !column_done[c] && (column < 0 || column_start[c+1]-column_start[c] > column_start[column+1]-column_start[column]))
+                    column=c;
+            }
+            if(degree[row] == 1)
+            {
+                encoder->solve_columns[encoder->solve_number]=column;
+                encoder->solve_rows[encoder->solve_number]=row;
+                encoder->solve_number++;
+                row_used[row]=1;
+            }
+            else
+                encoder->gap_columns[encoder->gap++]=column;
+            column_done[column]=1;
+            for (jab_int32 i=column_start[column]; i<column_start[column+1]; i++)
+            {
+                jab_int32 r=column_rows[i];
+                if(row_used[r])
+                    continue;
+                if(--degree[r] == 1)
+                    queue[top++]=r;
+                else if(degree[r] == 2)
+                    pairs[pair_top++]=r;
+            }
         }
     }
-    return G;
+    if(ok && encoder->gap > 0)
+        ok=solveInactivatedBits(encoder, nb_pcb, row_used);
+
+    scratchFree(column_start);
+    scratchFree(column_rows);
+    scratchFree(degree);
+    scratchFree(queue);
+    scratchFree(pairs);
+    scratchFree(row_used);
+    scratchFree(column_done);
+    scratchFree(matrixA);
+    if(!ok)
+    {
+        releaseLDPCEncoder(encoder);
+        return NULL;
+    }
+    return encoder;
+}
+
+/**
+ * @brief Set the parity bits solved by back substitution
+ * @param encoder the encoder
+ * @param encoded the codeword
+*/
+static void substituteParityBits(jab_ldpc_encoder* encoder, jab_char* encoded)
+{
+    for (jab_int32 n=0; n<encoder->solve_number; n++)
+    {
+        jab_int32 column=encoder->solve_columns[n];
+        jab_int32 row=encoder->solve_rows[n];
+        jab_char bit=0;
+        for (jab_int32 i=encoder->row_start[row]; i<encoder->row_start[row+1]; i++)
+            bit ^= encoded[encoder->row_columns[i]];
+        encoded[column] ^= bit;
+    }
+}
+
+/**
+ * @brief Encode a message block
+ * @param encoder the encoder
+ * @param message the message bits
+ * @param length the number of message bits
+ * @param encoded the encoded bits
+*/
+static void encodeMessageBlock(jab_ldpc_encoder* encoder, jab_char* message, jab_int32 length, jab_char* encoded)
+{
+    jab_int32 rank=encoder->matrix_rank;
+    memset(encoded, 0, encoder->capacity*sizeof(jab_char));
+    for (jab_int32 j=0; j<MIN(length, encoder->capacity-rank); j++)
+        encoded[rank+j]=message[j] & 1;
+    substituteParityBits(encoder, encoded);
+    if(encoder->gap == 0)
+        return;
+
+    //solve the inactivated parity bits from the syndrome of the remaining rows, then substitute again
+    jab_int32 words=encoder->gap_words;
+    jab_uint64 syndrome[words];
+    memset(syndrome, 0, words*sizeof(jab_uint64));
+    for (jab_int32 k=0; k<encoder->gap_row_number; k++)
+    {
+        jab_int32 row=encoder->gap_rows[k];
+        jab_uint64 bit=0;
+        for (jab_int32 i=encoder->row_start[row]; i<encoder->row_start[row+1]; i++)
+            bit ^= encoded[encoder->row_columns[i]];
+        syndrome[k/64] |= bit << (63-k%64);
+    }
+    for (jab_int32 k=0; k<encoder->gap; k++)
+    {
+        jab_uint64 acc=0;
+        for (jab_int32 w=0; w<words; w++)
+            acc ^= encoder->gap_inverse[k*words+w] & syndrome[w];
+        encoded[encoder->gap_columns[k]]=(jab_char)__builtin_parityll(acc);
+    }
+    substituteParityBits(encoder, encoded);
 }
 
 /**
@@ -378,7 +1002,6 @@ jab_int32 *createGeneratorMatrix(jab_int32* matrixA, jab_int32 capacity, jab_int
 */
 jab_data *encodeLDPC(jab_data* data, jab_int32* coderate_params)
 {
-    jab_int32 matrix_rank=0;
     jab_int32 wc, wr, Pg, Pn;       //number of '1' in column //number of '1' in row //gross message length //number of parity check symbols //calculate required parameters
     wc=coderate_params[0];
     wr=coderate_params[1];
@@ -420,109 +1043,76 @@ jab_data *encodeLDPC(jab_data* data, jab_int32* coderate_params)
     jab_int32 encoding_iterations=nb_sub_blocks=Pg / Pg_sub_block;//nb_sub_blocks;
     if(Pn_sub_block * nb_sub_blocks < Pn)
         encoding_iterations--;
-    jab_int32* matrixA;
-    //Matrix A
-    if(wr > 0)
-        matrixA = createMatrixA(wc, wr, Pg_sub_block);
-    else
-        matrixA = createMetadataMatrixA(wc, Pg_sub_block);
-    if(matrixA == NULL)
+    //the metadata matrices have no wr
+    jab_ldpc_encoder* encoder=createLDPCEncoder(wc, wr > 0 ? wr : 0, Pg_sub_block);
+    if(encoder == NULL)
     {
-        reportError("Generator matrix could not be created in LDPC encoder.");
+        reportError("LDPC encoder could not be created.");
         return NULL;
     }
-    jab_boolean encode=1;
-    if(GaussJordan(matrixA, wc, wr, Pg_sub_block, &matrix_rank,encode))
-    {
-        reportError("Gauss Jordan Elimination in LDPC encoder failed.");
-        free(matrixA);
-        return NULL;
-    }
-    //Generator Matrix
-    jab_int32* G = createGeneratorMatrix(matrixA, Pg_sub_block, Pg_sub_block - matrix_rank);
-    if(G == NULL)
-    {
-        reportError("Generator matrix could not be created in LDPC encoder.");
-        free(matrixA);
-        return NULL;
-    }
-    free(matrixA);
 
-    jab_data* ecc_encoded_data = (jab_data *)malloc(sizeof(jab_data) + Pg*sizeof(jab_char));
+    jab_data* ecc_encoded_data = (jab_data *)scratchMalloc(sizeof(jab_data) + Pg*sizeof(jab_char));
     if(ecc_encoded_data == NULL)
     {
         reportError("Memory allocation for LDPC encoded data failed");
-        free(G);
+        releaseLDPCEncoder(encoder);
         return NULL;
     }
 
     ecc_encoded_data->length = Pg;
-    jab_int32 temp,loop;
-    jab_int32 offset=ceil((Pg_sub_block - matrix_rank)/(jab_float)32);
-    //G * message = ecc_encoded_Data
     for(jab_int32 iter=0; iter < encoding_iterations; iter++)
     {
-        for (jab_int32 i=0;i<Pg_sub_block;i++)
-        {
-            temp=0;
-            loop=0;
-            jab_int32 offset_index=offset*i;
-            for (jab_int32 j=iter*Pn_sub_block; j < (iter+1)*Pn_sub_block; j++)
-            {
-                temp ^= (((G[offset_index + loop/32] >> (31-loop%32)) & 1) & ((data->data[j] >> 0) & 1)) << 0;
-                loop++;
-            }
-            ecc_encoded_data->data[i+iter*Pg_sub_block]=(jab_char) ((temp >> 0) & 1);
-        }
+        encodeMessageBlock(encoder, data->data + iter*Pn_sub_block, Pn_sub_block, ecc_encoded_data->data + iter*Pg_sub_block);
     }
-    free(G);
+    releaseLDPCEncoder(encoder);
     if(encoding_iterations != nb_sub_blocks)
     {
         jab_int32 start=encoding_iterations*Pn_sub_block;
         jab_int32 last_index=encoding_iterations*Pg_sub_block;
-        matrix_rank=0;
         Pg_sub_block=Pg - encoding_iterations * Pg_sub_block;
-        Pn_sub_block=Pg_sub_block * (wr-wc) / wr;
-        jab_int32* matrixA = createMatrixA(wc, wr, Pg_sub_block);
-        if(matrixA == NULL)
-        {
-            reportError("Generator matrix could not be created in LDPC encoder.");
-            return NULL;
-        }
-        if(GaussJordan(matrixA, wc, wr, Pg_sub_block, &matrix_rank,encode))
+        encoder=createLDPCEncoder(wc, wr, Pg_sub_block);
+        if(encoder == NULL)
         {
-            reportError("Gauss Jordan Elimination in LDPC encoder failed.");
-            free(matrixA);
+            reportError("LDPC encoder could not be created.");
+            scratchFree(ecc_encoded_data);
             return NULL;
         }
-        jab_int32* G = createGeneratorMatrix(matrixA, Pg_sub_block, Pg_sub_block - matrix_rank);
-        if(G == NULL)
-        {
-            reportError("Generator matrix could not be created in LDPC encoder.");
-            free(matrixA);
-            return NULL;
-        }
-        free(matrixA);
-        offset=ceil((Pg_sub_block - matrix_rank)/(jab_float)32);
-        for (jab_int32 i=0;i<Pg_sub_block;i++)
-        {
-            temp=0;
-            loop=0;
-            jab_int32 offset_index=offset*i;
-            for (jab_int32 j=start; j < data->length; j++)
-            {
-                temp ^= (((G[offset_index + loop/32] >> (31-loop%32)) & 1) & ((data->data[j] >> 0) & 1)) << 0;
-                loop++;
-            }
-            ecc_encoded_data->data[i+last_index]=(jab_char) ((temp >> 0) & 1);
-        }
-        free(G);
+        encodeMessageBlock(encoder, data->data + start, data->length - start, ecc_encoded_data->data + last_index);
+        releaseLDPCEncoder(encoder);
     }
     return ecc_encoded_data;
 }
 
 /**
- * @brief Iterative hard decision error correction decoder
+ * @brief Count the parity checks the data does not satisfy
+ * @param matrix the parity check matrix
+ * @param data the data
+ * @param length the data length
+ * @param height the number of check bits
+ * @return the number of unsatisfied checks
+*/
+static jab_int32 getSyndromeWeight(jab_int32* matrix, jab_byte* data, jab_int32 length, jab_int32 height)
+{
+    jab_int32 offset=ceil(length/(jab_float)32);
+    //pack the data bits like the matrix rows to check 32 bits at once
+    jab_uint32 packed[offset];
+    memset(packed, 0, offset*sizeof(jab_uint32));
+    for (jab_int32 j=0;j<length;j++)
+        packed[j/32] |= (jab_uint32)(data[j] & 1) << (31-j%32);
+    jab_int32 weight=0;
+    for (jab_int32 i=0;i<height;i++)
+    {
+        jab_uint32 temp=0;
+        for (jab_int32 k=0;k<offset;k++)
+            temp ^= (jab_uint32)matrix[i*offset+k] & packed[k];
+        weight+=__builtin_parity(temp);
+    }
+    return weight;
+}
+
+/**
+ * @brief Iterative hard decision error correction decoder. The parity of each check and the number of unsatisfied
+ * checks of each bit are updated with every flipped bit, so that an iteration only touches the checks of the flipped bits.
  * @param data the received data
  * @param matrix the parity check matrix
  * @param length the encoded data length
@@ -530,130 +1120,253 @@ jab_data *encodeLDPC(jab_data* data, jab_int32* coderate_params)
  * @param max_iter the maximal number of iterations
  * @param is_correct indicating if decodedMessage function could correct all errors
  * @param start_pos indicating the position to start reading in data array
+ * @param iterations the number of iterations run
  * @return 1: error correction succeeded | 0: fatal error (out of memory)
 */
-jab_int32 decodeMessage(jab_byte* data, jab_int32* matrix, jab_int32 length, jab_int32 height, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos)
+jab_int32 decodeMessage(jab_byte* data, jab_int32* matrix, jab_int32 length, jab_int32 height, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos, jab_int32* iterations)
 {
-    jab_int32* max_val=(jab_int32 *)calloc(length, sizeof(jab_int32));
-    if(max_val == NULL)
-    {
-        reportError("Memory allocation for LDPC decoder failed");
+    jab_int32 offset=ceil(length/(jab_float)32);
+    jab_int32 nb_ones=0;
+    for (jab_int32 i=0;i<height*offset;i++)
+        nb_ones+=__builtin_popcount((jab_uint32)matrix[i]);
 
-        return 0;
-    }
-    jab_int32* equal_max=(jab_int32 *)calloc(length, sizeof(jab_int32));
-    if(equal_max == NULL)
-    {
-        reportError("Memory allocation for LDPC decoder failed");
-        free(max_val);
-        return 0;
-    }
-    jab_int32* prev_index=(jab_int32 *)calloc(length, sizeof(jab_int32));
-    if(prev_index == NULL)
-    {
+    //the bits of each check, the checks of each bit, the parity of each check and the number of unsatisfied checks of each bit
+    jab_int32* row_start=(jab_int32 *)scratchMalloc((height+1)*sizeof(jab_int32));
+    jab_int32* row_bits=(jab_int32 *)scratchMalloc((nb_ones+1)*sizeof(jab_int32));
+    jab_int32* column_start=(jab_int32 *)scratchCalloc(length+1, sizeof(jab_int32));
+    jab_int32* column_checks=(jab_int32 *)scratchMalloc((nb_ones+1)*sizeof(jab_int32));
+    jab_byte* parity=(jab_byte *)scratchCalloc(height+1, sizeof(jab_byte));
+    jab_int32* unsatisfied=(jab_int32 *)scratchCalloc(length, sizeof(jab_int32));
+    jab_int32* equal_max=(jab_int32 *)scratchCalloc(length, sizeof(jab_int32));
+    jab_int32* prev_index=(jab_int32 *)scratchCalloc(length, sizeof(jab_int32));
+    jab_byte* is_used=(jab_byte *)scratchCalloc(length, sizeof(jab_byte));
+    jab_boolean ok=row_start && row_bits && column_start && column_checks && parity && unsatisfied && equal_max && prev_index && is_used;
+    if(!ok)
         reportError("Memory allocation for LDPC decoder failed");
-        free(max_val);
-        free(equal_max);
-        return 0;
-    }
-
-    *is_correct=(jab_boolean)1;
-    jab_int32 check=0;
-    jab_int32 counter=0, prev_count=0;
-    jab_int32 max=0;
-    jab_int32 offset=ceil(length/(jab_float)32);
 
-    for (jab_int32 kl=0;kl<max_iter;kl++)
+    if(ok)
     {
-        max=0;
-        for(jab_int32 j=0;j<height;j++)
+        jab_int32 n=0;
+        for (jab_int32 j=0;j<height;j++)
         {
-            check=0;
-            for (jab_int32 i=0;i<length;i++)
+            row_start[j]=n;
+            for (jab_int32 k=0;k<offset;k++)
             {
-                if(((matrix[j*offset+i/32] >> (31-i%32)) & 1) & ((data[start_pos+i] >> 0) & 1))
-                    check+=1;
-            }
-            check=check%2;
-            if(check)
-            {
-                for(jab_int32 k=0;k<length;k++)
+                jab_uint32 word=(jab_uint32)matrix[j*offset+k];
+                while(word)
                 {
-                    if(((matrix[j*offset+k/32] >> (31-k%32)) & 1))
-                        max_val[k]++;
+                    jab_int32 b=__builtin_clz(word);
+                    jab_int32 i=k*32+b;
+                    row_bits[n++]=i;
+                    column_start[i+1]++;
+                    parity[j]^=data[start_pos+i] & 1;
+                    word &= ~(0x80000000u >> b);
                 }
             }
         }
-        //find maximal values in max_val
-        jab_boolean is_used=0;
-        for (jab_int32 j=0;j<length;j++)
+        row_start[height]=n;
+        for (jab_int32 i=0;i<length;i++)
+            column_start[i+1]+=column_start[i];
+        for (jab_int32 j=0;j<height;j++)
         {
-            is_used=(jab_boolean)0;
-            for(jab_int32 i=0;i< prev_count;i++)
-            {
-                if(prev_index[i]==j)
-                    is_used=(jab_boolean)1;
-            }
-            if(max_val[j]>=max && !is_used)
+            for (jab_int32 k=row_start[j];k<row_start[j+1];k++)
             {
-                if(max_val[j]!=max)
-                    counter=0;
-                max=max_val[j];
-                equal_max[counter]=j;
-                counter++;
+                jab_int32 i=row_bits[k];
+                column_checks[column_start[i]++]=j;
+                unsatisfied[i]+=parity[j];
             }
-            max_val[j]=0;
         }
-        //flip bits
-        if(max>0)
+        for (jab_int32 i=length;i>0;i--)
+            column_start[i]=column_start[i-1];
+        column_start[0]=0;
+
+        *is_correct=(jab_boolean)1;
+        *iterations=0;
+        jab_int32 counter=0, prev_count=0;
+        jab_int32 max=0;
+        for (jab_int32 kl=0;kl<max_iter;kl++)
         {
-            *is_correct=(jab_boolean) 0;
-            if(length < 36)
+            *iterations=kl+1;
+            //find maximal values in unsatisfied, skipping the bits flipped in the previous iteration
+            max=0;
+            for(jab_int32 i=0;i<prev_count;i++)
             {
-                jab_int32 rand_tmp=(jab_int32)(rand()/(jab_float)UINT32_MAX * counter);
-                prev_index[0]=start_pos+equal_max[rand_tmp];
-                data[start_pos+equal_max[rand_tmp]]=(data[start_pos+equal_max[rand_tmp]]+1)%2;
+                if(prev_index[i] < length)
+                    is_used[prev_index[i]]=1;
             }
-            else
+            for (jab_int32 j=0;j<length;j++)
             {
-                for(jab_int32 j=0; j< counter;j++)
+                if(unsatisfied[j]>=max && !is_used[j])
                 {
-                    prev_index[j]=start_pos+equal_max[j];
-                    data[start_pos+equal_max[j]]=(data[start_pos+equal_max[j]]+1)%2;
+                    if(unsatisfied[j]!=max)
+                        counter=0;
+                    max=unsatisfied[j];
+                    equal_max[counter]=j;
+                    counter++;
                 }
             }
-            prev_count=counter;
-            counter=0;
-        }
-        else
-            *is_correct=(jab_boolean) 1;
+            for(jab_int32 i=0;i<prev_count;i++)
+            {
+                if(prev_index[i] < length)
+                    is_used[prev_index[i]]=0;
+            }
+            //flip bits
+            if(max>0)
+            {
+                *is_correct=(jab_boolean) 0;
+                jab_int32 first=0, last=counter;
+                if(length < 36)
+                {
+                    jab_int32 rand_tmp=(jab_int32)(rand()/(jab_float)UINT32_MAX * counter);
+                    prev_index[0]=start_pos+equal_max[rand_tmp];
+                    first=rand_tmp;
+                    last=rand_tmp+1;
+                }
+                else
+                {
+                    for(jab_int32 j=0; j< counter;j++)
+                        prev_index[j]=start_pos+equal_max[j];
+                }
+                for(jab_int32 j=first; j<last;j++)
+                {
+                    jab_int32 bit=equal_max[j];
+                    data[start_pos+bit]=(data[start_pos+bit]+1)%2;
+                    for (jab_int32 k=column_start[bit];k<column_start[bit+1];k++)
+                    {
+                        jab_int32 check=column_checks[k];
+                        parity[check]^=1;
+                        jab_int32 delta=parity[check] ? 1 : -1;
+                        for (jab_int32 l=row_start[check];l<row_start[check+1];l++)
+                            unsatisfied[row_bits[l]]+=delta;
+                    }
+                }
+                prev_count=counter;
+                counter=0;
+            }
+            else
+                *is_correct=(jab_boolean) 1;
 
-        if(*is_correct == 0 && kl+1 < max_iter)
-            *is_correct=(jab_boolean)1;
-        else
-            break;
-    }
+            if(*is_correct == 0 && kl+1 < max_iter)
+                *is_correct=(jab_boolean)1;
+            else
+                break;
+        }
 #if TEST_MODE
-    JAB_REPORT_INFO(("start position:%d, stop position:%d, correct:%d", start_pos, start_pos+length,(jab_int32)*is_correct))
+        JAB_REPORT_INFO(("start position:%d, stop position:%d, correct:%d", start_pos, start_pos+length,(jab_int32)*is_correct))
 #endif
-    free(prev_index);
-    free(equal_max);
-    free(max_val);
-    return 1;
+    }
+    scratchFree(row_start);
+    scratchFree(row_bits);
+    scratchFree(column_start);
+    scratchFree(column_checks);
+    scratchFree(parity);
+    scratchFree(unsatisfied);
+    scratchFree(equal_max);
+    scratchFree(prev_index);
+    scratchFree(is_used);
+    return ok;
+}
+
+/**
+ * @brief Correct a code block with the decoders selected by the LDPC decoder policy
+ * @param data the received data
+ * @param matrix the parity check matrix
+ * @param length the code block length
+ * @param matrix_rank the rank of the matrix
+ * @param nb_pcb the number of rows of the matrix
+ * @param start_pos the position of the code block in data
+ * @param stats the statistics to add the code block to, NULL if not needed
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+static jab_boolean decodeBlock(jab_byte* data, jab_int32* matrix, jab_int32 length, jab_int32 matrix_rank, jab_int32 nb_pcb, jab_int32 start_pos, jab_ldpc_stats* stats)
+{
+    //first check syndrom
+    jab_int32 syndrome=getSyndromeWeight(matrix, data+start_pos, length, matrix_rank);
+    if(stats)
+    {
+        stats->blocks++;
+        stats->syndrome_before+=syndrome;
+    }
+    if(syndrome == 0)
+        return JAB_SUCCESS;
+
+    //keep the received bits for the soft decoder and to count the corrected bits
+    jab_byte* received=(jab_byte *)scratchMalloc(length*sizeof(jab_byte));
+    if(received == NULL)
+    {
+        reportError("Memory allocation for LDPC decoder failed");
+        return JAB_FAILURE;
+    }
+    memcpy(received, data+start_pos, length);
+    jab_boolean is_correct=0;
+    jab_int32 iterations=0, block_iterations=0;
+    if(ldpc_policy != LDPC_SOFT_DECISION)
+    {
+        if(!decodeMessage(data, matrix, length, matrix_rank, ldpc_max_iter, &is_correct, start_pos, &iterations))
+        {
+            reportError("LDPC decoder error.");
+            scratchFree(received);
+            return JAB_FAILURE;
+        }
+        block_iterations+=iterations;
+        syndrome=getSyndromeWeight(matrix, data+start_pos, length, matrix_rank);
+    }
+    if(syndrome > 0 && ldpc_policy != LDPC_HARD_DECISION)
+    {
+        //belief propagation on the received bits, all with the same reliability
+        memcpy(data+start_pos, received, length);
+        jab_float* enc=(jab_float *)scratchMalloc(length*sizeof(jab_float));
+        if(enc == NULL)
+        {
+            reportError("Memory allocation for LDPC decoder failed");
+            scratchFree(received);
+            return JAB_FAILURE;
+        }
+        for (jab_int32 i=0;i<length;i++)
+            enc[i]=1.0f;
+        jab_int32 success=decodeMessageBP(enc, matrix, length, matrix_rank, nb_pcb, ldpc_max_iter, &is_correct, 0, data+start_pos, &iterations);
+        scratchFree(enc);
+        if(success == 0)
+        {
+            reportError("LDPC decoder error.");
+            scratchFree(received);
+            return JAB_FAILURE;
+        }
+        block_iterations+=iterations;
+        syndrome=getSyndromeWeight(matrix, data+start_pos, length, matrix_rank);
+        if(stats)
+            stats->soft_blocks++;
+    }
+    if(stats)
+    {
+        stats->iterations+=block_iterations;
+        stats->max_block_iterations=MAX(stats->max_block_iterations, block_iterations);
+        for (jab_int32 i=0;i<length;i++)
+            stats->corrected_bits+=(data[start_pos+i] & 1) != (received[i] & 1);
+        stats->syndrome_after+=syndrome;
+    }
+    scratchFree(received);
+    if(syndrome > 0)
+    {
+        reportError("Too many errors in message. LDPC decoding failed.");
+        return JAB_FAILURE;
+    }
+    return JAB_SUCCESS;
 }
 
 /**
- * @brief LDPC decoding to perform hard decision
+ * @brief LDPC decoding of hard decisions, by bit flipping, belief propagation or both as set by setLDPCDecodeOptions
  * @param data the encoded data
  * @param length the encoded data length
  * @param wc the number of '1's in a column
  * @param wr the number of '1's in a row
- * @return the decoded data length | 0: fatal error (out of memory)
+ * @param stats the decoding statistics, NULL if not needed
+ * @return the decoded data length | 0: decoding failed
 */
-jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32 wr)
+jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32 wr, jab_ldpc_stats* stats)
 {
+    jab_int64 start_time=getMonotonicTime();
     jab_int32 matrix_rank=0;
-    jab_int32 max_iter=25;
     jab_int32 Pn, Pg, decoded_data_len = 0;
     if(wr > 3)
     {
@@ -697,144 +1410,37 @@ jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32
         decoding_iterations--;
 
     //parity check matrix
-    jab_int32* matrixA;
-    if(wr > 0)
-        matrixA = createMatrixA(wc, wr,Pg_sub_block);
-    else
-        matrixA = createMetadataMatrixA(wc, Pg_sub_block);
+    jab_int32* matrixA = createParityCheckMatrix(wc, wr, Pg_sub_block, &matrix_rank);
     if(matrixA == NULL)
-    {
-        reportError("LDPC matrix could not be created in decoder.");
-        return 0;
-    }
-    jab_boolean encode=0;
-    if(GaussJordan(matrixA, wc, wr, Pg_sub_block, &matrix_rank,encode))
-    {
-        reportError("Gauss Jordan Elimination in LDPC encoder failed.");
-        free(matrixA);
         return 0;
-    }
 
     jab_int32 old_Pg_sub=Pg_sub_block;
     jab_int32 old_Pn_sub=Pn_sub_block;
     for (jab_int32 iter = 0; iter < nb_sub_blocks; iter++)
     {
+        jab_int32 start_pos=iter*old_Pg_sub;
         if(decoding_iterations != nb_sub_blocks && iter == decoding_iterations)
         {
             matrix_rank=0;
             Pg_sub_block=Pg - decoding_iterations * Pg_sub_block;
             Pn_sub_block=Pg_sub_block * (wr-wc) / wr;
-            jab_int32* matrixA1 = createMatrixA(wc, wr, Pg_sub_block);
+            jab_int32* matrixA1 = createParityCheckMatrix(wc, wr, Pg_sub_block, &matrix_rank);
             if(matrixA1 == NULL)
             {
-                reportError("LDPC matrix could not be created in decoder.");
+                scratchFree(matrixA);
                 return 0;
             }
-            jab_boolean encode=0;
-            if(GaussJordan(matrixA1, wc, wr, Pg_sub_block, &matrix_rank,encode))
-            {
-                reportError("Gauss Jordan Elimination in LDPC encoder failed.");
-                free(matrixA1);
-                return 0;
-            }
-            //ldpc decoding
-            //first check syndrom
-            jab_boolean is_correct=1;
-            jab_int32 offset=ceil(Pg_sub_block/(jab_float)32);
-            for (jab_int32 i=0;i< matrix_rank; i++)
-            {
-                jab_int32 temp=0;
-                for (jab_int32 j=0;j<Pg_sub_block;j++)
-                    temp ^= (((matrixA1[i*offset+j/32] >> (31-j%32)) & 1) & ((data[iter*old_Pg_sub+j] >> 0) & 1)) << 0; //
-                if (temp)
-                {
-                    is_correct=(jab_boolean) 0;//message not correct
-                    break;
-                }
-            }
-
-            if(is_correct==0)
-            {
-                jab_int32 start_pos=iter*old_Pg_sub;
-                jab_int32 success=decodeMessage(data, matrixA1, Pg_sub_block, matrix_rank, max_iter, &is_correct,start_pos);
-                if(success == 0)
-                {
-                    reportError("LDPC decoder error.");
-                    free(matrixA1);
-                    return 0;
-                }
-            }
-            if(is_correct==0)
-            {
-                jab_boolean is_correct=1;
-                for (jab_int32 i=0;i< matrix_rank; i++)
-                {
-                    jab_int32 temp=0;
-                    for (jab_int32 j=0;j<Pg_sub_block;j++)
-                        temp ^= (((matrixA1[i*offset+j/32] >> (31-j%32)) & 1) & ((data[iter*old_Pg_sub+j] >> 0) & 1)) << 0;
-                    if (temp)
-                    {
-                        is_correct=(jab_boolean) 0;//message not correct
-                        break;
-                    }
-                }
-                if(is_correct==0)
-                {
-                    reportError("Too many errors in message. LDPC decoding failed.");
-                    free(matrixA1);
-                    return 0;
-                }
-            }
-            free(matrixA1);
+            if(!decodeBlock(data, matrixA1, Pg_sub_block, matrix_rank, getParityCheckNumber(wc, wr, Pg_sub_block), start_pos, stats))
+                decoded_data_len=0;
+            scratchFree(matrixA1);
         }
         else
         {
-            //ldpc decoding
-            //first check syndrom
-            jab_boolean is_correct=1;
-            jab_int32 offset=ceil(Pg_sub_block/(jab_float)32);
-            for (jab_int32 i=0;i< matrix_rank; i++)
-            {
-                jab_int32 temp=0;
-                for (jab_int32 j=0;j<Pg_sub_block;j++)
-                    temp ^= (((matrixA[i*offset+j/32] >> (31-j%32)) & 1) & ((data[iter*old_Pg_sub+j] >> 0) & 1)) << 0;
-                if (temp)
-                {
-                    is_correct=(jab_boolean) 0;//message not correct
-                    break;
-                }
-            }
-
-            if(is_correct==0)
-            {
-                jab_int32 start_pos=iter*old_Pg_sub;
-                jab_int32 success=decodeMessage(data, matrixA, Pg_sub_block, matrix_rank, max_iter, &is_correct, start_pos);
-                if(success == 0)
-                {
-                    reportError("LDPC decoder error.");
-                    free(matrixA);
-                    return 0;
-                }
-                is_correct=1;
-                for (jab_int32 i=0;i< matrix_rank; i++)
-                {
-                    jab_int32 temp=0;
-                    for (jab_int32 j=0;j<Pg_sub_block;j++)
-                        temp ^= (((matrixA[i*offset+j/32] >> (31-j%32)) & 1) & ((data[iter*old_Pg_sub+j] >> 0) & 1)) << 0;
-                    if (temp)
-                    {
-                        is_correct=(jab_boolean)0;//message not correct
-                        break;
-                    }
-                }
-                if(is_correct==0)
-                {
-                    reportError("Too many errors in message. LDPC decoding failed.");
-                    free(matrixA);
-                    return 0;
-                }
-            }
+            if(!decodeBlock(data, matrixA, Pg_sub_block, matrix_rank, getParityCheckNumber(wc, wr, Pg_sub_block), start_pos, stats))
+                decoded_data_len=0;
         }
+        if(decoded_data_len == 0)
+            break;
         jab_int32 loop=0;
         for (jab_int32 i=iter*old_Pg_sub;i < iter * old_Pg_sub + Pn_sub_block; i++)
         {
@@ -842,7 +1448,9 @@ jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32
             loop++;
         }
     }
-    free(matrixA);
+    scratchFree(matrixA);
+    if(stats)
+        stats->time+=getMonotonicTime()-start_time;
     return decoded_data_len;
 }
 
@@ -861,35 +1469,35 @@ jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32
 */
 jab_int32 decodeMessageILL(jab_float* enc, jab_int32* matrix, jab_int32 length, jab_int32 checkbits, jab_int32 height, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos, jab_byte* dec)
 {
-    jab_double* lambda=(jab_double *)malloc(length * sizeof(jab_double));
+    jab_double* lambda=(jab_double *)scratchMalloc(length * sizeof(jab_double));
     if(lambda == NULL)
     {
         reportError("Memory allocation for Lambda in LDPC decoder failed");
         return 0;
     }
-    jab_double* old_nu_row=(jab_double *)malloc(length * sizeof(jab_double));
+    jab_double* old_nu_row=(jab_double *)scratchMalloc(length * sizeof(jab_double));
     if(old_nu_row == NULL)
     {
         reportError("Memory allocation for Lambda in LDPC decoder failed");
-        free(lambda);
+        scratchFree(lambda);
         return 0;
     }
-    jab_double* nu=(jab_double *)malloc(length*height * sizeof(jab_double));
+    jab_double* nu=(jab_double *)scratchMalloc(length*height * sizeof(jab_double));
     if(nu == NULL)
     {
         reportError("Memory allocation for nu in LDPC decoder failed");
-        free(old_nu_row);
-        free(lambda);
+        scratchFree(old_nu_row);
+        scratchFree(lambda);
         return 0;
     }
     memset(nu,0,length*height *sizeof(jab_double));
-    jab_int32* index=(jab_int32 *)malloc(length * sizeof(jab_int32));
+    jab_int32* index=(jab_int32 *)scratchMalloc(length * sizeof(jab_int32));
     if(index == NULL)
     {
         reportError("Memory allocation for index in LDPC decoder failed");
-        free(old_nu_row);
-        free(lambda);
-        free(nu);
+        scratchFree(old_nu_row);
+        scratchFree(lambda);
+        scratchFree(nu);
         return 0;
     }
     jab_int32 offset=ceil(length/(jab_float)32);
@@ -981,10 +1589,10 @@ jab_int32 decodeMessageILL(jab_float* enc, jab_int32* matrix, jab_int32 length,
 #if TEST_MODE
     JAB_REPORT_INFO(("start position:%d, stop position:%d, correct:%d", start_pos, start_pos+length,(jab_int32)*is_correct))
 #endif
-    free(lambda);
-    free(nu);
-    free(old_nu_row);
-    free(index);
+    scratchFree(lambda);
+    scratchFree(nu);
+    scratchFree(old_nu_row);
+    scratchFree(index);
     return 1;
 }
 
@@ -1000,39 +1608,40 @@ jab_int32 decodeMessageILL(jab_float* enc, jab_int32* matrix, jab_int32 length,
  * @param is_correct indicating if decodedMessage function could correct all errors
  * @param start_pos indicating the position to start reading in enc array
  * @param dec is the tentative decision after each decoding iteration
+ * @param iterations the number of iterations run
  * @return 1: error correction succeded | 0: decoding failed
 */
-jab_int32 decodeMessageBP(jab_float* enc, jab_int32* matrix, jab_int32 length, jab_int32 checkbits, jab_int32 height, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos, jab_byte* dec)
+jab_int32 decodeMessageBP(jab_float* enc, jab_int32* matrix, jab_int32 length, jab_int32 checkbits, jab_int32 height, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos, jab_byte* dec, jab_int32* iterations)
 {
-    jab_double* lambda=(jab_double *)malloc(length * sizeof(jab_double));
+    jab_double* lambda=(jab_double *)scratchMalloc(length * sizeof(jab_double));
     if(lambda == NULL)
     {
         reportError("Memory allocation for Lambda in LDPC decoder failed");
         return 0;
     }
-    jab_double* old_nu_row=(jab_double *)malloc(length * sizeof(jab_double));
+    jab_double* old_nu_row=(jab_double *)scratchMalloc(length * sizeof(jab_double));
     if(old_nu_row == NULL)
     {
         reportError("Memory allocation for Lambda in LDPC decoder failed");
-        free(lambda);
+        scratchFree(lambda);
         return 0;
     }
-    jab_double* nu=(jab_double *)malloc(length*height * sizeof(jab_double));
+    jab_double* nu=(jab_double *)scratchMalloc(length*height * sizeof(jab_double));
     if(nu == NULL)
     {
         reportError("Memory allocation for nu in LDPC decoder failed");
-        free(old_nu_row);
-        free(lambda);
+        scratchFree(old_nu_row);
+        scratchFree(lambda);
         return 0;
     }
     memset(nu,0,length*height *sizeof(jab_double));
-    jab_int32* index=(jab_int32 *)malloc(length * sizeof(jab_int32));
+    jab_int32* index=(jab_int32 *)scratchMalloc(length * sizeof(jab_int32));
     if(index == NULL)
     {
         reportError("Memory allocation for index in LDPC decoder failed");
-        free(old_nu_row);
-        free(lambda);
-        free(nu);
+        scratchFree(old_nu_row);
+        scratchFree(lambda);
+        scratchFree(nu);
         return 0;
     }
     jab_int32 offset=ceil(length/(jab_float)32);
@@ -1055,6 +1664,9 @@ jab_int32 decodeMessageBP(jab_float* enc, jab_int32* matrix, jab_int32 length, j
     for (jab_int32 i=0;i<length;i++)
         var+=(enc[start_pos+i]-meansum)*(enc[start_pos+i]-meansum);
     var/=(length-1);
+    //reliabilities of hard decisions are all the same, take the unit variance
+    if(var <= 0)
+        var=1.0;
 
     //initialize lambda
     for (jab_int32 i=0;i<length;i++)
@@ -1066,8 +1678,10 @@ jab_int32 decodeMessageBP(jab_float* enc, jab_int32* matrix, jab_int32 length, j
 
     //check node update
     jab_int32 count;
+    *iterations=0;
     for (jab_int32 kl=0;kl<max_iter;kl++)
     {
+        *iterations=kl+1;
         for(jab_int32 j=0;j<height;j++)
         {
             product=1.0;
@@ -1153,10 +1767,10 @@ jab_int32 decodeMessageBP(jab_float* enc, jab_int32* matrix, jab_int32 length, j
 #if TEST_MODE
     JAB_REPORT_INFO(("start position:%d, stop position:%d, correct:%d", start_pos, start_pos+length,(jab_int32)*is_correct))
 #endif
-    free(lambda);
-    free(nu);
-    free(old_nu_row);
-    free(index);
+    scratchFree(lambda);
+    scratchFree(nu);
+    scratchFree(old_nu_row);
+    scratchFree(index);
     return 1;
 }
 
@@ -1172,7 +1786,8 @@ jab_int32 decodeMessageBP(jab_float* enc, jab_int32* matrix, jab_int32 length, j
 jab_int32 decodeLDPC(jab_float* enc, jab_int32 length, jab_int32 wc, jab_int32 wr, jab_byte* dec)
 {
     jab_int32 matrix_rank=0;
-    jab_int32 max_iter=25;
+    jab_int32 max_iter=ldpc_max_iter;
+    jab_int32 iterations=0;
     jab_int32 Pn, Pg, decoded_data_len = 0;
     if(wr > 3)
     {
@@ -1216,24 +1831,10 @@ jab_int32 decodeLDPC(jab_float* enc, jab_int32 length, jab_int32 wc, jab_int32 w
         decoding_iterations--;
 
     //parity check matrix
-    jab_int32* matrixA;
-    if(wr > 0)
-        matrixA = createMatrixA(wc, wr,Pg_sub_block);
-    else
-        matrixA = createMetadataMatrixA(wc, Pg_sub_block);
+    jab_int32* matrixA = createParityCheckMatrix(wc, wr, Pg_sub_block, &matrix_rank);
     if(matrixA == NULL)
-    {
-        reportError("LDPC matrix could not be created in decoder.");
         return 0;
-    }
 
-    jab_boolean encode=0;
-    if(GaussJordan(matrixA, wc, wr, Pg_sub_block, &matrix_rank,encode))
-    {
-        reportError("Gauss Jordan Elimination in LDPC encoder failed.");
-        free(matrixA);
-        return 0;
-    }
 #if TEST_MODE
 	//JAB_REPORT_INFO(("GaussJordan matrix done"))
 #endif
@@ -1246,19 +1847,9 @@ jab_int32 decodeLDPC(jab_float* enc, jab_int32 length, jab_int32 wc, jab_int32 w
             matrix_rank=0;
             Pg_sub_block=Pg - decoding_iterations * Pg_sub_block;
             Pn_sub_block=Pg_sub_block * (wr-wc) / wr;
-            jab_int32* matrixA1 = createMatrixA(wc, wr, Pg_sub_block);
+            jab_int32* matrixA1 = createParityCheckMatrix(wc, wr, Pg_sub_block, &matrix_rank);
             if(matrixA1 == NULL)
-            {
-                reportError("LDPC matrix could not be created in decoder.");
                 return 0;
-            }
-            jab_boolean encode=0;
-            if(GaussJordan(matrixA1, wc, wr, Pg_sub_block, &matrix_rank,encode))
-            {
-                reportError("Gauss Jordan Elimination in LDPC encoder failed.");
-                free(matrixA1);
-                return 0;
-            }
             //ldpc decoding
             //first check syndrom
             jab_boolean is_correct=1;
@@ -1278,11 +1869,11 @@ jab_int32 decodeLDPC(jab_float* enc, jab_int32 length, jab_int32 wc, jab_int32 w
             if(is_correct==0)
             {
                 jab_int32 start_pos=iter*old_Pg_sub;
-                jab_int32 success=decodeMessageBP(enc, matrixA1, Pg_sub_block, matrix_rank, wr<4 ? Pg_sub_block/2 : Pg_sub_block/wr*wc, max_iter, &is_correct,start_pos,dec);
+                jab_int32 success=decodeMessageBP(enc, matrixA1, Pg_sub_block, matrix_rank, wr<4 ? Pg_sub_block/2 : Pg_sub_block/wr*wc, max_iter, &is_correct, start_pos, dec, &iterations);
                 if(success == 0)
                 {
                     reportError("LDPC decoder error.");
-                    free(matrixA1);
+                    scratchFree(matrixA1);
                     return 0;
                 }
             }
@@ -1303,11 +1894,11 @@ jab_int32 decodeLDPC(jab_float* enc, jab_int32 length, jab_int32 wc, jab_int32 w
                 if(is_correct==0)
                 {
  //                   reportError("Too many errors in message. LDPC decoding failed.");
-                    free(matrixA1);
+                    scratchFree(matrixA1);
                     return 0;
                 }
             }
-            free(matrixA1);
+            scratchFree(matrixA1);
         }
         else
         {
@@ -1330,11 +1921,11 @@ jab_int32 decodeLDPC(jab_float* enc, jab_int32 length, jab_int32 wc, jab_int32 w
             if(is_correct==0)
             {
                 jab_int32 start_pos=iter*old_Pg_sub;
-                jab_int32 success=decodeMessageBP(enc, matrixA, Pg_sub_block, matrix_rank, wr<4 ? Pg_sub_block/2 : Pg_sub_block/wr*wc, max_iter, &is_correct, start_pos,dec);
+                jab_int32 success=decodeMessageBP(enc, matrixA, Pg_sub_block, matrix_rank, wr<4 ? Pg_sub_block/2 : Pg_sub_block/wr*wc, max_iter, &is_correct, start_pos, dec, &iterations);
                 if(success == 0)
                 {
                     reportError("LDPC decoder error.");
-                    free(matrixA);
+                    scratchFree(matrixA);
                     return 0;
                 }
                 is_correct=1;
@@ -1352,7 +1943,7 @@ jab_int32 decodeLDPC(jab_float* enc, jab_int32 length, jab_int32 wc, jab_int32 w
                 if(is_correct==0)
                 {
        //             reportError("Too many errors in message. LDPC decoding failed.");
-                    free(matrixA);
+                    scratchFree(matrixA);
                     return 0;
                 }
             }
@@ -1365,6 +1956,6 @@ jab_int32 decodeLDPC(jab_float* enc, jab_int32 length, jab_int32 wc, jab_int32 w
             loop++;
         }
     }
-    free(matrixA);
+    scratchFree(matrixA);
     return decoded_data_len;
 }
@@ -23,8 +23,28 @@
 //static const jab_vector2d default_ecl = {4, 7};	//default (wc, wr) for LDPC, corresponding to ecc level 5.
 //static const jab_vector2d default_ecl = {5, 6};	//This (wc, wr) could be used, if higher robustness is preferred to capacity.
 
+/**
+ * @brief Precomputed Gauss Jordan elimination result of a parity check matrix
+*/
+typedef struct {
+	jab_int32			wc;				///< The number of '1's in a column
+	jab_int32			wr;				///< The number of '1's in a row, 0 for metadata
+	jab_int32			capacity;		///< The number of columns of the matrix
+	jab_int32			matrix_rank;	///< The rank of the matrix
+	jab_int32			swap_number;	///< The number of column swaps
+	const jab_uint16*	row_order;		///< The order of the rows of the rearranged matrix
+	const jab_uint16*	swap_col;		///< The pairs of swapped columns
+}jab_ldpc_table;
+
+//the tables are sorted by wr, wc and capacity
+extern const jab_ldpc_table jab_ldpc_tables[];
+extern const jab_int32 jab_ldpc_table_number;
+
+extern jab_int32 getParityCheckOrder(jab_int32 wc, jab_int32 wr, jab_int32 capacity, jab_int32* matrix_rank, jab_int32* row_order, jab_int32* swap_col, jab_int32* swap_number);
 extern jab_data *encodeLDPC(jab_data* data, jab_int32* coderate_params);
-extern jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32 wr);
+extern void setLDPCDecodeOptions(jab_int32 max_iter, jab_int32 policy);
+extern jab_int32 decodeMessageBP(jab_float* enc, jab_int32* matrix, jab_int32 length, jab_int32 checkbits, jab_int32 height, jab_int32 max_iter, jab_boolean *is_correct, jab_int32 start_pos, jab_byte* dec, jab_int32* iterations);
+extern jab_int32 decodeLDPChd(jab_byte* data, jab_int32 length, jab_int32 wc, jab_int32 wr, jab_ldpc_stats* stats);
 extern jab_int32 decodeLDPC(jab_float* enc, jab_int32 length, jab_int32 wc, jab_int32 wr, jab_byte* dec);
 
 
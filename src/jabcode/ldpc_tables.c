@@ -0,0 +1,18 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file ldpc_tables.c
+ * @brief Empty stub of the precomputed LDPC parity check matrix tables, 'make ldpc-tables' generates them into build/ldpc_tables.c
+ */
+
+#include "jabcode.h"
+#include "ldpc.h"
+
+const jab_ldpc_table jab_ldpc_tables[] = {{0}};
+const jab_int32 jab_ldpc_table_number = 0;
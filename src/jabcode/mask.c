@@ -18,6 +18,7 @@
 #include "jabcode.h"
 #include "encoder.h"
 #include "detector.h"
+#include "arena.h"
 
 #define W1	100
 #define W2	3
@@ -366,7 +367,7 @@ jab_int32 maskCode(jab_encode* enc, jab_code* cp)
 	jab_int32 min_penalty_score = 10000;
 
 	//allocate memory for masked code
-    jab_int32* masked = (jab_int32 *)malloc(cp->code_size.x * cp->code_size.y * sizeof(jab_int32));
+    jab_int32* masked = (jab_int32 *)scratchMalloc(cp->code_size.x * cp->code_size.y * sizeof(jab_int32));
     if(masked == NULL)
     {
         reportError("Memory allocation for masked code failed");
@@ -381,6 +382,8 @@ jab_int32 maskCode(jab_encode* enc, jab_code* cp)
 		maskSymbols(enc, t, masked, cp);
 		//calculate the penalty score
 		penalty_score = evaluateMask(masked, cp->code_size.x, cp->code_size.y, enc->color_number);
+		if(enc->record_stats)
+			enc->stats.mask_penalty[t] = penalty_score;
 #if TEST_MODE
 		//JAB_REPORT_INFO(("Penalty score: %d", penalty_score))
 #endif
@@ -391,11 +394,14 @@ jab_int32 maskCode(jab_encode* enc, jab_code* cp)
 		}
 	}
 
+	if(enc->record_stats)
+		enc->stats.mask_type = mask_type;
+
 	//mask all symbols with the selected mask pattern
 	maskSymbols(enc, mask_type, 0, 0);
 
     //clean memory
-    free(masked);
+    scratchFree(masked);
 	return mask_type;
 }
 
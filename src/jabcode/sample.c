@@ -17,22 +17,89 @@
 #include "jabcode.h"
 #include "detector.h"
 #include "decoder.h"
+#include "arena.h"
 
 #define SAMPLE_AREA_WIDTH	(CROSS_AREA_WIDTH / 2 - 2) //width of the columns where the metadata and palette in slave symbol are located
 #define SAMPLE_AREA_HEIGHT	20	//height of the metadata rows including the first row, though it does not contain metadata
 
 /**
- * @brief Sample a symbol
+ * @brief Get the pixel a sampling point falls on, a point at most one pixel outside the image is moved to the border
+ * @param bitmap the image bitmap
+ * @param point the sampling point
+ * @param x the x coordinate of the pixel
+ * @param y the y coordinate of the pixel
+ * @return JAB_SUCCESS | JAB_FAILURE if the point is outside the image
+*/
+static jab_boolean getSamplePixel(jab_bitmap* bitmap, jab_point point, jab_int32* x, jab_int32* y)
+{
+	jab_int32 mapped_x = (jab_int32)point.x;
+	jab_int32 mapped_y = (jab_int32)point.y;
+	if(mapped_x < 0 || mapped_x > bitmap->width-1)
+	{
+		if(mapped_x == -1) mapped_x = 0;
+		else if(mapped_x ==  bitmap->width) mapped_x = bitmap->width - 1;
+		else return JAB_FAILURE;
+	}
+	if(mapped_y < 0 || mapped_y > bitmap->height-1)
+	{
+		if(mapped_y == -1) mapped_y = 0;
+		else if(mapped_y ==  bitmap->height) mapped_y = bitmap->height - 1;
+		else return JAB_FAILURE;
+	}
+	*x = mapped_x;
+	*y = mapped_y;
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Sample a module as the average of the pixel values in the 3x3 neighborhood of its mapped position
+ * @param bitmap the image bitmap
+ * @param point the mapped module position
+ * @param module the sampled pixel values of the module
+ * @return JAB_SUCCESS | JAB_FAILURE if the module is outside the image
+*/
+static jab_boolean sampleModule(jab_bitmap* bitmap, jab_point point, jab_byte* module)
+{
+	jab_int32 mapped_x, mapped_y;
+	if(!getSamplePixel(bitmap, point, &mapped_x, &mapped_y))
+		return JAB_FAILURE;
+
+	jab_int32 bmp_bytes_per_pixel = bitmap->bits_per_pixel / 8;
+	jab_int32 bmp_bytes_per_row = bitmap->width * bmp_bytes_per_pixel;
+	for(jab_int32 c=0; c<bitmap->channel_count; c++)
+	{
+		jab_float sum = 0;
+		for(jab_int32 dx=-1; dx<=1; dx++)
+		{
+			for(jab_int32 dy=-1; dy<=1; dy++)
+			{
+				jab_int32 px = mapped_x + dx;
+				jab_int32 py = mapped_y + dy;
+				if(px < 0 || px > bitmap->width - 1)  px = mapped_x;
+				if(py < 0 || py > bitmap->height - 1) py = mapped_y;
+				sum += bitmap->pixel[py*bmp_bytes_per_row + px*bmp_bytes_per_pixel + c];
+			}
+		}
+		module[c] = (jab_byte)(sum / 9.0f + 0.5f);
+#if TEST_MODE
+		test_mode_bitmap->pixel[mapped_y*bmp_bytes_per_row + mapped_x*bmp_bytes_per_pixel + c] = test_mode_color;
+		if(c == 3 && test_mode_color == 0)
+			test_mode_bitmap->pixel[mapped_y*bmp_bytes_per_row + mapped_x*bmp_bytes_per_pixel + c] = 255;
+#endif
+	}
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Create the bitmap of a sampled symbol matrix
  * @param bitmap the image bitmap
- * @param pt the transformation matrix
  * @param side_size the symbol size in module
- * @return the sampled symbol matrix
+ * @return the matrix | NULL if failed
 */
-jab_bitmap* sampleSymbol(jab_bitmap* bitmap, jab_perspective_transform* pt, jab_vector2d side_size)
+static jab_bitmap* createSampleMatrix(jab_bitmap* bitmap, jab_vector2d side_size)
 {
 	jab_int32 mtx_bytes_per_pixel = bitmap->bits_per_pixel / 8;
-	jab_int32 mtx_bytes_per_row = side_size.x * mtx_bytes_per_pixel;
-	jab_bitmap* matrix = (jab_bitmap*)malloc(sizeof(jab_bitmap) + side_size.x*side_size.y*mtx_bytes_per_pixel*sizeof(jab_byte));
+	jab_bitmap* matrix = (jab_bitmap*)scratchMalloc(sizeof(jab_bitmap) + side_size.x*side_size.y*mtx_bytes_per_pixel*sizeof(jab_byte));
 	if(matrix == NULL)
 	{
 		reportError("Memory allocation for symbol bitmap matrix failed");
@@ -43,9 +110,23 @@ jab_bitmap* sampleSymbol(jab_bitmap* bitmap, jab_perspective_transform* pt, jab_
 	matrix->bits_per_pixel = matrix->bits_per_channel * matrix->channel_count;
 	matrix->width = side_size.x;
 	matrix->height= side_size.y;
+	return matrix;
+}
 
-	jab_int32 bmp_bytes_per_pixel = bitmap->bits_per_pixel / 8;
-	jab_int32 bmp_bytes_per_row = bitmap->width * bmp_bytes_per_pixel;
+/**
+ * @brief Sample a symbol
+ * @param bitmap the image bitmap
+ * @param pt the transformation matrix
+ * @param side_size the symbol size in module
+ * @return the sampled symbol matrix
+*/
+jab_bitmap* sampleSymbol(jab_bitmap* bitmap, jab_perspective_transform* pt, jab_vector2d side_size)
+{
+	jab_bitmap* matrix = createSampleMatrix(bitmap, side_size);
+	if(matrix == NULL)
+		return NULL;
+	jab_int32 mtx_bytes_per_pixel = matrix->bits_per_pixel / 8;
+	jab_int32 mtx_bytes_per_row = side_size.x * mtx_bytes_per_pixel;
 
 	jab_point points[side_size.x];
     for(jab_int32 i=0; i<side_size.y; i++)
@@ -58,43 +139,69 @@ jab_bitmap* sampleSymbol(jab_bitmap* bitmap, jab_perspective_transform* pt, jab_
 		warpPoints(pt, points, side_size.x);
 		for(jab_int32 j=0; j<side_size.x; j++)
 		{
-			jab_int32 mapped_x = (jab_int32)points[j].x;
-			jab_int32 mapped_y = (jab_int32)points[j].y;
-			if(mapped_x < 0 || mapped_x > bitmap->width-1)
+			if(!sampleModule(bitmap, points[j], &matrix->pixel[i*mtx_bytes_per_row + j*mtx_bytes_per_pixel]))
 			{
-				if(mapped_x == -1) mapped_x = 0;
-				else if(mapped_x ==  bitmap->width) mapped_x = bitmap->width - 1;
-				else return NULL;
+				scratchFree(matrix);
+				return NULL;
 			}
-			if(mapped_y < 0 || mapped_y > bitmap->height-1)
+		}
+    }
+	return matrix;
+}
+
+/**
+ * @brief Sample a symbol piecewise in one pass, each module using the transformation matrix of the block it belongs to
+ * @param bitmap the image bitmap
+ * @param pts the transformation matrices of the blocks
+ * @param origins the top-left module of each block in the symbol
+ * @param sizes the size of each block in module
+ * @param block_number the number of blocks
+ * @param block_map the block index of each module, 0xFF if the module is not covered by any block
+ * @param side_size the symbol size in module
+ * @return the sampled symbol matrix | NULL if failed
+*/
+jab_bitmap* sampleSymbolByBlocks(jab_bitmap* bitmap, jab_perspective_transform* pts, jab_vector2d* origins, jab_vector2d* sizes,
+								 jab_int32 block_number, jab_byte* block_map, jab_vector2d side_size)
+{
+	//every block must lie inside the image as a whole, including the modules a later block overrides
+	for(jab_int32 b=0; b<block_number; b++)
+	{
+		for(jab_int32 i=0; i<sizes[b].y; i++)
+		{
+			for(jab_int32 j=0; j<sizes[b].x; j++)
 			{
-				if(mapped_y == -1) mapped_y = 0;
-				else if(mapped_y ==  bitmap->height) mapped_y = bitmap->height - 1;
-				else return NULL;
+				jab_point point = {(jab_float)j + 0.5f, (jab_float)i + 0.5f};
+				jab_int32 x, y;
+				warpPoints(&pts[b], &point, 1);
+				if(!getSamplePixel(bitmap, point, &x, &y))
+					return NULL;
 			}
-			for(jab_int32 c=0; c<matrix->channel_count; c++)
+		}
+	}
+
+	jab_bitmap* matrix = createSampleMatrix(bitmap, side_size);
+	if(matrix == NULL)
+		return NULL;
+	jab_int32 mtx_bytes_per_pixel = matrix->bits_per_pixel / 8;
+	jab_int32 mtx_bytes_per_row = side_size.x * mtx_bytes_per_pixel;
+	//the modules not covered by any block stay black
+	memset(matrix->pixel, 0, side_size.y * mtx_bytes_per_row);
+
+    for(jab_int32 i=0; i<side_size.y; i++)
+    {
+		for(jab_int32 j=0; j<side_size.x; j++)
+		{
+			jab_byte blk = block_map[i*side_size.x + j];
+			if(blk == 0xFF) continue;
+			//the module position relative to its block
+			jab_point point;
+			point.x = (jab_float)(j - origins[blk].x) + 0.5f;
+			point.y = (jab_float)(i - origins[blk].y) + 0.5f;
+			warpPoints(&pts[blk], &point, 1);
+			if(!sampleModule(bitmap, point, &matrix->pixel[i*mtx_bytes_per_row + j*mtx_bytes_per_pixel]))
 			{
-				//get the average of pixel values in 3x3 neighborhood as the sampled value
-				jab_float sum = 0;
-				for(jab_int32 dx=-1; dx<=1; dx++)
-				{
-					for(jab_int32 dy=-1; dy<=1; dy++)
-					{
-						jab_int32 px = mapped_x + dx;
-						jab_int32 py = mapped_y + dy;
-						if(px < 0 || px > bitmap->width - 1)  px = mapped_x;
-						if(py < 0 || py > bitmap->height - 1) py = mapped_y;
-						sum += bitmap->pixel[py*bmp_bytes_per_row + px*bmp_bytes_per_pixel + c];
-					}
-				}
-				jab_byte ave = (jab_byte)(sum / 9.0f + 0.5f);
-				matrix->pixel[i*mtx_bytes_per_row + j*mtx_bytes_per_pixel + c] = ave;
-				//matrix->pixel[i*mtx_bytes_per_row + j*mtx_bytes_per_pixel + c] = bitmap->pixel[mapped_y*bmp_bytes_per_row + mapped_x*bmp_bytes_per_pixel + c];
-#if TEST_MODE
-				test_mode_bitmap->pixel[mapped_y*bmp_bytes_per_row + mapped_x*bmp_bytes_per_pixel + c] = test_mode_color;
-				if(c == 3 && test_mode_color == 0)
-                    test_mode_bitmap->pixel[mapped_y*bmp_bytes_per_row + mapped_x*bmp_bytes_per_pixel + c] = 255;
-#endif
+				scratchFree(matrix);
+				return NULL;
 			}
 		}
     }
@@ -111,7 +218,7 @@ jab_bitmap* sampleCrossArea(jab_bitmap* bitmap, jab_perspective_transform* pt)
 {
 	jab_int32 mtx_bytes_per_pixel = bitmap->bits_per_pixel / 8;
 	jab_int32 mtx_bytes_per_row = SAMPLE_AREA_WIDTH * mtx_bytes_per_pixel;
-	jab_bitmap* matrix = (jab_bitmap*)malloc(sizeof(jab_bitmap) + SAMPLE_AREA_WIDTH*SAMPLE_AREA_HEIGHT*mtx_bytes_per_pixel*sizeof(jab_byte));
+	jab_bitmap* matrix = (jab_bitmap*)scratchMalloc(sizeof(jab_bitmap) + SAMPLE_AREA_WIDTH*SAMPLE_AREA_HEIGHT*mtx_bytes_per_pixel*sizeof(jab_byte));
 	if(matrix == NULL)
 	{
 		reportError("Memory allocation for cross area bitmap matrix failed");
@@ -144,13 +251,21 @@ jab_bitmap* sampleCrossArea(jab_bitmap* bitmap, jab_perspective_transform* pt)
 			{
 				if(mapped_x == -1) mapped_x = 0;
 				else if(mapped_x ==  bitmap->width) mapped_x = bitmap->width - 1;
-				else return NULL;
+				else
+				{
+					scratchFree(matrix);
+					return NULL;
+				}
 			}
 			if(mapped_y < 0 || mapped_y > bitmap->height-1)
 			{
 				if(mapped_y == -1) mapped_y = 0;
 				else if(mapped_y ==  bitmap->height) mapped_y = bitmap->height - 1;
-				else return NULL;
+				else
+				{
+					scratchFree(matrix);
+					return NULL;
+				}
 			}
 			for(jab_int32 c=0; c<matrix->channel_count; c++)
 			{
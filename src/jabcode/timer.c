@@ -0,0 +1,87 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file timer.c
+ * @brief Monotonic clock and decode stage timers
+ */
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#define _POSIX_C_SOURCE 199309L	//clock_gettime is not part of C11
+#include <time.h>
+#endif
+#include "jabcode.h"
+#include "timer.h"
+
+/**
+ * @brief Read the monotonic clock
+ * @return the time in nanoseconds since an unspecified starting point
+*/
+jab_int64 getMonotonicTime(void)
+{
+#if defined(_WIN32)
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (jab_int64)(counter.QuadPart / frequency.QuadPart * 1000000000LL + counter.QuadPart % frequency.QuadPart * 1000000000LL / frequency.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (jab_int64)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+/**
+ * @brief The statistics the decode stages of the calling thread are recorded in, NULL if not recorded
+*/
+static _Thread_local jab_decode_stats* decode_stats = NULL;
+
+/**
+ * @brief Set the statistics the decode stages of the calling thread are recorded in
+ * @param stats the statistics, NULL to stop recording
+ * @return the previously set statistics
+*/
+jab_decode_stats* setDecodeStats(jab_decode_stats* stats)
+{
+	jab_decode_stats* prev = decode_stats;
+	decode_stats = stats;
+	return prev;
+}
+
+/**
+ * @brief Get the statistics the decode stages of the calling thread are recorded in
+ * @return the statistics | NULL if not recorded
+*/
+jab_decode_stats* getDecodeStats(void)
+{
+	return decode_stats;
+}
+
+/**
+ * @brief Start timing a decode stage
+ * @return the start time | 0 if not recorded
+*/
+jab_int64 startDecodeStage(void)
+{
+	return decode_stats ? getMonotonicTime() : 0;
+}
+
+/**
+ * @brief Finish timing a decode stage
+ * @param stage the decode stage
+ * @param start the start time returned by startDecodeStage
+*/
+void endDecodeStage(jab_int32 stage, jab_int64 start)
+{
+	if(decode_stats == NULL)
+		return;
+	decode_stats->stage_time[stage] += getMonotonicTime() - start;
+	decode_stats->stage_count[stage]++;
+}
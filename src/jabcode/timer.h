@@ -0,0 +1,23 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file timer.h
+ * @brief Monotonic clock and decode stage timers header
+ */
+
+#ifndef JABCODE_TIMER_H
+#define JABCODE_TIMER_H
+
+extern jab_int64 getMonotonicTime(void);
+extern jab_decode_stats* setDecodeStats(jab_decode_stats* stats);
+extern jab_decode_stats* getDecodeStats(void);
+extern jab_int64 startDecodeStage(void);
+extern void endDecodeStage(jab_int32 stage, jab_int64 start);
+
+#endif
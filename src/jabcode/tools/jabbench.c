@@ -0,0 +1,968 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file jabbench.c
+ * @brief Benchmark of encoding and decoding a deterministic corpus of codes with synthetic degradations
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "jabcode.h"
+#include "encoder.h"
+#include "detector.h"
+#include "timer.h"
+
+#define MAX_LIST_LENGTH		16
+#define MAX_REPEAT			100
+#define DEGRADATION_NUMBER	6
+#define JPEG_QUALITY		75
+#define PNG_WRITER_NUMBER	3
+#define TIFF_WRITER_NUMBER	4
+
+extern jab_int32 getSymbolCapacity(jab_encode* enc, jab_int32 index);
+
+static const jab_char* degradation_names[DEGRADATION_NUMBER] = {"none", "blur", "noise", "warp", "scale", "jpeg"};
+static const jab_char* png_writer_names[PNG_WRITER_NUMBER] = {"rgba_file", "indexed", "indexed_level1"};
+static const jab_char* tiff_writer_names[TIFF_WRITER_NUMBER] = {"none", "lzw", "deflate", "packbits"};
+static const jab_int32 tiff_compressions[TIFF_WRITER_NUMBER] = {TIFF_COMPRESSION_NONE, TIFF_COMPRESSION_LZW, TIFF_COMPRESSION_DEFLATE,
+																 TIFF_COMPRESSION_PACKBITS};
+static const jab_char* encode_stage_names[ENCODE_STAGE_NUMBER] = {"analyze", "encode", "fit", "ldpc", "interleave", "matrix", "mask", "bitmap"};
+static const jab_char* decode_stage_names[DECODE_STAGE_NUMBER] = {"balance", "binarize", "filter", "finder", "retry_binarize", "sampling",
+																	"palette", "metadata", "module_read", "demask", "deinterleave", "ldpc", "data"};
+
+static const jab_byte jpeg_luminance_table[64] = {
+	16, 11, 10, 16, 24, 40, 51, 61,		12, 12, 14, 19, 26, 58, 60, 55,
+	14, 13, 16, 24, 40, 57, 69, 56,		14, 17, 22, 29, 51, 87, 80, 62,
+	18, 22, 37, 56, 68,109,103, 77,		24, 35, 55, 64, 81,104,113, 92,
+	49, 64, 78, 87,103,121,120,101,		72, 92, 95, 98,112,100,103, 99
+};
+static const jab_byte jpeg_chrominance_table[64] = {
+	17, 18, 24, 47, 99, 99, 99, 99,		18, 21, 26, 66, 99, 99, 99, 99,
+	24, 26, 56, 99, 99, 99, 99, 99,		47, 66, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99,		99, 99, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99,		99, 99, 99, 99, 99, 99, 99, 99
+};
+
+/**
+ * @brief A list of corpus parameter values
+*/
+typedef struct {
+	jab_int32 length;
+	jab_int32 values[MAX_LIST_LENGTH];
+}jab_value_list;
+
+/**
+ * @brief The accumulated results of the benchmark
+*/
+typedef struct {
+	jab_int32	codes;
+	jab_int32	encoded;
+	jab_int64	encode_bytes;
+	jab_int64	encode_time;
+	jab_int64	encode_peak;
+	jab_int64	encode_stage_time[ENCODE_STAGE_NUMBER];
+	jab_int64	png_bytes[PNG_WRITER_NUMBER];
+	jab_int64	png_time[PNG_WRITER_NUMBER];
+	jab_int64	tiff_bytes[TIFF_WRITER_NUMBER];
+	jab_int64	tiff_time[TIFF_WRITER_NUMBER];
+	jab_int32	decodes[DEGRADATION_NUMBER];
+	jab_int32	decoded[DEGRADATION_NUMBER];
+	jab_int64	decode_pixels;
+	jab_int64	decode_bytes;
+	jab_int64	decode_time;
+	jab_int64	decode_peak;
+	jab_int64	decode_stage_time[DECODE_STAGE_NUMBER];
+}jab_bench_summary;
+
+/**
+ * @brief The state of the pseudo random generator of the corpus, independent of the one used by the library
+*/
+static jab_uint64 random_state = 1;
+
+/**
+ * @brief Get the next pseudo random number of the corpus
+ * @return the random number
+*/
+static jab_uint32 nextRandom(void)
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 7;
+	random_state ^= random_state << 17;
+	return (jab_uint32)(random_state >> 16);
+}
+
+/**
+ * @brief Compare two times for qsort
+*/
+static int compareTimes(const void* a, const void* b)
+{
+	jab_int64 x = *(const jab_int64*)a;
+	jab_int64 y = *(const jab_int64*)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief Get the median of measured times
+ * @param times the times, sorted on return
+ * @param length the number of times
+ * @return the median
+*/
+static jab_int64 getMedian(jab_int64* times, jab_int32 length)
+{
+	qsort(times, length, sizeof(jab_int64), compareTimes);
+	return times[length / 2];
+}
+
+/**
+ * @brief Create an RGBA bitmap filled with white
+ * @param width the bitmap width
+ * @param height the bitmap height
+ * @return the bitmap | NULL if failed
+*/
+static jab_bitmap* createWhiteBitmap(jab_int32 width, jab_int32 height)
+{
+	jab_bitmap* bitmap = (jab_bitmap*)malloc(sizeof(jab_bitmap) + width * height * BITMAP_CHANNEL_COUNT);
+	if(bitmap == NULL)
+	{
+		reportError("Memory allocation for degraded bitmap failed");
+		return NULL;
+	}
+	bitmap->width = width;
+	bitmap->height = height;
+	bitmap->bits_per_pixel = BITMAP_BITS_PER_PIXEL;
+	bitmap->bits_per_channel = BITMAP_BITS_PER_CHANNEL;
+	bitmap->channel_count = BITMAP_CHANNEL_COUNT;
+	memset(bitmap->pixel, 255, width * height * BITMAP_CHANNEL_COUNT);
+	return bitmap;
+}
+
+/**
+ * @brief Sample the RGB values of a bitmap at a subpixel position by bilinear interpolation, white outside the bitmap
+ * @param bitmap the bitmap
+ * @param x the x coordinate in pixels, pixel centers at .5
+ * @param y the y coordinate in pixels, pixel centers at .5
+ * @param rgb the sampled RGB values
+*/
+static void sampleBilinear(jab_bitmap* bitmap, jab_float x, jab_float y, jab_byte* rgb)
+{
+	x -= 0.5f;
+	y -= 0.5f;
+	jab_int32 x0 = (jab_int32)floorf(x);
+	jab_int32 y0 = (jab_int32)floorf(y);
+	jab_float fx = x - x0;
+	jab_float fy = y - y0;
+	for(jab_int32 c=0; c<3; c++)
+	{
+		jab_float value = 0;
+		for(jab_int32 j=0; j<2; j++)
+		{
+			for(jab_int32 i=0; i<2; i++)
+			{
+				jab_int32 px = x0 + i;
+				jab_int32 py = y0 + j;
+				jab_float weight = (i ? fx : 1 - fx) * (j ? fy : 1 - fy);
+				if(px < 0 || py < 0 || px >= bitmap->width || py >= bitmap->height)
+					value += weight * 255;
+				else
+					value += weight * bitmap->pixel[(py * bitmap->width + px) * BITMAP_CHANNEL_COUNT + c];
+			}
+		}
+		rgb[c] = (jab_byte)(value + 0.5f);
+	}
+}
+
+/**
+ * @brief Blur a bitmap by a separable 5-tap binomial filter
+ * @param src the source bitmap
+ * @return the blurred bitmap | NULL if failed
+*/
+static jab_bitmap* blurBitmap(jab_bitmap* src)
+{
+	static const jab_int32 kernel[5] = {1, 4, 6, 4, 1};
+	jab_int32 w = src->width, h = src->height;
+	jab_bitmap* tmp = createWhiteBitmap(w, h);
+	jab_bitmap* dst = createWhiteBitmap(w, h);
+	if(tmp == NULL || dst == NULL)
+	{
+		free(tmp);
+		free(dst);
+		return NULL;
+	}
+	for(jab_int32 pass=0; pass<2; pass++)
+	{
+		jab_bitmap* in = pass ? tmp : src;
+		jab_bitmap* out = pass ? dst : tmp;
+		for(jab_int32 y=0; y<h; y++)
+		{
+			for(jab_int32 x=0; x<w; x++)
+			{
+				for(jab_int32 c=0; c<3; c++)
+				{
+					jab_int32 sum = 0;
+					for(jab_int32 k=-2; k<=2; k++)
+					{
+						jab_int32 px = pass ? x : MIN(MAX(x + k, 0), w - 1);
+						jab_int32 py = pass ? MIN(MAX(y + k, 0), h - 1) : y;
+						sum += kernel[k + 2] * in->pixel[(py * w + px) * BITMAP_CHANNEL_COUNT + c];
+					}
+					out->pixel[(y * w + x) * BITMAP_CHANNEL_COUNT + c] = (jab_byte)((sum + 8) / 16);
+				}
+			}
+		}
+	}
+	free(tmp);
+	return dst;
+}
+
+/**
+ * @brief Add pseudo random noise to the color channels of a bitmap
+ * @param src the source bitmap
+ * @return the noisy bitmap | NULL if failed
+*/
+static jab_bitmap* addNoise(jab_bitmap* src)
+{
+	jab_bitmap* dst = createWhiteBitmap(src->width, src->height);
+	if(dst == NULL)
+		return NULL;
+	for(jab_int32 i=0; i<src->width*src->height; i++)
+	{
+		for(jab_int32 c=0; c<3; c++)
+		{
+			//the sum of three uniform values approximates a normal distribution with a deviation of about 16
+			jab_int32 noise = (jab_int32)(nextRandom() % 33) + (jab_int32)(nextRandom() % 33) + (jab_int32)(nextRandom() % 33) - 48;
+			jab_int32 value = src->pixel[i * BITMAP_CHANNEL_COUNT + c] + noise;
+			dst->pixel[i * BITMAP_CHANNEL_COUNT + c] = (jab_byte)MIN(MAX(value, 0), 255);
+		}
+	}
+	return dst;
+}
+
+/**
+ * @brief Warp a bitmap by a perspective transform into a larger canvas with a white border
+ * @param src the source bitmap
+ * @return the warped bitmap | NULL if failed
+*/
+static jab_bitmap* warpBitmap(jab_bitmap* src)
+{
+	jab_float w = src->width, h = src->height;
+	jab_float margin = MAX(w, h) / 8;
+	jab_bitmap* dst = createWhiteBitmap(src->width + 2 * margin, src->height + 2 * margin);
+	if(dst == NULL)
+		return NULL;
+	//map the destination quadrilateral back onto the source rectangle
+	jab_perspective_transform pt;
+	calcPerspectiveTransform(margin + 0.05f * w, margin + 0.03f * h,
+							 margin + 0.97f * w, margin,
+							 margin + w, margin + 0.96f * h,
+							 margin, margin + h,
+							 0, 0, w, 0, w, h, 0, h, &pt);
+	for(jab_int32 y=0; y<dst->height; y++)
+	{
+		for(jab_int32 x=0; x<dst->width; x++)
+		{
+			jab_point p = {x + 0.5f, y + 0.5f};
+			warpPoints(&pt, &p, 1);
+			sampleBilinear(src, p.x, p.y, &dst->pixel[(y * dst->width + x) * BITMAP_CHANNEL_COUNT]);
+		}
+	}
+	return dst;
+}
+
+/**
+ * @brief Scale a bitmap down to three quarters by bilinear interpolation
+ * @param src the source bitmap
+ * @return the scaled bitmap | NULL if failed
+*/
+static jab_bitmap* scaleBitmap(jab_bitmap* src)
+{
+	const jab_float scale = 0.75f;
+	jab_bitmap* dst = createWhiteBitmap(src->width * scale, src->height * scale);
+	if(dst == NULL)
+		return NULL;
+	for(jab_int32 y=0; y<dst->height; y++)
+	{
+		for(jab_int32 x=0; x<dst->width; x++)
+			sampleBilinear(src, (x + 0.5f) / scale, (y + 0.5f) / scale, &dst->pixel[(y * dst->width + x) * BITMAP_CHANNEL_COUNT]);
+	}
+	return dst;
+}
+
+/**
+ * @brief Quantize the DCT coefficients of the 8x8 blocks of a bitmap in YCbCr like a baseline JPEG without subsampling
+ * @param src the source bitmap
+ * @return the quantized bitmap | NULL if failed
+*/
+static jab_bitmap* quantizeBitmap(jab_bitmap* src)
+{
+	jab_bitmap* dst = createWhiteBitmap(src->width, src->height);
+	if(dst == NULL)
+		return NULL;
+	//the quantization tables scaled to the quality as by the IJG encoder
+	jab_int32 scaling = JPEG_QUALITY < 50 ? 5000 / JPEG_QUALITY : 200 - 2 * JPEG_QUALITY;
+	jab_float quant[2][64];
+	for(jab_int32 i=0; i<64; i++)
+	{
+		quant[0][i] = MIN(MAX((jpeg_luminance_table[i] * scaling + 50) / 100, 1), 255);
+		quant[1][i] = MIN(MAX((jpeg_chrominance_table[i] * scaling + 50) / 100, 1), 255);
+	}
+	jab_float basis[8][8];
+	for(jab_int32 u=0; u<8; u++)
+	{
+		for(jab_int32 x=0; x<8; x++)
+			basis[u][x] = (u == 0 ? sqrtf(0.125f) : 0.5f) * cosf((2 * x + 1) * u * 3.14159265f / 16);
+	}
+	for(jab_int32 by=0; by<src->height; by+=8)
+	{
+		for(jab_int32 bx=0; bx<src->width; bx+=8)
+		{
+			//convert the block to YCbCr, the pixels outside the bitmap repeat the border
+			jab_float block[3][8][8], coef[8][8], tmp[8][8];
+			for(jab_int32 y=0; y<8; y++)
+			{
+				for(jab_int32 x=0; x<8; x++)
+				{
+					jab_int32 px = MIN(bx + x, src->width - 1);
+					jab_int32 py = MIN(by + y, src->height - 1);
+					jab_byte* p = &src->pixel[(py * src->width + px) * BITMAP_CHANNEL_COUNT];
+					block[0][y][x] = 0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2] - 128;
+					block[1][y][x] = -0.168736f * p[0] - 0.331264f * p[1] + 0.5f * p[2];
+					block[2][y][x] = 0.5f * p[0] - 0.418688f * p[1] - 0.081312f * p[2];
+				}
+			}
+			for(jab_int32 c=0; c<3; c++)
+			{
+				//forward DCT, quantization and inverse DCT
+				for(jab_int32 v=0; v<8; v++)
+					for(jab_int32 x=0; x<8; x++)
+					{
+						tmp[v][x] = 0;
+						for(jab_int32 y=0; y<8; y++)
+							tmp[v][x] += basis[v][y] * block[c][y][x];
+					}
+				for(jab_int32 v=0; v<8; v++)
+					for(jab_int32 u=0; u<8; u++)
+					{
+						jab_float sum = 0;
+						for(jab_int32 x=0; x<8; x++)
+							sum += basis[u][x] * tmp[v][x];
+						jab_float q = quant[c ? 1 : 0][v * 8 + u];
+						coef[v][u] = roundf(sum / q) * q;
+					}
+				for(jab_int32 y=0; y<8; y++)
+					for(jab_int32 u=0; u<8; u++)
+					{
+						tmp[y][u] = 0;
+						for(jab_int32 v=0; v<8; v++)
+							tmp[y][u] += basis[v][y] * coef[v][u];
+					}
+				for(jab_int32 y=0; y<8; y++)
+					for(jab_int32 x=0; x<8; x++)
+					{
+						jab_float sum = 0;
+						for(jab_int32 u=0; u<8; u++)
+							sum += basis[u][x] * tmp[y][u];
+						block[c][y][x] = sum;
+					}
+			}
+			for(jab_int32 y=0; y<8 && by + y<src->height; y++)
+			{
+				for(jab_int32 x=0; x<8 && bx + x<src->width; x++)
+				{
+					jab_float yy = block[0][y][x] + 128, cb = block[1][y][x], cr = block[2][y][x];
+					jab_float rgb[3] = {yy + 1.402f * cr, yy - 0.344136f * cb - 0.714136f * cr, yy + 1.772f * cb};
+					jab_byte* p = &dst->pixel[((by + y) * dst->width + bx + x) * BITMAP_CHANNEL_COUNT];
+					for(jab_int32 c=0; c<3; c++)
+						p[c] = (jab_byte)MIN(MAX(rgb[c] + 0.5f, 0), 255);
+				}
+			}
+		}
+	}
+	return dst;
+}
+
+/**
+ * @brief Apply a synthetic degradation to a code bitmap
+ * @param src the code bitmap
+ * @param degradation the index in degradation_names
+ * @return the degraded bitmap | NULL if failed
+*/
+static jab_bitmap* degradeBitmap(jab_bitmap* src, jab_int32 degradation)
+{
+	switch(degradation)
+	{
+	case 1:
+		return blurBitmap(src);
+	case 2:
+		return addNoise(src);
+	case 3:
+		return warpBitmap(src);
+	case 4:
+		return scaleBitmap(src);
+	case 5:
+		return quantizeBitmap(src);
+	default:
+	{
+		jab_int32 size = sizeof(jab_bitmap) + src->width * src->height * BITMAP_CHANNEL_COUNT;
+		jab_bitmap* dst = (jab_bitmap*)malloc(size);
+		if(dst == NULL)
+			reportError("Memory allocation for degraded bitmap failed");
+		else
+			memcpy(dst, src, size);
+		return dst;
+	}
+	}
+}
+
+/**
+ * @brief Fill a payload with pseudo random text of mixed character classes
+ * @param data the payload
+*/
+static void fillPayload(jab_data* data)
+{
+	static const jab_char charset[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 abcdefghijklmnopqrstuvwxyz,.:/-";
+	for(jab_int32 i=0; i<data->length; i++)
+		data->data[i] = charset[nextRandom() % (sizeof(charset) - 1)];
+}
+
+/**
+ * @brief Estimate the payload length in bytes that fills most of the net capacity of a code
+ * @param enc the encode parameters with the symbol versions and error correction levels set
+ * @return the payload length
+*/
+static jab_int32 estimatePayloadLength(jab_encode* enc)
+{
+	jab_int32 bits = 0;
+	for(jab_int32 i=0; i<enc->symbol_number; i++)
+	{
+		jab_int32 wc = ecclevel2wcwr[enc->symbol_ecc_levels[i]][0];
+		jab_int32 wr = ecclevel2wcwr[enc->symbol_ecc_levels[i]][1];
+		bits += getSymbolCapacity(enc, i) / wr * (wr - wc);
+	}
+	return MAX(bits / 8 * 9 / 10, 1);
+}
+
+/**
+ * @brief Print stage times as a JSON object
+ * @param out the output file
+ * @param names the stage names
+ * @param times the stage times in nanoseconds
+ * @param number the number of stages
+ * @param divisor the number of runs the times are summed over
+*/
+static void printStageTimes(FILE* out, const jab_char** names, jab_int64* times, jab_int32 number, jab_int32 divisor)
+{
+	fprintf(out, "{");
+	for(jab_int32 i=0; i<number; i++)
+		fprintf(out, "%s\"%s\": %lld", i ? ", " : "", names[i], (long long)(times[i] / divisor));
+	fprintf(out, "}");
+}
+
+/**
+ * @brief Get the size of a file and remove it
+ * @param filename the file
+ * @return the file size in bytes | -1 if the file could not be read
+*/
+static jab_int64 removeFile(jab_char* filename)
+{
+	jab_int64 bytes = -1;
+	FILE* fp = fopen(filename, "rb");
+	if(fp && fseek(fp, 0, SEEK_END) == 0)
+		bytes = ftell(fp);
+	if(fp)
+		fclose(fp);
+	remove(filename);
+	return bytes;
+}
+
+/**
+ * @brief Write the code bitmap as png with saveImage and with saveImageToMemory at the default and the fastest
+ * compression level, and print the sizes and times as a JSON object
+ * @param out the output file
+ * @param summary the accumulated results
+ * @param bitmap the code bitmap
+ * @param repeat the number of runs each time is the median of
+ * @param png_file the temporary file saveImage writes to
+*/
+static void benchPNG(FILE* out, jab_bench_summary* summary, jab_bitmap* bitmap, jab_int32 repeat, jab_char* png_file)
+{
+	jab_int64 times[MAX_REPEAT];
+	fprintf(out, "     \"png\": {");
+	for(jab_int32 w=0; w<PNG_WRITER_NUMBER; w++)
+	{
+		jab_int64 bytes = -1;
+		for(jab_int32 r=0; r<repeat; r++)
+		{
+			jab_int64 start = getMonotonicTime();
+			if(w == 0)
+			{
+				saveImage(bitmap, png_file);
+			}
+			else
+			{
+				jab_data* png = saveImageToMemory(bitmap, NULL, 0, w == 1 ? -1 : 1, ROW_FILTER_DEFAULT);
+				bytes = png ? png->length : -1;
+				free(png);
+			}
+			times[r] = getMonotonicTime() - start;
+		}
+		if(w == 0)
+			bytes = removeFile(png_file);
+		jab_int64 time = getMedian(times, repeat);
+		summary->png_bytes[w] += bytes;
+		summary->png_time[w] += time;
+		fprintf(out, "%s\"%s\": {\"bytes\": %lld, \"ns\": %lld}", w ? ", " : "", png_writer_names[w], (long long)bytes, (long long)time);
+	}
+	fprintf(out, "},\n");
+}
+
+/**
+ * @brief Write the code bitmap as CMYK TIFF with saveImageCMYKEx uncompressed and with every compression, and print
+ * the sizes and times as a JSON object
+ * @param out the output file
+ * @param summary the accumulated results
+ * @param bitmap the code bitmap
+ * @param repeat the number of runs each time is the median of
+ * @param tiff_file the temporary file saveImageCMYKEx writes to
+*/
+static void benchTIFF(FILE* out, jab_bench_summary* summary, jab_bitmap* bitmap, jab_int32 repeat, jab_char* tiff_file)
+{
+	jab_int64 times[MAX_REPEAT];
+	fprintf(out, "     \"tiff\": {");
+	for(jab_int32 w=0; w<TIFF_WRITER_NUMBER; w++)
+	{
+		for(jab_int32 r=0; r<repeat; r++)
+		{
+			jab_int64 start = getMonotonicTime();
+			saveImageCMYKEx(bitmap, 0, tiff_compressions[w], tiff_file);
+			times[r] = getMonotonicTime() - start;
+		}
+		jab_int64 bytes = removeFile(tiff_file);
+		jab_int64 time = getMedian(times, repeat);
+		summary->tiff_bytes[w] += bytes;
+		summary->tiff_time[w] += time;
+		fprintf(out, "%s\"%s\": {\"bytes\": %lld, \"ns\": %lld}", w ? ", " : "", tiff_writer_names[w], (long long)bytes, (long long)time);
+	}
+	fprintf(out, "},\n");
+}
+
+/**
+ * @brief Create an encode parameter with the settings of one code of the corpus
+ * @param color_number the number of colors
+ * @param symbol_number the number of symbols
+ * @param version the side-version of all symbols
+ * @param ecc_level the error correction level of all symbols
+ * @param module_size the module size in pixels
+ * @return the encode parameter | NULL if failed
+*/
+static jab_encode* createBenchEncode(jab_int32 color_number, jab_int32 symbol_number, jab_int32 version, jab_int32 ecc_level,
+									 jab_int32 module_size)
+{
+	jab_encode* enc = createEncode(color_number, symbol_number);
+	if(enc == NULL)
+		return NULL;
+	enc->module_size = module_size;
+	enc->record_stats = 1;
+	for(jab_int32 i=0; i<symbol_number; i++)
+	{
+		enc->symbol_versions[i].x = version;
+		enc->symbol_versions[i].y = version;
+		enc->symbol_ecc_levels[i] = ecc_level;
+		enc->symbol_positions[i] = i;
+	}
+	return enc;
+}
+
+/**
+ * @brief Encode one code of the corpus and decode it with every degradation
+ * @param out the output file
+ * @param summary the accumulated results
+ * @param ctx the decode context
+ * @param color_number the number of colors
+ * @param symbol_number the number of symbols
+ * @param version the side-version of all symbols
+ * @param ecc_level the error correction level of all symbols
+ * @param module_size the module size in pixels
+ * @param repeat the number of runs each measurement is the median of
+ * @param fresh_encoder whether each encode run creates and destroys its own encode parameter
+ * @param decode whether the code is decoded
+ * @param dump_dir the directory the degraded images are saved in, NULL if not saved
+ * @param png_file the temporary file of the png measurement
+ * @param tiff_file the temporary file of the tiff measurement, NULL if tiff is not measured
+*/
+static void benchCode(FILE* out, jab_bench_summary* summary, jab_decode_context* ctx, jab_int32 color_number, jab_int32 symbol_number,
+					  jab_int32 version, jab_int32 ecc_level, jab_int32 module_size, jab_int32 repeat, jab_boolean fresh_encoder,
+					  jab_boolean decode, jab_char* dump_dir, jab_char* png_file, jab_char* tiff_file)
+{
+	if(summary->codes > 0)
+		fprintf(out, ",\n");
+	summary->codes++;
+	fprintf(out, "    {\"colors\": %d, \"symbols\": %d, \"version\": %d, \"ecc\": %d, \"module_size\": %d",
+			color_number, symbol_number, version, ecc_level, module_size);
+
+	jab_encode* enc = createBenchEncode(color_number, symbol_number, version, ecc_level, module_size);
+	if(enc == NULL)
+	{
+		reportError("Creating encode parameter failed");
+		fprintf(out, ", \"encode\": {\"ok\": false, \"error\": 1}}");
+		return;
+	}
+
+	//shrink the payload until it fits, the capacity estimate ignores the encoding modes and the slave metadata
+	jab_int32 length = estimatePayloadLength(enc);
+	jab_data* payload = NULL;
+	jab_int32 result = 4;
+	while(result == 4 && length > 0)
+	{
+		free(payload);
+		payload = (jab_data*)malloc(sizeof(jab_data) + length);
+		if(payload == NULL)
+		{
+			reportError("Memory allocation for payload failed");
+			result = 1;
+			break;
+		}
+		payload->length = length;
+		fillPayload(payload);
+		result = generateJABCode(enc, payload);
+		if(result == 4)
+			length = length * 4 / 5;
+	}
+	if(result != 0)
+	{
+		fprintf(out, ", \"encode\": {\"ok\": false, \"error\": %d}}", result);
+		free(payload);
+		destroyEncode(enc);
+		return;
+	}
+
+	jab_int64 times[MAX_REPEAT];
+	jab_int64 encode_stage_time[ENCODE_STAGE_NUMBER] = {0};
+	jab_int64 decode_stage_time[DECODE_STAGE_NUMBER];
+	jab_int32 heap_allocs = 0;
+	for(jab_int32 r=0; r<repeat; r++)
+	{
+		if(fresh_encoder)
+		{
+			//the time includes creating and destroying the encode parameter, as when each code gets its own
+			jab_int64 start = getMonotonicTime();
+			jab_encode* run_enc = createBenchEncode(color_number, symbol_number, version, ecc_level, module_size);
+			if(run_enc == NULL || generateJABCode(run_enc, payload) != 0)
+			{
+				reportError("Encoding with a fresh encode parameter failed");
+				destroyEncode(run_enc);
+				times[r] = 0;
+				continue;
+			}
+			for(jab_int32 i=0; i<ENCODE_STAGE_NUMBER; i++)
+				encode_stage_time[i] += run_enc->stats.stage_time[i];
+			heap_allocs = run_enc->stats.heap_allocs;
+			destroyEncode(run_enc);
+			times[r] = getMonotonicTime() - start;
+		}
+		else
+		{
+			generateJABCode(enc, payload);
+			times[r] = enc->stats.total_time;
+			for(jab_int32 i=0; i<ENCODE_STAGE_NUMBER; i++)
+				encode_stage_time[i] += enc->stats.stage_time[i];
+			heap_allocs = enc->stats.heap_allocs;
+		}
+	}
+	jab_int64 encode_time = getMedian(times, repeat);
+	summary->encoded++;
+	summary->encode_bytes += length;
+	summary->encode_time += encode_time;
+	summary->encode_peak = MAX(summary->encode_peak, enc->stats.scratch_peak);
+	for(jab_int32 i=0; i<ENCODE_STAGE_NUMBER; i++)
+		summary->encode_stage_time[i] += encode_stage_time[i] / repeat;
+	fprintf(out, ", \"payload_bytes\": %d, \"width\": %d, \"height\": %d,\n", length, enc->bitmap->width, enc->bitmap->height);
+	fprintf(out, "     \"encode\": {\"ok\": true, \"ns\": %lld, \"peak_bytes\": %lld, \"heap_allocs\": %d, \"mask\": %d, \"stage_ns\": ",
+			(long long)encode_time, (long long)enc->stats.scratch_peak, heap_allocs, enc->stats.mask_type);
+	printStageTimes(out, encode_stage_names, encode_stage_time, ENCODE_STAGE_NUMBER, repeat);
+	fprintf(out, "},\n");
+	benchPNG(out, summary, enc->bitmap, repeat, png_file);
+	if(tiff_file)
+		benchTIFF(out, summary, enc->bitmap, repeat, tiff_file);
+	fprintf(out, "     \"decode\": [");
+
+	for(jab_int32 d=0; d<DEGRADATION_NUMBER && decode; d++)
+	{
+		jab_bitmap* bitmap = degradeBitmap(enc->bitmap, d);
+		if(bitmap == NULL)
+			continue;
+		if(dump_dir)
+		{
+			jab_char filename[1024];
+			snprintf(filename, sizeof(filename), "%s/c%d_s%d_v%d_e%d_m%d_%s.png", dump_dir, color_number, symbol_number, version, ecc_level,
+					 module_size, degradation_names[d]);
+			saveImage(bitmap, filename);
+		}
+		jab_boolean ok = 1;
+		jab_int32 status = 0;
+		memset(decode_stage_time, 0, sizeof(decode_stage_time));
+		for(jab_int32 r=0; r<repeat; r++)
+		{
+			jab_data* decoded = decodeJABCodeWithContext(ctx, bitmap, NORMAL_DECODE, &status, NULL, 0);
+			ok = decoded && decoded->length == length && memcmp(decoded->data, payload->data, length) == 0;
+			free(decoded);
+			times[r] = ctx->stats.total_time;
+			for(jab_int32 i=0; i<DECODE_STAGE_NUMBER; i++)
+				decode_stage_time[i] += ctx->stats.stage_time[i];
+		}
+		jab_int64 decode_time = getMedian(times, repeat);
+		summary->decodes[d]++;
+		summary->decoded[d] += ok;
+		summary->decode_pixels += (jab_int64)bitmap->width * bitmap->height;
+		summary->decode_bytes += length;
+		summary->decode_time += decode_time;
+		summary->decode_peak = MAX(summary->decode_peak, ctx->peak_usage);
+		for(jab_int32 i=0; i<DECODE_STAGE_NUMBER; i++)
+			summary->decode_stage_time[i] += decode_stage_time[i] / repeat;
+		fprintf(out, "%s\n      {\"degradation\": \"%s\", \"ok\": %s, \"status\": %d, \"width\": %d, \"height\": %d, \"ns\": %lld, "
+				"\"peak_bytes\": %lld, \"corrected_bits\": %d, \"stage_ns\": ", d ? "," : "", degradation_names[d], ok ? "true" : "false",
+				status, bitmap->width, bitmap->height, (long long)decode_time, (long long)ctx->peak_usage, ctx->stats.corrected_bits);
+		printStageTimes(out, decode_stage_names, decode_stage_time, DECODE_STAGE_NUMBER, repeat);
+		fprintf(out, "}");
+		free(bitmap);
+	}
+	fprintf(out, "]}");
+	fflush(out);
+	free(payload);
+	destroyEncode(enc);
+}
+
+/**
+ * @brief Print the accumulated results as JSON
+ * @param out the output file
+ * @param summary the accumulated results
+*/
+static void printSummary(FILE* out, jab_bench_summary* summary)
+{
+	jab_int32 decodes = 0, decoded = 0;
+	for(jab_int32 d=0; d<DEGRADATION_NUMBER; d++)
+	{
+		decodes += summary->decodes[d];
+		decoded += summary->decoded[d];
+	}
+	fprintf(out, "  \"summary\": {\n");
+	fprintf(out, "    \"codes\": %d, \"encoded\": %d, \"decodes\": %d, \"decoded\": %d, \"success_rate\": %.4f,\n",
+			summary->codes, summary->encoded, decodes, decoded, decodes ? (jab_double)decoded / decodes : 0);
+	fprintf(out, "    \"encode_ns\": %lld, \"encode_bytes_per_s\": %.0f, \"encode_peak_bytes\": %lld,\n", (long long)summary->encode_time,
+			summary->encode_time ? summary->encode_bytes * 1e9 / summary->encode_time : 0, (long long)summary->encode_peak);
+	fprintf(out, "    \"png\": {");
+	for(jab_int32 w=0; w<PNG_WRITER_NUMBER; w++)
+	{
+		fprintf(out, "%s\"%s\": {\"bytes\": %lld, \"ns\": %lld}", w ? ", " : "", png_writer_names[w], (long long)summary->png_bytes[w],
+				(long long)summary->png_time[w]);
+	}
+	fprintf(out, "},\n");
+	fprintf(out, "    \"tiff\": {");
+	for(jab_int32 w=0; w<TIFF_WRITER_NUMBER; w++)
+	{
+		fprintf(out, "%s\"%s\": {\"bytes\": %lld, \"ns\": %lld}", w ? ", " : "", tiff_writer_names[w], (long long)summary->tiff_bytes[w],
+				(long long)summary->tiff_time[w]);
+	}
+	fprintf(out, "},\n");
+	fprintf(out, "    \"decode_ns\": %lld, \"decode_pixels_per_s\": %.0f, \"decode_bytes_per_s\": %.0f, \"decode_peak_bytes\": %lld,\n",
+			(long long)summary->decode_time, summary->decode_time ? summary->decode_pixels * 1e9 / summary->decode_time : 0,
+			summary->decode_time ? summary->decode_bytes * 1e9 / summary->decode_time : 0, (long long)summary->decode_peak);
+	fprintf(out, "    \"degradations\": {");
+	for(jab_int32 d=0; d<DEGRADATION_NUMBER; d++)
+	{
+		fprintf(out, "%s\"%s\": {\"decodes\": %d, \"decoded\": %d, \"success_rate\": %.4f}", d ? ", " : "", degradation_names[d],
+				summary->decodes[d], summary->decoded[d], summary->decodes[d] ? (jab_double)summary->decoded[d] / summary->decodes[d] : 0);
+	}
+	fprintf(out, "},\n    \"encode_stage_ns\": ");
+	printStageTimes(out, encode_stage_names, summary->encode_stage_time, ENCODE_STAGE_NUMBER, 1);
+	fprintf(out, ",\n    \"decode_stage_ns\": ");
+	printStageTimes(out, decode_stage_names, summary->decode_stage_time, DECODE_STAGE_NUMBER, 1);
+	fprintf(out, "\n  }\n");
+}
+
+/**
+ * @brief Print a list of corpus parameter values as a JSON array
+*/
+static void printList(FILE* out, const jab_char* name, jab_value_list* list)
+{
+	fprintf(out, "\"%s\": [", name);
+	for(jab_int32 i=0; i<list->length; i++)
+		fprintf(out, "%s%d", i ? ", " : "", list->values[i]);
+	fprintf(out, "]");
+}
+
+/**
+ * @brief Print usage of the benchmark
+*/
+void printUsage()
+{
+	printf("\n");
+	printf("jabbench (Version %s Build date: %s) - Fraunhofer SIT\n\n", VERSION, BUILD_DATE);
+	printf("Usage:\n\n");
+	printf("jabbench [options]\n");
+	printf("\n");
+	printf("--color-number\t\tNumber of colors of the codes (4,8), may be repeated. The decoder\n\t\t\tsupports no other color number. (default: 4 8)\n");
+	printf("--symbol-number\t\tNumber of symbols of the codes, may be repeated. (default: 1 3)\n");
+	printf("--symbol-version\tSide-version of all symbols of the codes, may be repeated. (default: 6 12)\n");
+	printf("--ecc-level\t\tError correction level of the codes, may be repeated. (default: 3 6)\n");
+	printf("--module-size\t\tModule size in pixels of the codes, may be repeated. (default: 4 8)\n");
+	printf("--repeat\t\tNumber of runs each time is the median of. (default: 3)\n");
+	printf("--fresh-encoder\t\tCreate a new encode parameter for every encode run instead of reusing one.\n");
+	printf("--tiff\t\t\tAlso measure writing the codes as CMYK TIFF with every compression.\n");
+	printf("--no-decode\t\tOnly encode and write the codes, e.g. for large codes.\n");
+	printf("--seed\t\t\tSeed of the payloads and the noise. (default: 1)\n");
+	printf("--label\t\t\tLabel of the run written to the results, e.g. a commit id.\n");
+	printf("--output\t\tFile the JSON results are written to. (default: bench.json)\n");
+	printf("--dump\t\t\tDirectory the degraded images are saved in as PNG.\n");
+	printf("--help\t\t\tPrint this help.\n");
+	printf("\n");
+}
+
+/**
+ * @brief Add a value to a list of corpus parameter values
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+static jab_boolean addValue(jab_value_list* list, jab_char* value, jab_int32 min, jab_int32 max)
+{
+	jab_int32 v = atoi(value);
+	if(list->length == MAX_LIST_LENGTH || v < min || v > max)
+		return JAB_FAILURE;
+	list->values[list->length++] = v;
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Set the default values of an empty list of corpus parameter values
+*/
+static void setDefaultValues(jab_value_list* list, jab_int32 v0, jab_int32 v1)
+{
+	if(list->length > 0)
+		return;
+	list->values[list->length++] = v0;
+	list->values[list->length++] = v1;
+}
+
+int main(int argc, char* argv[])
+{
+	jab_value_list colors = {0}, symbols = {0}, versions = {0}, ecc_levels = {0}, module_sizes = {0};
+	jab_int32 repeat = 3;
+	jab_uint64 seed = 1;
+	jab_char* label = "";
+	jab_char* output = "bench.json";
+	jab_char* dump_dir = NULL;
+	jab_boolean fresh_encoder = 0, tiff = 0, decode = 1;
+	for(jab_int32 i=1; i<argc; i++)
+	{
+		if(0 == strcmp(argv[i], "--fresh-encoder"))
+		{
+			fresh_encoder = 1;
+			continue;
+		}
+		if(0 == strcmp(argv[i], "--tiff"))
+		{
+			tiff = 1;
+			continue;
+		}
+		if(0 == strcmp(argv[i], "--no-decode"))
+		{
+			decode = 0;
+			continue;
+		}
+		jab_boolean valid = (i+1 < argc);
+		if(valid && 0 == strcmp(argv[i], "--color-number"))
+		{
+			//the decoder only derives palette thresholds for 4 and 8 colors, codes with 16 and 32 colors are encoded
+			//but never decoded and the master metadata placement is undefined for 64 and more colors
+			valid = addValue(&colors, argv[++i], 4, 8) && (colors.values[colors.length-1] == 4 || colors.values[colors.length-1] == 8);
+		}
+		else if(valid && 0 == strcmp(argv[i], "--symbol-number"))
+			valid = addValue(&symbols, argv[++i], 1, MAX_SYMBOL_NUMBER);
+		else if(valid && 0 == strcmp(argv[i], "--symbol-version"))
+			valid = addValue(&versions, argv[++i], 1, 32);
+		else if(valid && 0 == strcmp(argv[i], "--ecc-level"))
+			valid = addValue(&ecc_levels, argv[++i], 1, 10);
+		else if(valid && 0 == strcmp(argv[i], "--module-size"))
+			valid = addValue(&module_sizes, argv[++i], 1, 100);
+		else if(valid && 0 == strcmp(argv[i], "--repeat"))
+		{
+			repeat = atoi(argv[++i]);
+			valid = (repeat >= 1 && repeat <= MAX_REPEAT);
+		}
+		else if(valid && 0 == strcmp(argv[i], "--seed"))
+			seed = strtoull(argv[++i], NULL, 10);
+		else if(valid && 0 == strcmp(argv[i], "--label"))
+			label = argv[++i];
+		else if(valid && 0 == strcmp(argv[i], "--output"))
+			output = argv[++i];
+		else if(valid && 0 == strcmp(argv[i], "--dump"))
+			dump_dir = argv[++i];
+		else
+			valid = 0;
+		if(!valid)
+		{
+			printUsage();
+			return 1;
+		}
+	}
+	setDefaultValues(&colors, 4, 8);
+	setDefaultValues(&symbols, 1, 3);
+	setDefaultValues(&versions, 6, 12);
+	setDefaultValues(&ecc_levels, 3, 6);
+	setDefaultValues(&module_sizes, 4, 8);
+	random_state = seed ? seed : 1;
+
+	//not stdout, the library reports errors there
+	FILE* out = fopen(output, "w");
+	if(out == NULL)
+	{
+		reportError("Opening the output file failed");
+		return 1;
+	}
+	jab_char png_file[1024];
+	snprintf(png_file, sizeof(png_file), "%s.png", output);
+	jab_char tiff_file[1024];
+	snprintf(tiff_file, sizeof(tiff_file), "%s.tif", output);
+	jab_decode_context* ctx = createDecodeContext(0);
+	if(ctx == NULL)
+	{
+		reportError("Creating decode context failed");
+		return 1;
+	}
+
+	fprintf(out, "{\n  \"library\": \"%s\", \"label\": \"%s\", \"seed\": %llu, \"repeat\": %d, \"fresh_encoder\": %s,\n  \"corpus\": {", VERSION,
+			label, (unsigned long long)seed, repeat, fresh_encoder ? "true" : "false");
+	printList(out, "colors", &colors);
+	fprintf(out, ", ");
+	printList(out, "symbols", &symbols);
+	fprintf(out, ", ");
+	printList(out, "versions", &versions);
+	fprintf(out, ", ");
+	printList(out, "ecc_levels", &ecc_levels);
+	fprintf(out, ", ");
+	printList(out, "module_sizes", &module_sizes);
+	fprintf(out, "},\n  \"results\": [\n");
+
+	jab_bench_summary summary;
+	memset(&summary, 0, sizeof(summary));
+	for(jab_int32 c=0; c<colors.length; c++)
+		for(jab_int32 s=0; s<symbols.length; s++)
+			for(jab_int32 v=0; v<versions.length; v++)
+				for(jab_int32 e=0; e<ecc_levels.length; e++)
+					for(jab_int32 m=0; m<module_sizes.length; m++)
+						benchCode(out, &summary, ctx, colors.values[c], symbols.values[s], versions.values[v], ecc_levels.values[e],
+								  module_sizes.values[m], repeat, fresh_encoder, decode, dump_dir, png_file, tiff ? tiff_file : NULL);
+	fprintf(out, "\n  ],\n");
+	printSummary(out, &summary);
+	fprintf(out, "}\n");
+
+	destroyDecodeContext(ctx);
+	fclose(out);
+	return 0;
+}
@@ -0,0 +1,1029 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file jabmicro.c
+ * @brief Micro-benchmark of the hot encoding and decoding kernels on fixed inputs taken from a generated code
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "jabcode.h"
+#include "encoder.h"
+#include "detector.h"
+#include "decoder.h"
+#include "ldpc.h"
+#include "arena.h"
+#include "timer.h"
+
+#define MAX_ITERATIONS		10000
+#define QUIET_ZONE			4		//the width of the white border around the code in modules
+#define DEFAULT_ERROR_RATE	0.5		//the percentage of the bits flipped in the LDPC codewords
+#define MAX_PAYLOAD_SIZE	(1024 * 1024)
+#define PAYLOAD_TYPE_NUMBER	3
+#define VERSION_NUMBER		32
+
+static const jab_char* payload_type_names[PAYLOAD_TYPE_NUMBER] = {"text", "numeric", "binary"};
+
+extern jab_int32 getSymbolCapacity(jab_encode* enc, jab_int32 index);
+extern jab_code* getCodePara(jab_encode* enc);
+extern jab_boolean createBitmap(jab_encode* enc, jab_code* cp);
+extern jab_byte* analyzeInputData(jab_payload_reader* input, jab_int32* encoded_length);
+extern jab_uint64* encodeData(jab_payload_reader* data, jab_int32 encoded_length, jab_byte* encode_seq);
+extern void binarizePixel(jab_byte* pixel, jab_float* rgb_ths, jab_bitmap* rgb[3], jab_int32 index);
+extern void filterBinary(jab_bitmap* binary);
+extern jab_boolean seekPatternHorizontal(jab_byte* row, jab_int32* startx, jab_int32* endx, jab_float* centerx, jab_float* module_size, jab_int32* skip);
+extern jab_byte decodeModuleHD(jab_bitmap* matrix, jab_byte* palette, jab_int32 color_number, jab_float* norm_palette, jab_float* pal_ths, jab_int32 x, jab_int32 y);
+extern void getPaletteThreshold(jab_byte* palette, jab_int32 color_number, jab_float* palette_ths);
+extern void normalizeColorPalette(jab_decoded_symbol* symbol, jab_float* norm_palette, jab_int32 color_number);
+extern jab_data* rawModuleData2RawData(jab_data* raw_module_data, jab_int32 bits_per_module);
+extern jab_int32* createMatrixA(jab_int32 wc, jab_int32 wr, jab_int32 capacity);
+extern jab_int32 GaussJordan(jab_int32* matrixA, jab_int32 wc, jab_int32 wr, jab_int32 capacity, jab_int32* matrix_rank, jab_boolean encode);
+
+/**
+ * @brief The fixed inputs of the kernels and the buffers they work on
+*/
+typedef struct {
+	jab_encode*					enc;
+	jab_int32					color_number;
+	jab_bitmap*					image;				///< The code with a quiet zone and noise
+	jab_bitmap*					frame;				///< The copy of the image balanceBinarizeRGB stretches in place
+	jab_frame_stats*			stats;				///< The statistics of the image
+	jab_bitmap*					binary[3];			///< The binarized channels of the image before filtering
+	jab_bitmap*					filtered[3];		///< The binarized channels of the image after filtering
+	jab_bitmap*					channels[3];		///< The binarized channels written by the kernels
+	jab_bitmap*					unfiltered[3];		///< The binarized channels filterBinary works on in place
+	jab_perspective_transform	pt;					///< The transform from the symbol modules to the image pixels
+	jab_vector2d				side_size;
+	jab_bitmap*					matrix;				///< The sampled symbol
+	jab_bitmap*					sampled;			///< The symbol sampled by the kernel
+	jab_byte*					palette;
+	jab_float*					norm_palette;
+	jab_float					pal_ths[3 * COLOR_PALETTE_NUMBER];
+	jab_byte*					data_map;			///< The data module positions, 0 for data modules
+	jab_int32					mask_type;
+	jab_data*					modules;			///< The masked module values of the symbol
+	jab_data*					bits;				///< The interleaved bits of the symbol
+	jab_data*					message;			///< The net bits of the symbol
+	jab_data*					work;				///< The module values or bits the kernels work on in place
+	jab_data*					encoded;
+	jab_int32					wcwr[2];
+	jab_int32					block_length;		///< The length of the first LDPC block of the symbol
+	jab_int32					block_rank;
+	jab_int32*					matrixA;			///< The parity check matrix of the block before elimination
+	jab_int32*					matrix_work;
+	jab_int32*					matrix_reduced;		///< The parity check matrix of the block after elimination
+	jab_byte*					received;			///< The first LDPC block of the symbol with bit errors
+	jab_byte*					decoded;
+	jab_float*					reliability;
+	jab_double					error_rate;			///< The percentage of the bits flipped in the LDPC codewords
+	jab_data*					codeword;			///< The LDPC codeword of the net bits with bit errors
+	jab_byte*					hd_work;			///< The codeword decodeLDPChd corrects in place
+	jab_int32					hd_errors;			///< The number of bits flipped in the codeword
+	jab_boolean					hd_decoded;			///< Whether decodeLDPChd recovers the net bits from the codeword
+	jab_data*					version_messages[VERSION_NUMBER];	///< The net bits of a symbol of every side-version
+	jab_byte*					symbol_matrices[MAX_SYMBOL_NUMBER];
+	jab_code*					cp;
+	jab_int32					payload_type;		///< The index in payload_type_names
+	jab_data*					payload;			///< The payload of the data encoding kernels, independent of the code
+	jab_payload_reader			payload_reader;		///< The reader over the whole payload
+	jab_byte*					encode_seq;			///< The encoding modes of the payload written by the kernel
+	jab_byte*					payload_modes;		///< The encoding modes of the payload
+	jab_byte*					modes_work;			///< The encoding modes encodeData rewrites in place at shifts
+	jab_int32					encoded_length;		///< The length of the encoded payload in bits
+	jab_uint64*					encoded_words;		///< The encoded payload written by the kernel
+	jab_data*					stream;				///< The encoded payload one bit per byte, NULL if encoding it failed
+	jab_data*					decoded_payload;	///< The payload decoded by the kernel
+	jab_boolean					stream_decoded;		///< Whether decodeData recovers the payload from the stream
+}jab_micro_input;
+
+/**
+ * @brief A kernel of the benchmark
+*/
+typedef struct {
+	const jab_char*	name;
+	const jab_char*	unit;								///< What one operation processes
+	void			(*prepare)(jab_micro_input* in);	///< Restores the input before each run, not timed
+	jab_int32		(*run)(jab_micro_input* in);		///< Runs the kernel, returns the number of operations | 0 if failed
+	void			(*release)(jab_micro_input* in);	///< Frees the output after each run, not timed
+}jab_micro_kernel;
+
+/**
+ * @brief The state of the pseudo random generator of the inputs, independent of the one used by the library
+*/
+static jab_uint64 random_state = 1;
+
+/**
+ * @brief Get the next pseudo random number of the inputs
+ * @return the random number
+*/
+static jab_uint32 nextRandom(void)
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 7;
+	random_state ^= random_state << 17;
+	return (jab_uint32)(random_state >> 16);
+}
+
+/**
+ * @brief Compare two times for qsort
+*/
+static int compareTimes(const void* a, const void* b)
+{
+	jab_int64 x = *(const jab_int64*)a;
+	jab_int64 y = *(const jab_int64*)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief Free the binarized channels written by a kernel
+*/
+static void releaseChannels(jab_micro_input* in)
+{
+	for(jab_int32 i=0; i<3; i++)
+	{
+		scratchFree(in->channels[i]);
+		in->channels[i] = NULL;
+	}
+}
+
+static void prepareBalance(jab_micro_input* in)
+{
+	memcpy(in->frame->pixel, in->image->pixel, in->image->width * in->image->height * BITMAP_CHANNEL_COUNT);
+}
+
+static jab_int32 runBalance(jab_micro_input* in)
+{
+	return balanceBinarizeRGB(in->frame, NULL, in->stats, in->channels) ? 1 : 0;
+}
+
+static jab_int32 runBinarizer(jab_micro_input* in)
+{
+	return binarizerRGB(in->image, in->channels, NULL) ? 1 : 0;
+}
+
+static void prepareFilter(jab_micro_input* in)
+{
+	for(jab_int32 i=0; i<3; i++)
+		memcpy(in->unfiltered[i], in->binary[i], sizeof(jab_bitmap) + in->image->width * in->image->height);
+}
+
+static jab_int32 runFilter(jab_micro_input* in)
+{
+	for(jab_int32 i=0; i<3; i++)
+		filterBinary(in->unfiltered[i]);
+	return 3;
+}
+
+static jab_int32 runSeekPattern(jab_micro_input* in)
+{
+	//scan every row of the green channel as the finder pattern search does
+	jab_bitmap* ch = in->filtered[1];
+	jab_int32 calls = 0;
+	for(jab_int32 i=0; i<ch->height; i++)
+	{
+		jab_byte* row = ch->pixel + i * ch->width;
+		jab_int32 startx = 0, endx = ch->width, skip = 0;
+		do
+		{
+			jab_float centerx, module_size;
+			startx += skip;
+			endx = ch->width;
+			seekPatternHorizontal(row, &startx, &endx, &centerx, &module_size, &skip);
+			calls++;
+		}while(startx < ch->width && endx < ch->width);
+	}
+	return calls;
+}
+
+static jab_int32 runSample(jab_micro_input* in)
+{
+	in->sampled = sampleSymbol(in->image, &in->pt, in->side_size);
+	return in->sampled ? 1 : 0;
+}
+
+static void releaseSample(jab_micro_input* in)
+{
+	scratchFree(in->sampled);
+	in->sampled = NULL;
+}
+
+/**
+ * @brief Decode the data modules of the sampled symbol in the order of readRawModuleData
+ * @param in the inputs
+ * @param data the decoded module values
+ * @return the number of data modules
+*/
+static jab_int32 decodeModules(jab_micro_input* in, jab_data* data)
+{
+	jab_int32 count = 0;
+	for(jab_int32 j=0; j<in->side_size.x; j++)
+	{
+		for(jab_int32 i=0; i<in->side_size.y; i++)
+		{
+			if(in->data_map[i * in->side_size.x + j] == 0)
+				data->data[count++] = (jab_char)decodeModuleHD(in->matrix, in->palette, in->color_number, in->norm_palette, in->pal_ths, j, i);
+		}
+	}
+	data->length = count;
+	return count;
+}
+
+static jab_int32 runDecodeModule(jab_micro_input* in)
+{
+	return decodeModules(in, in->work);
+}
+
+static void prepareDemask(jab_micro_input* in)
+{
+	memcpy(in->work, in->modules, sizeof(jab_data) + in->modules->length);
+}
+
+static jab_int32 runDemask(jab_micro_input* in)
+{
+	demaskSymbol(in->work, in->data_map, in->side_size, in->mask_type, in->color_number);
+	return 1;
+}
+
+static void prepareDeinterleave(jab_micro_input* in)
+{
+	memcpy(in->work, in->bits, sizeof(jab_data) + in->bits->length);
+}
+
+static jab_int32 runDeinterleave(jab_micro_input* in)
+{
+	deinterleaveData(in->work);
+	return 1;
+}
+
+static void prepareGaussJordan(jab_micro_input* in)
+{
+	jab_int32 nb_pcb = in->block_length / in->wcwr[1] * in->wcwr[0];
+	memcpy(in->matrix_work, in->matrixA, (size_t)ceil(in->block_length / (jab_float)32) * nb_pcb * sizeof(jab_int32));
+}
+
+static jab_int32 runGaussJordan(jab_micro_input* in)
+{
+	jab_int32 matrix_rank = 0;
+	return GaussJordan(in->matrix_work, in->wcwr[0], in->wcwr[1], in->block_length, &matrix_rank, 0) == 0 ? 1 : 0;
+}
+
+static jab_int32 runEncodeLDPC(jab_micro_input* in)
+{
+	in->encoded = encodeLDPC(in->message, in->wcwr);
+	return in->encoded ? 1 : 0;
+}
+
+static void releaseEncodeLDPC(jab_micro_input* in)
+{
+	scratchFree(in->encoded);
+	in->encoded = NULL;
+}
+
+static jab_int32 runEncodeLDPCVersions(jab_micro_input* in)
+{
+	for(jab_int32 v=0; v<VERSION_NUMBER; v++)
+	{
+		jab_data* encoded = encodeLDPC(in->version_messages[v], in->wcwr);
+		if(encoded == NULL)
+			return 0;
+		scratchFree(encoded);
+	}
+	return 1;
+}
+
+static void prepareDecodeBP(jab_micro_input* in)
+{
+	memcpy(in->decoded, in->received, in->block_length);
+	//the hard decision values are all equally reliable as in the decoder
+	for(jab_int32 i=0; i<in->block_length; i++)
+		in->reliability[i] = 1.0f;
+}
+
+static jab_int32 runDecodeBP(jab_micro_input* in)
+{
+	jab_boolean is_correct = 0;
+	jab_int32 iterations = 0;
+	jab_int32 nb_pcb = in->block_length / in->wcwr[1] * in->wcwr[0];
+	return decodeMessageBP(in->reliability, in->matrix_reduced, in->block_length, in->block_rank, nb_pcb, LDPC_DEFAULT_MAX_ITER, &is_correct, 0, in->decoded, &iterations) ? 1 : 0;
+}
+
+static void prepareDecodeHD(jab_micro_input* in)
+{
+	memcpy(in->hd_work, in->codeword->data, in->codeword->length);
+}
+
+static jab_int32 runDecodeHD(jab_micro_input* in)
+{
+	//decoding fails past the error correction capability, which is timed as well
+	decodeLDPChd(in->hd_work, in->codeword->length, in->wcwr[0], in->wcwr[1], NULL);
+	return 1;
+}
+
+static void prepareMask(jab_micro_input* in)
+{
+	for(jab_int32 i=0; i<in->enc->symbol_number; i++)
+	{
+		jab_int32 size = in->enc->symbols[i].side_size.x * in->enc->symbols[i].side_size.y;
+		memcpy(in->enc->symbols[i].matrix, in->symbol_matrices[i], size * sizeof(jab_byte));
+	}
+}
+
+static jab_int32 runMask(jab_micro_input* in)
+{
+	return maskCode(in->enc, in->cp) >= 0 ? 1 : 0;
+}
+
+static jab_int32 runBitmap(jab_micro_input* in)
+{
+	return createBitmap(in->enc, in->cp) ? 1 : 0;
+}
+
+static void prepareIndexedBitmap(jab_micro_input* in)
+{
+	in->enc->output_mode = INDEXED_BITMAP_OUTPUT;
+}
+
+static void releaseIndexedBitmap(jab_micro_input* in)
+{
+	in->enc->output_mode = BITMAP_OUTPUT;
+}
+
+static jab_int32 runAnalyze(jab_micro_input* in)
+{
+	jab_int32 encoded_length = 0;
+	in->encode_seq = analyzeInputData(&in->payload_reader, &encoded_length);
+	return in->encode_seq ? 1 : 0;
+}
+
+static void releaseAnalyze(jab_micro_input* in)
+{
+	scratchFree(in->encode_seq);
+	in->encode_seq = NULL;
+}
+
+static void prepareEncodeData(jab_micro_input* in)
+{
+	memcpy(in->modes_work, in->payload_modes, in->payload->length + 2);
+}
+
+static jab_int32 runEncodeData(jab_micro_input* in)
+{
+	in->encoded_words = encodeData(&in->payload_reader, in->encoded_length, in->modes_work);
+	return in->encoded_words ? 1 : 0;
+}
+
+static void releaseEncodeData(jab_micro_input* in)
+{
+	scratchFree(in->encoded_words);
+	in->encoded_words = NULL;
+}
+
+static jab_int32 runDecodeData(jab_micro_input* in)
+{
+	if(in->stream == NULL)
+		return 0;
+	in->decoded_payload = decodeData(in->stream);
+	return in->decoded_payload ? 1 : 0;
+}
+
+static void releaseDecodeData(jab_micro_input* in)
+{
+	free(in->decoded_payload);
+	in->decoded_payload = NULL;
+}
+
+static const jab_micro_kernel kernels[] = {
+	{"balanceBinarizeRGB",		"frame",	prepareBalance,		runBalance,			releaseChannels},
+	{"binarizerRGB",			"frame",	NULL,				runBinarizer,		releaseChannels},
+	{"filterBinary",			"channel",	prepareFilter,		runFilter,			NULL},
+	{"seekPatternHorizontal",	"call",		NULL,				runSeekPattern,		NULL},
+	{"sampleSymbol",			"symbol",	NULL,				runSample,			releaseSample},
+	{"decodeModuleHD",			"module",	NULL,				runDecodeModule,	NULL},
+	{"demaskSymbol",			"symbol",	prepareDemask,		runDemask,			NULL},
+	{"deinterleaveData",		"symbol",	prepareDeinterleave,runDeinterleave,	NULL},
+	{"GaussJordan",				"block",	prepareGaussJordan,	runGaussJordan,		NULL},
+	{"encodeLDPC",				"symbol",	NULL,				runEncodeLDPC,		releaseEncodeLDPC},
+	{"encodeLDPCVersions",		"versions 1-32",	NULL,		runEncodeLDPCVersions,	NULL},
+	{"decodeMessageBP",			"block",	prepareDecodeBP,	runDecodeBP,		NULL},
+	{"decodeLDPChd",			"symbol",	prepareDecodeHD,	runDecodeHD,		NULL},
+	{"maskCode",				"code",		prepareMask,		runMask,			NULL},
+	{"analyzeInputData",		"payload",	NULL,				runAnalyze,			releaseAnalyze},
+	{"encodeData",				"payload",	prepareEncodeData,	runEncodeData,		releaseEncodeData},
+	{"decodeData",				"payload",	NULL,				runDecodeData,		releaseDecodeData},
+	{"createBitmap",			"code",		NULL,				runBitmap,			NULL},
+	{"createBitmapIndexed",		"code",		prepareIndexedBitmap,runBitmap,			releaseIndexedBitmap},
+};
+#define KERNEL_NUMBER	(jab_int32)(sizeof(kernels) / sizeof(kernels[0]))
+
+/**
+ * @brief Allocate a binary bitmap of the image size
+ * @param in the inputs
+ * @return the bitmap | NULL if failed
+*/
+static jab_bitmap* createChannel(jab_micro_input* in)
+{
+	jab_bitmap* ch = (jab_bitmap*)scratchCalloc(1, sizeof(jab_bitmap) + in->image->width * in->image->height);
+	if(ch == NULL)
+	{
+		reportError("Memory allocation for binary channel failed");
+		return NULL;
+	}
+	ch->width = in->image->width;
+	ch->height = in->image->height;
+	ch->bits_per_channel = 8;
+	ch->bits_per_pixel = 8;
+	ch->channel_count = 1;
+	return ch;
+}
+
+/**
+ * @brief Generate a single symbol code and derive the inputs of all kernels from it
+ * @param in the inputs
+ * @param color_number the number of colors
+ * @param version the side-version of the symbol
+ * @param ecc_level the error correction level
+ * @param module_size the module size in pixels
+ * @param error_rate the percentage of the bits flipped in the LDPC codewords
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+static jab_boolean createInputs(jab_micro_input* in, jab_int32 color_number, jab_int32 version, jab_int32 ecc_level, jab_int32 module_size,
+								jab_double error_rate)
+{
+	static const jab_char charset[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 abcdefghijklmnopqrstuvwxyz,.:/-";
+	jab_encode* enc = createEncode(color_number, 1);
+	if(enc == NULL)
+	{
+		reportError("Creating encode parameter failed");
+		return JAB_FAILURE;
+	}
+	in->enc = enc;
+	in->color_number = color_number;
+	in->error_rate = error_rate;
+	enc->module_size = module_size;
+	enc->record_stats = 1;
+	enc->symbol_versions[0].x = version;
+	enc->symbol_versions[0].y = version;
+	enc->symbol_ecc_levels[0] = ecc_level;
+
+	//fill most of the capacity, shrink the payload until it fits
+	jab_int32 wc = ecclevel2wcwr[ecc_level][0];
+	jab_int32 wr = ecclevel2wcwr[ecc_level][1];
+	jab_int32 length = MAX(getSymbolCapacity(enc, 0) / wr * (wr - wc) / 8 * 9 / 10, 1);
+	jab_int32 result = 4;
+	jab_data* payload = (jab_data*)malloc(sizeof(jab_data) + length);
+	if(payload == NULL)
+	{
+		reportError("Memory allocation for payload failed");
+		return JAB_FAILURE;
+	}
+	for(jab_int32 i=0; i<length; i++)
+		payload->data[i] = charset[nextRandom() % (sizeof(charset) - 1)];
+	while(result == 4 && length > 0)
+	{
+		payload->length = length;
+		result = generateJABCode(enc, payload);
+		length = length * 4 / 5;
+	}
+	free(payload);
+	if(result != 0)
+	{
+		JAB_REPORT_ERROR(("Creating the code failed with error %d", result))
+		return JAB_FAILURE;
+	}
+	in->mask_type = enc->stats.mask_type;
+	enc->record_stats = 0;
+
+	//place the code in a white quiet zone and add noise with a deviation of about 16
+	jab_int32 margin = QUIET_ZONE * module_size;
+	jab_int32 width = enc->bitmap->width + 2 * margin;
+	jab_int32 height = enc->bitmap->height + 2 * margin;
+	jab_int32 size = sizeof(jab_bitmap) + width * height * BITMAP_CHANNEL_COUNT;
+	in->image = (jab_bitmap*)malloc(size);
+	in->frame = (jab_bitmap*)malloc(size);
+	in->stats = (jab_frame_stats*)malloc(sizeof(jab_frame_stats));
+	if(in->image == NULL || in->frame == NULL || in->stats == NULL)
+	{
+		reportError("Memory allocation for image failed");
+		return JAB_FAILURE;
+	}
+	in->image->width = width;
+	in->image->height = height;
+	in->image->bits_per_pixel = BITMAP_BITS_PER_PIXEL;
+	in->image->bits_per_channel = BITMAP_BITS_PER_CHANNEL;
+	in->image->channel_count = BITMAP_CHANNEL_COUNT;
+	memset(in->image->pixel, 255, width * height * BITMAP_CHANNEL_COUNT);
+	for(jab_int32 y=0; y<enc->bitmap->height; y++)
+		memcpy(in->image->pixel + ((y + margin) * width + margin) * BITMAP_CHANNEL_COUNT,
+			   enc->bitmap->pixel + y * enc->bitmap->width * BITMAP_CHANNEL_COUNT, enc->bitmap->width * BITMAP_CHANNEL_COUNT);
+	for(jab_int32 i=0; i<width*height; i++)
+	{
+		for(jab_int32 c=0; c<3; c++)
+		{
+			jab_int32 noise = (jab_int32)(nextRandom() % 33) + (jab_int32)(nextRandom() % 33) + (jab_int32)(nextRandom() % 33) - 48;
+			jab_int32 value = in->image->pixel[i * BITMAP_CHANNEL_COUNT + c] + noise;
+			in->image->pixel[i * BITMAP_CHANNEL_COUNT + c] = (jab_byte)MIN(MAX(value, 0), 255);
+		}
+	}
+	memcpy(in->frame, in->image, size);
+	initFrameStats(in->stats, width, height);
+	for(jab_int32 i=0; i<height; i++)
+		addFrameRow(in->stats, in->image->pixel + i * width * BITMAP_CHANNEL_COUNT, BITMAP_CHANNEL_COUNT, i);
+
+	//the binarized channels before and after filtering
+	if(!binarizerRGB(in->image, in->filtered, NULL))
+		return JAB_FAILURE;
+	jab_float rgb_ave[3] = {0, 0, 0};
+	for(jab_int32 i=0; i<width*height; i++)
+	{
+		for(jab_int32 c=0; c<3; c++)
+			rgb_ave[c] += in->image->pixel[i * BITMAP_CHANNEL_COUNT + c];
+	}
+	for(jab_int32 c=0; c<3; c++)
+		rgb_ave[c] /= (jab_float)(width * height);
+	for(jab_int32 i=0; i<3; i++)
+	{
+		in->binary[i] = createChannel(in);
+		in->unfiltered[i] = createChannel(in);
+		if(in->binary[i] == NULL || in->unfiltered[i] == NULL)
+			return JAB_FAILURE;
+	}
+	for(jab_int32 i=0; i<width*height; i++)
+		binarizePixel(&in->image->pixel[i * BITMAP_CHANNEL_COUNT], rgb_ave, in->binary, i);
+
+	//sample the symbol at the known finder pattern centers
+	in->side_size = enc->symbols[0].side_size;
+	jab_float ms = (jab_float)module_size;
+	calcPerspectiveTransform(3.5f, 3.5f, in->side_size.x - 3.5f, 3.5f, in->side_size.x - 3.5f, in->side_size.y - 3.5f, 3.5f, in->side_size.y - 3.5f,
+							 margin + 3.5f * ms, margin + 3.5f * ms,
+							 margin + (in->side_size.x - 3.5f) * ms, margin + 3.5f * ms,
+							 margin + (in->side_size.x - 3.5f) * ms, margin + (in->side_size.y - 3.5f) * ms,
+							 margin + 3.5f * ms, margin + (in->side_size.y - 3.5f) * ms, &in->pt);
+	in->matrix = sampleSymbol(in->image, &in->pt, in->side_size);
+	if(in->matrix == NULL)
+		return JAB_FAILURE;
+
+	//the palettes as placed by the encoder and the data module positions, which the encoder marks with 1
+	jab_int32 modules = in->side_size.x * in->side_size.y;
+	in->palette = (jab_byte*)malloc(color_number * 3 * COLOR_PALETTE_NUMBER);
+	in->norm_palette = (jab_float*)malloc(color_number * 4 * COLOR_PALETTE_NUMBER * sizeof(jab_float));
+	in->data_map = (jab_byte*)malloc(modules);
+	in->modules = (jab_data*)scratchMalloc(sizeof(jab_data) + modules);
+	in->work = (jab_data*)scratchMalloc(sizeof(jab_data) + modules * 8);
+	if(in->palette == NULL || in->norm_palette == NULL || in->data_map == NULL || in->modules == NULL || in->work == NULL)
+	{
+		reportError("Memory allocation for symbol data failed");
+		return JAB_FAILURE;
+	}
+	jab_decoded_symbol symbol;
+	memset(&symbol, 0, sizeof(symbol));
+	symbol.palette = in->palette;
+	for(jab_int32 i=0; i<COLOR_PALETTE_NUMBER; i++)
+	{
+		memcpy(in->palette + color_number * 3 * i, enc->palette, color_number * 3);
+		getPaletteThreshold(in->palette + color_number * 3 * i, color_number, &in->pal_ths[i * 3]);
+	}
+	normalizeColorPalette(&symbol, in->norm_palette, color_number);
+	for(jab_int32 i=0; i<modules; i++)
+		in->data_map[i] = enc->symbols[0].data_map[i] ? 0 : 1;
+	decodeModules(in, in->modules);
+
+	//the interleaved bits of the symbol and the net bits of the same length
+	jab_int32 bits_per_module = (jab_int32)(log(color_number) / log(2));
+	in->bits = rawModuleData2RawData(in->modules, bits_per_module);
+	if(in->bits == NULL)
+		return JAB_FAILURE;
+	in->bits->length = in->bits->length / wr * wr;
+	jab_int32 net_length = in->bits->length / wr * (wr - wc);
+	in->message = (jab_data*)scratchMalloc(sizeof(jab_data) + net_length);
+	if(in->message == NULL)
+	{
+		reportError("Memory allocation for message failed");
+		return JAB_FAILURE;
+	}
+	in->message->length = net_length;
+	for(jab_int32 i=0; i<net_length; i++)
+		in->message->data[i] = (jab_char)(nextRandom() & 1);
+	in->wcwr[0] = wc;
+	in->wcwr[1] = wr;
+
+	//the first LDPC block of the symbol split as by the encoder, with bit errors
+	jab_int32 nb_sub_blocks = 1;
+	while(in->bits->length / nb_sub_blocks >= 2700)
+		nb_sub_blocks++;
+	in->block_length = in->bits->length / nb_sub_blocks / wr * wr;
+	jab_int32 nb_pcb = in->block_length / wr * wc;
+	jab_int32 matrix_size = (jab_int32)ceil(in->block_length / (jab_float)32) * nb_pcb * sizeof(jab_int32);
+	in->matrixA = createMatrixA(wc, wr, in->block_length);
+	in->matrix_reduced = createMatrixA(wc, wr, in->block_length);
+	in->matrix_work = (jab_int32*)scratchMalloc(matrix_size);
+	in->received = (jab_byte*)scratchMalloc(in->block_length);
+	in->decoded = (jab_byte*)scratchMalloc(in->block_length);
+	in->reliability = (jab_float*)scratchMalloc(in->block_length * sizeof(jab_float));
+	if(in->matrixA == NULL || in->matrix_reduced == NULL || in->matrix_work == NULL || in->received == NULL || in->decoded == NULL || in->reliability == NULL)
+	{
+		reportError("Memory allocation for LDPC block failed");
+		return JAB_FAILURE;
+	}
+	if(GaussJordan(in->matrix_reduced, wc, wr, in->block_length, &in->block_rank, 0))
+		return JAB_FAILURE;
+	if(!runEncodeLDPC(in))
+		return JAB_FAILURE;
+	memcpy(in->received, in->encoded->data, in->block_length);
+	in->codeword = in->encoded;
+	in->encoded = NULL;
+	for(jab_int32 i=0; i<(jab_int32)(in->block_length * in->error_rate / 100); i++)
+		in->received[nextRandom() % in->block_length] ^= 1;
+
+	//the codeword of the whole symbol with distinct bit errors, and whether decodeLDPChd corrects them
+	in->hd_work = (jab_byte*)scratchMalloc(in->codeword->length);
+	if(in->hd_work == NULL)
+	{
+		reportError("Memory allocation for LDPC codeword failed");
+		return JAB_FAILURE;
+	}
+	memset(in->hd_work, 0, in->codeword->length);
+	in->hd_errors = (jab_int32)(in->codeword->length * in->error_rate / 100);
+	for(jab_int32 i=0; i<in->hd_errors; i++)
+	{
+		jab_int32 pos = nextRandom() % in->codeword->length;
+		while(in->hd_work[pos])
+			pos = (pos + 1) % in->codeword->length;
+		in->hd_work[pos] = 1;
+		in->codeword->data[pos] ^= 1;
+	}
+	prepareDecodeHD(in);
+	in->hd_decoded = decodeLDPChd(in->hd_work, in->codeword->length, wc, wr, NULL) == in->message->length &&
+					 memcmp(in->hd_work, in->message->data, in->message->length) == 0;
+
+	//the module values of all symbols before masking
+	in->cp = getCodePara(enc);
+	if(in->cp == NULL)
+		return JAB_FAILURE;
+	for(jab_int32 i=0; i<enc->symbol_number; i++)
+	{
+		size = enc->symbols[i].side_size.x * enc->symbols[i].side_size.y;
+		in->symbol_matrices[i] = (jab_byte*)malloc(size * sizeof(jab_byte));
+		if(in->symbol_matrices[i] == NULL)
+		{
+			reportError("Memory allocation for symbol matrix failed");
+			return JAB_FAILURE;
+		}
+		memcpy(in->symbol_matrices[i], enc->symbols[i].matrix, size * sizeof(jab_byte));
+	}
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Create the payload of the data encoding kernels
+ * @param in the inputs
+ * @param size the payload size in bytes
+ * @param type the payload type, the index in payload_type_names
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+static jab_boolean createPayloadInputs(jab_micro_input* in, jab_int32 size, jab_int32 type)
+{
+	static const jab_char charset[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 abcdefghijklmnopqrstuvwxyz,.:/-";
+	in->payload_type = type;
+	in->payload = (jab_data*)malloc(sizeof(jab_data) + size);
+	if(in->payload == NULL)
+	{
+		reportError("Memory allocation for payload failed");
+		return JAB_FAILURE;
+	}
+	in->payload->length = size;
+	for(jab_int32 i=0; i<size; i++)
+	{
+		switch(type)
+		{
+		case 0:
+			in->payload->data[i] = charset[nextRandom() % (sizeof(charset) - 1)];
+			break;
+		case 1:
+			in->payload->data[i] = (jab_char)('0' + nextRandom() % 10);
+			break;
+		default:
+			in->payload->data[i] = (jab_char)(nextRandom() & 0xFF);
+			break;
+		}
+	}
+	in->payload_reader.length = size;
+	in->payload_reader.size = size;
+	in->payload_reader.buffer = in->payload->data;
+	in->payload_modes = analyzeInputData(&in->payload_reader, &in->encoded_length);
+	in->modes_work = (jab_byte*)scratchMalloc(size + 2);
+	if(in->payload_modes == NULL || in->modes_work == NULL)
+	{
+		reportError("Memory allocation for encoding modes failed");
+		return JAB_FAILURE;
+	}
+
+	//the input of decodeData, the encoding fails for payloads beyond about 1 Mbit
+	prepareEncodeData(in);
+	if(!runEncodeData(in))
+		return JAB_SUCCESS;
+	in->stream = (jab_data*)scratchMalloc(sizeof(jab_data) + in->encoded_length);
+	if(in->stream == NULL)
+	{
+		reportError("Memory allocation for encoded payload failed");
+		return JAB_FAILURE;
+	}
+	in->stream->length = in->encoded_length;
+	for(jab_int32 i=0; i<in->encoded_length; i++)
+		in->stream->data[i] = (jab_char)((in->encoded_words[i / 64] >> (63 - i % 64)) & 1);
+	releaseEncodeData(in);
+	runDecodeData(in);
+	in->stream_decoded = in->decoded_payload && in->decoded_payload->length == size &&
+						 memcmp(in->decoded_payload->data, in->payload->data, size) == 0;
+	releaseDecodeData(in);
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Create the net bits of a master symbol of every side-version with the colors and the error correction level
+ * of the input code
+ * @param in the inputs
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+static jab_boolean createVersionInputs(jab_micro_input* in)
+{
+	for(jab_int32 v=0; v<VERSION_NUMBER; v++)
+	{
+		jab_encode* version_enc = createEncode(in->color_number, 1);
+		if(version_enc == NULL)
+		{
+			reportError("Creating encode parameter failed");
+			return JAB_FAILURE;
+		}
+		version_enc->symbol_versions[0].x = v + 1;
+		version_enc->symbol_versions[0].y = v + 1;
+		version_enc->symbol_ecc_levels[0] = in->enc->symbol_ecc_levels[0];
+		jab_int32 version_length = getSymbolCapacity(version_enc, 0) / in->wcwr[1] * (in->wcwr[1] - in->wcwr[0]);
+		destroyEncode(version_enc);
+		in->version_messages[v] = (jab_data*)scratchMalloc(sizeof(jab_data) + version_length);
+		if(in->version_messages[v] == NULL)
+		{
+			reportError("Memory allocation for message failed");
+			return JAB_FAILURE;
+		}
+		in->version_messages[v]->length = version_length;
+		for(jab_int32 i=0; i<version_length; i++)
+			in->version_messages[v]->data[i] = (jab_char)(nextRandom() & 1);
+	}
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Free the inputs, the scratch memory is released with the arena
+ * @param in the inputs
+*/
+static void releaseInputs(jab_micro_input* in)
+{
+	for(jab_int32 i=0; i<MAX_SYMBOL_NUMBER; i++)
+		free(in->symbol_matrices[i]);
+	free(in->payload);
+	free(in->data_map);
+	free(in->norm_palette);
+	free(in->palette);
+	free(in->stats);
+	free(in->frame);
+	free(in->image);
+	destroyEncode(in->enc);
+}
+
+/**
+ * @brief Run a kernel repeatedly on the inputs and print its results as JSON
+ * @param out the output file
+ * @param arena the scratch arena of the kernels
+ * @param in the inputs
+ * @param kernel the kernel
+ * @param iterations the number of timed runs
+ * @param first whether the kernel is the first one printed
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+static jab_boolean benchKernel(FILE* out, jab_arena* arena, jab_micro_input* in, const jab_micro_kernel* kernel, jab_int32 iterations, jab_boolean first)
+{
+	jab_int64* times = (jab_int64*)malloc(iterations * sizeof(jab_int64));
+	if(times == NULL)
+	{
+		reportError("Memory allocation for times failed");
+		return JAB_FAILURE;
+	}
+	jab_int32 ops = 0, allocs = 0;
+	size_t alloc_bytes = 0;
+	//one untimed run to warm up the caches
+	for(jab_int32 r=-1; r<iterations; r++)
+	{
+		if(kernel->prepare)
+			kernel->prepare(in);
+		jab_int32 allocs_before = arena->allocs;
+		size_t bytes_before = arena->alloc_bytes;
+		jab_int64 start = getMonotonicTime();
+		ops = kernel->run(in);
+		jab_int64 time = getMonotonicTime() - start;
+		allocs = arena->allocs - allocs_before;
+		alloc_bytes = arena->alloc_bytes - bytes_before;
+		if(kernel->release)
+			kernel->release(in);
+		if(ops <= 0)
+		{
+			JAB_REPORT_ERROR(("Running kernel %s failed", kernel->name))
+			free(times);
+			return JAB_FAILURE;
+		}
+		if(r >= 0)
+			times[r] = time;
+	}
+	qsort(times, iterations, sizeof(jab_int64), compareTimes);
+	fprintf(out, "%s\n    {\"name\": \"%s\", \"unit\": \"%s\", \"ops_per_run\": %d, \"ns_per_op\": %.1f, \"min_ns_per_op\": %.1f, "
+			"\"bytes_per_op\": %.1f, \"allocs_per_op\": %.2f}", first ? "" : ",", kernel->name, kernel->unit, ops,
+			(jab_double)times[iterations / 2] / ops, (jab_double)times[0] / ops, (jab_double)alloc_bytes / ops, (jab_double)allocs / ops);
+	fflush(out);
+	free(times);
+	return JAB_SUCCESS;
+}
+
+/**
+ * @brief Print usage of the micro-benchmark
+*/
+void printUsage()
+{
+	printf("\n");
+	printf("jabmicro (Version %s Build date: %s) - Fraunhofer SIT\n\n", VERSION, BUILD_DATE);
+	printf("Usage:\n\n");
+	printf("jabmicro [options]\n");
+	printf("\n");
+	printf("--kernel\t\tName of a kernel to run, may be repeated. (default: all)\n");
+	printf("--color-number\t\tNumber of colors of the input code (4,8). The decoder supports no\n\t\t\tother color number. (default: 8)\n");
+	printf("--symbol-version\tSide-version of the input code. (default: 12)\n");
+	printf("--ecc-level\t\tError correction level of the input code. (default: %d)\n", DEFAULT_ECC_LEVEL);
+	printf("--module-size\t\tModule size in pixels of the input code. (default: 8)\n");
+	printf("--iterations\t\tNumber of timed runs of each kernel. (default: 100)\n");
+	printf("--payload-size\t\tSize in bytes of the payload of the data encoding kernels, up to %d. (default: 10240)\n", MAX_PAYLOAD_SIZE);
+	printf("--payload-type\t\tType of the payload of the data encoding kernels (text,numeric,binary). (default: text)\n");
+	printf("--error-rate\t\tPercentage of the bits flipped in the LDPC codewords. (default: %.1f)\n", DEFAULT_ERROR_RATE);
+	printf("--seed\t\t\tSeed of the payload, the noise and the bit errors. (default: 1)\n");
+	printf("--label\t\t\tLabel of the run written to the results, e.g. a commit id.\n");
+	printf("--output\t\tFile the JSON results are written to. (default: micro.json)\n");
+	printf("--help\t\t\tPrint this help.\n");
+	printf("\n");
+	printf("Kernels:");
+	for(jab_int32 i=0; i<KERNEL_NUMBER; i++)
+		printf(" %s", kernels[i].name);
+	printf("\n\n");
+}
+
+int main(int argc, char* argv[])
+{
+	jab_boolean selected[KERNEL_NUMBER] = {0};
+	jab_boolean any_selected = 0;
+	jab_int32 color_number = 8, version = 12, ecc_level = DEFAULT_ECC_LEVEL, module_size = 8, iterations = 100;
+	jab_double error_rate = DEFAULT_ERROR_RATE;
+	jab_int32 payload_size = 10240, payload_type = 0;
+	jab_uint64 seed = 1;
+	jab_char* label = "";
+	jab_char* output = "micro.json";
+	for(jab_int32 i=1; i<argc; i++)
+	{
+		jab_boolean valid = (i+1 < argc);
+		if(valid && 0 == strcmp(argv[i], "--kernel"))
+		{
+			i++;
+			valid = 0;
+			for(jab_int32 k=0; k<KERNEL_NUMBER; k++)
+			{
+				if(0 == strcmp(argv[i], kernels[k].name))
+				{
+					selected[k] = 1;
+					any_selected = 1;
+					valid = 1;
+				}
+			}
+		}
+		else if(valid && 0 == strcmp(argv[i], "--color-number"))
+		{
+			//the decoder only derives palette thresholds for 4 and 8 colors
+			color_number = atoi(argv[++i]);
+			valid = (color_number == 4 || color_number == 8);
+		}
+		else if(valid && 0 == strcmp(argv[i], "--symbol-version"))
+		{
+			version = atoi(argv[++i]);
+			valid = (version >= 1 && version <= 32);
+		}
+		else if(valid && 0 == strcmp(argv[i], "--ecc-level"))
+		{
+			ecc_level = atoi(argv[++i]);
+			valid = (ecc_level >= 1 && ecc_level <= 10);
+		}
+		else if(valid && 0 == strcmp(argv[i], "--module-size"))
+		{
+			module_size = atoi(argv[++i]);
+			valid = (module_size >= 1 && module_size <= 100);
+		}
+		else if(valid && 0 == strcmp(argv[i], "--iterations"))
+		{
+			iterations = atoi(argv[++i]);
+			valid = (iterations >= 1 && iterations <= MAX_ITERATIONS);
+		}
+		else if(valid && 0 == strcmp(argv[i], "--payload-size"))
+		{
+			payload_size = atoi(argv[++i]);
+			valid = (payload_size >= 1 && payload_size <= MAX_PAYLOAD_SIZE);
+		}
+		else if(valid && 0 == strcmp(argv[i], "--payload-type"))
+		{
+			i++;
+			valid = 0;
+			for(jab_int32 t=0; t<PAYLOAD_TYPE_NUMBER; t++)
+			{
+				if(0 == strcmp(argv[i], payload_type_names[t]))
+				{
+					payload_type = t;
+					valid = 1;
+				}
+			}
+		}
+		else if(valid && 0 == strcmp(argv[i], "--error-rate"))
+		{
+			error_rate = atof(argv[++i]);
+			valid = (error_rate >= 0 && error_rate <= 50);
+		}
+		else if(valid && 0 == strcmp(argv[i], "--seed"))
+			seed = strtoull(argv[++i], NULL, 10);
+		else if(valid && 0 == strcmp(argv[i], "--label"))
+			label = argv[++i];
+		else if(valid && 0 == strcmp(argv[i], "--output"))
+			output = argv[++i];
+		else
+			valid = 0;
+		if(!valid)
+		{
+			printUsage();
+			return 1;
+		}
+	}
+	random_state = seed ? seed : 1;
+
+	//the kernels and the inputs share one scratch arena, its counters give the allocations of each run
+	jab_arena arena;
+	if(!initArena(&arena, 0))
+	{
+		reportError("Creating scratch arena failed");
+		return 1;
+	}
+	jab_arena* prev_arena = setScratchArena(&arena);
+	jab_micro_input in;
+	memset(&in, 0, sizeof(in));
+	if(!createInputs(&in, color_number, version, ecc_level, module_size, error_rate) || !createPayloadInputs(&in, payload_size, payload_type) ||
+	   !createVersionInputs(&in))
+	{
+		reportError("Creating the kernel inputs failed");
+		releaseInputs(&in);
+		setScratchArena(prev_arena);
+		releaseArena(&arena);
+		return 1;
+	}
+
+	//not stdout, the library reports errors there
+	FILE* out = fopen(output, "w");
+	if(out == NULL)
+	{
+		reportError("Opening the output file failed");
+		return 1;
+	}
+	fprintf(out, "{\n  \"library\": \"%s\", \"label\": \"%s\", \"seed\": %llu, \"iterations\": %d,\n", VERSION, label,
+			(unsigned long long)seed, iterations);
+	fprintf(out, "  \"input\": {\"colors\": %d, \"version\": %d, \"ecc\": %d, \"module_size\": %d, \"width\": %d, \"height\": %d, "
+			"\"data_modules\": %d, \"bits\": %d, \"ldpc_block\": %d, \"error_rate\": %.2f, \"codeword_bits\": %d, \"codeword_errors\": %d, "
+			"\"codeword_decoded\": %s, \"payload_bytes\": %d, \"payload_type\": \"%s\", "
+			"\"encoded_bits\": %d, \"stream_decoded\": %s},\n", color_number, version, ecc_level, module_size,
+			in.image->width, in.image->height, in.modules->length, in.bits->length, in.block_length, error_rate, in.codeword->length,
+			in.hd_errors, in.hd_decoded ? "true" : "false", in.payload->length, payload_type_names[payload_type],
+			in.encoded_length, in.stream_decoded ? "true" : "false");
+	fprintf(out, "  \"kernels\": [");
+	jab_int32 result = 0;
+	jab_boolean first = 1;
+	for(jab_int32 k=0; k<KERNEL_NUMBER; k++)
+	{
+		if(any_selected && !selected[k])
+			continue;
+		if(!benchKernel(out, &arena, &in, &kernels[k], iterations, first))
+			result = 1;
+		first = 0;
+	}
+	fprintf(out, "\n  ]\n}\n");
+	fclose(out);
+
+	releaseInputs(&in);
+	setScratchArena(prev_arena);
+	releaseArena(&arena);
+	return result;
+}
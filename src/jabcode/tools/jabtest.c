@@ -0,0 +1,159 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file jabtest.c
+ * @brief Regression tests of library internals that the round trip through jabcodeWriter and jabcodeReader does not catch
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "jabcode.h"
+#include "encoder.h"
+#include "decoder.h"
+
+#define MESSAGE_NUMBER	6
+
+extern void placeMasterMetadataPartII(jab_encode* enc);
+extern jab_boolean reserveBuffer(void** buffer, jab_int32* capacity, jab_int32 size);
+
+static const jab_char* messages[MESSAGE_NUMBER] = {"Hi", "Hello", "abc", "x", "Hi there 4 colours", "The quick brown fox"};
+
+/**
+ * @brief Get the position of a module of the master metadata in the order the encoder places them
+ * @param enc the encode parameter
+ * @param module_index the index of the module counted from the first module of Part I
+ * @param x the x coordinate of the module
+ * @param y the y coordinate of the module
+*/
+static void getMasterMetadataModule(jab_encode* enc, jab_int32 module_index, jab_int32* x, jab_int32* y)
+{
+	*x = MASTER_METADATA_X;
+	*y = MASTER_METADATA_Y;
+	for(jab_int32 i=1; i<=module_index; i++)
+	{
+		getNextMetadataModuleInMaster(enc->symbols[0].side_size.y, enc->symbols[0].side_size.x, i, x, y);
+	}
+}
+
+/**
+ * @brief Check that rewriting master metadata Part II for a non-default mask touches only the Part II modules.
+ * The module following Part II is set to the lowest and the highest color index in turn, and a guard byte after the
+ * encoded metadata is set to 0 and 1 in turn, so that placing Part II beyond its end changes the matrix whatever the
+ * values. Part II is placed again and the whole matrix has to stay as it was.
+ * @param enc the encode parameter holding a code with a non-default mask
+ * @return JAB_SUCCESS | JAB_FAILURE
+*/
+static jab_boolean checkPartIIPlacement(jab_encode* enc)
+{
+	jab_int32 nb_of_bits_per_mod = log(enc->color_number)/log(2);
+	jab_int32 color_palette_size = MIN(enc->color_number-2, 64-2);
+	jab_int32 partII_start = MASTER_METADATA_PART1_MODULE_NUMBER + color_palette_size*COLOR_PALETTE_NUMBER;
+	jab_int32 partII_modules = (MASTER_METADATA_PART2_LENGTH + nb_of_bits_per_mod - 1) / nb_of_bits_per_mod;
+	jab_int32 x, y;
+	getMasterMetadataModule(enc, partII_start + partII_modules, &x, &y);
+
+	jab_int32 metadata_length = enc->symbols[0].metadata->length;
+	if(!reserveBuffer((void**)&enc->symbols[0].metadata, &enc->symbols[0].metadata_capacity, sizeof(jab_data) + metadata_length + 1))
+	{
+		reportError("Memory allocation for metadata guard byte failed");
+		return JAB_FAILURE;
+	}
+	jab_int32 size = enc->symbols[0].side_size.x * enc->symbols[0].side_size.y;
+	jab_byte* matrix = enc->symbols[0].matrix;
+	jab_byte* expected = (jab_byte*)malloc(size);
+	if(expected == NULL)
+	{
+		reportError("Memory allocation for expected matrix failed");
+		return JAB_FAILURE;
+	}
+	jab_boolean ok = JAB_SUCCESS;
+	jab_byte original = matrix[y*enc->symbols[0].side_size.x + x];
+	jab_byte sentinels[2] = {0, (jab_byte)(enc->color_number - 1)};
+	for(jab_int32 i=0; i<4 && ok; i++)
+	{
+		enc->symbols[0].metadata->data[metadata_length] = i / 2;
+		matrix[y*enc->symbols[0].side_size.x + x] = sentinels[i % 2];
+		memcpy(expected, matrix, size);
+		placeMasterMetadataPartII(enc);
+		ok = (memcmp(expected, matrix, size) == 0);
+	}
+	matrix[y*enc->symbols[0].side_size.x + x] = original;
+	free(expected);
+	return ok;
+}
+
+/**
+ * @brief Encode codes with non-default masks for every color number up to 32 and check their Part II placement
+ * @return the number of failed checks
+*/
+static jab_int32 testMasterMetadataPartII(void)
+{
+	jab_int32 failed = 0;
+	//the metadata module order of the master symbol is only defined for the first 172 modules,
+	//which the color palettes of 64 and more colors exceed
+	for(jab_int32 color_number=4; color_number<=32; color_number*=2)
+	{
+		jab_int32 checked = 0;
+		jab_int32 masks = 0;	//bit set of the checked mask types
+		for(jab_int32 ecc_level=1; ecc_level<=10; ecc_level++)
+		{
+			for(jab_int32 m=0; m<MESSAGE_NUMBER; m++)
+			{
+				jab_encode* enc = createEncode(color_number, 1);
+				if(enc == NULL)
+				{
+					reportError("Creating encode parameter failed");
+					return failed + 1;
+				}
+				enc->record_stats = 1;
+				enc->symbol_ecc_levels[0] = ecc_level;
+				jab_int32 length = strlen(messages[m]);
+				jab_data* data = (jab_data*)malloc(sizeof(jab_data) + length);
+				if(data == NULL)
+				{
+					destroyEncode(enc);
+					reportError("Memory allocation for input data failed");
+					return failed + 1;
+				}
+				data->length = length;
+				memcpy(data->data, messages[m], length);
+				if(generateJABCode(enc, data) == 0 && enc->stats.mask_type != DEFAULT_MASKING_REFERENCE)
+				{
+					checked++;
+					masks |= 1 << enc->stats.mask_type;
+					if(!checkPartIIPlacement(enc))
+					{
+						printf("FAIL master metadata Part II: %d colors, ecc level %d, mask %d, message \"%s\"\n",
+							   color_number, ecc_level, enc->stats.mask_type, messages[m]);
+						failed++;
+					}
+				}
+				free(data);
+				destroyEncode(enc);
+			}
+		}
+		printf("master metadata Part II: %d colors, %d codes with non-default masks (mask set 0x%02x)\n", color_number, checked, masks);
+		if(checked == 0)
+		{
+			printf("FAIL master metadata Part II: no code with %d colors uses a non-default mask\n", color_number);
+			failed++;
+		}
+	}
+	return failed;
+}
+
+int main(int argc, char* argv[])
+{
+	jab_int32 failed = 0;
+	failed += testMasterMetadataPartII();
+	printf("%s\n", failed ? "FAILED" : "PASSED");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,240 @@
+/**
+ * libjabcode - JABCode Encoding/Decoding Library
+ *
+ * Copyright 2016 by Fraunhofer SIT. All rights reserved.
+ * See LICENSE file for full terms of use and distribution.
+ *
+ * Contact: Huajian Liu <liu@sit.fraunhofer.de>
+ *			Waldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>
+ *
+ * @file ldpctables.c
+ * @brief Generator of the precomputed LDPC parity check matrix tables in build/ldpc_tables.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jabcode.h"
+#include "encoder.h"
+#include "decoder.h"
+#include "ldpc.h"
+
+#define MAX_TABLE_NUMBER	4096
+
+extern jab_int32 getSymbolCapacity(jab_encode* enc, jab_int32 index);
+
+/**
+ * @brief The key of a parity check matrix
+*/
+typedef struct {
+	jab_int32 wc;
+	jab_int32 wr;
+	jab_int32 capacity;
+}jab_table_key;
+
+jab_table_key keys[MAX_TABLE_NUMBER];
+jab_int32 key_number = 0;
+
+/**
+ * @brief Add the key of a parity check matrix if it is new
+ * @param wc the number of '1's in a column
+ * @param wr the number of '1's in a row, 0 for metadata
+ * @param capacity the number of columns of the matrix
+*/
+void addKey(jab_int32 wc, jab_int32 wr, jab_int32 capacity)
+{
+	for(jab_int32 i=0; i<key_number; i++)
+	{
+		if(keys[i].wc == wc && keys[i].wr == wr && keys[i].capacity == capacity)
+			return;
+	}
+	if(key_number == MAX_TABLE_NUMBER)
+	{
+		reportError("Too many LDPC tables");
+		exit(1);
+	}
+	keys[key_number].wc = wc;
+	keys[key_number].wr = wr;
+	keys[key_number].capacity = capacity;
+	key_number++;
+}
+
+/**
+ * @brief Add the keys of the sub-block matrices used to decode a data stream, as split by decodeLDPChd
+ * @param wc the number of '1's in a column
+ * @param wr the number of '1's in a row
+ * @param length the length of the data stream
+*/
+void addDataKeys(jab_int32 wc, jab_int32 wr, jab_int32 length)
+{
+	jab_int32 Pg = wr * (length / wr);
+	jab_int32 Pn = Pg * (wr - wc) / wr;
+	jab_int32 nb_sub_blocks = 1;
+	while(Pg / nb_sub_blocks >= 2700)
+		nb_sub_blocks++;
+	jab_int32 Pg_sub_block = ((Pg / nb_sub_blocks) / wr) * wr;
+	jab_int32 Pn_sub_block = Pg_sub_block * (wr-wc) / wr;
+	if(Pg_sub_block == 0)
+		return;
+	addKey(wc, wr, Pg_sub_block);
+	nb_sub_blocks = Pg / Pg_sub_block;
+	if(Pn_sub_block * nb_sub_blocks < Pn)
+		addKey(wc, wr, Pg - (nb_sub_blocks - 1) * Pg_sub_block);
+}
+
+/**
+ * @brief Compare two keys by wr, wc and capacity
+*/
+int compareKeys(const void* a, const void* b)
+{
+	const jab_table_key* ka = (const jab_table_key*)a;
+	const jab_table_key* kb = (const jab_table_key*)b;
+	if(ka->wr != kb->wr) return ka->wr - kb->wr;
+	if(ka->wc != kb->wc) return ka->wc - kb->wc;
+	return ka->capacity - kb->capacity;
+}
+
+/**
+ * @brief Print an array of 16-bit values
+ * @param name the array name
+ * @param values the values
+ * @param length the number of values
+*/
+void printArray(jab_char* name, jab_int32* values, jab_int32 length)
+{
+	printf("static const jab_uint16 %s[] = {", name);
+	for(jab_int32 i=0; i<length; i++)
+	{
+		printf(i % 24 == 0 ? "\n\t%d," : "%d,", values[i]);
+	}
+	printf("%s};\n", length > 0 ? "\n" : "0");
+}
+
+/**
+ * @brief Print usage of the generator
+*/
+void printUsage()
+{
+	printf("\n");
+	printf("ldpctables (Version %s Build date: %s) - Fraunhofer SIT\n\n", VERSION, BUILD_DATE);
+	printf("Usage:\n\n");
+	printf("ldpctables [--color-number N]... [--ecc-level L]... > build/ldpc_tables.c\n");
+	printf("\n");
+	printf("--color-number\t\tNumber of colors of the symbols to generate tables for. (default: %d)\n", DEFAULT_COLOR_NUMBER);
+	printf("--ecc-level\t\tError correction level of the symbols to generate tables for. (default: %d)\n", DEFAULT_ECC_LEVEL);
+	printf("--help\t\t\tPrint this help.\n");
+	printf("\n");
+}
+
+int main(int argc, char* argv[])
+{
+	jab_int32 color_numbers[8], color_number_count = 0;
+	jab_int32 ecc_levels[11], ecc_level_count = 0;
+	for(jab_int32 i=1; i<argc; i++)
+	{
+		if(0 == strcmp(argv[i], "--color-number") && i+1 < argc && color_number_count < 8)
+			color_numbers[color_number_count++] = atoi(argv[++i]);
+		else if(0 == strcmp(argv[i], "--ecc-level") && i+1 < argc && ecc_level_count < 11)
+			ecc_levels[ecc_level_count++] = atoi(argv[++i]);
+		else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+	if(color_number_count == 0)
+		color_numbers[color_number_count++] = DEFAULT_COLOR_NUMBER;
+	if(ecc_level_count == 0)
+		ecc_levels[ecc_level_count++] = DEFAULT_ECC_LEVEL;
+
+	//master metadata, see decodeLDPChd
+	addKey(MASTER_METADATA_PART1_LENGTH/2 > 36 ? 3 : 2, 0, MASTER_METADATA_PART1_LENGTH);
+	addKey(MASTER_METADATA_PART2_LENGTH/2 > 36 ? 3 : 2, 0, MASTER_METADATA_PART2_LENGTH);
+	//data of square master and slave symbols
+	for(jab_int32 c=0; c<color_number_count; c++)
+	{
+		jab_encode* enc = createEncode(color_numbers[c], 2);
+		if(enc == NULL)
+		{
+			reportError("Creating encode parameter failed");
+			return 1;
+		}
+		for(jab_int32 l=0; l<ecc_level_count; l++)
+		{
+			if(ecc_levels[l] < 1 || ecc_levels[l] > 10)
+				continue;
+			enc->symbol_ecc_levels[0] = ecc_levels[l];
+			for(jab_int32 v=1; v<=32; v++)
+			{
+				for(jab_int32 index=0; index<2; index++)
+				{
+					enc->symbol_versions[index].x = v;
+					enc->symbol_versions[index].y = v;
+					addDataKeys(ecclevel2wcwr[ecc_levels[l]][0], ecclevel2wcwr[ecc_levels[l]][1], getSymbolCapacity(enc, index));
+				}
+			}
+		}
+		destroyEncode(enc);
+	}
+	qsort(keys, key_number, sizeof(jab_table_key), compareKeys);
+
+	printf("/**\n");
+	printf(" * libjabcode - JABCode Encoding/Decoding Library\n");
+	printf(" *\n");
+	printf(" * Copyright 2016 by Fraunhofer SIT. All rights reserved.\n");
+	printf(" * See LICENSE file for full terms of use and distribution.\n");
+	printf(" *\n");
+	printf(" * Contact: Huajian Liu <liu@sit.fraunhofer.de>\n");
+	printf(" *\t\t\tWaldemar Berchtold <waldemar.berchtold@sit.fraunhofer.de>\n");
+	printf(" *\n");
+	printf(" * @file ldpc_tables.c\n");
+	printf(" * @brief Precomputed LDPC parity check matrix tables, generated by 'make ldpc-tables'\n");
+	printf(" */\n\n");
+	printf("#include \"jabcode.h\"\n");
+	printf("#include \"ldpc.h\"\n\n");
+
+	jab_int32* matrix_ranks = (jab_int32*)malloc(key_number * sizeof(jab_int32));
+	jab_int32* swap_numbers = (jab_int32*)malloc(key_number * sizeof(jab_int32));
+	if(matrix_ranks == NULL || swap_numbers == NULL)
+	{
+		reportError("Memory allocation for LDPC tables failed");
+		return 1;
+	}
+	jab_int32 total_size = 0;
+	for(jab_int32 i=0; i<key_number; i++)
+	{
+		jab_int32* row_order = (jab_int32*)calloc(keys[i].capacity, sizeof(jab_int32));
+		jab_int32* swap_col = (jab_int32*)calloc(2*keys[i].capacity, sizeof(jab_int32));
+		if(row_order == NULL || swap_col == NULL)
+		{
+			reportError("Memory allocation for LDPC tables failed");
+			return 1;
+		}
+		if(getParityCheckOrder(keys[i].wc, keys[i].wr, keys[i].capacity, &matrix_ranks[i], row_order, swap_col, &swap_numbers[i]))
+		{
+			reportError("Gauss Jordan Elimination for LDPC tables failed");
+			return 1;
+		}
+		jab_int32 nb_pcb = keys[i].wr < 4 ? keys[i].capacity/2 : keys[i].capacity/keys[i].wr*keys[i].wc;
+		jab_char name[32];
+		sprintf(name, "row_order_%d", i);
+		printArray(name, row_order, nb_pcb);
+		sprintf(name, "swap_col_%d", i);
+		printArray(name, swap_col, 2*swap_numbers[i]);
+		total_size += (nb_pcb + 2*swap_numbers[i]) * sizeof(jab_uint16);
+		free(row_order);
+		free(swap_col);
+	}
+
+	printf("\nconst jab_ldpc_table jab_ldpc_tables[] = {\n");
+	for(jab_int32 i=0; i<key_number; i++)
+	{
+		printf("\t{%d, %d, %d, %d, %d, row_order_%d, swap_col_%d},\n", keys[i].wc, keys[i].wr, keys[i].capacity, matrix_ranks[i], swap_numbers[i], i, i);
+	}
+	printf("};\n");
+	printf("const jab_int32 jab_ldpc_table_number = %d;\n", key_number);
+	fprintf(stderr, "%d LDPC tables, %d bytes\n", key_number, total_size);
+	free(matrix_ranks);
+	free(swap_numbers);
+	return 0;
+}
@@ -17,6 +17,7 @@
 #include <math.h>
 #include "jabcode.h"
 #include "detector.h"
+#include "arena.h"
 
 /**
  * @brief Calculate transformation matrix of square to quadrilateral
@@ -28,19 +29,14 @@
  * @param y2 the y coordinate of the 3rd destination point
  * @param x3 the x coordinate of the 4th destination point
  * @param y3 the y coordinate of the 4th destination point
- * @return the transformation matrix
+ * @param pt the transformation matrix
 */
-jab_perspective_transform* square2Quad( jab_float x0, jab_float y0,
-										jab_float x1, jab_float y1,
-										jab_float x2, jab_float y2,
-										jab_float x3, jab_float y3)
+void square2Quad( jab_float x0, jab_float y0,
+				  jab_float x1, jab_float y1,
+				  jab_float x2, jab_float y2,
+				  jab_float x3, jab_float y3,
+				  jab_perspective_transform* pt)
 {
-	jab_perspective_transform* pt = (jab_perspective_transform*)malloc(sizeof(jab_perspective_transform));
-	if(pt == NULL)
-	{
-		reportError("Memory allocation for perspective transform failed");
-		return NULL;
-	}
 	jab_float dx3 = x0 - x1 + x2 - x3;
 	jab_float dy3 = y0 - y1 + y2 - y3;
 	if (dx3 == 0 && dy3 == 0) {
@@ -53,7 +49,6 @@ jab_perspective_transform* square2Quad( jab_float x0, jab_float y0,
         pt->a13 = 0;
         pt->a23 = 0;
         pt->a33 = 1;
-		return pt;
 	}
 	else
 	{
@@ -73,7 +68,6 @@ jab_perspective_transform* square2Quad( jab_float x0, jab_float y0,
 		pt->a13 = a13;
 		pt->a23 = a23;
 		pt->a33 = 1;
-		return pt;
 	}
 }
 
@@ -87,48 +81,36 @@ jab_perspective_transform* square2Quad( jab_float x0, jab_float y0,
  * @param y2 the y coordinate of the 3rd source point
  * @param x3 the x coordinate of the 4th source point
  * @param y3 the y coordinate of the 4th source point
- * @return the transformation matrix
+ * @param pt the transformation matrix
 */
-jab_perspective_transform* quad2Square( jab_float x0, jab_float y0,
-										jab_float x1, jab_float y1,
-										jab_float x2, jab_float y2,
-										jab_float x3, jab_float y3)
+void quad2Square( jab_float x0, jab_float y0,
+				  jab_float x1, jab_float y1,
+				  jab_float x2, jab_float y2,
+				  jab_float x3, jab_float y3,
+				  jab_perspective_transform* pt)
 {
-	jab_perspective_transform* pt = (jab_perspective_transform*)malloc(sizeof(jab_perspective_transform));
-	if(pt == NULL)
-	{
-		reportError("Memory allocation for perspective transform failed");
-		return NULL;
-	}
-	jab_perspective_transform* s2q = square2Quad(x0, y0, x1, y1, x2, y2, x3, y3);
+	jab_perspective_transform s2q;
+	square2Quad(x0, y0, x1, y1, x2, y2, x3, y3, &s2q);
 	//calculate the adjugate matrix of s2q
-	pt->a11 = s2q->a22 * s2q->a33 - s2q->a23 * s2q->a32;
-	pt->a21 = s2q->a23 * s2q->a31 - s2q->a21 * s2q->a33;
-	pt->a31 = s2q->a21 * s2q->a32 - s2q->a22 * s2q->a31;
-	pt->a12 = s2q->a13 * s2q->a32 - s2q->a12 * s2q->a33;
-	pt->a22 = s2q->a11 * s2q->a33 - s2q->a13 * s2q->a31;
-	pt->a32 = s2q->a12 * s2q->a31 - s2q->a11 * s2q->a32;
-	pt->a13 = s2q->a12 * s2q->a23 - s2q->a13 * s2q->a22;
-	pt->a23 = s2q->a13 * s2q->a21 - s2q->a11 * s2q->a23;
-	pt->a33 = s2q->a11 * s2q->a22 - s2q->a12 * s2q->a21;
-	free(s2q);
-	return pt;
+	pt->a11 = s2q.a22 * s2q.a33 - s2q.a23 * s2q.a32;
+	pt->a21 = s2q.a23 * s2q.a31 - s2q.a21 * s2q.a33;
+	pt->a31 = s2q.a21 * s2q.a32 - s2q.a22 * s2q.a31;
+	pt->a12 = s2q.a13 * s2q.a32 - s2q.a12 * s2q.a33;
+	pt->a22 = s2q.a11 * s2q.a33 - s2q.a13 * s2q.a31;
+	pt->a32 = s2q.a12 * s2q.a31 - s2q.a11 * s2q.a32;
+	pt->a13 = s2q.a12 * s2q.a23 - s2q.a13 * s2q.a22;
+	pt->a23 = s2q.a13 * s2q.a21 - s2q.a11 * s2q.a23;
+	pt->a33 = s2q.a11 * s2q.a22 - s2q.a12 * s2q.a21;
 }
 
 /**
  * @brief Calculate matrix multiplication
  * @param m1 the multiplicand
  * @param m2 the multiplier
- * @return m1 x m2
+ * @param product m1 x m2, must not alias m1 or m2
 */
-jab_perspective_transform* multiply(jab_perspective_transform* m1, jab_perspective_transform* m2)
+void multiply(jab_perspective_transform* m1, jab_perspective_transform* m2, jab_perspective_transform* product)
 {
-	jab_perspective_transform* product = (jab_perspective_transform*)malloc(sizeof(jab_perspective_transform));
-	if(product == NULL)
-	{
-		reportError("Memory allocation for perpective transform failed");
-		return NULL;
-	}
 	product->a11 = m1->a11 * m2->a11 + m1->a12 * m2->a21 + m1->a13 * m2->a31;
     product->a21 = m1->a21 * m2->a11 + m1->a22 * m2->a21 + m1->a23 * m2->a31;
     product->a31 = m1->a31 * m2->a11 + m1->a32 * m2->a21 + m1->a33 * m2->a31;
@@ -138,7 +120,42 @@ jab_perspective_transform* multiply(jab_perspective_transform* m1, jab_perspecti
     product->a13 = m1->a11 * m2->a13 + m1->a12 * m2->a23 + m1->a13 * m2->a33;
     product->a23 = m1->a21 * m2->a13 + m1->a22 * m2->a23 + m1->a23 * m2->a33;
     product->a33 = m1->a31 * m2->a13 + m1->a32 * m2->a23 + m1->a33 * m2->a33;
-    return product;
+}
+
+/**
+ * @brief Calculate transformation matrix of quadrilateral to quadrilateral into caller-provided storage
+ * @param x0 the x coordinate of the 1st source point
+ * @param y0 the y coordinate of the 1st source point
+ * @param x1 the x coordinate of the 2nd source point
+ * @param y1 the y coordinate of the 2nd source point
+ * @param x2 the x coordinate of the 3rd source point
+ * @param y2 the y coordinate of the 3rd source point
+ * @param x3 the x coordinate of the 4th source point
+ * @param y3 the y coordinate of the 4th source point
+ * @param x0p the x coordinate of the 1st destination point
+ * @param y0p the y coordinate of the 1st destination point
+ * @param x1p the x coordinate of the 2nd destination point
+ * @param y1p the y coordinate of the 2nd destination point
+ * @param x2p the x coordinate of the 3rd destination point
+ * @param y2p the y coordinate of the 3rd destination point
+ * @param x3p the x coordinate of the 4th destination point
+ * @param y3p the y coordinate of the 4th destination point
+ * @param pt the transformation matrix
+*/
+void calcPerspectiveTransform(jab_float x0, jab_float y0,
+							  jab_float x1, jab_float y1,
+							  jab_float x2, jab_float y2,
+							  jab_float x3, jab_float y3,
+							  jab_float x0p, jab_float y0p,
+							  jab_float x1p, jab_float y1p,
+							  jab_float x2p, jab_float y2p,
+							  jab_float x3p, jab_float y3p,
+							  jab_perspective_transform* pt)
+{
+	jab_perspective_transform q2s, s2q;
+	quad2Square(x0, y0, x1, y1, x2, y2, x3, y3, &q2s);
+	square2Quad(x0p, y0p, x1p, y1p, x2p, y2p, x3p, y3p, &s2q);
+	multiply(&q2s, &s2q, pt);
 }
 
 /**
@@ -159,7 +176,7 @@ jab_perspective_transform* multiply(jab_perspective_transform* m1, jab_perspecti
  * @param y2p the y coordinate of the 3rd destination point
  * @param x3p the x coordinate of the 4th destination point
  * @param y3p the y coordinate of the 4th destination point
- * @return the transformation matrix
+ * @return the transformation matrix | NULL if failed
 */
 jab_perspective_transform* perspectiveTransform(jab_float x0, jab_float y0,
 												jab_float x1, jab_float y1,
@@ -170,23 +187,15 @@ jab_perspective_transform* perspectiveTransform(jab_float x0, jab_float y0,
 												jab_float x2p, jab_float y2p,
 												jab_float x3p, jab_float y3p)
 {
-	jab_perspective_transform* q2s = quad2Square(x0, y0, x1, y1, x2, y2, x3, y3);
-	if(q2s == NULL)
-	{
-		return NULL;
-	}
-	jab_perspective_transform* s2q = square2Quad(x0p, y0p, x1p, y1p, x2p, y2p, x3p, y3p);
-	if(s2q == NULL)
-	{
-		return NULL;
-	}
-	jab_perspective_transform* pt = multiply(q2s, s2q);
+	jab_perspective_transform* pt = (jab_perspective_transform*)scratchMalloc(sizeof(jab_perspective_transform));
 	if(pt == NULL)
 	{
+		reportError("Memory allocation for perspective transform failed");
 		return NULL;
 	}
-	free(q2s);
-	free(s2q);
+	calcPerspectiveTransform(x0, y0, x1, y1, x2, y2, x3, y3,
+							 x0p, y0p, x1p, y1p, x2p, y2p, x3p, y3p,
+							 pt);
 	return pt;
 }
 
@@ -42,19 +42,12 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	//load image
-	jab_bitmap* bitmap;
-	bitmap = readImage(argv[1]);
-	if(bitmap == NULL)
-		return 255;
-
-	//find and decode JABCode in the image
+	//read the image and find and decode JABCode in it
 	jab_int32 decode_status;
 	jab_decoded_symbol symbols[MAX_SYMBOL_NUMBER];
-	jab_data* decoded_data = decodeJABCodeEx(bitmap, NORMAL_DECODE, &decode_status, symbols, MAX_SYMBOL_NUMBER);
+	jab_data* decoded_data = decodeJABCodeFromFile(NULL, argv[1], NORMAL_DECODE, &decode_status, symbols, MAX_SYMBOL_NUMBER);
 	if(decoded_data == NULL)
 	{
-		free(bitmap);
 		reportError("Decoding JABCode failed");
 		if(decode_status > 0)
 			return (jab_int32)(symbols[0].module_size + 0.5f);
@@ -87,7 +80,6 @@ int main(int argc, char *argv[])
 		printf("\n");
 	}
 
-	free(bitmap);
 	free(decoded_data);
     return 0;
 }
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include "jabcode.h"
@@ -18,6 +19,7 @@ jab_int32 		symbol_versions_number = 0;
 jab_int32* 		symbol_ecc_levels = 0;
 jab_int32 		symbol_ecc_levels_number = 0;
 jab_int32		color_space = 0;
+jab_boolean		module_image = 0;
 
 /**
  * @brief Print usage of JABCode writer
@@ -49,6 +51,9 @@ void printUsage()
 							  "multi-symbol code.\n");
 	printf("--color-space\t\tColor space of output image (0:RGB,1:CMYK,default:0).\n\t\t\t"
 							"RGB image is saved as PNG and CMYK image as TIFF.\n");
+	printf("--module-image		Save a PNG image with one pixel per module. The module\n\t\t\t"
+							"size is recorded in the image and jabcodeReader\n\t\t\t"
+							"decodes it without detection.\n");
     printf("--help\t\t\tPrint this help.\n");
     printf("\n");
     printf("Example for 1-symbol-code: \n");
@@ -99,9 +104,14 @@ jab_boolean parseCommandLineParameters(jab_int32 para_number, jab_char* para[])
 				reportError("Opening input data file failed");
                 return 0;
             }
-			jab_int32 file_size;
 			fseek(fp, 0, SEEK_END);
-			file_size = ftell(fp);
+			long file_size = ftell(fp);
+			if(file_size < 0 || file_size > INT32_MAX - (long)sizeof(jab_data))
+			{
+				reportError("Invalid input data file size");
+				fclose(fp);
+				return 0;
+			}
 			if(data) free(data);
             data = (jab_data *)malloc(sizeof(jab_data) + file_size * sizeof(jab_char));
             if(!data)
@@ -110,7 +120,7 @@ jab_boolean parseCommandLineParameters(jab_int32 para_number, jab_char* para[])
                 return 0;
             }
             fseek(fp, 0, SEEK_SET);
-            if(fread(data->data, 1, file_size, fp) != file_size)
+            if(fread(data->data, 1, file_size, fp) != (size_t)file_size)
             {
 				reportError("Reading input data file failed");
 				free(data);
@@ -240,9 +250,18 @@ jab_boolean parseCommandLineParameters(jab_int32 para_number, jab_char* para[])
 				return 0;
             }
         }
+		else if (0 == strcmp(para[loop],"--module-image"))
+		{
+			module_image = 1;
+		}
 	}
 
 	//check input
+	if(module_image && color_space != 0)
+	{
+		reportError("Module image is only available in RGB color space");
+		return 0;
+	}
     if(!data)
     {
 		reportError("Input data missing");
@@ -458,6 +477,10 @@ int main(int argc, char *argv[])
     {
 		enc->master_symbol_height = master_symbol_height;
     }
+	if(module_image)
+	{
+		enc->output_mode = MODULE_MATRIX_OUTPUT;
+	}
 	for(jab_int32 loop=0; loop<symbol_number; loop++)
 	{
 		if(symbol_ecc_levels)
@@ -479,7 +502,19 @@ int main(int argc, char *argv[])
 
 	//save bitmap in image file
 	jab_int32 result = 0;
-	if(color_space == 0)
+	if(module_image)
+	{
+		jab_data* png = saveModuleImageToMemory(enc->module_matrix, -1, ROW_FILTER_DEFAULT);
+		FILE* fp = fopen(filename, "wb");
+		if(png == NULL || fp == NULL || fwrite(png->data, 1, png->length, fp) != (size_t)png->length)
+		{
+			reportError("Saving module image failed");
+			result = 1;
+		}
+		if(fp) fclose(fp);
+		free(png);
+	}
+	else if(color_space == 0)
 	{
 		if(!saveImage(enc->bitmap, filename))
 		{